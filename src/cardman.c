@@ -39,6 +39,7 @@
 #include "cardman.h"
 #include "convert.h"
 #include "membuf.h"
+#include "gpacontext.h"
 
 #include "gpagenkeycardop.h"
 
@@ -50,6 +51,15 @@
 #include "cm-unknown.h"
 
 
+/* Intervals in milliseconds used to poll scdaemon for card status
+   changes.  After each poll without a change the interval is doubled
+   up to the maximum.  If we are notified about changes by the file
+   watcher, polling is only used as a safety net.  */
+#define POLL_INTERVAL_MIN          1000
+#define POLL_INTERVAL_MAX         16000
+#define POLL_INTERVAL_MAX_WATCHED 60000
+
+
 
 /* Object's class definition.  */
 struct _GpaCardManagerClass
@@ -78,8 +88,29 @@ struct _GpaCardManager
   const char *cardtypename;  /* String with the card type's name.  */
   GType cardtype;            /* Widget type of a supported card.  */
 
-  gpa_filewatch_id_t watch;  /* For watching the reader status file.  */
+  gpa_filewatch_id_t watch;  /* For watching the reader status files.  */
   int in_card_reload;        /* Sentinel for card_reload.  */
+  GpaContext *reloadctx;     /* Context used for the card reload.  */
+  int reload_state;          /* State of the card reload sequence.  */
+  int reload_pending;        /* Reload again after the current one.  */
+  int reload_auto_app;       /* Application is selected automatically.  */
+  char *reload_command;      /* The SERIALNO command used.  */
+  gpg_error_t reload_err;    /* Error of the first SERIALNO command.  */
+  gpg_error_t reload_result; /* Result of the last command.  */
+  const char *reload_err_desc;  /* Error description for the widget.  */
+  int reload_force;          /* Next reload must not use the cache.  */
+  int reload_forced;         /* The current reload doesn't use the cache.  */
+  char *reload_serialno;     /* Serial number seen by the current reload.  */
+
+  /* The card shown by the current card widget.  If the event counter
+     did not change, the card widget is still valid and there is no
+     need to read the card again.  */
+  struct {
+    int valid;
+    char *serialno;
+    unsigned int eventcounter;
+    GType cardtype;
+  } cache;
 
 
   gpgme_ctx_t gpgagent;      /* Gpgme context for the assuan
@@ -87,6 +118,9 @@ struct _GpaCardManager
 
 
   guint ticker_timeout_id;   /* Source Id of the timeout ticker or 0.  */
+  guint ticker_interval;     /* Current interval of the ticker.  */
+  GpaContext *pollctx;       /* Context used by the ticker.  */
+  int poll_changed;          /* The last poll detected a change.  */
 
 
   struct {
@@ -96,6 +130,19 @@ struct _GpaCardManager
 
 };
 
+/* States of the card reload sequence.  */
+enum
+  {
+    RELOAD_IDLE = 0,
+    RELOAD_CHECK,
+    RELOAD_SERIALNO,
+    RELOAD_RESTART,
+    RELOAD_SERIALNO_RETRY,
+    RELOAD_SERIALNO_UNDEF,
+    RELOAD_EVENTCOUNTER,
+    RELOAD_APPTYPE
+  };
+
 /* There is only one instance of the card manager class.  Use a global
    variable to keep track of it.  */
 static GpaCardManager *this_instance;
@@ -103,6 +150,11 @@ static GpaCardManager *this_instance;
 
 /* Local prototypes */
 static void start_ticker (GpaCardManager *cardman);
+static gboolean ticker_cb (gpointer user_data);
+static void card_reload (GpaCardManager *cardman);
+static void do_card_reload (GpaCardManager *cardman);
+static void reload_step (GpaCardManager *cardman, gpg_error_t err);
+static void reload_send_serialno (GpaCardManager *cardman);
 static void update_card_widget (GpaCardManager *cardman, const char *err_desc);
 
 static void gpa_card_manager_finalize (GObject *object);
@@ -257,6 +309,11 @@ scd_status_cb (void *opaque, const char *status, const char *args)
         cardman->cardtypename = "Unknown";
 
     }
+  else if (!strcmp (status, "SERIALNO"))
+    {
+      g_free (cardman->reload_serialno);
+      cardman->reload_serialno = g_strndup (args, strcspn (args, " "));
+    }
   else if ( !strcmp (status, "EVENTCOUNTER") )
     {
       unsigned int count;
@@ -279,177 +336,364 @@ card_reload_finish_idle_cb (void *user_data)
   GpaCardManager *cardman = user_data;
 
   cardman->in_card_reload--;
+  if (!cardman->in_card_reload && cardman->reload_pending
+      && cardman == this_instance)
+    do_card_reload (cardman);
   g_object_unref (cardman);
 
   return FALSE;  /* Remove us from the idle queue. */
 }
 
 
-/* This function is called to trigger a card-reload.  */
+/* Send the next command of the card reload sequence.  The result is
+   delivered to reload_done_cb.  */
 static void
-card_reload (GpaCardManager *cardman)
+reload_send (GpaCardManager *cardman, int state, const char *command,
+             int want_status)
 {
-  gpg_error_t err, operr;
-  const char *application;
-  char *command_buf = NULL;
-  const char *command;
-  const char *err_desc = NULL;
-  char *err_desc_buffer = NULL;
-  int auto_app;
+  gpg_error_t err;
 
-  if (!cardman->gpgagent)
-    return;  /* No support for GPGME_PROTOCOL_ASSUAN.  */
+  cardman->reload_state = state;
+  err = gpgme_op_assuan_transact_start (cardman->reloadctx->ctx, command,
+                                        scd_data_cb, NULL,
+                                        scd_inq_cb, NULL,
+                                        want_status? scd_status_cb : NULL,
+                                        cardman);
+  if (err)
+    reload_step (cardman, err);
+}
 
-  /* Start the ticker if not yet done.  */
-  start_ticker (cardman);
-  if (!cardman->in_card_reload)
+
+/* Finish the card reload sequence and display the result.  */
+static void
+reload_finish (GpaCardManager *cardman)
+{
+  cardman->reload_state = RELOAD_IDLE;
+
+  /* If this is still the same card, the card widget is up to date
+     and we don't need to read all the data again.  */
+  if (!cardman->reload_forced
+      && !cardman->reload_err_desc
+      && cardman->cache.valid
+      && cardman->reload_serialno
+      && !strcmp (cardman->reload_serialno, cardman->cache.serialno)
+      && cardman->eventcounter.card_any
+      && cardman->eventcounter.card == cardman->cache.eventcounter
+      && cardman->cardtype == cardman->cache.cardtype
+      && GPA_IS_CM_OBJECT (cardman->card_widget))
+    ;
+  else
+    update_card_widget (cardman, cardman->reload_err_desc);
+
+  g_free (cardman->cache.serialno);
+  cardman->cache.serialno = cardman->reload_serialno;
+  cardman->reload_serialno = NULL;
+  cardman->cache.eventcounter = cardman->eventcounter.card;
+  cardman->cache.cardtype = cardman->cardtype;
+  cardman->cache.valid = (!cardman->reload_err_desc
+                          && cardman->cache.serialno
+                          && cardman->eventcounter.card_any
+                          && GPA_IS_CM_OBJECT (cardman->card_widget));
+
+  cardman->reload_err_desc = NULL;
+  update_title (cardman);
+
+  update_info_visibility (cardman);
+  /* We decrement our lock using a idle handler with lo priority.
+     This gives us a better chance not to do a reload a second time
+     on behalf of the file watcher or ticker.  */
+  g_object_ref (cardman);
+  g_idle_add_full (G_PRIORITY_LOW,
+                   card_reload_finish_idle_cb, cardman, NULL);
+}
+
+
+/* Evaluate the error ERR of a failed SERIALNO command.  */
+static void
+reload_serialno_failed (GpaCardManager *cardman, gpg_error_t err)
+{
+  if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
+      || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
     {
-      cardman->in_card_reload++;
+      cardman->reload_err_desc = _("No card found.");
+    }
+  else if (gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+           && gpg_err_code (err) == GPG_ERR_CONFLICT)
+    {
+      cardman->reload_err_desc = cardman->reload_auto_app
+        ? _("The selected card application is currently not available.")
+        : _("Another process is using a different card application "
+            "than the selected one.\n\n"
+            "You may change the application selection mode to "
+            "\"Auto\" to select the active application.");
+    }
+  else if (!cardman->reload_auto_app
+           && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+           && gpg_err_code (err) == GPG_ERR_NOT_SUPPORTED)
+    {
+      cardman->reload_err_desc =
+        _("The selected card application is not available.");
+    }
+  else
+    {
+      g_debug ("assuan command `%s' failed: %s <%s>\n",
+               cardman->reload_command, gpg_strerror (err),
+               gpg_strsource (err));
+      reload_send (cardman, RELOAD_SERIALNO_UNDEF,
+                   "SCD SERIALNO undefined", 0);
+      return;
+    }
 
-      update_info_visibility (cardman);
+  reload_finish (cardman);
+}
 
-      cardman->cardtype = G_TYPE_NONE;
-      cardman->cardtypename = "Unknown";
-
-      /* The first thing we need to do is to issue the SERIALNO
-         command; this makes sure that scdaemon initalizes the card if
-         that has not yet been done.  */
-      command = "SCD SERIALNO";
-      if (cardman->app_selector
-          && (gtk_combo_box_get_active
-              (GTK_COMBO_BOX (cardman->app_selector)) > 0)
-          && (application = gtk_combo_box_get_active_text
-              (GTK_COMBO_BOX (cardman->app_selector))))
+
+/* Advance the card reload sequence after a command completed with
+   ERR.  */
+static void
+reload_step (GpaCardManager *cardman, gpg_error_t err)
+{
+  if (gpg_err_code (err) == GPG_ERR_CANCELED && cardman->reload_pending)
+    {
+      /* The card changed while we were reading it.  Start over.  */
+      cardman->reload_state = RELOAD_IDLE;
+      cardman->reload_err_desc = NULL;
+      cardman->in_card_reload--;
+      do_card_reload (cardman);
+      return;
+    }
+
+  switch (cardman->reload_state)
+    {
+    case RELOAD_CHECK:
+      if (!err && cardman->eventcounter.card_any
+          && cardman->eventcounter.card == cardman->cache.eventcounter)
+        {
+          /* Nothing changed - keep the current card widget.  */
+          cardman->reload_state = RELOAD_IDLE;
+          update_info_visibility (cardman);
+          g_object_ref (cardman);
+          g_idle_add_full (G_PRIORITY_LOW,
+                           card_reload_finish_idle_cb, cardman, NULL);
+        }
+      else
+        reload_send_serialno (cardman);
+      break;
+
+    case RELOAD_SERIALNO:
+      if (!err)
+        reload_send (cardman, RELOAD_EVENTCOUNTER, "GETEVENTCOUNTER", 1);
+      else if (!cardman->reload_auto_app
+               && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+               && gpg_err_code (err) == GPG_ERR_CONFLICT)
         {
-          command_buf = g_strdup_printf ("%s %s", command, application);
-          command = command_buf;
-          auto_app = 0;
+          /* Not in auto select mode and the scdaemon told us about a
+             conflicting use.  We now do a restart and try again to
+             display an application selection conflict error only if
+             it is not due to our own connection to the scdaemon.  */
+          cardman->reload_err = err;
+          reload_send (cardman, RELOAD_RESTART, "SCD RESTART", 0);
         }
       else
-        auto_app = 1;
-      err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                          command,
-                                          scd_data_cb, NULL,
-                                          scd_inq_cb, NULL,
-                                          scd_status_cb, cardman, &operr);
+        reload_serialno_failed (cardman, err);
+      break;
+
+    case RELOAD_RESTART:
+      if (!err)
+        reload_send (cardman, RELOAD_SERIALNO_RETRY,
+                     cardman->reload_command, 1);
+      else
+        reload_serialno_failed (cardman, cardman->reload_err);
+      break;
+
+    case RELOAD_SERIALNO_RETRY:
+      if (!err)
+        reload_send (cardman, RELOAD_EVENTCOUNTER, "GETEVENTCOUNTER", 1);
+      else
+        reload_serialno_failed (cardman, err);
+      break;
+
+    case RELOAD_SERIALNO_UNDEF:
       if (!err)
+        reload_send (cardman, RELOAD_EVENTCOUNTER, "GETEVENTCOUNTER", 1);
+      else
         {
-          err = operr;
-          if (!auto_app
-              && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-              && gpg_err_code (err) == GPG_ERR_CONFLICT)
-            {
-              /* Not in auto select mode and the scdaemon told us
-                 about a conflicting use.  We now do a restart and try
-                 again to display an application selection conflict
-                 error only if it is not due to our own connection to
-                 the scdaemon.  */
-              if (!gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                                 "SCD RESTART",
-                                                 NULL, NULL, NULL, NULL,
-                                                 NULL, NULL, &operr)
-                  && !operr)
-                {
-                  err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                                      command,
-                                                      scd_data_cb, NULL,
-                                                      scd_inq_cb, NULL,
-                                                      scd_status_cb, cardman,
-                                                      &operr);
-                  if (!err)
-                    err = operr;
-                }
-            }
+          cardman->reload_err_desc = _("Error accessing the card.");
+          statusbar_update (cardman, _("Error accessing card"));
+          reload_finish (cardman);
         }
+      break;
 
+    case RELOAD_EVENTCOUNTER:
+      /* We got the event counter to avoid a duplicate reload due to
+         the ticker.  Now we need to get the APPTYPE of the card so
+         that the correct GpaCM* object can can act on the data.  */
+      reload_send (cardman, RELOAD_APPTYPE, "SCD GETATTR APPTYPE", 1);
+      break;
 
+    case RELOAD_APPTYPE:
       if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
           || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
-        {
-          err_desc = _("No card found.");
-        }
-      else if (gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-               && gpg_err_code (err) == GPG_ERR_CONFLICT)
-        {
-          err_desc = auto_app
-            ? _("The selected card application is currently not available.")
-            : _("Another process is using a different card application "
-                "than the selected one.\n\n"
-                "You may change the application selection mode to "
-                "\"Auto\" to select the active application.");
-        }
-      else if (!auto_app
-               && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-               && gpg_err_code (err) == GPG_ERR_NOT_SUPPORTED)
-        {
-          err_desc =
-            _("The selected card application is not available.");
-        }
+        statusbar_update (cardman, _("No card"));
       else if (err)
         {
           g_debug ("assuan command `%s' failed: %s <%s>\n",
-                   command, gpg_strerror (err), gpg_strsource (err));
-          if (!gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                             "SCD SERIALNO undefined",
-                                             NULL, NULL, NULL, NULL,
-                                             NULL, NULL, &operr) && !operr)
-            err = 0;
-          else
-            {
-              err_desc = _("Error accessing the card.");
-              statusbar_update (cardman, _("Error accessing card"));
-            }
+                   "SCD GETATTR APPTYPE", gpg_strerror (err),
+                   gpg_strsource (err));
+          statusbar_update (cardman, _("Error accessing card"));
         }
-      g_free (command_buf);
+      reload_finish (cardman);
+      break;
 
+    default:
+      break;
+    }
+}
 
-      if (!err)
+
+/* Idle queue callback to continue the card reload sequence.  */
+static gboolean
+reload_step_idle_cb (void *user_data)
+{
+  GpaCardManager *cardman = user_data;
+
+  /* Don't touch the widgets if the window has been closed.  */
+  if (cardman == this_instance)
+    reload_step (cardman, cardman->reload_result);
+  g_object_unref (cardman);
+
+  return FALSE;  /* Remove us from the idle queue. */
+}
+
+
+/* Signal handler for the "done" signal of the reload context.  We
+   can't start the next command from within GPGME's callback; thus
+   this is done from the idle queue.  */
+static void
+reload_done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  GpaCardManager *cardman = user_data;
+
+  cardman->reload_result = err;
+  g_object_ref (cardman);
+  g_idle_add (reload_step_idle_cb, cardman);
+}
+
+
+/* Start the card reload sequence with the SERIALNO command.  */
+static void
+reload_send_serialno (GpaCardManager *cardman)
+{
+  const char *command;
+  char *application;
+
+  cardman->cardtype = G_TYPE_NONE;
+  cardman->cardtypename = "Unknown";
+  update_info_visibility (cardman);
+
+  g_free (cardman->reload_serialno);
+  cardman->reload_serialno = NULL;
+
+  /* The first thing we need to do is to issue the SERIALNO command;
+     this makes sure that scdaemon initalizes the card if that has not
+     yet been done.  */
+  command = "SCD SERIALNO";
+  g_free (cardman->reload_command);
+  if (cardman->app_selector
+      && (gtk_combo_box_get_active
+          (GTK_COMBO_BOX (cardman->app_selector)) > 0)
+      && (application = gtk_combo_box_get_active_text
+          (GTK_COMBO_BOX (cardman->app_selector))))
+    {
+      cardman->reload_command = g_strdup_printf ("%s %s",
+                                                 command, application);
+      g_free (application);
+      cardman->reload_auto_app = 0;
+    }
+  else
+    {
+      cardman->reload_command = g_strdup (command);
+      cardman->reload_auto_app = 1;
+    }
+
+  reload_send (cardman, RELOAD_SERIALNO, cardman->reload_command, 1);
+}
+
+
+/* Start a card reload.  The reload is done asynchronously; the card
+   widget is updated when all required information has been received.
+   Unless a forced reload has been requested, the card is only read
+   if the event counter changed since the last reload.  */
+static void
+do_card_reload (GpaCardManager *cardman)
+{
+  if (!cardman->gpgagent)
+    return;  /* No support for GPGME_PROTOCOL_ASSUAN.  */
+
+  /* Start the ticker if not yet done.  */
+  start_ticker (cardman);
+
+  if (!cardman->reloadctx)
+    {
+      cardman->reloadctx = gpa_context_new ();
+      if (gpgme_set_protocol (cardman->reloadctx->ctx, GPGME_PROTOCOL_ASSUAN))
         {
-          /* Get the event counter to avoid a duplicate reload due to
-             the ticker.  */
-          gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                        "GETEVENTCOUNTER",
-                                        NULL, NULL,
-                                        NULL, NULL,
-                                        scd_status_cb, cardman, NULL);
-
-          /* Now we need to get the APPTYPE of the card so that the
-             correct GpaCM* object can can act on the data.  */
-          command = "SCD GETATTR APPTYPE";
-          err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                              command,
-                                              scd_data_cb, NULL,
-                                              scd_inq_cb, NULL,
-                                              scd_status_cb, cardman, &operr);
-          if (!err)
-            err = operr;
-
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
-              || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
-            statusbar_update (cardman, _("No card"));
-          else if (err)
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-              statusbar_update (cardman, _("Error accessing card"));
-            }
+          g_object_unref (cardman->reloadctx);
+          cardman->reloadctx = NULL;
+          return;
         }
+      g_signal_connect (G_OBJECT (cardman->reloadctx), "done",
+                        G_CALLBACK (reload_done_cb), cardman);
+    }
+
+  if (cardman->reload_state != RELOAD_IDLE)
+    {
+      /* Do it again after the current reload.  */
+      cardman->reload_pending = 1;
+      return;
+    }
 
+  if (!cardman->in_card_reload)
+    {
+      cardman->in_card_reload++;
+      cardman->reload_pending = 0;
+      cardman->reload_err_desc = NULL;
+      cardman->reload_forced = cardman->reload_force;
+      cardman->reload_force = 0;
+
+      /* Asking for the event counter does not access the card.  */
+      if (!cardman->reload_forced && cardman->cache.valid)
+        reload_send (cardman, RELOAD_CHECK, "GETEVENTCOUNTER", 1);
+      else
+        reload_send_serialno (cardman);
+    }
+}
 
-      update_card_widget (cardman, err_desc);
-      g_free (err_desc_buffer);
-      err_desc_buffer = NULL;
-      err_desc = NULL;
-      update_title (cardman);
 
-      update_info_visibility (cardman);
-      /* We decrement our lock using a idle handler with lo priority.
-         This gives us a better chance not to do a reload a second
-         time on behalf of the file watcher or ticker.  */
-      g_object_ref (cardman);
-      g_idle_add_full (G_PRIORITY_LOW,
-                       card_reload_finish_idle_cb, cardman, NULL);
+/* This function is called to trigger a card-reload which reads the
+   card even if it has not changed.  */
+static void
+card_reload (GpaCardManager *cardman)
+{
+  cardman->reload_force = 1;
+  if (cardman->in_card_reload && cardman->reload_state == RELOAD_IDLE)
+    cardman->reload_pending = 1;  /* Run it after the current one.  */
+  do_card_reload (cardman);
+}
+
+
+/* Request a reload because the card status may have changed.  A
+   reload in progress is cancelled and restarted.  */
+static void
+card_changed (GpaCardManager *cardman)
+{
+  if (cardman->reload_state != RELOAD_IDLE)
+    {
+      cardman->reload_pending = 1;
+      gpgme_cancel (cardman->reloadctx->ctx);
     }
+  else if (!cardman->in_card_reload)
+    do_card_reload (cardman);
 }
 
 
@@ -500,6 +744,7 @@ geteventcounter_status_cb (void *opaque, const char *status, const char *args)
                  from the user hitting the reload button.  */
               g_object_ref (cardman);
               g_idle_add (card_reload_idle_cb, cardman);
+              cardman->poll_changed = 1;
             }
           cardman->eventcounter.card_any = 1;
           cardman->eventcounter.card = count;
@@ -509,28 +754,77 @@ geteventcounter_status_cb (void *opaque, const char *status, const char *args)
   return 0;
 }
 
+
+/* Schedule the next run of the ticker.  If RESET is set the minimum
+   interval is used; otherwise the interval is doubled.  */
+static void
+schedule_ticker (GpaCardManager *cardman, int reset)
+{
+  guint max_interval;
+
+  if (disable_ticker)
+    return;
+
+  max_interval = (cardman->watch
+                  ? POLL_INTERVAL_MAX_WATCHED : POLL_INTERVAL_MAX);
+  if (reset || !cardman->ticker_interval)
+    cardman->ticker_interval = POLL_INTERVAL_MIN;
+  else if (cardman->ticker_interval < max_interval)
+    cardman->ticker_interval = MIN (2 * cardman->ticker_interval,
+                                    max_interval);
+
+  if (cardman->ticker_timeout_id)
+    g_source_remove (cardman->ticker_timeout_id);
+  cardman->ticker_timeout_id = g_timeout_add (cardman->ticker_interval,
+                                              ticker_cb, cardman);
+}
+
+
+/* Signal handler for the "done" signal of the ticker's context.  */
+static void
+ticker_done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  GpaCardManager *cardman = user_data;
+
+  schedule_ticker (cardman, cardman->poll_changed);
+}
+
+
 /* This function is called by the timeout ticker started by
    start_ticker.  It is used to poll scdaemon to detect a card status
-   change.  */
+   change.  The request is sent asynchronously so that a slow agent
+   does not block the main loop.  */
 static gboolean
 ticker_cb (gpointer user_data)
 {
   GpaCardManager *cardman = user_data;
+  gpg_error_t err;
 
-  if (!cardman || !cardman->ticker_timeout_id || !cardman->gpgagent
-      || cardman->in_card_reload)
-    return TRUE;  /* Keep on ticking.  */
+  cardman->ticker_timeout_id = 0;
+  if (!cardman->gpgagent || !cardman->pollctx)
+    return FALSE;
 
-  /* Note that we are single threaded and thus there is no need to
-     lock the assuan context.  */
+  if (cardman->in_card_reload || gpa_context_busy (cardman->pollctx))
+    {
+      /* Try again later.  */
+      schedule_ticker (cardman, 0);
+      return FALSE;
+    }
 
-  gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                "GETEVENTCOUNTER",
-                                NULL, NULL,
-                                NULL, NULL,
-                                geteventcounter_status_cb, cardman, NULL);
+  cardman->poll_changed = 0;
+  err = gpgme_op_assuan_transact_start (cardman->pollctx->ctx,
+                                        "GETEVENTCOUNTER",
+                                        NULL, NULL,
+                                        NULL, NULL,
+                                        geteventcounter_status_cb, cardman);
+  if (err)
+    {
+      g_debug ("assuan command `GETEVENTCOUNTER' failed: %s <%s>\n",
+               gpg_strerror (err), gpg_strsource (err));
+      schedule_ticker (cardman, 0);
+    }
 
-  return TRUE;  /* Keep on ticking.  */
+  return FALSE;  /* The ticker is rescheduled by ticker_done_cb.  */
 }
 
 
@@ -538,18 +832,42 @@ ticker_cb (gpointer user_data)
 static void
 start_ticker (GpaCardManager *cardman)
 {
+  gpg_error_t err;
+
   if (disable_ticker)
     return;
 
-  if (!cardman->ticker_timeout_id)
+  if (!cardman->pollctx)
     {
-#if GTK_CHECK_VERSION (2, 14, 0)
-      cardman->ticker_timeout_id = g_timeout_add_seconds (1,
-                                                          ticker_cb, cardman);
-#else
-      cardman->ticker_timeout_id = g_timeout_add (1000, ticker_cb, cardman);
-#endif
+      cardman->pollctx = gpa_context_new ();
+      err = gpgme_set_protocol (cardman->pollctx->ctx, GPGME_PROTOCOL_ASSUAN);
+      if (err)
+        {
+          g_object_unref (cardman->pollctx);
+          cardman->pollctx = NULL;
+          return;
+        }
+      g_signal_connect (G_OBJECT (cardman->pollctx), "done",
+                        G_CALLBACK (ticker_done_cb), cardman);
     }
+
+  if (!cardman->ticker_timeout_id && !gpa_context_busy (cardman->pollctx))
+    schedule_ticker (cardman, 1);
+}
+
+
+/* Signal handler for the "focus-in-event".  A user looking at the
+   window expects a quick update; thus we poll at a high rate again.  */
+static gboolean
+focus_in_cb (GtkWidget *widget, GdkEventFocus *event, gpointer user_data)
+{
+  GpaCardManager *cardman = user_data;
+
+  if (cardman->ticker_timeout_id
+      && cardman->ticker_interval > POLL_INTERVAL_MIN)
+    schedule_ticker (cardman, 1);
+
+  return FALSE;
 }
 
 
@@ -616,15 +934,23 @@ card_genkey_action (GtkAction *action, gpointer param)
 }
 
 
+/* Callback for the file watch on the GnuPG home directory.  Scdaemon
+   updates the file "reader_N.status" whenever the status of a reader
+   changes.  */
 static void
 watcher_cb (void *opaque, const char *filename, const char *reason)
 {
   GpaCardManager *cardman = opaque;
+  char *name;
+  int is_status;
 
-  if (cardman && strchr (reason, 'w') && !cardman->in_card_reload)
-    {
-      card_reload (cardman);
-    }
+  name = g_path_get_basename (filename);
+  is_status = (g_str_has_prefix (name, "reader_")
+               && g_str_has_suffix (name, ".status"));
+  g_free (name);
+
+  if (cardman && is_status && strchr (reason, 'w'))
+    card_changed (cardman);
 }
 
 
@@ -988,7 +1314,6 @@ gpa_card_manager_init (GTypeInstance *instance, void *class_ptr)
 {
   GpaCardManager *cardman = GPA_CARD_MANAGER (instance);
   gpg_error_t err;
-  char *fname;
 
   cardman->cardtype = G_TYPE_NONE;
   cardman->cardtypename = "Unknown";
@@ -998,14 +1323,18 @@ gpa_card_manager_init (GTypeInstance *instance, void *class_ptr)
 
   g_signal_connect (cardman, "destroy",
                     G_CALLBACK (card_manager_closed), cardman);
+  g_signal_connect (cardman, "focus-in-event",
+                    G_CALLBACK (focus_in_cb), cardman);
 
 
-  /* We use the file watcher to speed up card change detection.  If it
-     does not work (i.e. on non Linux based systems) the ticker takes
-     care of it.  */
-  fname = g_build_filename (gnupg_homedir, "reader_0.status", NULL);
-  cardman->watch = gpa_add_filewatch (fname, "w", watcher_cb, cardman);
-  xfree (fname);
+  /* We use the file watcher for card change detection.  The
+     directory is watched so that we also notice status files created
+     after we started and those of further readers.  If it does not
+     work (i.e. on non Linux based systems) the ticker takes care of
+     it.  */
+  cardman->watch = gpa_add_filewatch (gnupg_homedir, "w",
+                                      watcher_cb, cardman);
+  gpa_filewatch_set_debounce (cardman->watch, 100);
 
   err = gpgme_new (&cardman->gpgagent);
   if (err)
@@ -1049,7 +1378,32 @@ gpa_card_manager_finalize (GObject *object)
       cardman->ticker_timeout_id = 0;
     }
 
-  /* FIXME: Remove the watch object and all other resources.  */
+  if (cardman->pollctx)
+    {
+      g_signal_handlers_disconnect_by_func (cardman->pollctx,
+                                            ticker_done_cb, cardman);
+      g_object_unref (cardman->pollctx);
+      cardman->pollctx = NULL;
+    }
+
+  if (cardman->reloadctx)
+    {
+      g_signal_handlers_disconnect_by_func (cardman->reloadctx,
+                                            reload_done_cb, cardman);
+      g_object_unref (cardman->reloadctx);
+      cardman->reloadctx = NULL;
+    }
+  g_free (cardman->reload_command);
+  cardman->reload_command = NULL;
+  g_free (cardman->reload_serialno);
+  cardman->reload_serialno = NULL;
+  g_free (cardman->cache.serialno);
+  cardman->cache.serialno = NULL;
+
+  gpa_remove_filewatch (cardman->watch);
+  cardman->watch = NULL;
+
+  /* FIXME: Remove all other resources.  */
 
   G_OBJECT_CLASS (g_type_class_peek_parent
                   (GPA_CM_OPENPGP_GET_CLASS (cardman)))->finalize (object);
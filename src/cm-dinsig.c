@@ -79,6 +79,9 @@ struct _GpaCMDinsig
   GtkWidget *entries[ENTRY_LAST];
 
   int  reloading;   /* Sentinel to avoid recursive reloads.  */
+
+  /* The state of an asynchronous reload or NULL.  */
+  struct scd_getattr_parm *getattrparm;
 };
 
 /* The parent class.  */
@@ -113,6 +116,7 @@ struct scd_getattr_parm
   const char *name;   /* Name of expected attribute.  */
   int entry_id;       /* The identifier for the entry.  */
   void (*updfnc) (GpaCMDinsig *card, int entry_id, char *string);
+  int attridx;        /* Index of the attribute in ATTRTBL.  */
 };
 
 
@@ -149,57 +153,97 @@ scd_getattr_cb (void *opaque, const char *status, const char *args)
 }
 
 
-/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+/* The attributes we display and the functions to update them.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMDinsig *card, int entry_id, char *string);
+} attrtbl[] = {
+  { "SERIALNO",    ENTRY_SERIALNO },
+  { NULL }
+};
+
+
+static void reload_getattr_done (GpaCMObject *obj, gpg_error_t err,
+                                 void *opaque);
+
+/* Request the next attribute or finish the reload.  */
 static void
-reload_data (GpaCMDinsig *card)
+reload_next_attr (GpaCMDinsig *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMDinsig *card, int entry_id, char *string);
-  } attrtbl[] = {
-    { "SERIALNO",    ENTRY_SERIALNO },
-    { NULL }
-  };
-  int attridx;
-  gpg_error_t err, operr;
+  struct scd_getattr_parm *parm = card->getattrparm;
   char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
+  gpg_error_t err;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  if (!attrtbl[parm->attridx].name)
+    {
+      xfree (parm);
+      card->getattrparm = NULL;
+      card->reloading--;
+      return;
+    }
 
-  card->reloading++;
-  parm.card = card;
-  for (attridx=0; attrtbl[attridx].name; attridx++)
+  parm->card     = card;
+  parm->name     = attrtbl[parm->attridx].name;
+  parm->entry_id = attrtbl[parm->attridx].entry_id;
+  parm->updfnc   = attrtbl[parm->attridx].updfnc;
+  snprintf (command, sizeof command, "SCD GETATTR %s", parm->name);
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), command,
+                                NULL, NULL,
+                                scd_getattr_cb, parm,
+                                reload_getattr_done, NULL);
+  if (err)
+    reload_getattr_done (GPA_CM_OBJECT (card), err, NULL);
+}
+
+
+/* Completion callback for the GETATTR commands of reload_data.  */
+static void
+reload_getattr_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMDinsig *card = GPA_CM_DINSIG (obj);
+  struct scd_getattr_parm *parm = card->getattrparm;
+
+  if (err)
     {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err)
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
+          g_debug ("assuan command `SCD GETATTR %s' failed: %s <%s>\n",
+                   parm->name, gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
+      xfree (parm);
+      card->getattrparm = NULL;
+      card->reloading--;
+      return;
+    }
+
+  parm->attridx++;
+  reload_next_attr (card);
+}
+
+
+/* Use the assuan machinery to load the bulk of the DINSIG card data.
+   The attributes are requested one after the other without blocking
+   the GUI.  */
+static void
+reload_data (GpaCMDinsig *card)
+{
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_ctx);
+
+  if (card->getattrparm)
+    {
+      gpa_cm_object_transact_cancel (GPA_CM_OBJECT (card));
+      xfree (card->getattrparm);
+      card->reloading--;
     }
-  card->reloading--;
+
+  card->reloading++;
+  card->getattrparm = xcalloc (1, sizeof *card->getattrparm);
+  card->getattrparm->card = card;
+  reload_next_attr (card);
 }
 
 
@@ -324,7 +368,10 @@ gpa_cm_dinsig_init (GTypeInstance *instance, void *class_ptr)
 static void
 gpa_cm_dinsig_finalize (GObject *object)
 {
-/*   GpaCMDinsig *card = GPA_CM_DINSIG (object); */
+  GpaCMDinsig *card = GPA_CM_DINSIG (object);
+
+  xfree (card->getattrparm);
+  card->getattrparm = NULL;
 
   parent_class->finalize (object);
 }
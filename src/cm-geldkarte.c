@@ -82,6 +82,9 @@ struct _GpaCMGeldkarte
   GtkWidget *general_frame;
 
   GtkWidget *entries[ENTRY_LAST];
+
+  /* The state of an asynchronous reload or NULL.  */
+  struct scd_getattr_parm *getattrparm;
 };
 
 /* The parent class.  */
@@ -115,6 +118,7 @@ struct scd_getattr_parm
   const char *name;      /* Name of expected attribute.  */
   int entry_id;          /* The identifier for the entry.  */
   void (*updfnc) (GpaCMGeldkarte *card, int entry_id, const char *string);
+  int attridx;           /* Index of the attribute in ATTRTBL.  */
 };
 
 
@@ -144,62 +148,103 @@ scd_getattr_cb (void *opaque, const char *status, const char *args)
 }
 
 
-/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+/* The attributes we display and the functions to update them.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMGeldkarte *card, int entry_id,  const char *string);
+} attrtbl[] = {
+  { "X-KBLZ",      ENTRY_KBLZ },
+  { "X-BANKINFO",  ENTRY_BANKTYPE },
+  { "X-CARDNO",    ENTRY_CARDNO },
+  { "X-EXPIRES",   ENTRY_EXPIRES },
+  { "X-VALIDFROM", ENTRY_VALIDFROM },
+  { "X-COUNTRY",   ENTRY_COUNTRY },
+  { "X-CURRENCY",  ENTRY_CURRENCY },
+  { "X-ZKACHIPID", ENTRY_ZKACHIPID },
+  { "X-OSVERSION", ENTRY_OSVERSION },
+  { "X-BALANCE",   ENTRY_BALANCE },
+  { "X-MAXAMOUNT", ENTRY_MAXAMOUNT },
+  { "X-MAXAMOUNT1",ENTRY_MAXAMOUNT1 },
+  { NULL }
+};
+
+
+static void reload_getattr_done (GpaCMObject *obj, gpg_error_t err,
+                                 void *opaque);
+
+/* Request the next attribute or finish the reload.  */
 static void
-reload_data (GpaCMGeldkarte *card, gpgme_ctx_t gpgagent)
+reload_next_attr (GpaCMGeldkarte *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMGeldkarte *card, int entry_id,  const char *string);
-  } attrtbl[] = {
-    { "X-KBLZ",      ENTRY_KBLZ },
-    { "X-BANKINFO",  ENTRY_BANKTYPE },
-    { "X-CARDNO",    ENTRY_CARDNO },
-    { "X-EXPIRES",   ENTRY_EXPIRES },
-    { "X-VALIDFROM", ENTRY_VALIDFROM },
-    { "X-COUNTRY",   ENTRY_COUNTRY },
-    { "X-CURRENCY",  ENTRY_CURRENCY },
-    { "X-ZKACHIPID", ENTRY_ZKACHIPID },
-    { "X-OSVERSION", ENTRY_OSVERSION },
-    { "X-BALANCE",   ENTRY_BALANCE },
-    { "X-MAXAMOUNT", ENTRY_MAXAMOUNT },
-    { "X-MAXAMOUNT1",ENTRY_MAXAMOUNT1 },
-    { NULL }
-  };
-  int attridx;
-  gpg_error_t err, operr;
+  struct scd_getattr_parm *parm = card->getattrparm;
   char command[100];
-  struct scd_getattr_parm parm;
+  gpg_error_t err;
 
-  parm.card = card;
-  for (attridx=0; attrtbl[attridx].name; attridx++)
+  if (!attrtbl[parm->attridx].name)
     {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err)
+      xfree (parm);
+      card->getattrparm = NULL;
+      return;
+    }
+
+  parm->card     = card;
+  parm->name     = attrtbl[parm->attridx].name;
+  parm->entry_id = attrtbl[parm->attridx].entry_id;
+  parm->updfnc   = attrtbl[parm->attridx].updfnc;
+  snprintf (command, sizeof command, "SCD GETATTR %s", parm->name);
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), command,
+                                NULL, NULL,
+                                scd_getattr_cb, parm,
+                                reload_getattr_done, NULL);
+  if (err)
+    reload_getattr_done (GPA_CM_OBJECT (card), err, NULL);
+}
+
+
+/* Completion callback for the GETATTR commands of reload_data.  */
+static void
+reload_getattr_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMGeldkarte *card = GPA_CM_GELDKARTE (obj);
+  struct scd_getattr_parm *parm = card->getattrparm;
+
+  if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
+          g_debug ("assuan command `SCD GETATTR %s' failed: %s <%s>\n",
+                   parm->name, gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
+      xfree (parm);
+      card->getattrparm = NULL;
+      return;
+    }
+
+  parm->attridx++;
+  reload_next_attr (card);
+}
+
+
+/* Use the assuan machinery to load the bulk of the Geldkarte data.
+   The attributes are requested one after the other without blocking
+   the GUI.  */
+static void
+reload_data (GpaCMGeldkarte *card, gpgme_ctx_t gpgagent)
+{
+  g_return_if_fail (gpgagent);
+
+  if (card->getattrparm)
+    {
+      gpa_cm_object_transact_cancel (GPA_CM_OBJECT (card));
+      xfree (card->getattrparm);
     }
+  card->getattrparm = xcalloc (1, sizeof *card->getattrparm);
+  card->getattrparm->card = card;
+  reload_next_attr (card);
 }
 
 
@@ -347,7 +392,10 @@ gpa_cm_geldkarte_init (GTypeInstance *instance, void *class_ptr)
 static void
 gpa_cm_geldkarte_finalize (GObject *object)
 {
-/*   GpaCMGeldkarte *card = GPA_CM_GELDKARTE (object); */
+  GpaCMGeldkarte *card = GPA_CM_GELDKARTE (object);
+
+  xfree (card->getattrparm);
+  card->getattrparm = NULL;
 
   parent_class->finalize (object);
 }
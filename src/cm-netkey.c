@@ -103,6 +103,10 @@ struct _GpaCMNetkey
 
   int  reloading;   /* Sentinel to avoid recursive reloads.  */
 
+  /* The state of an asynchronous reload or NULL.  */
+  struct scd_getattr_parm *getattrparm;
+  /* The state of an asynchronous reload of the keys or NULL.  */
+  struct reload_more_data_parm *moreparm;
 };
 
 /* The parent class.  */
@@ -272,11 +276,9 @@ reload_more_data_cb (void *opaque, const char *status, const char *args)
   const char *keyid;
   int any = 0;
 
-  g_debug ("  reload_more_data (%s=%s)", status, args);
   if (strcmp (status, "KEYPAIRINFO") )
     return 0;
 
-  g_debug ("   start search");
   idx = 0;
   pattern[idx++] = '&';
   for (s=args; hexdigitp (s) && idx < sizeof pattern - 1; s++)
@@ -320,63 +322,44 @@ reload_more_data_cb (void *opaque, const char *status, const char *args)
   gpgme_op_keylist_end (parm->ctx);
   if (!any)
     parm->any_unknown = 1;
-  g_debug ("   ready");
   return 0;
 }
 
 
-/* Reload more data.  This function is called from the idle handler.  */
+/* Stop a reload in progress.  */
 static void
-reload_more_data (GpaCMNetkey *card)
+reload_cancel (GpaCMNetkey *card)
 {
-  gpg_error_t err, operr;
-  gpgme_ctx_t gpgagent;
-  GtkWidget *vbox;
-  struct reload_more_data_parm parm;
-
-  g_debug ("start reload_more_data (count=%d)", card->reloading);
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
-  g_return_if_fail (card->keys_frame);
-  g_debug ("  gpgagent=%p", gpgagent);
-
-  /* We remove any existing children of the keys frame and then we add
-     a new vbox to be filled with new widgets by the callback.  */
-  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
-  if (vbox)
-    gtk_widget_destroy (vbox);
-  vbox = gtk_vbox_new (FALSE, 5);
-  gtk_container_add (GTK_CONTAINER (card->keys_frame), vbox);
-
-  /* Create a context for key listings.  */
-  parm.any_unknown = 0;
-  parm.card = card;
-  err = gpgme_new (&parm.ctx);
-  if (err)
+  gpa_cm_object_transact_cancel (GPA_CM_OBJECT (card));
+  if (card->getattrparm)
     {
-      /* We don't want an error window because we are run from an idle
-         handler and the information is not that important.  */
-      g_debug ("failed to create a context: %s", gpg_strerror (err));
-      return;
+      xfree (card->getattrparm);
+      card->getattrparm = NULL;
+      card->reloading--;
     }
-  gpgme_set_protocol (parm.ctx, GPGME_PROTOCOL_CMS);
-  /* We include ephemeral keys in the listing.  */
-  gpgme_set_keylist_mode (parm.ctx, GPGME_KEYLIST_MODE_EPHEMERAL);
+  if (card->moreparm)
+    {
+      gpgme_release (card->moreparm->ctx);
+      xfree (card->moreparm);
+      card->moreparm = NULL;
+      card->reloading--;
+    }
+}
 
-  g_debug ("  parm.ctx=%p", parm.ctx);
 
-  err = gpgme_op_assuan_transact_ext (gpgagent,
-                                      "SCD LEARN --keypairinfo",
-                                      NULL, NULL, NULL, NULL,
-                                      reload_more_data_cb, &parm, &operr);
-  g_debug ("  assuan ret=%d", err);
-  if (!err)
-    err = operr;
+/* Completion callback for the LEARN command of reload_more_data.  */
+static void
+reload_more_data_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMNetkey *card = GPA_CM_NETKEY (obj);
+  struct reload_more_data_parm *parm = card->moreparm;
+  GtkWidget *vbox;
 
   if (err)
     g_debug ("SCD LEARN failed: %s", gpg_strerror (err));
 
-  if (parm.any_unknown)
+  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
+  if (parm->any_unknown && vbox)
     {
       GtkWidget *button, *align;
 
@@ -403,30 +386,76 @@ reload_more_data (GpaCMNetkey *card)
                         G_CALLBACK (learn_keys_clicked_cb), card);
     }
 
-  gpgme_release (parm.ctx);
+  gpgme_release (parm->ctx);
+  xfree (parm);
+  card->moreparm = NULL;
+  card->reloading--;
   gtk_widget_show_all (card->keys_frame);
-  g_debug ("end   reload_more_data (count=%d)", card->reloading);
-  return;
 }
 
 
-/* Idle queue callback to reload more data.  */
-static gboolean
-reload_more_data_idle_cb (void *user_data)
+/* Reload more data.  The keypair information is requested
+   asynchronously and the keys are added to the keys frame by
+   reload_more_data_cb as they arrive.  */
+static void
+reload_more_data (GpaCMNetkey *card)
 {
-  GpaCMNetkey *card = user_data;
+  gpg_error_t err;
+  GtkWidget *vbox;
+  struct reload_more_data_parm *parm;
+
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_ctx);
+  g_return_if_fail (card->keys_frame);
+
+  /* Restart a key reload in progress.  */
+  if (card->moreparm)
+    reload_cancel (card);
+
+  /* We remove any existing children of the keys frame and then we add
+     a new vbox to be filled with new widgets by the callback.  */
+  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
+  if (vbox)
+    gtk_widget_destroy (vbox);
+  vbox = gtk_vbox_new (FALSE, 5);
+  gtk_container_add (GTK_CONTAINER (card->keys_frame), vbox);
 
-  if (card->reloading)
+  /* Create a context for key listings.  */
+  parm = xcalloc (1, sizeof *parm);
+  parm->card = card;
+  err = gpgme_new (&parm->ctx);
+  if (err)
     {
-      g_debug ("already reloading (count=%d)", card->reloading);
-    return TRUE; /* Just in case we are still reloading, wait for the
-                    next idle slot.  */
+      /* We don't want an error window because we are run from an idle
+         handler and the information is not that important.  */
+      g_debug ("failed to create a context: %s", gpg_strerror (err));
+      xfree (parm);
+      return;
     }
+  gpgme_set_protocol (parm->ctx, GPGME_PROTOCOL_CMS);
+  /* We include ephemeral keys in the listing.  */
+  gpgme_set_keylist_mode (parm->ctx, GPGME_KEYLIST_MODE_EPHEMERAL);
 
+  card->moreparm = parm;
   card->reloading++;
-  reload_more_data (card);
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card),
+                                "SCD LEARN --keypairinfo",
+                                NULL, NULL,
+                                reload_more_data_cb, parm,
+                                reload_more_data_done, NULL);
+  if (err)
+    reload_more_data_done (GPA_CM_OBJECT (card), err, NULL);
+}
+
+
+/* Idle queue callback to reload more data.  */
+static gboolean
+reload_more_data_idle_cb (void *user_data)
+{
+  GpaCMNetkey *card = user_data;
+
+  if (!card->getattrparm)
+    reload_more_data (card);  /* Otherwise the reload does it.  */
   g_object_unref (card);
-  card->reloading--;
 
   return FALSE;  /* Remove us from the idle queue.  */
 }
@@ -438,6 +467,7 @@ struct scd_getattr_parm
   const char *name;   /* Name of expected attribute.  */
   int entry_id;       /* The identifier for the entry.  */
   void (*updfnc) (GpaCMNetkey *card, int entry_id, char *string);
+  int attridx;        /* Index of the attribute in ATTRTBL.  */
 };
 
 
@@ -474,77 +504,105 @@ scd_getattr_cb (void *opaque, const char *status, const char *args)
 }
 
 
-/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+/* The attributes we display and the functions to update them.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMNetkey *card, int entry_id, char *string);
+} attrtbl[] = {
+  { "SERIALNO",    ENTRY_SERIALNO },
+  { "NKS-VERSION", ENTRY_NKS_VERSION },
+  { "CHV-STATUS",  ENTRY_PIN_RETRYCOUNTER, update_entry_chv_status },
+  { NULL }
+};
+
+
+static void reload_getattr_done (GpaCMObject *obj, gpg_error_t err,
+                                 void *opaque);
+
+/* Request the next attribute or continue with the keys if all
+   attributes have been received.  */
 static void
-reload_data (GpaCMNetkey *card)
+reload_next_attr (GpaCMNetkey *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMNetkey *card, int entry_id, char *string);
-  } attrtbl[] = {
-    { "SERIALNO",    ENTRY_SERIALNO },
-    { "NKS-VERSION", ENTRY_NKS_VERSION },
-    { "CHV-STATUS",  ENTRY_PIN_RETRYCOUNTER, update_entry_chv_status },
-    { NULL }
-  };
-  int attridx;
-  gpg_error_t err = 0;
-  gpg_error_t operr;
+  struct scd_getattr_parm *parm = card->getattrparm;
   char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
+  gpg_error_t err;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  if (!attrtbl[parm->attridx].name)
+    {
+      xfree (parm);
+      card->getattrparm = NULL;
+      card->reloading--;
+      reload_more_data (card);
+      return;
+    }
 
-  card->reloading++;
-  g_debug ("uped reloading counter (count=%d)", card->reloading);
+  parm->card     = card;
+  parm->name     = attrtbl[parm->attridx].name;
+  parm->entry_id = attrtbl[parm->attridx].entry_id;
+  parm->updfnc   = attrtbl[parm->attridx].updfnc;
+  snprintf (command, sizeof command, "SCD GETATTR %s", parm->name);
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), command,
+                                NULL, NULL,
+                                scd_getattr_cb, parm,
+                                reload_getattr_done, NULL);
+  if (err)
+    reload_getattr_done (GPA_CM_OBJECT (card), err, NULL);
+}
 
-  /* Show all attributes.  */
-  parm.card = card;
-  for (attridx=0; attrtbl[attridx].name; attridx++)
-    {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
 
-      if (err && attrtbl[attridx].entry_id == ENTRY_NKS_VERSION)
-        {
-          /* The NKS-VERSION is only supported by GnuPG > 2.0.11
-             thus we ignore the error.  */
-          gtk_label_set_text
-            (GTK_LABEL (card->entries[attrtbl[attridx].entry_id]),
-             _("unknown"));
-        }
-      else if (err)
-        {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
-        }
+/* Completion callback for the GETATTR commands of reload_data.  */
+static void
+reload_getattr_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMNetkey *card = GPA_CM_NETKEY (obj);
+  struct scd_getattr_parm *parm = card->getattrparm;
+
+  if (err && parm->entry_id == ENTRY_NKS_VERSION)
+    {
+      /* The NKS-VERSION is only supported by GnuPG > 2.0.11
+         thus we ignore the error.  */
+      gtk_label_set_text
+        (GTK_LABEL (card->entries[parm->entry_id]), _("unknown"));
     }
-  if (!err)
+  else if (err)
     {
-      g_object_ref (card);
-      g_idle_add (reload_more_data_idle_cb, card);
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
+        {
+          g_debug ("assuan command `SCD GETATTR %s' failed: %s <%s>\n",
+                   parm->name, gpg_strerror (err), gpg_strsource (err));
+        }
+      clear_card_data (card);
+      xfree (parm);
+      card->getattrparm = NULL;
+      card->reloading--;
+      return;
     }
-  card->reloading--;
-  g_debug ("downed reloading counter (count=%d)", card->reloading);
+
+  parm->attridx++;
+  reload_next_attr (card);
+}
+
+
+/* Use the assuan machinery to load the bulk of the NetKey card data.
+   The attributes are requested one after the other without blocking
+   the GUI; the keys are loaded thereafter.  A reload in progress is
+   restarted.  */
+static void
+reload_data (GpaCMNetkey *card)
+{
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_ctx);
+
+  reload_cancel (card);
+
+  card->reloading++;
+
+  card->getattrparm = xcalloc (1, sizeof *card->getattrparm);
+  card->getattrparm->card = card;
+  reload_next_attr (card);
 }
 
 
@@ -1035,7 +1093,16 @@ gpa_cm_netkey_init (GTypeInstance *instance, void *class_ptr)
 static void
 gpa_cm_netkey_finalize (GObject *object)
 {
-/*   GpaCMNetkey *card = GPA_CM_NETKEY (object); */
+  GpaCMNetkey *card = GPA_CM_NETKEY (object);
+
+  xfree (card->getattrparm);
+  card->getattrparm = NULL;
+  if (card->moreparm)
+    {
+      gpgme_release (card->moreparm->ctx);
+      xfree (card->moreparm);
+      card->moreparm = NULL;
+    }
 
   parent_class->finalize (object);
 }
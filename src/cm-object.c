@@ -58,7 +58,10 @@ static GObjectClass *parent_class;
 static guint signals [LAST_SIGNAL];
 
 /* Local prototypes */
+static void gpa_cm_object_dispose (GObject *object);
 static void gpa_cm_object_finalize (GObject *object);
+static void transact_done_cb (GpaContext *context, gpg_error_t err,
+                              GpaCMObject *obj);
 
 
 
@@ -80,6 +83,7 @@ gpa_cm_object_class_init (void *class_ptr, void *class_data)
 
   parent_class = g_type_class_peek_parent (klass);
 
+  G_OBJECT_CLASS (klass)->dispose = gpa_cm_object_dispose;
   G_OBJECT_CLASS (klass)->finalize = gpa_cm_object_finalize;
 
   signals[UPDATE_STATUS] =
@@ -110,6 +114,26 @@ gpa_cm_object_init (GTypeInstance *instance, void *class_ptr)
 }
 
 
+/* The status callbacks of a running command access the child
+   widgets; thus we need to stop it before they are destroyed.  */
+static void
+gpa_cm_object_dispose (GObject *object)
+{
+  GpaCMObject *obj = GPA_CM_OBJECT (object);
+
+  if (obj->transact_ctx)
+    {
+      gpa_cm_object_transact_cancel (obj);
+      g_signal_handlers_disconnect_by_func (obj->transact_ctx,
+                                            transact_done_cb, obj);
+      g_object_unref (obj->transact_ctx);
+      obj->transact_ctx = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+
 static void
 gpa_cm_object_finalize (GObject *object)
 {
@@ -177,3 +201,108 @@ gpa_cm_object_alert_dialog (GpaCMObject *obj, const gchar *messageg)
 
   g_signal_emit (obj, signals[ALERT_DIALOG], 0, messageg);
 }
+
+
+/* Deliver the result of the command started by
+   gpa_cm_object_transact.  */
+static gboolean
+transact_idle_cb (gpointer user_data)
+{
+  GpaCMObject *obj = user_data;
+  void (*done) (GpaCMObject *obj, gpg_error_t err, void *opaque);
+  void *opaque;
+
+  obj->transact_idle_id = 0;
+  done = obj->transact_done;
+  opaque = obj->transact_opaque;
+  obj->transact_done = NULL;
+  obj->transact_opaque = NULL;
+  if (done)
+    done (obj, obj->transact_result, opaque);
+
+  return FALSE;
+}
+
+
+/* Signal handler for the "done" signal of the transact context.  */
+static void
+transact_done_cb (GpaContext *context, gpg_error_t err, GpaCMObject *obj)
+{
+  if (!obj->transact_done)
+    return;  /* Cancelled.  */
+
+  obj->transact_result = err;
+  /* The callback may start the next command; this is not allowed
+     from within the done handler.  */
+  if (!obj->transact_idle_id)
+    obj->transact_idle_id = g_idle_add (transact_idle_cb, obj);
+}
+
+
+/* Send COMMAND to the agent without blocking the main loop.  Data
+   lines are passed to DATA_CB and status lines to STATUS_CB.  When
+   the command has completed, DONE is called from the idle queue with
+   the error code of the command; it may start the next command.
+   Only one command may run at a time.  If the command could not be
+   started, an error is returned and DONE is not called.  */
+gpg_error_t
+gpa_cm_object_transact (GpaCMObject *obj, const char *command,
+                        gpgme_assuan_data_cb_t data_cb, void *data_opaque,
+                        gpgme_assuan_status_cb_t status_cb,
+                        void *status_opaque,
+                        void (*done) (GpaCMObject *obj, gpg_error_t err,
+                                      void *opaque),
+                        void *opaque)
+{
+  gpg_error_t err;
+
+  g_return_val_if_fail (GPA_IS_CM_OBJECT (obj),
+                        gpg_error (GPG_ERR_INV_VALUE));
+  g_return_val_if_fail (done, gpg_error (GPG_ERR_INV_VALUE));
+  g_return_val_if_fail (!obj->transact_done, gpg_error (GPG_ERR_EBUSY));
+
+  if (!obj->transact_ctx)
+    {
+      obj->transact_ctx = gpa_context_new ();
+      err = gpgme_set_protocol (obj->transact_ctx->ctx,
+                                GPGME_PROTOCOL_ASSUAN);
+      if (err)
+        {
+          g_object_unref (obj->transact_ctx);
+          obj->transact_ctx = NULL;
+          return err;
+        }
+      g_signal_connect (G_OBJECT (obj->transact_ctx), "done",
+                        G_CALLBACK (transact_done_cb), obj);
+    }
+
+  err = gpgme_op_assuan_transact_start (obj->transact_ctx->ctx, command,
+                                        data_cb, data_opaque,
+                                        NULL, NULL,
+                                        status_cb, status_opaque);
+  if (err)
+    return err;
+
+  obj->transact_done = done;
+  obj->transact_opaque = opaque;
+  return 0;
+}
+
+
+/* Cancel the command started by gpa_cm_object_transact.  Its
+   completion callback won't be called.  */
+void
+gpa_cm_object_transact_cancel (GpaCMObject *obj)
+{
+  g_return_if_fail (GPA_IS_CM_OBJECT (obj));
+
+  obj->transact_done = NULL;
+  obj->transact_opaque = NULL;
+  if (obj->transact_idle_id)
+    {
+      g_source_remove (obj->transact_idle_id);
+      obj->transact_idle_id = 0;
+    }
+  if (obj->transact_ctx && gpa_context_busy (obj->transact_ctx))
+    gpgme_cancel (obj->transact_ctx->ctx);
+}
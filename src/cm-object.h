@@ -31,6 +31,9 @@
 #define CM_OBJECT_H
 
 #include <gtk/gtk.h>
+#include <gpgme.h>
+
+#include "gpacontext.h"
 
 /* Declare the Object. */
 typedef struct _GpaCMObject      GpaCMObject;
@@ -76,6 +79,16 @@ struct _GpaCMObject
 
   /* Private.  Fixme:  Hide them.  */
   gpgme_ctx_t agent_ctx;
+
+  /* Context used by gpa_cm_object_transact.  */
+  GpaContext *transact_ctx;
+  /* Idle source id to run the completion callback.  */
+  guint transact_idle_id;
+  /* The result of the last command.  */
+  gpg_error_t transact_result;
+  /* The completion callback and its argument.  */
+  void (*transact_done) (GpaCMObject *obj, gpg_error_t err, void *opaque);
+  void *transact_opaque;
 };
 
 
@@ -86,5 +99,16 @@ struct _GpaCMObject
 void gpa_cm_object_update_status (GpaCMObject *obj, const char *text);
 void gpa_cm_object_alert_dialog (GpaCMObject *obj, const gchar *messageg);
 
+/* Send COMMAND asynchronously to the agent.  */
+gpg_error_t gpa_cm_object_transact
+   (GpaCMObject *obj, const char *command,
+    gpgme_assuan_data_cb_t data_cb, void *data_opaque,
+    gpgme_assuan_status_cb_t status_cb, void *status_opaque,
+    void (*done) (GpaCMObject *obj, gpg_error_t err, void *opaque),
+    void *opaque);
+
+/* Cancel a command started with gpa_cm_object_transact.  */
+void gpa_cm_object_transact_cancel (GpaCMObject *obj);
+
 
 #endif /*CM_OBJECT_H*/
@@ -118,6 +118,9 @@ struct _GpaCMOpenpgp
 
   /* This flag is set while we are reloading data.  */
   int  reloading;
+
+  /* The state of an asynchronous reload or NULL.  */
+  struct scd_learn_parm *learnparm;
 };
 
 /* The parent class.  */
@@ -584,73 +587,206 @@ scd_getattr_cb (void *opaque, const char *status, const char *args)
 
 
 
-/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+/* The attributes we display and the functions to update them.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMOpenpgp *card, int entry_id,  const char *string);
+} attrtbl[] = {
+  { "SERIALNO",   ENTRY_SERIALNO, update_entry_serialno },
+  { "DISP-NAME",  ENTRY_LAST_NAME, update_entry_name },
+  { "DISP-LANG",  ENTRY_LANGUAGE },
+  { "DISP-SEX",   ENTRY_SEX, update_entry_sex },
+  { "PUBKEY-URL", ENTRY_PUBKEY_URL },
+  { "LOGIN-DATA", ENTRY_LOGIN },
+  { "SIG-COUNTER",ENTRY_SIG_COUNTER },
+  { "CHV-STATUS", ENTRY_PIN_RETRYCOUNTER,  update_entry_chv_status },
+  { "KEY-FPR",    ENTRY_LAST, update_entry_fpr },
+/*   { "CA-FPR", }, */
+  { "KEY-ATTR",   ENTRY_LAST, update_entry_key_attr },
+  { NULL }
+};
+
+
+struct scd_learn_parm
+{
+  GpaCMOpenpgp *card;         /* The object.  */
+  char seen[DIM (attrtbl)];   /* Attributes received.  */
+  int attridx;                /* Attribute requested by GETATTR.  */
+  struct scd_getattr_parm parm;  /* Parameters for scd_getattr_cb.  */
+};
+
+
+/* Status callback for the LEARN command.  Dispatches the status lines
+   we know about to scd_getattr_cb.  */
+static gpg_error_t
+scd_learn_cb (void *opaque, const char *status, const char *args)
+{
+  struct scd_learn_parm *learnparm = opaque;
+  struct scd_getattr_parm parm;
+  int attridx;
+  char *tmp = NULL;
+  gpg_error_t err;
+
+  for (attridx=0; attrtbl[attridx].name; attridx++)
+    if (!strcmp (status, attrtbl[attridx].name))
+      break;
+  if (!attrtbl[attridx].name)
+    return 0;  /* Not used by us.  */
+
+  /* LEARN appends a timestamp to the serial number.  */
+  if (attrtbl[attridx].entry_id == ENTRY_SERIALNO && strchr (args, ' '))
+    {
+      tmp = xstrdup (args);
+      *strchr (tmp, ' ') = 0;
+      args = tmp;
+    }
+
+  learnparm->seen[attridx] = 1;
+  parm.card     = learnparm->card;
+  parm.name     = attrtbl[attridx].name;
+  parm.entry_id = attrtbl[attridx].entry_id;
+  parm.updfnc   = attrtbl[attridx].updfnc;
+  err = scd_getattr_cb (&parm, status, args);
+  xfree (tmp);
+  return err;
+}
+
+
+/* Finish a reload of the card data.  */
+static void
+reload_finish (GpaCMOpenpgp *card)
+{
+  update_entry_key_attr (card, 0, NULL);  /* Append ky attributes.  */
+  clear_changed_flags (card);
+  xfree (card->learnparm);
+  card->learnparm = NULL;
+  card->reloading--;
+}
+
+
+static void reload_getattr_done (GpaCMObject *obj, gpg_error_t err,
+                                 void *opaque);
+
+/* Request the next attribute which has not been delivered by LEARN
+   or finish the reload if there is none.  */
 static void
-reload_data (GpaCMOpenpgp *card)
+reload_next_attr (GpaCMOpenpgp *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMOpenpgp *card, int entry_id,  const char *string);
-  } attrtbl[] = {
-    { "SERIALNO",   ENTRY_SERIALNO, update_entry_serialno },
-    { "DISP-NAME",  ENTRY_LAST_NAME, update_entry_name },
-    { "DISP-LANG",  ENTRY_LANGUAGE },
-    { "DISP-SEX",   ENTRY_SEX, update_entry_sex },
-    { "PUBKEY-URL", ENTRY_PUBKEY_URL },
-    { "LOGIN-DATA", ENTRY_LOGIN },
-    { "SIG-COUNTER",ENTRY_SIG_COUNTER },
-    { "CHV-STATUS", ENTRY_PIN_RETRYCOUNTER,  update_entry_chv_status },
-    { "KEY-FPR",    ENTRY_LAST, update_entry_fpr },
-/*     { "CA-FPR", }, */
-    { "KEY-ATTR",   ENTRY_LAST, update_entry_key_attr },
-    { NULL }
-  };
+  struct scd_learn_parm *learnparm = card->learnparm;
   int attridx;
-  gpg_error_t err, operr;
   char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
+  gpg_error_t err;
 
-  show_edit_error (card, NULL);
+  for (attridx = learnparm->attridx; attrtbl[attridx].name; attridx++)
+    if (!learnparm->seen[attridx])
+      break;
+  learnparm->attridx = attridx;
+  if (!attrtbl[attridx].name)
+    {
+      reload_finish (card);
+      return;
+    }
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  learnparm->parm.card     = card;
+  learnparm->parm.name     = attrtbl[attridx].name;
+  learnparm->parm.entry_id = attrtbl[attridx].entry_id;
+  learnparm->parm.updfnc   = attrtbl[attridx].updfnc;
+  snprintf (command, sizeof command, "SCD GETATTR %s", learnparm->parm.name);
+
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), command,
+                                NULL, NULL,
+                                scd_getattr_cb, &learnparm->parm,
+                                reload_getattr_done, NULL);
+  if (err)
+    reload_getattr_done (GPA_CM_OBJECT (card), err, NULL);
+}
 
-  card->reloading++;
-  parm.card = card;
-  for (attridx=0; attrtbl[attridx].name; attridx++)
-    {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
 
-      if (err)
+/* Completion callback for the GETATTR command.  */
+static void
+reload_getattr_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMOpenpgp *card = GPA_CM_OPENPGP (obj);
+
+  if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
+          g_debug ("assuan command `SCD GETATTR %s' failed: %s <%s>\n",
+                   card->learnparm->parm.name,
+                   gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
+      reload_finish (card);
+      return;
+    }
+
+  card->learnparm->attridx++;
+  reload_next_attr (card);
+}
+
+
+/* Completion callback for the LEARN command.  */
+static void
+reload_learn_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
+{
+  GpaCMOpenpgp *card = GPA_CM_OPENPGP (obj);
 
+  if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+    {
+      /* Lost the card.  */
+      clear_card_data (card);
+      reload_finish (card);
+      return;
     }
-  update_entry_key_attr (card, 0, NULL);  /* Append ky attributes.  */
-  clear_changed_flags (card);
-  card->reloading--;
+  else if (err)
+    {
+      g_debug ("assuan command `%s' failed: %s <%s>\n",
+               "SCD LEARN --force", gpg_strerror (err), gpg_strsource (err));
+      memset (card->learnparm->seen, 0, sizeof card->learnparm->seen);
+    }
+
+  card->learnparm->attridx = 0;
+  reload_next_attr (card);
+}
+
+
+/* Use the assuan machinery to load the bulk of the OpenPGP card data.
+   All attributes are requested with one LEARN command; only those
+   not delivered by LEARN (e.g. by an old scdaemon) are then requested
+   one by one.  The commands are sent asynchronously so that a slow
+   card reader does not block the GUI; a reload in progress is
+   restarted.  */
+static void
+reload_data (GpaCMOpenpgp *card)
+{
+  gpg_error_t err;
+
+  show_edit_error (card, NULL);
+
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_ctx);
+
+  if (card->learnparm)
+    {
+      gpa_cm_object_transact_cancel (GPA_CM_OBJECT (card));
+      xfree (card->learnparm);
+      card->learnparm = NULL;
+      card->reloading--;
+    }
+
+  card->reloading++;
+
+  card->learnparm = xcalloc (1, sizeof *card->learnparm);
+  card->learnparm->card = card;
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), "SCD LEARN --force",
+                                NULL, NULL,
+                                scd_learn_cb, card->learnparm,
+                                reload_learn_done, NULL);
+  if (err)
+    reload_learn_done (GPA_CM_OBJECT (card), err, NULL);
 }
 
 
@@ -1657,6 +1793,8 @@ gpa_cm_openpgp_finalize (GObject *object)
 
   xfree (card->key_attributes);
   card->key_attributes = NULL;
+  xfree (card->learnparm);
+  card->learnparm = NULL;
 
   parent_class->finalize (object);
 }
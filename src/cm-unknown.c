@@ -66,6 +66,9 @@ struct _GpaCMUnknown
   GtkWidget *label;
 
   int  reloading;   /* Sentinel to avoid recursive reloads.  */
+
+  /* Buffer for the ATR while it is being read or NULL.  */
+  membuf_t *atrbuf;
 };
 
 /* The parent class.  */
@@ -92,40 +95,25 @@ scd_atr_data_cb (void *opaque, const void *data, size_t datalen)
 }
 
 
-/* Use the assuan machinery to read the ATR.  */
+/* Completion callback for the APDU command of reload_data.  */
 static void
-reload_data (GpaCMUnknown *card)
+reload_atr_done (GpaCMObject *obj, gpg_error_t err, void *opaque)
 {
-  gpg_error_t err, operr;
-  char command[100];
-  gpgme_ctx_t gpgagent;
-  membuf_t mb;
+  GpaCMUnknown *card = GPA_CM_UNKNOWN (obj);
+  membuf_t *mb = card->atrbuf;
   char *buf;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
-
-  card->reloading++;
-
-  init_membuf (&mb, 512);
-
-  err = gpgme_op_assuan_transact_ext (gpgagent,
-                                      "SCD APDU --dump-atr",
-                                      scd_atr_data_cb, &mb,
-                                      NULL, NULL, NULL, NULL, &operr);
-  if (!err)
-    err = operr;
-
   if (!err)
     {
-      put_membuf (&mb, "", 1);
-      buf = get_membuf (&mb, NULL);
+      put_membuf (mb, "", 1);
+      buf = get_membuf (mb, NULL);
       if (buf)
         {
-          buf = g_strdup_printf ("\n%s\n%s",
-                                 _("The ATR of the card is:"),
-                                 buf);
-          gtk_label_set_text (GTK_LABEL (card->label), buf);
+          char *tmp = g_strdup_printf ("\n%s\n%s",
+                                       _("The ATR of the card is:"),
+                                       buf);
+          gtk_label_set_text (GTK_LABEL (card->label), tmp);
+          g_free (tmp);
           g_free (buf);
         }
       else
@@ -133,19 +121,53 @@ reload_data (GpaCMUnknown *card)
     }
   else
     {
-      g_free (get_membuf (&mb, NULL));
+      g_free (get_membuf (mb, NULL));
 
       if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
         ; /* Lost the card.  */
       else
         g_debug ("assuan command `%s' failed: %s <%s>\n",
-                 command, gpg_strerror (err), gpg_strsource (err));
+                 "SCD APDU --dump-atr",
+                 gpg_strerror (err), gpg_strsource (err));
       gtk_label_set_text (GTK_LABEL (card->label), "");
     }
+  xfree (mb);
+  card->atrbuf = NULL;
   card->reloading--;
 }
 
 
+/* Use the assuan machinery to read the ATR.  The command is sent
+   without blocking the GUI.  */
+static void
+reload_data (GpaCMUnknown *card)
+{
+  gpg_error_t err;
+
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_ctx);
+
+  if (card->atrbuf)
+    {
+      gpa_cm_object_transact_cancel (GPA_CM_OBJECT (card));
+      g_free (get_membuf (card->atrbuf, NULL));
+      xfree (card->atrbuf);
+      card->reloading--;
+    }
+
+  card->reloading++;
+
+  card->atrbuf = xcalloc (1, sizeof *card->atrbuf);
+  init_membuf (card->atrbuf, 512);
+
+  err = gpa_cm_object_transact (GPA_CM_OBJECT (card), "SCD APDU --dump-atr",
+                                scd_atr_data_cb, card->atrbuf,
+                                NULL, NULL,
+                                reload_atr_done, NULL);
+  if (err)
+    reload_atr_done (GPA_CM_OBJECT (card), err, NULL);
+}
+
+
 
 
 /* This function constructs the container holding all widgets making
@@ -203,7 +225,14 @@ gpa_cm_unknown_init (GTypeInstance *instance, void *class_ptr)
 static void
 gpa_cm_unknown_finalize (GObject *object)
 {
-/*   GpaCMUnknown *card = GPA_CM_UNKNOWN (object); */
+  GpaCMUnknown *card = GPA_CM_UNKNOWN (object);
+
+  if (card->atrbuf)
+    {
+      g_free (get_membuf (card->atrbuf, NULL));
+      xfree (card->atrbuf);
+      card->atrbuf = NULL;
+    }
 
   parent_class->finalize (object);
 }
@@ -137,6 +137,9 @@ gpa_file_encrypt_dialog_constructor (GType type, guint n_construct_properties,
   GtkWidget *clistKeys;
   GtkWidget *checkerSign;
   GtkWidget *checkerArmor;
+  GtkWidget *hboxCompress;
+  GtkWidget *labelCompress;
+  GtkWidget *comboCompress;
   GtkWidget *labelWho;
   GtkWidget *scrollerWho;
   GtkWidget *clistWho;
@@ -236,6 +239,23 @@ gpa_file_encrypt_dialog_constructor (GType type, guint n_construct_properties,
       gtk_widget_set_sensitive (dialog->check_armor, FALSE);
     }
 
+  hboxCompress = gtk_hbox_new (FALSE, 5);
+  gtk_box_pack_start (GTK_BOX (vboxEncrypt), hboxCompress, FALSE, FALSE, 0);
+  labelCompress = gtk_label_new_with_mnemonic (_("Co_mpression:"));
+  gtk_box_pack_start (GTK_BOX (hboxCompress), labelCompress, FALSE, FALSE, 0);
+  /* The order must match gpa_compress_mode_t.  */
+  comboCompress = gtk_combo_box_new_text ();
+  gtk_combo_box_append_text (GTK_COMBO_BOX (comboCompress),
+                             _("Automatic"));
+  gtk_combo_box_append_text (GTK_COMBO_BOX (comboCompress),
+                             _("Always compress"));
+  gtk_combo_box_append_text (GTK_COMBO_BOX (comboCompress),
+                             _("Do not compress"));
+  gtk_combo_box_set_active (GTK_COMBO_BOX (comboCompress), GPA_COMPRESS_AUTO);
+  gtk_box_pack_start (GTK_BOX (hboxCompress), comboCompress, FALSE, FALSE, 0);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (labelCompress), comboCompress);
+  dialog->combo_compress = comboCompress;
+
   return object;
 }
 
@@ -366,6 +386,26 @@ gpa_file_encrypt_dialog_set_sign (GpaFileEncryptDialog *dialog, gboolean sign)
 }
 
 
+gpa_compress_mode_t
+gpa_file_encrypt_dialog_get_compress (GpaFileEncryptDialog *dialog)
+{
+  int idx;
+
+  idx = gtk_combo_box_get_active (GTK_COMBO_BOX (dialog->combo_compress));
+  if (idx < GPA_COMPRESS_AUTO || idx > GPA_COMPRESS_NEVER)
+    return GPA_COMPRESS_AUTO;
+  return idx;
+}
+
+
+void
+gpa_file_encrypt_dialog_set_compress (GpaFileEncryptDialog *dialog,
+                                      gpa_compress_mode_t mode)
+{
+  gtk_combo_box_set_active (GTK_COMBO_BOX (dialog->combo_compress), mode);
+}
+
+
 static void
 changed_select_row_cb (GtkTreeSelection *treeselection, gpointer user_data)
 {
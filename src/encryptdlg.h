@@ -32,6 +32,14 @@
 #define GPA_IS_FILE_ENCRYPT_DIALOG_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_FILE_ENCRYPT_DIALOG_TYPE))
 #define GPA_FILE_ENCRYPT_DIALOG_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_FILE_ENCRYPT_DIALOG_TYPE, GpaFileEncryptDialogClass))
 
+/* How to compress the data before encryption.  */
+typedef enum
+  {
+    GPA_COMPRESS_AUTO,    /* Skip compression for compressed input.  */
+    GPA_COMPRESS_ALWAYS,  /* Use the engine's default compression.  */
+    GPA_COMPRESS_NEVER    /* Do not compress.  */
+  } gpa_compress_mode_t;
+
 typedef struct _GpaFileEncryptDialog GpaFileEncryptDialog;
 typedef struct _GpaFileEncryptDialogClass GpaFileEncryptDialogClass;
 
@@ -41,6 +49,7 @@ struct _GpaFileEncryptDialog {
   GtkWidget *clist_keys;
   GtkWidget *check_sign;
   GtkWidget *check_armor;
+  GtkWidget *combo_compress;
   GtkWidget *clist_who;
   /* FIXME: See comment in encryptdlg.h.  */
   GtkWidget *scroller_who;
@@ -71,4 +80,9 @@ gboolean gpa_file_encrypt_dialog_get_armor (GpaFileEncryptDialog *dialog);
 void gpa_file_encrypt_dialog_set_armor (GpaFileEncryptDialog *dialog,
 					gboolean armor);
 
+gpa_compress_mode_t
+gpa_file_encrypt_dialog_get_compress (GpaFileEncryptDialog *dialog);
+void gpa_file_encrypt_dialog_set_compress (GpaFileEncryptDialog *dialog,
+                                           gpa_compress_mode_t mode);
+
 #endif /* ENCRYPTDLG_H */
@@ -20,6 +20,7 @@
 
 #include <config.h>
 
+#include <time.h>
 #include <gpgme.h>
 #include <gtk/gtk.h>
 
@@ -173,3 +174,102 @@ gpa_expiry_dialog_run (GtkWidget * parent, gpgme_key_t key, GDate ** new_date)
       return FALSE;
     }
 }
+
+
+/* Run the expiry date dialog for the keys in KEYS.  Same as
+ * gpa_expiry_dialog_run but additionally ask which subkeys to change
+ * and store the answer at SUBKEYS.  The calendar starts one year from
+ * now.
+ */
+gboolean
+gpa_expiry_dialog_run_batch (GtkWidget *parent, GList *keys,
+                             GDate **new_date,
+                             gpa_expiry_subkeys_t *subkeys)
+{
+  GtkWidget *window;
+  GtkWidget *vbox;
+  GtkWidget *hbox;
+  GtkWidget *label;
+  GtkWidget *radio;
+  GtkWidget *calendar;
+  GtkWidget *combo;
+  GDate tmp;
+  gchar *string;
+  guint nkeys = g_list_length (keys);
+  gboolean result = FALSE;
+
+  GPAExpiryDialog dialog;
+
+  window = gtk_dialog_new_with_buttons (_("Change expiry date"),
+                                        GTK_WINDOW (parent),
+                                        GTK_DIALOG_MODAL,
+                                        GTK_STOCK_OK,
+                                        GTK_RESPONSE_OK,
+                                        _("_Cancel"),
+                                        GTK_RESPONSE_CANCEL,
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (window), GTK_RESPONSE_OK);
+  gtk_container_set_border_width (GTK_CONTAINER (window), 5);
+  dialog.window = window;
+
+  vbox = GTK_DIALOG (window)->vbox;
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 5);
+
+  string = g_strdup_printf (ngettext ("Change the expiry date of %u key:",
+                                      "Change the expiry date of %u keys:",
+                                      nkeys), nkeys);
+  label = gtk_label_new (string);
+  g_free (string);
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+
+  radio = gtk_radio_button_new_with_mnemonic (NULL, _("_never expire"));
+  dialog.radio_never = radio;
+  gtk_box_pack_start (GTK_BOX (vbox), radio, FALSE, FALSE, 0);
+
+  radio = gtk_radio_button_new_with_mnemonic_from_widget
+    (GTK_RADIO_BUTTON (radio), _("_expire on:"));
+  dialog.radio_date = radio;
+  gtk_box_pack_start (GTK_BOX (vbox), radio, FALSE, FALSE, 0);
+
+  calendar = gtk_calendar_new ();
+  dialog.calendar = calendar;
+  gtk_box_pack_start (GTK_BOX (vbox), calendar, FALSE, FALSE, 0);
+
+  g_signal_connect (G_OBJECT (dialog.radio_date), "toggled",
+                    G_CALLBACK (expire_date_toggled_cb), calendar);
+
+  g_date_set_time_t (&tmp, time (NULL));
+  g_date_add_years (&tmp, 1);
+  gtk_calendar_select_month (GTK_CALENDAR (calendar),
+                             g_date_get_month (&tmp)-1,
+                             g_date_get_year (&tmp));
+  gtk_calendar_select_day (GTK_CALENDAR (calendar), g_date_get_day (&tmp));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (dialog.radio_date), TRUE);
+
+  hbox = gtk_hbox_new (FALSE, 5);
+  gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 5);
+  label = gtk_label_new_with_mnemonic (_("_Subkeys:"));
+  gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+  combo = gtk_combo_box_new_text ();
+  gtk_combo_box_append_text (GTK_COMBO_BOX (combo),
+                             _("Do not change the subkeys"));
+  gtk_combo_box_append_text (GTK_COMBO_BOX (combo),
+                             _("Change all subkeys"));
+  gtk_combo_box_append_text (GTK_COMBO_BOX (combo),
+                             _("Change subkeys expiring before that date"));
+  gtk_combo_box_set_active (GTK_COMBO_BOX (combo),
+                            GPA_EXPIRY_SUBKEYS_EXPIRING);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), combo);
+  gtk_box_pack_start (GTK_BOX (hbox), combo, TRUE, TRUE, 0);
+
+  gtk_widget_show_all (window);
+  if (gtk_dialog_run (GTK_DIALOG (window)) == GTK_RESPONSE_OK)
+    {
+      result = expiry_ok (&dialog, new_date);
+      if (result)
+        *subkeys = gtk_combo_box_get_active (GTK_COMBO_BOX (combo));
+    }
+  gtk_widget_destroy (window);
+  return result;
+}
@@ -25,4 +25,16 @@
 gboolean gpa_expiry_dialog_run (GtkWidget * window, gpgme_key_t key,
                                 GDate ** new_date);
 
+/* Which subkeys to change with gpa_expiry_dialog_run_batch.  */
+typedef enum
+  {
+    GPA_EXPIRY_SUBKEYS_NONE,
+    GPA_EXPIRY_SUBKEYS_ALL,
+    GPA_EXPIRY_SUBKEYS_EXPIRING
+  } gpa_expiry_subkeys_t;
+
+gboolean gpa_expiry_dialog_run_batch (GtkWidget * window, GList * keys,
+                                      GDate ** new_date,
+                                      gpa_expiry_subkeys_t * subkeys);
+
 #endif /* EXPIRYDLG_H */
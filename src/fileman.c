@@ -47,6 +47,8 @@
 #include "gpafileencryptop.h"
 #include "gpafilesignop.h"
 #include "gpafileverifyop.h"
+#include "encryptdlg.h"
+#include "folderwatch.h"
 
 
 #if ! GTK_CHECK_VERSION (2, 10, 0)
@@ -62,6 +64,10 @@ struct _GpaFileManager
   GtkWidget *window;
   GtkWidget *list_files;
   GList *selection_sensitive_actions;
+
+  /* The set of UTF-8 encoded file names in LIST_FILES.  Used for
+     fast duplicate detection.  */
+  GHashTable *filenames;
 };
 
 struct _GpaFileManagerClass
@@ -106,6 +112,7 @@ static GObject *gpa_file_manager_constructor
                          (GType type,
                           guint n_construct_properties,
                           GObjectConstructParam *construct_properties);
+static void update_selection_sensitive_actions (GpaFileManager *fileman);
 
 
 
@@ -115,6 +122,11 @@ static GObject *gpa_file_manager_constructor
 static void
 gpa_file_manager_finalize (GObject *object)
 {
+  GpaFileManager *fileman = GPA_FILE_MANAGER (object);
+
+  g_hash_table_destroy (fileman->filenames);
+  fileman->filenames = NULL;
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -123,6 +135,8 @@ static void
 gpa_file_manager_init (GpaFileManager *fileman)
 {
   fileman->selection_sensitive_actions = NULL;
+  fileman->filenames = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
 }
 
 static void
@@ -206,14 +220,11 @@ get_selected_files (GtkWidget *list)
 }
 
 
-/* Add file FILENAME to the file list of FILEMAN and select it */
-static gboolean
-add_file (GpaFileManager *fileman, const gchar *filename)
+/* Return FILENAME converted to UTF-8.  The caller must free the
+   result.  */
+static gchar *
+filename_to_utf8 (const gchar *filename)
 {
-  GtkListStore *store;
-  GtkTreeIter iter;
-  GtkTreePath *path;
-  GtkTreeSelection *sel;
   gchar *filename_utf8;
 
   /* The tree contains filenames in the UTF-8 encoding.  */
@@ -234,36 +245,53 @@ add_file (GpaFileManager *fileman, const gchar *filename)
       filename_utf8 = g_filename_display_name (filename);
     }
 
-  store = GTK_LIST_STORE (gtk_tree_view_get_model
-                          (GTK_TREE_VIEW (fileman->list_files)));
+  return filename_utf8;
+}
+
+
+/* Append file FILENAME to the file list of FILEMAN and store the new
+   row at ITER.  Returns FALSE if the file is already in the list.  */
+static gboolean
+append_file (GpaFileManager *fileman, const gchar *filename,
+             GtkTreeIter *iter)
+{
+  GtkListStore *store;
+  gchar *filename_utf8;
+
+  filename_utf8 = filename_to_utf8 (filename);
 
   /* Check for duplicates. */
-  path = gtk_tree_path_new_first ();
-  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, path))
-    do
-      {
-	gchar *tmp;
-	gboolean exists;
-
-	gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, FILE_NAME_COLUMN,
-			    &tmp, -1);
-	exists = g_str_equal (filename_utf8, tmp);
-	g_free (tmp);
-	if (exists)
-	  {
-	    g_free (filename_utf8);
-	    gtk_tree_path_free (path);
-	    return FALSE; /* This file is already in our list.  */
-	  }
-      }
-    while (gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter));
-  gtk_tree_path_free (path);
+  if (g_hash_table_lookup_extended (fileman->filenames, filename_utf8,
+                                    NULL, NULL))
+    {
+      g_free (filename_utf8);
+      return FALSE; /* This file is already in our list.  */
+    }
 
-  /* Append it to our list.  */
-  gtk_list_store_append (store, &iter);
+  store = GTK_LIST_STORE (gtk_tree_view_get_model
+                          (GTK_TREE_VIEW (fileman->list_files)));
 
+  /* Append it to our list.  */
   /* FIXME: Add the file status when/if gpgme supports it */
-  gtk_list_store_set (store, &iter, FILE_NAME_COLUMN, filename_utf8, -1);
+  gtk_list_store_insert_with_values (store, iter, G_MAXINT,
+                                     FILE_NAME_COLUMN, filename_utf8, -1);
+
+  /* The hash table takes ownership of FILENAME_UTF8.  */
+  g_hash_table_insert (fileman->filenames, filename_utf8, filename_utf8);
+
+  return TRUE;
+}
+
+
+/* Add file FILENAME to the file list of FILEMAN and select it */
+static gboolean
+add_file (GpaFileManager *fileman, const gchar *filename)
+{
+  GtkTreeIter iter;
+  GtkTreeSelection *sel;
+
+  if (!append_file (fileman, filename, &iter))
+    return FALSE;
 
   /* Select the row */
   sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (fileman->list_files));
@@ -273,6 +301,36 @@ add_file (GpaFileManager *fileman, const gchar *filename)
 }
 
 
+/* Add all files in the list FILENAMES to the file list of FILEMAN and
+   select them.  Files already in the list are skipped.  Unlike
+   calling add_file for each file, the selection sensitive actions are
+   updated only once.  Returns the number of files added.  */
+static guint
+add_files (GpaFileManager *fileman, GSList *filenames)
+{
+  GtkTreeSelection *sel;
+  GtkTreeIter iter;
+  guint count = 0;
+
+  sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (fileman->list_files));
+  g_signal_handlers_block_by_func (sel, update_selection_sensitive_actions,
+                                   fileman);
+  for (; filenames; filenames = g_slist_next (filenames))
+    if (append_file (fileman, filenames->data, &iter))
+      {
+        gtk_tree_selection_select_iter (sel, &iter);
+        count++;
+      }
+  g_signal_handlers_unblock_by_func (sel, update_selection_sensitive_actions,
+                                     fileman);
+
+  if (count)
+    update_selection_sensitive_actions (fileman);
+
+  return count;
+}
+
+
 /* Add a file created by an operation to the list */
 static void
 file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
@@ -381,30 +439,52 @@ get_load_file_name (GtkWidget *parent, const gchar *title,
 
 
 /* Handle menu item "File/Open".  */
-
-void
-open_file_one (gpointer data, gpointer user_data)
+static void
+file_open (GtkAction *action, gpointer param)
 {
-  GpaFileManager *fileman = user_data;
-  gchar *filename = (gchar *) data;
+  GpaFileManager *fileman = param;
+  GSList *filenames;
+
+  filenames = get_load_file_name (GTK_WIDGET (fileman), _("Open File"), NULL);
+  if (! filenames)
+    return;
 
   /* FIXME: We are ignoring errors here.  */
-  add_file (fileman, filename);
-  g_free (filename);
+  add_files (fileman, filenames);
+  g_slist_foreach (filenames, (GFunc) g_free, NULL);
+  g_slist_free (filenames);
 }
 
 
+/* Handle menu item "File/Open Folder".  A folder in the list is
+   encrypted as a single archive.  */
 static void
-file_open (GtkAction *action, gpointer param)
+file_open_folder (GtkAction *action, gpointer param)
 {
   GpaFileManager *fileman = param;
-  GSList *filenames;
+  static GtkWidget *dialog;
+  GSList *filenames = NULL;
 
-  filenames = get_load_file_name (GTK_WIDGET (fileman), _("Open File"), NULL);
+  if (! dialog)
+    {
+      dialog = gtk_file_chooser_dialog_new
+	(_("Open Folder"), GTK_WINDOW (fileman),
+	 GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+	 GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+	 GTK_STOCK_OPEN, GTK_RESPONSE_OK, NULL);
+      gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+      gtk_file_chooser_set_select_multiple (GTK_FILE_CHOOSER (dialog), TRUE);
+    }
+  gtk_file_chooser_unselect_all (GTK_FILE_CHOOSER (dialog));
+
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK)
+    filenames = gtk_file_chooser_get_filenames (GTK_FILE_CHOOSER (dialog));
+  gtk_widget_hide (dialog);
   if (! filenames)
     return;
 
-  g_slist_foreach (filenames, open_file_one, fileman);
+  add_files (fileman, filenames);
+  g_slist_foreach (filenames, (GFunc) g_free, NULL);
   g_slist_free (filenames);
 }
 
@@ -418,6 +498,7 @@ file_clear (GtkAction *action, gpointer param)
                                         (GTK_TREE_VIEW (fileman->list_files)));
 
   gtk_list_store_clear (store);
+  g_hash_table_remove_all (fileman->filenames);
 }
 
 
@@ -493,6 +574,198 @@ file_decrypt (GtkAction *action, gpointer param)
 }
 
 
+/* Ask the user for the recipients of files encrypted by the folder
+   watch.  Returns a NULL terminated array of keys or NULL if the user
+   cancelled or selected unusable keys.  */
+static gpgme_key_t *
+get_watch_recipients (GpaFileManager *fileman)
+{
+  GtkWidget *dialog;
+  GList *recipients = NULL;
+  GList *cur;
+  gpgme_key_t *rset = NULL;
+  gpgme_protocol_t protocol = GPGME_PROTOCOL_UNKNOWN;
+  int i;
+
+  /* The keys are owned by the dialog; thus we keep it until we have
+     taken our own references.  */
+  dialog = gpa_file_encrypt_dialog_new (GTK_WIDGET (fileman), FALSE);
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK)
+    recipients = gpa_file_encrypt_dialog_recipients
+      (GPA_FILE_ENCRYPT_DIALOG (dialog));
+  gtk_widget_hide (dialog);
+
+  /* Files are processed without asking, thus we accept only keys
+     which can be used without further questions.  */
+  for (cur = recipients; cur; cur = g_list_next (cur))
+    {
+      gpgme_key_t key = cur->data;
+
+      if (protocol == GPGME_PROTOCOL_UNKNOWN)
+        protocol = key->protocol;
+      if (key->protocol != protocol)
+        {
+          gpa_window_error
+            (_("The selected certificates are not all of the same type."
+               " That is, you mixed OpenPGP and X.509 certificates."
+               " Please make sure to select only certificates of the"
+               " same type."), GTK_WIDGET (fileman));
+          goto leave;
+        }
+      if (key->revoked || key->expired || key->disabled
+          || (key->protocol == GPGME_PROTOCOL_OpenPGP
+              && key->uids->validity != GPGME_VALIDITY_FULL
+              && key->uids->validity != GPGME_VALIDITY_ULTIMATE))
+        {
+          gpa_window_error
+            (_("Only valid keys can be used for a watched folder."
+               " Please make sure that the selected keys are neither"
+               " revoked nor expired and that they are fully valid."),
+             GTK_WIDGET (fileman));
+          goto leave;
+        }
+    }
+
+  rset = g_malloc0 (sizeof (gpgme_key_t) * (g_list_length (recipients) + 1));
+  for (cur = recipients, i = 0; cur; cur = g_list_next (cur), i++)
+    {
+      rset[i] = cur->data;
+      gpgme_key_ref (rset[i]);
+    }
+
+ leave:
+  g_list_free (recipients);
+  gtk_widget_destroy (dialog);
+  return rset;
+}
+
+
+/* Handle menu item "File/Watch Folder".  */
+static void
+file_watch_folder (GtkAction *action, gpointer param)
+{
+  GpaFileManager *fileman = param;
+  GtkWidget *dialog;
+  GtkWidget *vbox;
+  GtkWidget *table;
+  GtkWidget *label;
+  GtkWidget *check_enable;
+  GtkWidget *button_inbox;
+  GtkWidget *button_outbox;
+  GtkWidget *radio_encrypt;
+  GtkWidget *radio_decrypt;
+  char *inbox = NULL;
+  char *outbox = NULL;
+  gpa_folder_watch_mode_t mode;
+  gpgme_key_t *rset = NULL;
+  gpg_error_t err;
+
+  dialog = gtk_dialog_new_with_buttons
+    (_("Watch Folder"), GTK_WINDOW (fileman),
+     GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+     GTK_STOCK_OK, GTK_RESPONSE_OK, NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
+
+  vbox = GTK_DIALOG (dialog)->vbox;
+  gtk_box_set_spacing (GTK_BOX (vbox), 5);
+
+  check_enable = gtk_check_button_new_with_mnemonic
+    (_("_Process files landing in the inbox folder"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check_enable),
+                                gpa_folder_watch_is_active ());
+  gtk_box_pack_start (GTK_BOX (vbox), check_enable, FALSE, FALSE, 0);
+
+  table = gtk_table_new (2, 2, FALSE);
+  gtk_table_set_row_spacings (GTK_TABLE (table), 5);
+  gtk_table_set_col_spacings (GTK_TABLE (table), 10);
+  gtk_box_pack_start (GTK_BOX (vbox), table, FALSE, FALSE, 0);
+
+  label = gtk_label_new_with_mnemonic (_("_Inbox:"));
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_table_attach (GTK_TABLE (table), label, 0, 1, 0, 1, GTK_FILL, 0, 0, 0);
+  button_inbox = gtk_file_chooser_button_new
+    (_("Select Inbox Folder"), GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+  if (gpa_folder_watch_get_inbox ())
+    gtk_file_chooser_set_filename (GTK_FILE_CHOOSER (button_inbox),
+                                   gpa_folder_watch_get_inbox ());
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), button_inbox);
+  gtk_table_attach (GTK_TABLE (table), button_inbox, 1, 2, 0, 1,
+                    GTK_FILL | GTK_EXPAND, 0, 0, 0);
+
+  label = gtk_label_new_with_mnemonic (_("_Outbox:"));
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_table_attach (GTK_TABLE (table), label, 0, 1, 1, 2, GTK_FILL, 0, 0, 0);
+  button_outbox = gtk_file_chooser_button_new
+    (_("Select Outbox Folder"), GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+  if (gpa_folder_watch_get_outbox ())
+    gtk_file_chooser_set_filename (GTK_FILE_CHOOSER (button_outbox),
+                                   gpa_folder_watch_get_outbox ());
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), button_outbox);
+  gtk_table_attach (GTK_TABLE (table), button_outbox, 1, 2, 1, 2,
+                    GTK_FILL | GTK_EXPAND, 0, 0, 0);
+
+  radio_encrypt = gtk_radio_button_new_with_mnemonic
+    (NULL, _("_Encrypt the files"));
+  gtk_box_pack_start (GTK_BOX (vbox), radio_encrypt, FALSE, FALSE, 0);
+  radio_decrypt = gtk_radio_button_new_with_mnemonic_from_widget
+    (GTK_RADIO_BUTTON (radio_encrypt), _("_Decrypt and verify the files"));
+  gtk_box_pack_start (GTK_BOX (vbox), radio_decrypt, FALSE, FALSE, 0);
+  if (gpa_folder_watch_get_mode () == GPA_FOLDER_WATCH_DECRYPT)
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (radio_decrypt), TRUE);
+
+  gtk_widget_show_all (dialog);
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) != GTK_RESPONSE_OK)
+    {
+      gtk_widget_destroy (dialog);
+      return;
+    }
+
+  if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (check_enable)))
+    {
+      gtk_widget_destroy (dialog);
+      gpa_folder_watch_stop ();
+      return;
+    }
+
+  inbox = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (button_inbox));
+  outbox = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (button_outbox));
+  mode = (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (radio_decrypt))
+          ? GPA_FOLDER_WATCH_DECRYPT : GPA_FOLDER_WATCH_ENCRYPT);
+  gtk_widget_destroy (dialog);
+
+  if (!inbox || !outbox || !gpa_folder_watch_check_folders (inbox, outbox))
+    {
+      gpa_window_error (_("Please select two different folders as"
+                          " inbox and outbox.  Neither folder may be"
+                          " inside the other."), GTK_WIDGET (fileman));
+      goto leave;
+    }
+
+  if (mode == GPA_FOLDER_WATCH_ENCRYPT)
+    {
+      rset = get_watch_recipients (fileman);
+      if (!rset)
+        goto leave;
+    }
+
+  err = gpa_folder_watch_start (inbox, outbox, mode, rset);
+  if (err)
+    {
+      char *msg = g_strdup_printf (_("The folder `%s' can't be watched: %s"),
+                                   inbox, gpg_strerror (err));
+      gpa_window_error (msg, GTK_WIDGET (fileman));
+      g_free (msg);
+    }
+
+ leave:
+  gpa_gpgme_release_keyarray (rset);
+  g_free (outbox);
+  g_free (inbox);
+}
+
+
 /* Handle menu item "File/Close".  */
 static void
 file_close (GtkAction *action, gpointer param)
@@ -529,6 +802,9 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
       /* File menu.  */
       { "FileOpen", GTK_STOCK_OPEN, NULL, NULL,
 	N_("Open a file"), G_CALLBACK (file_open) },
+      { "FileOpenFolder", GTK_STOCK_DIRECTORY, N_("Open _Folder..."), NULL,
+	N_("Open a folder to encrypt it as an archive"),
+        G_CALLBACK (file_open_folder) },
       { "FileClear", GTK_STOCK_CLEAR, NULL, NULL,
 	N_("Close all files"), G_CALLBACK (file_clear) },
       { "FileSign", GPA_STOCK_SIGN, NULL, NULL,
@@ -539,6 +815,9 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
 	N_("Encrypt the selected file"), G_CALLBACK (file_encrypt) },
       { "FileDecrypt", GPA_STOCK_DECRYPT, NULL, NULL,
 	N_("Decrypt the selected file"), G_CALLBACK (file_decrypt) },
+      { "FileWatchFolder", NULL, N_("_Watch Folder..."), NULL,
+	N_("Process files landing in a folder"),
+        G_CALLBACK (file_watch_folder) },
       { "FileClose", GTK_STOCK_CLOSE, NULL, NULL,
 	N_("Close the window"), G_CALLBACK (file_close) },
       { "FileQuit", GTK_STOCK_QUIT, NULL, NULL,
@@ -554,6 +833,7 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
     "  <menubar name='MainMenu'>"
     "    <menu action='File'>"
     "      <menuitem action='FileOpen'/>"
+    "      <menuitem action='FileOpenFolder'/>"
     "      <menuitem action='FileClear'/>"
     "      <separator/>"
     "      <menuitem action='FileSign'/>"
@@ -561,6 +841,8 @@ fileman_action_new (GpaFileManager *fileman, GtkWidget **menubar,
     "      <menuitem action='FileEncrypt'/>"
     "      <menuitem action='FileDecrypt'/>"
     "      <separator/>"
+    "      <menuitem action='FileWatchFolder'/>"
+    "      <separator/>"
     "      <menuitem action='FileClose'/>"
     "      <menuitem action='FileQuit'/>"
     "    </menu>"
@@ -708,6 +990,7 @@ dnd_data_received_handler (GtkWidget *widget, GdkDragContext *context,
         {
           char *p = (char *) selection_data->data;
           char **list;
+          GSList *names = NULL;
           int i;
 
           list = g_uri_list_extract_uris (p);
@@ -719,11 +1002,14 @@ dnd_data_received_handler (GtkWidget *widget, GdkDragContext *context,
                   /* Canonical line endings are required for an uri-list. */
                   if ((p = strchr (name, '\r')))
                     *p = 0;
-                  add_file (fileman, name);
-                  g_free (name);
+                  names = g_slist_prepend (names, name);
                 }
             }
           g_strfreev (list);
+          names = g_slist_reverse (names);
+          add_files (fileman, names);
+          g_slist_foreach (names, (GFunc) g_free, NULL);
+          g_slist_free (names);
           dnd_success = TRUE;
         }
     }
@@ -916,3 +1202,13 @@ void gpa_file_manager_open_file (GpaFileManager *fileman,
 		      GTK_WIDGET (fileman));
   /* FIXME: Release filename?  */
 }
+
+
+/* Add all files in the list FILENAMES to the file list of FILEMAN
+   and select them.  Files already in the list are silently skipped.
+   Returns the number of added files.  */
+guint
+gpa_file_manager_open_files (GpaFileManager *fileman, GSList *filenames)
+{
+  return add_files (fileman, filenames);
+}
@@ -61,5 +61,8 @@ gboolean gpa_file_manager_is_open (void);
 void gpa_file_manager_open_file (GpaFileManager *fileman,
 				 const char *filename);
 
+guint gpa_file_manager_open_files (GpaFileManager *fileman,
+                                   GSList *filenames);
+
 
 #endif /*FILEMAN_H*/
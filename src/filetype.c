@@ -223,3 +223,110 @@ is_cms_data_ext (gpgme_data_t dh)
   return 0;
 #endif
 }
+
+
+/* The number of bytes we look at to decide whether a file is worth
+   compressing.  */
+#define COMPRESS_SAMPLE_SIZE 65536
+
+/* Magic numbers of file formats which are already compressed.  A
+   negative offset marks the end of the table.  */
+static const struct
+{
+  int offset;
+  size_t length;
+  const char *magic;
+} compressed_magic[] =
+  {
+    { 0,  4, "PK\x03\x04" },            /* Zip, OOXML, ODF, JAR.  */
+    { 0,  4, "PK\x05\x06" },            /* Empty Zip.  */
+    { 0,  2, "\x1f\x8b" },              /* Gzip.  */
+    { 0,  2, "\x1f\x9d" },              /* Compress.  */
+    { 0,  3, "BZh" },                   /* Bzip2.  */
+    { 0,  6, "\xfd" "7zXZ\x00" },       /* Xz.  */
+    { 0,  4, "LZIP" },                  /* Lzip.  */
+    { 0,  4, "\x28\xb5\x2f\xfd" },      /* Zstandard.  */
+    { 0,  4, "\x04\x22\x4d\x18" },      /* LZ4.  */
+    { 0,  6, "7z\xbc\xaf\x27\x1c" },    /* 7-Zip.  */
+    { 0,  6, "Rar!\x1a\x07" },          /* RAR.  */
+    { 0,  4, "MSCF" },                  /* Cabinet.  */
+    { 0,  3, "\xff\xd8\xff" },          /* JPEG.  */
+    { 0,  8, "\x89PNG\r\n\x1a\n" },     /* PNG.  */
+    { 0,  4, "GIF8" },                  /* GIF.  */
+    { 8,  4, "WEBP" },                  /* WebP (RIFF).  */
+    { 4,  4, "ftyp" },                  /* MP4, MOV, HEIF, M4A.  */
+    { 0,  4, "\x1a\x45\xdf\xa3" },      /* Matroska, WebM.  */
+    { 0,  4, "OggS" },                  /* Ogg.  */
+    { 0,  4, "fLaC" },                  /* FLAC.  */
+    { 0,  3, "ID3" },                   /* MP3 with ID3 tag.  */
+    { 0,  2, "\xff\xfb" },              /* MP3 frame.  */
+    { -1, 0, NULL }
+  };
+
+
+/* Return true if DATA of length DATALEN starts with the magic number
+   of a compressed file format or looks like random data.  */
+static int
+detect_incompressible (const unsigned char *data, size_t datalen)
+{
+  unsigned long count[256];
+  double expected, chi2;
+  size_t n;
+  int i;
+
+  for (i = 0; compressed_magic[i].offset >= 0; i++)
+    if (compressed_magic[i].offset + compressed_magic[i].length <= datalen
+        && !memcmp (data + compressed_magic[i].offset,
+                    compressed_magic[i].magic, compressed_magic[i].length))
+      return 1;
+
+  /* For unknown formats do a chi-square test against uniformly
+     distributed bytes.  Compressed or encrypted data comes close to
+     the number of degrees of freedom (255); text and most other
+     uncompressed formats are orders of magnitude above.  Small
+     samples are not significant; compressing them is cheap anyway.  */
+  if (datalen < 4096)
+    return 0;
+
+  memset (count, 0, sizeof count);
+  for (n = 0; n < datalen; n++)
+    count[data[n]]++;
+  expected = datalen / 256.0;
+  chi2 = 0.0;
+  for (i = 0; i < 256; i++)
+    chi2 += (count[i] - expected) * (count[i] - expected) / expected;
+
+  return chi2 < 2 * 255;
+}
+
+
+/* Return true if the file FNAME does not benefit from compression,
+   because it is already compressed or looks like random data.  There
+   is no error return; on error the file is assumed to be
+   compressible.  */
+int
+is_incompressible_file (const char *fname)
+{
+  int result;
+  FILE *fp;
+  unsigned char *data;
+  size_t datalen;
+
+  fp = fopen (fname, "rb");
+  if (!fp)
+    return 0;
+
+  data = malloc (COMPRESS_SAMPLE_SIZE);
+  if (!data)
+    {
+      fclose (fp);
+      return 0; /* Oops */
+    }
+
+  datalen = fread (data, 1, COMPRESS_SAMPLE_SIZE, fp);
+  fclose (fp);
+
+  result = detect_incompressible (data, datalen);
+  free (data);
+  return result;
+}
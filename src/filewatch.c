@@ -33,6 +33,8 @@
 #include <errno.h>
 #ifdef HAVE_INOTIFY_INIT
 # include <sys/inotify.h>
+# include <fcntl.h>
+# include <unistd.h>
 #endif /*HAVE_INOTIFY_INIT*/
 
 #include <glib.h>
@@ -43,9 +45,15 @@
 struct gpa_filewatch_id_s
 {
   gpa_filewatch_id_t next;
+  gpa_filewatch_id_t wd_next;  /* Next watch with the same WD.  */
   int wd;
+  unsigned int mask;
+  int removed;  /* Removed while walking the watch_list.  */
   gpa_filewatch_cb_t callback;
   void *callback_data;
+  unsigned int debounce_ms;  /* Coalescing window or 0.  */
+  GHashTable *pending;       /* Coalesced events: name -> mask.  */
+  guint pending_id;          /* Timeout source flushing PENDING.  */
   char fname[1];
 };
 
@@ -56,84 +64,264 @@ static int queue_fd = -1;
 /* We need to keep a list of active file watches.  */
 static gpa_filewatch_id_t watch_list;
 
+/* A table mapping inotify watch descriptors to the first watch with
+   that descriptor.  Several watches for the same file share the
+   descriptor and are chained using WD_NEXT.  */
+static GHashTable *wd_table;
+
 /* We set this flag to true while walking thewatch_list.  */
 static int walking_watch_list_p;
 
 
+#ifdef HAVE_INOTIFY_INIT
+/* Events the kernel reports regardless of the requested mask.  */
+#define ALWAYS_REPORTED (IN_UNMOUNT | IN_Q_OVERFLOW | IN_IGNORED)
+
+/* Size of the buffer used to read the inotify queue.  This is
+   sufficient for a few hundred events per read.  */
+#define EVENT_BUFFER_SIZE 16384
+
+/* Maximum number of reads per wakeup so that a very busy directory
+   can't starve the main loop.  */
+#define MAX_READS 64
+
+
+/* Store the reason string for the inotify event MASK at REASON which
+   must have space for at least 16 characters.  */
+static void
+make_reason (unsigned int mask, char *reason)
+{
+  int reasonidx = 0;
+
+#define MAKEREASON(a,b) do { if ((mask & (b)))                  \
+                                reason[reasonidx++] = (a);      \
+                           } while (0)
+  MAKEREASON ('a', IN_ACCESS);
+  MAKEREASON ('c', IN_MODIFY);
+  MAKEREASON ('e', IN_ATTRIB);
+  MAKEREASON ('w', IN_CLOSE_WRITE);
+  MAKEREASON ('0', IN_CLOSE_NOWRITE);
+  MAKEREASON ('r', IN_OPEN);
+  MAKEREASON ('m', IN_MOVED_FROM);
+  MAKEREASON ('y', IN_MOVED_TO);
+  MAKEREASON ('n', IN_CREATE);
+  MAKEREASON ('d', IN_DELETE);
+  MAKEREASON ('D', IN_DELETE_SELF);
+  MAKEREASON ('M', IN_MOVE_SELF);
+  MAKEREASON ('u', IN_UNMOUNT);
+  MAKEREASON ('o', IN_Q_OVERFLOW);
+  MAKEREASON ('x', IN_IGNORED);
+#undef MAKEREASON
+  reason[reasonidx] = 0;
+}
+
+
+/* Remove WATCH from the chain of watches for its descriptor.  */
+static void
+unlink_wd (gpa_filewatch_id_t watch)
+{
+  gpa_filewatch_id_t head, w;
+
+  head = g_hash_table_lookup (wd_table, GINT_TO_POINTER (watch->wd));
+  if (head == watch)
+    {
+      if (watch->wd_next)
+        g_hash_table_insert (wd_table, GINT_TO_POINTER (watch->wd),
+                             watch->wd_next);
+      else
+        g_hash_table_remove (wd_table, GINT_TO_POINTER (watch->wd));
+    }
+  else
+    {
+      for (w = head; w && w->wd_next != watch; w = w->wd_next)
+        ;
+      if (w)
+        w->wd_next = watch->wd_next;
+    }
+}
+
+
+/* Release all watches which have been removed while walking the
+   watch_list.  */
+static void
+purge_removed_watches (void)
+{
+  gpa_filewatch_id_t watch, prev, next;
+
+  for (prev = NULL, watch = watch_list; watch; watch = next)
+    {
+      next = watch->next;
+      if (watch->removed)
+        {
+          if (prev)
+            prev->next = next;
+          else
+            watch_list = next;
+          if (watch->pending)
+            g_hash_table_destroy (watch->pending);
+          xfree (watch);
+        }
+      else
+        prev = watch;
+    }
+}
+
+
+/* Helper for flush_pending.  */
+static void
+flush_one (gpointer key, gpointer value, gpointer user_data)
+{
+  gpa_filewatch_id_t watch = user_data;
+  char reason[16];
+
+  /* The callback may have removed the watch.  */
+  if (watch->removed)
+    return;
+
+  make_reason (GPOINTER_TO_UINT (value), reason);
+  watch->callback (watch->callback_data, key, reason);
+}
+
+
+/* Timeout handler to deliver the events coalesced for a watch.  */
+static gboolean
+flush_pending (gpointer data)
+{
+  gpa_filewatch_id_t watch = data;
+  GHashTable *pending;
+
+  /* Detach the table so that the callbacks may queue new events.  */
+  pending = watch->pending;
+  watch->pending = NULL;
+  watch->pending_id = 0;
+
+  walking_watch_list_p++;
+  if (pending)
+    {
+      g_hash_table_foreach (pending, flush_one, watch);
+      g_hash_table_destroy (pending);
+    }
+  walking_watch_list_p--;
+  if (!walking_watch_list_p)
+    purge_removed_watches ();
+
+  return FALSE;
+}
+
+
+/* Deliver the inotify event EV to WATCH.  REASON is a buffer for the
+   reason string; it is only computed if required and then cached in
+   that buffer.  */
+static void
+dispatch_event (gpa_filewatch_id_t watch, struct inotify_event *ev,
+                char *reason)
+{
+  char *fname;
+
+  if (watch->removed || !watch->callback
+      || !(ev->mask & (watch->mask | ALWAYS_REPORTED)))
+    return;
+
+  /* For events on files in a watched directory we pass the name of
+     that file.  */
+  if (ev->len && *ev->name)
+    fname = g_build_filename (watch->fname, ev->name, NULL);
+  else
+    fname = NULL;
+
+  if (watch->debounce_ms)
+    {
+      const char *name = fname ? fname : watch->fname;
+      gpointer mask;
+
+      if (!watch->pending)
+        watch->pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, NULL);
+      if (!g_hash_table_lookup_extended (watch->pending, name, NULL, &mask))
+        mask = NULL;
+      g_hash_table_replace (watch->pending, g_strdup (name),
+                            GUINT_TO_POINTER (GPOINTER_TO_UINT (mask)
+                                              | ev->mask));
+      if (!watch->pending_id)
+        watch->pending_id = g_timeout_add (watch->debounce_ms,
+                                           flush_pending, watch);
+    }
+  else
+    {
+      if (!*reason)
+        make_reason (ev->mask, reason);
+      watch->callback (watch->callback_data,
+                       fname ? fname : watch->fname, reason);
+    }
+
+  g_free (fname);
+}
+
+
 /* This function is called by the main event loop if the file watcher
    fd is readable.  This is currently only used under Linux if the
-   inotify interface is available. */
-#ifdef HAVE_INOTIFY_INIT
+   inotify interface is available.  The queue is drained until the
+   kernel reports that no more events are available.  */
 static gboolean 
 filewatch_cb (GIOChannel *channel, 
               GIOCondition condition, void *data)
 {
-  gsize nread;
-  GIOStatus status;
-  GError *err = NULL;
-  char buffer[512];
-
-  status = g_io_channel_read_chars (channel, buffer, sizeof buffer,
-                                    &nread, &err);
-  if (err)
-    {
-      g_debug ("error reading inotify queue: status=%d, err=%s",
-               status, err->message);
-      g_error_free (err);
-    }
-/*   g_debug ("new file watch event, nread=%u", (unsigned int)nread); */
-  
-  if (status == G_IO_STATUS_NORMAL)
+  static union
+  {
+    struct inotify_event ev;
+    char buf[EVENT_BUFFER_SIZE];
+  } buffer;
+  ssize_t nread;
+  int nreads;
+
+  walking_watch_list_p++;
+  for (nreads = 0; nreads < MAX_READS; nreads++)
     {
-      struct inotify_event *ev;
-      char *p = buffer;
-      gpa_filewatch_id_t watch;
-      char reason[20];
-      int  reasonidx;
-      
-      while (nread >= sizeof *ev) 
+      char *p, *end;
+
+      nread = read (queue_fd, buffer.buf, sizeof buffer.buf);
+      if (nread == -1 && errno == EINTR)
+        continue;
+      if (nread == -1)
         {
-          ev = (void *)p;
-#define MAKEREASON(a,b) do { if ((ev->mask & (b))                   \
-                                  && reasonidx < sizeof reason) \
-                                reason[reasonidx++] = (a);      \
-                           } while (0)
-          reasonidx = 0;
-          MAKEREASON ('a', IN_ACCESS);
-          MAKEREASON ('c', IN_MODIFY);
-          MAKEREASON ('e', IN_ATTRIB);
-          MAKEREASON ('w', IN_CLOSE_WRITE);
-          MAKEREASON ('0', IN_CLOSE_NOWRITE);
-          MAKEREASON ('r', IN_OPEN);
-          MAKEREASON ('m', IN_MOVED_FROM);
-          MAKEREASON ('y', IN_MOVED_TO);
-          MAKEREASON ('n', IN_CREATE);
-          MAKEREASON ('d', IN_DELETE);
-          MAKEREASON ('D', IN_DELETE_SELF);
-          MAKEREASON ('M', IN_MOVE_SELF);
-          MAKEREASON ('u', IN_UNMOUNT);
-          MAKEREASON ('o', IN_Q_OVERFLOW);
-          MAKEREASON ('x', IN_IGNORED);
-#undef MAKEREASON
-          reason[reasonidx] = 0;
-/*           g_debug ("event: wd=%d mask=%#x (%s) cookie=%#x len=%u name=`%.*s'", */
-/*                    ev->wd, ev->mask, reason, ev->cookie, ev->len,  */
-/*                    (int)ev->len, ev->name); */
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            g_debug ("error reading inotify queue: %s", strerror (errno));
+          break;
+        }
+      if (!nread)
+        break;
 
-          walking_watch_list_p++;
-          for (watch=watch_list; watch; watch = watch->next)
-            {
-              if (ev->wd == watch->wd && watch->callback)
-                watch->callback (watch->callback_data, watch->fname, reason);
-            }
-          walking_watch_list_p--;
+      p = buffer.buf;
+      end = buffer.buf + nread;
+      while (p + sizeof (struct inotify_event) <= end)
+        {
+          struct inotify_event *ev = (void *)p;
+          gpa_filewatch_id_t watch;
+          char reason[16];
 
-          nread -= sizeof *ev;
-          nread -= (nread > ev->len)?  ev->len : nread;
           p += sizeof *ev + ev->len;
+          if (p > end)
+            break;  /* Truncated event - should not happen.  */
+
+          *reason = 0;
+          if (ev->wd == -1)
+            {
+              /* A queue overflow concerns all watches.  */
+              for (watch = watch_list; watch; watch = watch->next)
+                dispatch_event (watch, ev, reason);
+            }
+          else
+            {
+              for (watch = g_hash_table_lookup (wd_table,
+                                                GINT_TO_POINTER (ev->wd));
+                   watch; watch = watch->wd_next)
+                dispatch_event (watch, ev, reason);
+            }
         }
-      
     }
+  walking_watch_list_p--;
+  if (!walking_watch_list_p)
+    purge_removed_watches ();
 
   return TRUE; /* Keep the file watcher fd in the event loop.  */
 }
@@ -163,6 +351,10 @@ gpa_init_filewatch (void)
       return;
     }
 
+  /* We drain the queue until no more events are available.  */
+  fcntl (queue_fd, F_SETFL, fcntl (queue_fd, F_GETFL) | O_NONBLOCK);
+  wd_table = g_hash_table_new (g_direct_hash, g_direct_equal);
+
   channel = g_io_channel_unix_new (queue_fd);
   if (!channel)
     {
@@ -207,7 +399,8 @@ gpa_init_filewatch (void)
 	"x"  File is no longer watched
 
    CALLBACK is the callback function to be called for all matching
-   events.  
+   events.  If FILENAME is a directory, events for files in that
+   directory are reported with the full name of that file.
 
    The function returns NULL on error or an object used for other
    operations.
@@ -219,7 +412,7 @@ gpa_add_filewatch (const char *filename, const char *maskstring,
 #ifdef HAVE_INOTIFY_INIT
   unsigned int mask = 0;
   int wd;
-  gpa_filewatch_id_t handle;
+  gpa_filewatch_id_t handle, head;
 
   for (mask=0; *maskstring; maskstring++)
     switch (*maskstring)
@@ -244,7 +437,12 @@ gpa_add_filewatch (const char *filename, const char *maskstring,
         return NULL;
       }
 
-  wd = inotify_add_watch (queue_fd, filename, mask);
+  if (queue_fd == -1)
+    return NULL;
+
+  /* Several watches for the same file share one descriptor; thus we
+     must not replace the mask of another watch.  */
+  wd = inotify_add_watch (queue_fd, filename, mask | IN_MASK_ADD);
   if (wd == -1)
     {
       g_debug ("adding watch for `%s' failed: %s", filename, strerror (errno));
@@ -254,15 +452,65 @@ gpa_add_filewatch (const char *filename, const char *maskstring,
   handle = xcalloc (1, sizeof *handle + strlen (filename));
   strcpy (handle->fname, filename);
   handle->wd = wd;
+  handle->mask = mask;
   handle->callback = callback;
   handle->callback_data = callback_data;
   
   handle->next = watch_list;
   watch_list = handle;
 
+  head = g_hash_table_lookup (wd_table, GINT_TO_POINTER (wd));
+  handle->wd_next = head;
+  g_hash_table_insert (wd_table, GINT_TO_POINTER (wd), handle);
+
   return handle;
 
 #else /*!HAVE_INOTIFY_INIT*/
   return NULL;
 #endif /*!HAVE_INOTIFY_INIT*/  
 }
+
+
+/* Remove the filewatch WATCH as returned by gpa_add_filewatch.  The
+   callback will not be called anymore after this function returns.
+   WATCH may be NULL.  */
+void
+gpa_remove_filewatch (gpa_filewatch_id_t watch)
+{
+#ifdef HAVE_INOTIFY_INIT
+  if (!watch || watch->removed)
+    return;
+
+  unlink_wd (watch);
+  if (!g_hash_table_lookup (wd_table, GINT_TO_POINTER (watch->wd)))
+    inotify_rm_watch (queue_fd, watch->wd);
+  if (watch->pending_id)
+    g_source_remove (watch->pending_id);
+  watch->pending_id = 0;
+  watch->removed = 1;
+  if (!walking_watch_list_p)
+    purge_removed_watches ();
+#endif /*HAVE_INOTIFY_INIT*/
+}
+
+
+/* Coalesce the events of WATCH: Instead of calling the callback for
+   each event, the events arriving within MSEC milliseconds are
+   collected and the callback is called once for each affected file
+   with the combined reasons.  An MSEC of 0 disables coalescing.  */
+void
+gpa_filewatch_set_debounce (gpa_filewatch_id_t watch, unsigned int msec)
+{
+#ifdef HAVE_INOTIFY_INIT
+  if (!watch)
+    return;
+
+  watch->debounce_ms = msec;
+  if (!msec && watch->pending_id)
+    {
+      /* Deliver what we have collected so far.  */
+      g_source_remove (watch->pending_id);
+      flush_pending (watch);
+    }
+#endif /*HAVE_INOTIFY_INIT*/
+}
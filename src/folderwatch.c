@@ -0,0 +1,1127 @@
+/* folderwatch.c - Automatic processing of files in a watched folder.
+   Copyright (C) 2026 g10 Code GmbH
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+   Files landing in the inbox directory are encrypted to a fixed set
+   of recipients, or decrypted and verified, and the result is written
+   to the outbox directory.  The input file is removed after it has
+   been processed; files which could not be processed are moved to
+   the "failed" sub directory of the inbox.
+
+   Output is first written to a hidden temporary file in the outbox
+   and renamed when complete, so that consumers of the outbox never
+   see partial files.  Existing files in the outbox are never replaced;
+   a numbered name is used instead.  A small journal records which files are in
+   progress so that a restart can clean up after an interrupted run.
+   The journal is locked while in use; only one instance of GPA
+   watches the folder at a time.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#else
+#include <io.h>
+#include <sys/locking.h>
+#endif
+
+#include "gpa.h"
+#include "gpgmetools.h"
+#include "gpacontext.h"
+#include "filetype.h"
+#include "folderwatch.h"
+
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY	_O_BINARY
+#else
+#define O_BINARY	0
+#endif
+#endif
+
+
+/* Maximum number of files processed concurrently.  */
+#define MAX_JOBS 4
+
+/* Time in milliseconds events on the inbox are collected before we
+   process the files.  Writers often close a file several times in a
+   row; this coalesces these bursts of events.  */
+#define DEBOUNCE_MS 500
+
+/* Sub directory of the inbox for files which could not be processed.  */
+#define FAILED_DIR "failed"
+
+/* Prefix of the temporary files in the outbox.  */
+#define TMP_PREFIX ".gpa-tmp-"
+
+/* The journal is compacted when it grows larger than this.  */
+#define JOURNAL_MAX_SIZE 65536
+
+/* Group used in the configuration file.  */
+#define CONF_GROUP "folder-watch"
+
+
+/* A file being processed.  */
+struct job_s
+{
+  char *name;       /* Name of the file relative to the inbox.  */
+  char *inbox;      /* The inbox at the time the job was started.  */
+  char *infile;     /* Full name of the input file.  */
+  char *outfile;    /* Full name of the output file.  */
+  char *tmpfile;    /* Full name of the temporary output file.  */
+  int in_fd;
+  int out_fd;
+  gpgme_data_t in;
+  gpgme_data_t out;
+  GpaContext *ctx;
+  int rerun;        /* The input has been changed while processing.  */
+};
+typedef struct job_s *job_t;
+
+
+/* The state of the folder watch.  There is only one watched folder.  */
+static struct
+{
+  int active;
+  gpa_folder_watch_mode_t mode;
+  char *inbox;
+  char *outbox;
+  gpgme_key_t *rset;
+  gpa_filewatch_id_t watch;
+  GHashTable *jobs;      /* Name -> job_t; NULL if only queued.  */
+  GQueue *queue;         /* Names waiting to be processed.  */
+  unsigned int running;  /* Number of running jobs.  */
+  FILE *journal;
+} fw;
+
+
+static void run_queue (void);
+
+
+
+/* Return the name of the configuration file.  Caller must free.  */
+static char *
+config_filename (void)
+{
+  return g_build_filename (gnupg_homedir, "folderwatch.conf", NULL);
+}
+
+
+/* Return the name of the journal.  Caller must free.  */
+static char *
+journal_filename (void)
+{
+  return g_build_filename (gnupg_homedir, "folderwatch.journal", NULL);
+}
+
+
+/* Return the name of the temporary output file for NAME.  */
+static char *
+tmp_filename (const char *name)
+{
+  char *tmpname, *result;
+
+  tmpname = g_strconcat (TMP_PREFIX, name, NULL);
+  result = g_build_filename (fw.outbox, tmpname, NULL);
+  g_free (tmpname);
+  return result;
+}
+
+
+/* Return the name of the output file for NAME.  */
+static char *
+out_filename (const char *name)
+{
+  static const char *suffixes[] = { ".gpg", ".pgp", ".asc", ".p7m", NULL };
+  char *outname, *result;
+  int i;
+
+  if (fw.mode == GPA_FOLDER_WATCH_ENCRYPT)
+    outname = g_strconcat (name, ".gpg", NULL);
+  else
+    {
+      outname = NULL;
+      for (i = 0; suffixes[i]; i++)
+        if (g_str_has_suffix (name, suffixes[i])
+            && strlen (name) > strlen (suffixes[i]))
+          {
+            outname = g_strndup (name, strlen (name) - strlen (suffixes[i]));
+            break;
+          }
+      if (!outname)
+        outname = g_strconcat (name, ".out", NULL);
+    }
+
+  result = g_build_filename (fw.outbox, outname, NULL);
+  g_free (outname);
+  return result;
+}
+
+
+
+/* Journal.  Each line consists of a record type and the
+   percent-escaped full names of the files:
+
+     S <infile> <tmpfile>  Processing of the file has started.
+     D <infile> <stamp>    The output is complete; the input with the
+                           given stamp (see file_stamp) is about to be
+                           removed.
+     F <infile>            Processing failed.
+
+   Full names are used so that the journal can be replayed even if the
+   watched folders have been changed in the meantime.  The journal is
+   compacted when it is opened, when all jobs are finished, and when
+   it grows too large.  */
+
+/* Return a string identifying the current version of the file FNAME
+   or NULL if it does not exist.  Caller must free.  */
+static char *
+file_stamp (const char *fname)
+{
+  struct stat st;
+
+  if (g_stat (fname, &st))
+    return NULL;
+  return g_strdup_printf ("%lu:%" G_GUINT64_FORMAT ":%lu",
+                          (unsigned long) st.st_ino, (guint64) st.st_size,
+                          (unsigned long) st.st_mtime);
+}
+
+
+static void
+journal_write (int type, const char *infile, const char *arg)
+{
+  char *escaped, *escaped2;
+
+  if (!fw.journal)
+    return;
+
+  escaped = percent_escape (infile, NULL, 0);
+  if (arg)
+    {
+      escaped2 = percent_escape (arg, NULL, 0);
+      fprintf (fw.journal, "%c %s %s\n", type, escaped, escaped2);
+      g_free (escaped2);
+    }
+  else
+    fprintf (fw.journal, "%c %s\n", type, escaped);
+  fflush (fw.journal);
+  g_free (escaped);
+}
+
+
+/* Helper for journal_compact.  */
+static void
+compact_one (gpointer key, gpointer value, gpointer user_data)
+{
+  job_t job = value;
+
+  if (job)
+    journal_write ('S', job->infile, job->tmpfile);
+}
+
+
+/* Truncate the journal and write records only for the jobs which are
+   still running.  */
+static void
+journal_compact (void)
+{
+  int fd;
+
+  if (!fw.journal)
+    return;
+
+  fflush (fw.journal);
+  fd = fileno (fw.journal);
+#ifdef G_OS_WIN32
+  if (_chsize (fd, 0))
+#else
+  if (ftruncate (fd, 0))
+#endif
+    {
+      g_message ("can't truncate the folder watch journal: %s",
+                 strerror (errno));
+      return;
+    }
+  fseek (fw.journal, 0, SEEK_SET);
+  if (fw.jobs)
+    g_hash_table_foreach (fw.jobs, compact_one, NULL);
+}
+
+
+/* Compact the journal if it grew too large.  */
+static void
+journal_check_size (void)
+{
+  if (fw.journal && ftell (fw.journal) > JOURNAL_MAX_SIZE)
+    journal_compact ();
+}
+
+
+/* Helper for journal_open.  */
+static void
+recover_one (gpointer key, gpointer value, gpointer user_data)
+{
+  const char *infile = key;
+  const char *record = value;
+  char *stamp;
+
+  switch (*record)
+    {
+    case 'S':
+      /* Interrupted while processing: remove the partial output; the
+         input is still in the inbox and will be rescanned.  */
+      if (record[1])
+        g_unlink (record + 1);
+      break;
+    case 'D':
+      /* Interrupted after the output was completed.  Remove the
+         input unless it has been replaced by a new file since.  */
+      stamp = file_stamp (infile);
+      if (stamp && record[1] && !strcmp (stamp, record + 1))
+        g_unlink (infile);
+      g_free (stamp);
+      break;
+    default:
+      break;
+    }
+}
+
+
+/* Lock the journal FP.  Returns 0 on success.  */
+static int
+lock_journal (FILE *fp)
+{
+#ifdef G_OS_WIN32
+  fseek (fp, 0, SEEK_SET);
+  return _locking (fileno (fp), _LK_NBLCK, 1);
+#else
+  struct flock fl;
+
+  memset (&fl, 0, sizeof fl);
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  return fcntl (fileno (fp), F_SETLK, &fl);
+#endif
+}
+
+
+/* Open and lock the journal, clean up after an interrupted run as
+   recorded in it, and compact it.  Returns an error if the journal
+   is in use by another instance.  */
+static gpg_error_t
+journal_open (void)
+{
+  char *fname;
+  FILE *fp;
+  char line[4096];
+  GHashTable *state;
+
+  fname = journal_filename ();
+  fp = g_fopen (fname, "a+");
+  if (!fp)
+    {
+      /* Processing works without a journal.  */
+      g_message ("can't open `%s': %s", fname, strerror (errno));
+      g_free (fname);
+      return 0;
+    }
+  g_free (fname);
+  if (lock_journal (fp))
+    {
+      fclose (fp);
+      return gpg_error (GPG_ERR_EBUSY);
+    }
+
+  state = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  fseek (fp, 0, SEEK_SET);
+  while (fgets (line, sizeof line, fp))
+    {
+      char *p = strchr (line, '\n');
+      char *arg;
+
+      if (!p || line[0] == '\n' || line[1] != ' ')
+        continue;  /* Ignore truncated or invalid lines.  */
+      *p = 0;
+      arg = strchr (line + 2, ' ');
+      if (arg)
+        {
+          *arg++ = 0;
+          percent_unescape (arg, 0);
+        }
+      percent_unescape (line + 2, 0);
+      g_hash_table_insert (state, g_strdup (line + 2),
+                           g_strdup_printf ("%c%s", line[0],
+                                            arg? arg : ""));
+    }
+
+  g_hash_table_foreach (state, recover_one, NULL);
+  g_hash_table_destroy (state);
+
+  fw.journal = fp;
+  journal_compact ();
+  return 0;
+}
+
+
+/* Close the journal and release the lock if it is no longer used.  */
+static void
+journal_close_if_unused (void)
+{
+  if (fw.journal && !fw.active && !fw.running)
+    {
+      fclose (fw.journal);
+      fw.journal = NULL;
+    }
+}
+
+
+
+/* Processing of files.  */
+
+/* Release all resources of JOB and remove it from the list of jobs.  */
+static void
+release_job (job_t job)
+{
+  if (job->in)
+    gpgme_data_release (job->in);
+  if (job->in_fd != -1)
+    close (job->in_fd);
+  if (job->out)
+    gpgme_data_release (job->out);
+  if (job->out_fd != -1)
+    close (job->out_fd);
+  if (job->ctx)
+    g_object_unref (job->ctx);
+  g_free (job->infile);
+  g_free (job->outfile);
+  g_free (job->tmpfile);
+  g_free (job->name);
+  g_free (job->inbox);
+  g_free (job);
+}
+
+
+/* Move the input file of JOB to the failed directory.  */
+static void
+move_to_failed (job_t job)
+{
+  char *dir, *target;
+
+  dir = g_build_filename (job->inbox, FAILED_DIR, NULL);
+  g_mkdir (dir, 0700);
+  target = g_build_filename (dir, job->name, NULL);
+  if (g_rename (job->infile, target))
+    g_message ("can't move `%s' to `%s': %s",
+               job->infile, target, strerror (errno));
+  g_free (target);
+  g_free (dir);
+}
+
+
+/* Move the complete output file SRC to DST.  An existing file DST is
+   not replaced; EEXIST is returned instead.  Returns 0 or an errno
+   value.  */
+static int
+install_file (const char *src, const char *dst)
+{
+#ifdef G_OS_UNIX
+  if (!link (src, dst))
+    {
+      g_unlink (src);
+      return 0;
+    }
+  if (errno == EEXIST)
+    return EEXIST;
+  /* The file system may not support hard links; fall back to a
+     rename after checking for an existing file.  */
+#endif
+  if (g_file_test (dst, G_FILE_TEST_EXISTS))
+    return EEXIST;
+  if (g_rename (src, dst))
+    return errno;
+  return 0;
+}
+
+
+/* Return FNAME with "-SEQ" inserted before the suffix.  */
+static char *
+numbered_filename (const char *fname, int seq)
+{
+  const char *base, *dot;
+
+  base = strrchr (fname, G_DIR_SEPARATOR);
+  base = base? base + 1 : fname;
+  dot = strrchr (base, '.');
+  if (!dot || dot == base)
+    return g_strdup_printf ("%s-%d", fname, seq);
+  return g_strdup_printf ("%.*s-%d%s", (int)(dot - fname), fname, seq, dot);
+}
+
+
+/* Move the output of JOB to the outbox.  If a file of that name
+   already exists, a numbered name is used.  */
+static gpg_error_t
+install_output (job_t job)
+{
+  char *fname;
+  int seq, rc;
+
+  fname = g_strdup (job->outfile);
+  for (seq = 1; (rc = install_file (job->tmpfile, fname)) == EEXIST
+         && seq < 1000; seq++)
+    {
+      g_free (fname);
+      fname = numbered_filename (job->outfile, seq);
+    }
+  g_free (fname);
+  return rc? gpg_error_from_errno (rc) : 0;
+}
+
+
+/* Finish processing JOB with status ERR and start the next one.  */
+static void
+finish_job (job_t job, gpg_error_t err)
+{
+  int rerun = 0;
+
+  /* Close the files before renaming them.  */
+  if (job->in)
+    gpgme_data_release (job->in);
+  job->in = NULL;
+  if (job->in_fd != -1)
+    close (job->in_fd);
+  job->in_fd = -1;
+  if (job->out)
+    gpgme_data_release (job->out);
+  job->out = NULL;
+  if (job->out_fd != -1)
+    close (job->out_fd);
+  job->out_fd = -1;
+
+  if (!err)
+    err = install_output (job);
+
+  if (!err)
+    {
+      char *stamp;
+
+      if (job->rerun)
+        rerun = 1;  /* Keep the input; it will be processed again.  */
+      else if ((stamp = file_stamp (job->infile)))
+        {
+          journal_write ('D', job->infile, stamp);
+          g_unlink (job->infile);
+          g_free (stamp);
+        }
+    }
+  else
+    {
+      g_message ("processing `%s' failed: %s",
+                 job->infile, gpg_strerror (err));
+      g_unlink (job->tmpfile);
+      if (g_file_test (job->infile, G_FILE_TEST_EXISTS))
+        move_to_failed (job);
+      journal_write ('F', job->infile, NULL);
+    }
+
+  g_hash_table_remove (fw.jobs, job->name);
+  fw.running--;
+  if (rerun && fw.active && !strcmp (job->inbox, fw.inbox))
+    {
+      g_hash_table_insert (fw.jobs, g_strdup (job->name), NULL);
+      g_queue_push_tail (fw.queue, g_strdup (job->name));
+    }
+  release_job (job);
+
+  if (!fw.running)
+    journal_compact ();
+  else
+    journal_check_size ();
+  journal_close_if_unused ();
+
+  run_queue ();
+}
+
+
+/* Return an error if the verification result of CTX shows a bad
+   signature.  Files without signatures are accepted.  */
+static gpg_error_t
+check_verify_result (gpgme_ctx_t ctx)
+{
+  gpgme_verify_result_t result;
+  gpgme_signature_t sig;
+
+  result = gpgme_op_verify_result (ctx);
+  if (!result)
+    return 0;
+  for (sig = result->signatures; sig; sig = sig->next)
+    if ((sig->summary & GPGME_SIGSUM_RED)
+        || gpg_err_code (sig->status) == GPG_ERR_BAD_SIGNATURE)
+      return gpg_error (GPG_ERR_BAD_SIGNATURE);
+  return 0;
+}
+
+
+/* Return an error if the encryption result of CTX lists recipients
+   which could not be used.  */
+static gpg_error_t
+check_encrypt_result (gpgme_ctx_t ctx)
+{
+  gpgme_encrypt_result_t result;
+  gpgme_invalid_key_t invkey;
+
+  result = gpgme_op_encrypt_result (ctx);
+  if (!result)
+    return 0;
+  invkey = result->invalid_recipients;
+  if (invkey)
+    {
+      g_message ("folder watch: recipient %s not usable: %s",
+                 invkey->fpr ? invkey->fpr : "?",
+                 gpg_strerror (invkey->reason));
+      return gpg_error (GPG_ERR_UNUSABLE_PUBKEY);
+    }
+  return 0;
+}
+
+
+/* Signal handler for the "done" signal of a job's context.  */
+static void
+job_done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  job_t job = user_data;
+
+  if (fw.mode == GPA_FOLDER_WATCH_ENCRYPT)
+    {
+      gpg_error_t err2 = check_encrypt_result (context->ctx);
+      if (err2)
+        err = err2;
+    }
+  else if (!err)
+    err = check_verify_result (context->ctx);
+
+  finish_job (job, err);
+}
+
+
+/* Start processing the file NAME in the inbox.  */
+static void
+start_job (const char *name)
+{
+  gpg_error_t err;
+  job_t job;
+
+  job = g_malloc0 (sizeof *job);
+  job->name = g_strdup (name);
+  job->inbox = g_strdup (fw.inbox);
+  job->infile = g_build_filename (fw.inbox, name, NULL);
+  job->outfile = out_filename (name);
+  job->tmpfile = tmp_filename (name);
+  job->in_fd = -1;
+  job->out_fd = -1;
+  g_hash_table_replace (fw.jobs, g_strdup (name), job);
+  fw.running++;
+
+  if (!g_file_test (job->infile, G_FILE_TEST_IS_REGULAR))
+    {
+      /* Vanished or not a regular file - silently skip it.  */
+      g_hash_table_remove (fw.jobs, job->name);
+      fw.running--;
+      release_job (job);
+      return;
+    }
+
+  journal_write ('S', job->infile, job->tmpfile);
+
+  job->in_fd = g_open (job->infile, O_RDONLY | O_BINARY, 0);
+  if (job->in_fd == -1)
+    {
+      finish_job (job, gpg_error_from_syserror ());
+      return;
+    }
+  job->out_fd = g_open (job->tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+                        0600);
+  if (job->out_fd == -1)
+    {
+      finish_job (job, gpg_error_from_syserror ());
+      return;
+    }
+
+  err = gpgme_data_new_from_fd (&job->in, job->in_fd);
+  if (!err)
+    err = gpgme_data_new_from_fd (&job->out, job->out_fd);
+  if (err)
+    {
+      finish_job (job, err);
+      return;
+    }
+
+  job->ctx = gpa_context_new ();
+  g_signal_connect (G_OBJECT (job->ctx), "done",
+                    G_CALLBACK (job_done_cb), job);
+
+  if (fw.mode == GPA_FOLDER_WATCH_ENCRYPT)
+    {
+      gpgme_set_protocol (job->ctx->ctx, fw.rset[0]->protocol);
+      /* The validity of the recipients is checked by the engine
+         for each file; if one of them has become unusable in the
+         meantime, the file is moved to the failed folder.  */
+      err = gpgme_op_encrypt_start (job->ctx->ctx, fw.rset,
+                                    (is_incompressible_file (job->infile)
+                                     ? GPGME_ENCRYPT_NO_COMPRESS : 0),
+                                    job->in, job->out);
+    }
+  else
+    {
+      gpgme_set_protocol (job->ctx->ctx,
+                          is_cms_file (job->infile)
+                          ? GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+      err = gpgme_op_decrypt_verify_start (job->ctx->ctx, job->in, job->out);
+    }
+  if (err)
+    finish_job (job, err);
+}
+
+
+/* Start queued jobs up to the concurrency limit.  */
+static void
+run_queue (void)
+{
+  static int in_run_queue;
+  char *name;
+
+  /* Jobs failing right at the start call us again; the outer
+     invocation takes care of them.  */
+  if (in_run_queue)
+    return;
+
+  in_run_queue = 1;
+  while (fw.active && fw.running < MAX_JOBS
+         && (name = g_queue_pop_head (fw.queue)))
+    {
+      start_job (name);
+      g_free (name);
+    }
+  in_run_queue = 0;
+}
+
+
+/* Queue the file NAME for processing unless it is already queued.
+   CHANGED is set if the file has been written; a running job for it
+   then needs to be run again.  */
+static void
+schedule (const char *name, int changed)
+{
+  gpointer value;
+
+  if (g_hash_table_lookup_extended (fw.jobs, name, NULL, &value))
+    {
+      if (value && changed)
+        ((job_t) value)->rerun = 1;
+      return;  /* Already queued or running.  */
+    }
+
+  g_hash_table_insert (fw.jobs, g_strdup (name), NULL);
+  g_queue_push_tail (fw.queue, g_strdup (name));
+  run_queue ();
+}
+
+
+/* Queue all files currently in the inbox.  */
+static void
+scan_inbox (void)
+{
+  GDir *dir;
+  const char *name;
+
+  dir = g_dir_open (fw.inbox, 0, NULL);
+  if (!dir)
+    return;
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *path;
+
+      if (*name == '.')
+        continue;
+      path = g_build_filename (fw.inbox, name, NULL);
+      if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        schedule (name, 0);
+      g_free (path);
+    }
+  g_dir_close (dir);
+}
+
+
+/* Callback for the file watch on the inbox.  Events are coalesced by
+   the file watch; thus we are called only once for a burst of
+   events.  */
+static void
+watch_cb (void *user_data, const char *filename, const char *reason)
+{
+  char *name;
+
+  if (!fw.active)
+    return;
+
+  if (strchr (reason, 'o'))
+    {
+      /* The inotify queue overflowed and events have been lost; look
+         at all files again.  */
+      scan_inbox ();
+      return;
+    }
+
+  if (!strchr (reason, 'w') && !strchr (reason, 'y'))
+    return;
+
+  name = g_path_get_basename (filename);
+  if (*name != '.')
+    schedule (name, 1);
+  g_free (name);
+}
+
+
+
+/* Configuration.  */
+
+static void
+save_config (void)
+{
+  GKeyFile *kf;
+  char *fname, *data;
+  gsize len;
+  GError *error = NULL;
+
+  kf = g_key_file_new ();
+  g_key_file_set_boolean (kf, CONF_GROUP, "enabled", fw.active);
+  if (fw.inbox)
+    g_key_file_set_string (kf, CONF_GROUP, "inbox", fw.inbox);
+  if (fw.outbox)
+    g_key_file_set_string (kf, CONF_GROUP, "outbox", fw.outbox);
+  g_key_file_set_string (kf, CONF_GROUP, "mode",
+                         fw.mode == GPA_FOLDER_WATCH_ENCRYPT
+                         ? "encrypt" : "decrypt");
+  if (fw.rset)
+    {
+      GPtrArray *fprs = g_ptr_array_new ();
+      int i;
+
+      for (i = 0; fw.rset[i]; i++)
+        g_ptr_array_add (fprs, fw.rset[i]->subkeys->fpr);
+      g_key_file_set_string_list (kf, CONF_GROUP, "recipients",
+                                  (const gchar **) fprs->pdata, fprs->len);
+      g_key_file_set_string (kf, CONF_GROUP, "protocol",
+                             fw.rset[0]->protocol == GPGME_PROTOCOL_CMS
+                             ? "cms" : "openpgp");
+      g_ptr_array_free (fprs, TRUE);
+    }
+
+  data = g_key_file_to_data (kf, &len, NULL);
+  fname = config_filename ();
+  if (!g_file_set_contents (fname, data, len, &error))
+    {
+      g_message ("can't write `%s': %s", fname, error->message);
+      g_error_free (error);
+    }
+  g_free (fname);
+  g_free (data);
+  g_key_file_free (kf);
+}
+
+
+/* Return a new array with the keys for the fingerprints FPRS or NULL
+   if none could be found.  */
+static gpgme_key_t *
+lookup_recipients (char **fprs, gpgme_protocol_t protocol)
+{
+  gpgme_ctx_t ctx;
+  gpgme_key_t *rset;
+  int i, n;
+
+  ctx = gpa_gpgme_new ();
+  gpgme_set_protocol (ctx, protocol);
+  rset = g_new0 (gpgme_key_t, g_strv_length (fprs) + 1);
+  for (i = n = 0; fprs[i]; i++)
+    {
+      gpg_error_t err = gpgme_get_key (ctx, fprs[i], &rset[n], 0);
+      if (err)
+        g_message ("folder watch: key %s not available: %s",
+                   fprs[i], gpg_strerror (err));
+      else
+        n++;
+    }
+  gpgme_release (ctx);
+
+  if (!n)
+    {
+      g_free (rset);
+      rset = NULL;
+    }
+  return rset;
+}
+
+
+/* Start the folder watch configured in a previous session, if any.  */
+void
+gpa_folder_watch_init (void)
+{
+  GKeyFile *kf;
+  char *fname, *inbox, *outbox, *mode, *protocol;
+  char **fprs;
+  gpgme_key_t *rset = NULL;
+  gpa_folder_watch_mode_t wmode;
+
+  kf = g_key_file_new ();
+  fname = config_filename ();
+  if (!g_key_file_load_from_file (kf, fname, 0, NULL))
+    {
+      g_free (fname);
+      g_key_file_free (kf);
+      return;
+    }
+  g_free (fname);
+
+  inbox = g_key_file_get_string (kf, CONF_GROUP, "inbox", NULL);
+  outbox = g_key_file_get_string (kf, CONF_GROUP, "outbox", NULL);
+  mode = g_key_file_get_string (kf, CONF_GROUP, "mode", NULL);
+  protocol = g_key_file_get_string (kf, CONF_GROUP, "protocol", NULL);
+  fprs = g_key_file_get_string_list (kf, CONF_GROUP, "recipients",
+                                     NULL, NULL);
+  wmode = (mode && !strcmp (mode, "decrypt")
+           ? GPA_FOLDER_WATCH_DECRYPT : GPA_FOLDER_WATCH_ENCRYPT);
+
+  if (fprs)
+    rset = lookup_recipients (fprs, (protocol && !strcmp (protocol, "cms"))
+                              ? GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+
+  if (inbox && outbox
+      && g_key_file_get_boolean (kf, CONF_GROUP, "enabled", NULL))
+    {
+      gpg_error_t err = gpa_folder_watch_start (inbox, outbox, wmode, rset);
+      if (err)
+        g_message ("can't watch folder `%s': %s", inbox, gpg_strerror (err));
+    }
+  else
+    {
+      /* Remember the settings for the configuration dialog.  */
+      g_free (fw.inbox);
+      fw.inbox = inbox;
+      inbox = NULL;
+      g_free (fw.outbox);
+      fw.outbox = outbox;
+      outbox = NULL;
+      fw.mode = wmode;
+    }
+
+  gpa_gpgme_release_keyarray (rset);
+  g_strfreev (fprs);
+  g_free (protocol);
+  g_free (mode);
+  g_free (outbox);
+  g_free (inbox);
+  g_key_file_free (kf);
+}
+
+
+/* Return the absolute name of the directory DIR with symbolic links
+   resolved.  Caller must free.  */
+static char *
+canonical_dir (const char *dir)
+{
+  char *buf, *result;
+
+#ifdef G_OS_WIN32
+  buf = _fullpath (NULL, dir, 0);
+#else
+  buf = realpath (dir, NULL);
+#endif
+  if (!buf)
+    return g_strdup (dir);
+  result = g_strdup (buf);
+  free (buf);
+  return result;
+}
+
+
+/* Return true if DIR is the directory PARENT or below it.  */
+static gboolean
+dir_is_within (const char *dir, const char *parent)
+{
+  size_t n = strlen (parent);
+
+  while (n && parent[n-1] == G_DIR_SEPARATOR)
+    n--;
+#ifdef G_OS_WIN32
+  if (g_ascii_strncasecmp (dir, parent, n))
+    return FALSE;
+#else
+  if (strncmp (dir, parent, n))
+    return FALSE;
+#endif
+  return !dir[n] || dir[n] == G_DIR_SEPARATOR;
+}
+
+
+/* Return true if INBOX and OUTBOX may be used together: they must be
+   different and neither may be inside the other.  */
+gboolean
+gpa_folder_watch_check_folders (const char *inbox, const char *outbox)
+{
+  char *in, *out;
+  gboolean okay;
+
+  in = canonical_dir (inbox);
+  out = canonical_dir (outbox);
+  okay = !dir_is_within (in, out) && !dir_is_within (out, in);
+  g_free (out);
+  g_free (in);
+  return okay;
+}
+
+
+/* Start watching the folder INBOX.  Depending on MODE files landing
+   there are encrypted to RECIPIENTS or decrypted and verified; the
+   result is written to OUTBOX.  Any previous watch is stopped.  The
+   caller keeps ownership of RECIPIENTS.  */
+gpg_error_t
+gpa_folder_watch_start (const char *inbox, const char *outbox,
+                        gpa_folder_watch_mode_t mode,
+                        gpgme_key_t *recipients)
+{
+  gpg_error_t err;
+
+  if (!g_file_test (inbox, G_FILE_TEST_IS_DIR)
+      || !g_file_test (outbox, G_FILE_TEST_IS_DIR))
+    return gpg_error (GPG_ERR_ENOENT);
+  if (!gpa_folder_watch_check_folders (inbox, outbox))
+    return gpg_error (GPG_ERR_INV_ARG);
+  if (mode == GPA_FOLDER_WATCH_ENCRYPT && (!recipients || !*recipients))
+    return gpg_error (GPG_ERR_NO_PUBKEY);
+
+  gpa_folder_watch_stop ();
+
+  /* The journal is still open if jobs of a previous watch are
+     running; it then already belongs to us.  */
+  if (!fw.journal)
+    {
+      err = journal_open ();
+      if (err)
+        return err;
+    }
+
+  if (!fw.jobs)
+    {
+      fw.jobs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      fw.queue = g_queue_new ();
+    }
+
+  g_free (fw.inbox);
+  fw.inbox = g_strdup (inbox);
+  g_free (fw.outbox);
+  fw.outbox = g_strdup (outbox);
+  fw.mode = mode;
+  gpa_gpgme_release_keyarray (fw.rset);
+  fw.rset = (mode == GPA_FOLDER_WATCH_ENCRYPT
+             ? gpa_gpgme_copy_keyarray (recipients) : NULL);
+
+  fw.watch = gpa_add_filewatch (fw.inbox, "wyo", watch_cb, NULL);
+  if (!fw.watch)
+    {
+      journal_close_if_unused ();
+      return gpg_error (GPG_ERR_NOT_SUPPORTED);
+    }
+  gpa_filewatch_set_debounce (fw.watch, DEBOUNCE_MS);
+  fw.active = 1;
+  save_config ();
+  scan_inbox ();
+
+  return 0;
+}
+
+
+/* Helper for gpa_folder_watch_stop.  */
+static gboolean
+remove_queued (gpointer key, gpointer value, gpointer user_data)
+{
+  return !value;
+}
+
+
+/* Stop watching the folder.  Files which are currently being
+   processed are finished; queued files are left in the inbox.  */
+void
+gpa_folder_watch_stop (void)
+{
+  char *name;
+
+  if (!fw.active)
+    return;
+
+  fw.active = 0;
+  gpa_remove_filewatch (fw.watch);
+  fw.watch = NULL;
+  while ((name = g_queue_pop_head (fw.queue)))
+    g_free (name);
+  g_hash_table_foreach_remove (fw.jobs, remove_queued, NULL);
+  save_config ();
+  journal_close_if_unused ();
+}
+
+
+/* Return true if a folder is being watched.  */
+gboolean
+gpa_folder_watch_is_active (void)
+{
+  return fw.active;
+}
+
+
+const char *
+gpa_folder_watch_get_inbox (void)
+{
+  return fw.inbox;
+}
+
+
+const char *
+gpa_folder_watch_get_outbox (void)
+{
+  return fw.outbox;
+}
+
+
+gpa_folder_watch_mode_t
+gpa_folder_watch_get_mode (void)
+{
+  return fw.mode;
+}
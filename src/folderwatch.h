@@ -0,0 +1,58 @@
+/* folderwatch.h - Automatic processing of files in a watched folder.
+   Copyright (C) 2026 g10 Code GmbH
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FOLDERWATCH_H
+#define FOLDERWATCH_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* What to do with files landing in the watched folder.  */
+typedef enum
+  {
+    GPA_FOLDER_WATCH_ENCRYPT,
+    GPA_FOLDER_WATCH_DECRYPT
+  } gpa_folder_watch_mode_t;
+
+
+/* Start the folder watch configured in a previous session, if any.  */
+void gpa_folder_watch_init (void);
+
+/* Return true if INBOX and OUTBOX are usable as a pair of folders.  */
+gboolean gpa_folder_watch_check_folders (const char *inbox,
+                                         const char *outbox);
+
+/* Start watching the folder INBOX.  */
+gpg_error_t gpa_folder_watch_start (const char *inbox, const char *outbox,
+                                    gpa_folder_watch_mode_t mode,
+                                    gpgme_key_t *recipients);
+
+/* Stop watching the folder.  */
+void gpa_folder_watch_stop (void);
+
+/* Return true if a folder is being watched.  */
+gboolean gpa_folder_watch_is_active (void);
+
+/* Return the configured inbox and outbox directories or NULL.  */
+const char *gpa_folder_watch_get_inbox (void);
+const char *gpa_folder_watch_get_outbox (void);
+
+/* Return the configured mode.  */
+gpa_folder_watch_mode_t gpa_folder_watch_get_mode (void);
+
+#endif /*FOLDERWATCH_H*/
@@ -34,6 +34,7 @@
 #include "gpa.h"
 #include "keymanager.h"
 #include "fileman.h"
+#include "folderwatch.h"
 #include "clipboard.h"
 #include "cardman.h"
 #include "keyserver.h"
@@ -616,6 +617,7 @@ main (int argc, char *argv[])
 
   /* Initialize the file watch facility.  */
   gpa_init_filewatch ();
+  gpa_folder_watch_init ();
 
   /* Startup whatever has been requested by the user.  */
   if (!args.start_only_server)
@@ -132,6 +132,9 @@ gpa_filewatch_id_t gpa_add_filewatch (const char *filename,
                                       const char *maskstring,
                                       gpa_filewatch_cb_t cb,
                                       void *cb_data);
+void gpa_remove_filewatch (gpa_filewatch_id_t watch);
+void gpa_filewatch_set_debounce (gpa_filewatch_id_t watch,
+                                 unsigned int msec);
 
 
 /*-- utils.c --*/
@@ -20,7 +20,12 @@
 
 #include <config.h>
 
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <gpgme.h>
+#include <glib/gstdio.h>
 #include "gpa.h"
 #include "i18n.h"
 #include "gtktools.h"
@@ -29,6 +34,18 @@
 static GObjectClass *parent_class = NULL;
 
 static gboolean gpa_backup_operation_idle_cb (gpointer data);
+static void gpa_backup_operation_done_cb (GpaContext *context, gpg_error_t err,
+                                          GpaBackupOperation *op);
+
+/* The number of fingerprints passed to one engine invocation.  */
+#define BACKUP_BATCH_SIZE 1000
+
+/* One engine invocation of a backup.  */
+struct backup_job_s
+{
+  gpgme_protocol_t protocol;
+  GPtrArray *fprs;        /* NULL terminated; the strings are not owned.  */
+};
 
 /* GObject boilerplate.  */
 
@@ -38,7 +55,8 @@ enum
   PROP_0,
   PROP_KEY,
   PROP_FINGERPRINT,
-  PROP_PROTOCOL
+  PROP_PROTOCOL,
+  PROP_KEYS
 };
 
 static void
@@ -60,6 +78,9 @@ gpa_backup_operation_get_property (GObject     *object,
     case PROP_PROTOCOL:
       g_value_set_int (value, op->protocol);
       break;
+    case PROP_KEYS:
+      g_value_set_pointer (value, op->keys);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -101,6 +122,11 @@ gpa_backup_operation_set_property (GObject     *object,
     case PROP_PROTOCOL:
       op->protocol = g_value_get_int (value);
       break;
+    case PROP_KEYS:
+      op->keys = (GList*) g_value_get_pointer (value);
+      /* Make sure we keep a reference for our keys */
+      g_list_foreach (op->keys, (GFunc) gpgme_key_ref, NULL);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -115,6 +141,19 @@ gpa_backup_operation_finalize (GObject *object)
   gpgme_key_unref (op->key);
   g_free (op->fpr);
   g_free (op->key_id);
+  g_list_foreach (op->keys, (GFunc) gpgme_key_unref, NULL);
+  g_list_free (op->keys);
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
+  if (op->jobs)
+    g_ptr_array_free (op->jobs, TRUE);
+  gpgme_data_release (op->out);
+  gpgme_data_release (op->plain);
+  if (op->fp)
+    fclose (op->fp);
+  g_free (op->filename);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -126,6 +165,16 @@ gpa_backup_operation_init (GpaBackupOperation *op)
   op->fpr = NULL;
   op->key_id = NULL;
   op->protocol = GPGME_PROTOCOL_UNKNOWN;
+  op->keys = NULL;
+  op->fp = NULL;
+  op->out = NULL;
+  op->plain = NULL;
+  op->encrypt = FALSE;
+  op->filename = NULL;
+  op->jobs = NULL;
+  op->next_step = 0;
+  op->idle_id = 0;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -142,6 +191,20 @@ gpa_backup_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_BACKUP_OPERATION (object);
 
+  if (!op->keys && op->key)
+    {
+      gpgme_key_ref (op->key);
+      op->keys = g_list_append (NULL, op->key);
+    }
+  else if (op->keys && !op->key_id)
+    {
+      op->key_id = g_strdup (gpa_gpgme_key_get_short_keyid (op->keys->data));
+      op->protocol = ((gpgme_key_t) op->keys->data)->protocol;
+    }
+
+  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
+		    G_CALLBACK (gpa_backup_operation_done_cb), op);
+
   /* Begin working when we are back into the main loop */
   g_idle_add (gpa_backup_operation_idle_cb, op);
 
@@ -173,6 +236,12 @@ gpa_backup_operation_class_init (GpaBackupOperationClass *klass)
 				   ("fpr", "fpr",
 				    "Fingerprint",
 				    G_PARAM_WRITABLE|G_PARAM_CONSTRUCT_ONLY));
+  g_object_class_install_property (object_class,
+				   PROP_KEYS,
+				   g_param_spec_pointer
+				   ("keys", "Keys",
+				    "Keys",
+				    G_PARAM_WRITABLE|G_PARAM_CONSTRUCT_ONLY));
   g_object_class_install_property
     (object_class, PROP_PROTOCOL,
      g_param_spec_int
@@ -213,9 +282,140 @@ gpa_backup_operation_get_type (void)
 /* Private functions */
 
 static void
-gpa_backup_operation_do_backup (GpaBackupOperation *op, gchar *filename)
+backup_job_free (gpointer data)
 {
-  if (gpa_backup_key (op->fpr, filename, (op->protocol == GPGME_PROTOCOL_CMS)))
+  struct backup_job_s *job = data;
+
+  g_ptr_array_free (job->fprs, TRUE);
+  g_free (job);
+}
+
+
+static struct backup_job_s *
+backup_job_new (gpgme_protocol_t protocol)
+{
+  struct backup_job_s *job;
+
+  job = g_malloc0 (sizeof *job);
+  job->protocol = protocol;
+  job->fprs = g_ptr_array_new ();
+  return job;
+}
+
+
+/* Split the keys of OP into engine invocations.  The OpenPGP keys
+   are exported BACKUP_BATCH_SIZE at a time to keep the command line
+   short; gpgsm needs one invocation per certificate.  Each job is run
+   twice, to export first the public and then the secret keys.  */
+static void
+backup_build_jobs (GpaBackupOperation *op)
+{
+  struct backup_job_s *openpgp = NULL;
+  struct backup_job_s *job;
+  GList *item;
+  guint i;
+
+  op->jobs = g_ptr_array_new_with_free_func (backup_job_free);
+  if (!op->keys)
+    {
+      job = backup_job_new (op->protocol == GPGME_PROTOCOL_CMS
+                            ? GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+      g_ptr_array_add (job->fprs, op->fpr);
+      g_ptr_array_add (op->jobs, job);
+    }
+  for (item = op->keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      if (key->protocol == GPGME_PROTOCOL_CMS)
+        {
+          job = backup_job_new (GPGME_PROTOCOL_CMS);
+          g_ptr_array_add (op->jobs, job);
+        }
+      else
+        {
+          if (!openpgp || openpgp->fprs->len >= BACKUP_BATCH_SIZE)
+            {
+              openpgp = backup_job_new (GPGME_PROTOCOL_OpenPGP);
+              g_ptr_array_add (op->jobs, openpgp);
+            }
+          job = openpgp;
+        }
+      g_ptr_array_add (job->fprs, key->subkeys->fpr);
+    }
+  for (i = 0; i < op->jobs->len; i++)
+    {
+      job = g_ptr_array_index (op->jobs, i);
+      g_ptr_array_add (job->fprs, NULL);
+    }
+}
+
+
+/* Write the warning and the list of keys to the backup file.  */
+static void
+backup_write_header (GpaBackupOperation *op)
+{
+  GList *item;
+  guint nkeys = op->keys? g_list_length (op->keys) : 1;
+  gchar *fpr;
+
+  fputs (_(
+    "************************************************************************\n"
+    "* WARNING: This file is a backup of your secret key. Please keep it in *\n"
+    "* a safe place.                                                        *\n"
+    "************************************************************************\n"
+    "\n"), op->fp);
+
+  fputs (ngettext ("The key backed up in this file is:\n\n",
+                   "The keys backed up in this file are:\n\n", nkeys),
+         op->fp);
+  if (!op->keys)
+    {
+      fpr = gpa_gpgme_key_format_fingerprint (op->fpr);
+      fprintf (op->fp, "      %s\n", fpr);
+      g_free (fpr);
+    }
+  for (item = op->keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+      gchar *uid = gpa_gpgme_key_get_userid (key->uids);
+
+      fpr = gpa_gpgme_key_format_fingerprint (key->subkeys->fpr);
+      fprintf (op->fp, "%s\n      %s\n", uid, fpr);
+      g_free (fpr);
+      g_free (uid);
+    }
+  fputs ("\n", op->fp);
+  fflush (op->fp);
+}
+
+
+/* Update the progress dialog.  */
+static void
+backup_progress (GpaBackupOperation *op)
+{
+  guint total = 2 * op->jobs->len + !!op->encrypt;
+
+  if (op->progress_dialog)
+    gpa_progress_bar_set_fraction
+      (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+       (gdouble) op->next_step / total);
+}
+
+
+/* The backup is complete, with ERR.  */
+static void
+backup_finish (GpaBackupOperation *op, gpg_error_t err)
+{
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+  gpgme_data_release (op->out);
+  op->out = NULL;
+  if (op->fp && fclose (op->fp) && !err)
+    err = gpg_error_from_syserror ();
+  op->fp = NULL;
+
+  if (!err)
     {
       gchar *message;
       message = g_strdup_printf (_("A copy of your secret key has "
@@ -225,32 +425,156 @@ gpa_backup_operation_do_backup (GpaBackupOperation *op, gchar *filename)
 				   "and should be stored carefully\n"
 				   "(for example, on a USB stick "
 				   "kept in a safe place)."),
-				 filename);
+				 op->filename);
       gpa_window_message (message, GPA_OPERATION (op)->window);
       g_free (message);
       gpa_options_set_backup_generated (gpa_options_get_instance (),
 					TRUE);
     }
+  else if (gpg_err_code (err) != GPG_ERR_CANCELED)
+    {
+      g_message ("error creating backup '%s': %s",
+                 op->filename, gpg_strerror (err));
+      gpa_window_error (_("An error ocurred during the backup operation."),
+                        GPA_OPERATION (op)->window);
+    }
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+/* Run the next engine invocation or, when all are done, encrypt the
+   collected keys.  */
+static gboolean
+backup_next_cb (gpointer data)
+{
+  GpaBackupOperation *op = data;
+  gpgme_ctx_t ctx = GPA_OPERATION (op)->context->ctx;
+  gpg_error_t err;
+
+  op->idle_id = 0;
+  if (op->next_step < 2 * op->jobs->len)
+    {
+      struct backup_job_s *job;
+
+      job = g_ptr_array_index (op->jobs, op->next_step / 2);
+      err = gpa_backup_keys_start (ctx, job->protocol,
+                                   (const char **) job->fprs->pdata,
+                                   op->next_step % 2,
+                                   op->plain? op->plain : op->out);
+    }
   else
     {
-      gchar *message = g_strdup_printf (_("An error ocurred during the "
-					  "backup operation."));
+      /* Encrypt with a passphrase only.  */
+      gpgme_data_seek (op->plain, 0, SEEK_SET);
+      gpgme_set_protocol (ctx, GPGME_PROTOCOL_OpenPGP);
+      gpgme_set_armor (ctx, 1);
+      err = gpgme_op_encrypt_start (ctx, NULL, 0, op->plain, op->out);
+    }
+  if (err)
+    backup_finish (op, err);
+
+  return FALSE;
+}
+
+
+static void
+gpa_backup_operation_done_cb (GpaContext *context, gpg_error_t err,
+                              GpaBackupOperation *op)
+{
+  gboolean more;
+
+  if (!op->jobs)
+    return;
+
+  op->next_step++;
+  backup_progress (op);
+  more = (op->next_step < 2 * op->jobs->len
+          || (op->encrypt && op->next_step == 2 * op->jobs->len));
+  if (err || !more)
+    {
+      backup_finish (op, err);
+      return;
+    }
+  if (op->next_step < 2 * op->jobs->len)
+    gpgme_data_write (op->plain? op->plain : op->out, "\n", 1);
+
+  /* Do not start the next operation from within the done handler.  */
+  op->idle_id = g_idle_add (backup_next_cb, op);
+}
+
+
+/* Start the backup into FILENAME.  */
+static void
+gpa_backup_operation_do_backup (GpaBackupOperation *op, gchar *filename)
+{
+  gpg_error_t err;
+  guint nkeys;
+
+  op->filename = filename;
+  {
+    mode_t mask = umask (0077);
+    op->fp = g_fopen (filename, "w");
+    umask (mask);
+  }
+  if (!op->fp)
+    {
+      gchar message[256];
+      g_snprintf (message, sizeof(message), "%s: %s",
+		  filename, strerror(errno));
       gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                             gpg_error_from_syserror ());
+      return;
+    }
+  backup_write_header (op);
+  backup_build_jobs (op);
+
+  err = gpgme_data_new_from_stream (&op->out, op->fp);
+  if (!err && op->encrypt)
+    err = gpgme_data_new (&op->plain);
+  if (err)
+    {
+      backup_finish (op, err);
+      return;
     }
+
+  nkeys = op->keys? g_list_length (op->keys) : 1;
+  if (nkeys > 1 || op->encrypt)
+    {
+      gchar *label;
+
+      op->progress_dialog = gpa_progress_dialog_new
+        (GPA_OPERATION (op)->window, GPA_OPERATION (op)->context);
+      gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                            _("Backing up Keys..."));
+      label = g_strdup_printf (ngettext ("Backing up %u key",
+                                         "Backing up %u keys", nkeys),
+                               nkeys);
+      gpa_progress_dialog_set_label
+        (GPA_PROGRESS_DIALOG (op->progress_dialog), label);
+      g_free (label);
+      gtk_widget_show_all (op->progress_dialog);
+    }
+
+  backup_next_cb (op);
 }
 
 
-/* Return the filename in filename encoding.  */
+/* Return the filename in filename encoding.  ID_TEXT describes the
+   keys to back up.  R_ENCRYPT is set if the user wants the backup to
+   be encrypted with a passphrase.  */
 static gchar*
-gpa_backup_operation_dialog_run (GtkWidget *parent, const gchar *key_id,
-                                 int is_x509)
+gpa_backup_operation_dialog_run (GtkWidget *parent, const gchar *id_text,
+                                 const gchar *default_name,
+                                 gboolean *r_encrypt)
 {
   static GtkWidget *dialog;
   GtkResponseType response;
   gchar *default_comp;
   gchar *filename = NULL;
-  gchar *id_text;
+  GtkWidget *vbox;
   GtkWidget *id_label;
+  GtkWidget *encrypt_check;
 
   if (! dialog)
     {
@@ -268,28 +592,27 @@ gpa_backup_operation_dialog_run (GtkWidget *parent, const gchar *key_id,
     }
 
   /* Set the label with more explanations.  */
-  id_text = g_strdup_printf (_("Generating backup of key: 0x%s"), key_id);
+  vbox = gtk_vbox_new (FALSE, 5);
   id_label = gtk_label_new (id_text);
-  g_free (id_text);
-  gtk_file_chooser_set_extra_widget (GTK_FILE_CHOOSER (dialog), id_label);
-
-  /* Set the default file name.  I am not sure whether ".p12" or
-     ".pem" is better for an _armored_ pkcs#12. */
-  default_comp = g_strdup_printf ("%s%csecret-key-%s.%s",
+  gtk_box_pack_start (GTK_BOX (vbox), id_label, FALSE, FALSE, 0);
+  encrypt_check = gtk_check_button_new_with_mnemonic
+    (_("_Encrypt the backup with a passphrase"));
+  gtk_box_pack_start (GTK_BOX (vbox), encrypt_check, FALSE, FALSE, 0);
+  gtk_widget_show_all (vbox);
+  gtk_file_chooser_set_extra_widget (GTK_FILE_CHOOSER (dialog), vbox);
+
+  default_comp = g_strdup_printf ("%s%c%s",
                                   gnupg_homedir,
                                   G_DIR_SEPARATOR,
-                                  key_id,
-                                  is_x509? "p12":"asc");
+                                  default_name);
   gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (dialog), default_comp);
   g_free (default_comp);
 
   response = gtk_dialog_run (GTK_DIALOG (dialog));
   if (response == GTK_RESPONSE_OK)
-    {
-      filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
-      if (filename)
-	g_strdup (filename);
-    }
+    filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+  *r_encrypt = gtk_toggle_button_get_active
+    (GTK_TOGGLE_BUTTON (encrypt_check));
 
   gtk_widget_hide (dialog);
 
@@ -301,15 +624,37 @@ gpa_backup_operation_idle_cb (gpointer data)
 {
   GpaBackupOperation *op = data;
   gchar *file;
+  gchar *id_text;
+  gchar *default_name;
+  guint nkeys = op->keys? g_list_length (op->keys) : 1;
+
+  if (nkeys == 1)
+    {
+      int is_x509 = (op->protocol == GPGME_PROTOCOL_CMS);
+
+      id_text = g_strdup_printf (_("Generating backup of key: 0x%s"),
+                                 op->key_id);
+      /* I am not sure whether ".p12" or ".pem" is better for an
+         _armored_ pkcs#12. */
+      default_name = g_strdup_printf ("secret-key-%s.%s", op->key_id,
+                                      is_x509? "p12":"asc");
+    }
+  else
+    {
+      id_text = g_strdup_printf (_("Generating backup of %u keys"), nkeys);
+      default_name = g_strdup ("secret-keys.asc");
+    }
 
   file = gpa_backup_operation_dialog_run (GPA_OPERATION (op)->window,
-                                          op->key_id,
-                                          !!(op->protocol==GPGME_PROTOCOL_CMS));
+                                          id_text, default_name,
+                                          &op->encrypt);
+  g_free (id_text);
+  g_free (default_name);
   if (file)
     gpa_backup_operation_do_backup (op, file);
-
-  /* FIXME: Error handling.  */
-  g_signal_emit_by_name (GPA_OPERATION (op), "completed", 0);
+  else
+    g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                           gpg_error (GPG_ERR_CANCELED));
 
   return FALSE;  /* Remove us from the idle chain.  */
 }
@@ -330,6 +675,19 @@ gpa_backup_operation_new (GtkWidget *window, gpgme_key_t key)
   return op;
 }
 
+GpaBackupOperation*
+gpa_backup_operation_new_list (GtkWidget *window, GList *keys)
+{
+  GpaBackupOperation *op;
+
+  op = g_object_new (GPA_BACKUP_OPERATION_TYPE,
+		     "window", window,
+		     "keys", keys,
+		     NULL);
+
+  return op;
+}
+
 GpaBackupOperation*
 gpa_backup_operation_new_from_fpr (GtkWidget *window,
                                    const gchar *fpr, gpgme_protocol_t protocol)
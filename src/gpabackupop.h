@@ -44,6 +44,20 @@ struct _GpaBackupOperation {
   gpgme_key_t key;
   gchar *fpr, *key_id;
   gpgme_protocol_t protocol;
+
+  /* The keys to back up.  Includes KEY.  */
+  GList *keys;
+
+  /* The state of a running backup.  */
+  FILE *fp;
+  gpgme_data_t out;
+  gpgme_data_t plain;
+  gboolean encrypt;
+  gchar *filename;
+  GPtrArray *jobs;
+  guint next_step;       /* Two steps per job: public, then secret.  */
+  guint idle_id;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaBackupOperationClass {
@@ -56,6 +70,11 @@ GType gpa_backup_operation_get_type (void) G_GNUC_CONST;
 GpaBackupOperation*
 gpa_backup_operation_new (GtkWidget *window, gpgme_key_t key);
 
+/* Backup all secret keys in the list KEYS.  The operation takes
+   ownership of the list.  */
+GpaBackupOperation*
+gpa_backup_operation_new_list (GtkWidget *window, GList *keys);
+
 GpaBackupOperation*
 gpa_backup_operation_new_from_fpr (GtkWidget *window, const gchar *fpr,
                                    gpgme_protocol_t protocol);
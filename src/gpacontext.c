@@ -20,8 +20,13 @@
 
 #include <config.h>
 
+#include <string.h>
+#include <errno.h>
 #include <glib.h>
 #include <gpgme.h>
+#ifdef HAVE_EPOLL_CREATE
+# include <sys/epoll.h>
+#endif /*HAVE_EPOLL_CREATE*/
 #include "gpa.h"
 #include "gpgmetools.h"
 #include "gpacontext.h"
@@ -258,8 +263,236 @@ struct gpa_io_cb_data
   gint watch;
   GpaContext *context;
   gboolean registered;
+  guint id;             /* Tag used by the I/O multiplexer.  */
+  gboolean in_mux;      /* Registered with the I/O multiplexer.  */
+  gboolean suspended;   /* Disabled while a nested loop runs.  */
 };
 
+
+#ifdef HAVE_EPOLL_CREATE
+/* All file descriptors of all contexts are watched by one epoll
+   instance whose descriptor is polled by a single GSource.  This
+   makes registering a callback as cheap as an epoll_ctl call and
+   avoids one GSource per descriptor.  The epoll events carry a tag
+   which is looked up in a table; thus events for callbacks removed
+   while dispatching an earlier event are simply ignored.
+
+   A callback may run a nested main loop, for example the passphrase
+   dialog.  The source may thus be dispatched recursively.  The GPGME
+   callbacks are not reentrant, so the descriptor of a callback being
+   run is disabled while a nested dispatch is going on.  */
+
+/* Maximum number of events handled per dispatch.  */
+#define MUX_MAX_EVENTS 64
+
+typedef struct
+{
+  GSource source;
+  GPollFD pollfd;
+} MuxSource;
+
+static struct
+{
+  int initialized;
+  int epfd;             /* The epoll descriptor or -1.  */
+  GSource *source;
+  GHashTable *tags;     /* Tag -> struct gpa_io_cb_data.  */
+  guint next_id;
+  struct gpa_io_cb_data *running;  /* The callback being run.  */
+  guint serial;         /* Incremented on each dispatch.  */
+} io_mux;
+
+
+/* Return the epoll events to wait for on behalf of CB.  */
+static guint32
+io_mux_events (struct gpa_io_cb_data *cb)
+{
+  return (cb->dir ? (EPOLLIN | EPOLLHUP | EPOLLERR)
+          : (EPOLLOUT | EPOLLERR));
+}
+
+
+/* Enable or disable the descriptor of CB.  */
+static void
+io_mux_suspend (struct gpa_io_cb_data *cb, gboolean suspend)
+{
+  struct epoll_event ev;
+
+  if (!cb->in_mux || cb->suspended == suspend)
+    return;
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = suspend ? 0 : io_mux_events (cb);
+  ev.data.u32 = cb->id;
+  epoll_ctl (io_mux.epfd, EPOLL_CTL_MOD, cb->fd, &ev);
+  cb->suspended = suspend;
+}
+
+
+static gboolean
+io_mux_prepare (GSource *source, gint *timeout)
+{
+  *timeout = -1;
+  return FALSE;
+}
+
+
+static gboolean
+io_mux_check (GSource *source)
+{
+  MuxSource *mux = (MuxSource *) source;
+
+  return !!(mux->pollfd.revents & G_IO_IN);
+}
+
+
+static gboolean
+io_mux_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+  struct epoll_event events[MUX_MAX_EVENTS];
+  struct gpa_io_cb_data *cb, *outer;
+  guint serial;
+  int n, i;
+
+  /* Called from a nested main loop.  */
+  if (io_mux.running)
+    io_mux_suspend (io_mux.running, TRUE);
+  outer = io_mux.running;
+  serial = ++io_mux.serial;
+
+  n = epoll_wait (io_mux.epfd, events, MUX_MAX_EVENTS, 0);
+  for (i = 0; i < n; i++)
+    {
+      guint id = events[i].data.u32;
+
+      cb = g_hash_table_lookup (io_mux.tags, GUINT_TO_POINTER (id));
+      if (!cb || !cb->in_mux || cb->suspended)
+        continue;
+
+      /* We have to use the GPGME provided "file descriptor" here.  */
+      io_mux.running = cb;
+      cb->fnc (cb->fnc_data, cb->fd);
+      io_mux.running = outer;
+
+      /* The callback may have been removed meanwhile.  */
+      if (g_hash_table_lookup (io_mux.tags, GUINT_TO_POINTER (id)) == cb)
+        io_mux_suspend (cb, FALSE);
+
+      /* After a nested dispatch the remaining events may be stale;
+         the descriptors which are still ready are reported again.  */
+      if (io_mux.serial != serial)
+        break;
+    }
+
+  return TRUE;
+}
+
+
+static GSourceFuncs io_mux_funcs =
+  {
+    io_mux_prepare,
+    io_mux_check,
+    io_mux_dispatch,
+    NULL
+  };
+
+
+/* Create the multiplexer.  Returns false if it is not available.  */
+static gboolean
+io_mux_init (void)
+{
+  MuxSource *mux;
+
+  if (io_mux.initialized)
+    return io_mux.epfd != -1;
+  io_mux.initialized = 1;
+
+  io_mux.epfd = epoll_create (MUX_MAX_EVENTS);
+  if (io_mux.epfd == -1)
+    {
+      g_debug ("epoll_create failed: %s - using I/O channels",
+               strerror (errno));
+      return FALSE;
+    }
+  io_mux.tags = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  io_mux.source = g_source_new (&io_mux_funcs, sizeof (MuxSource));
+  mux = (MuxSource *) io_mux.source;
+  mux->pollfd.fd = io_mux.epfd;
+  mux->pollfd.events = G_IO_IN;
+  g_source_add_poll (io_mux.source, &mux->pollfd);
+  g_source_set_can_recurse (io_mux.source, TRUE);
+  g_source_attach (io_mux.source, NULL);
+
+  return TRUE;
+}
+
+
+/* Assign a tag to CB.  */
+static void
+io_mux_add_tag (struct gpa_io_cb_data *cb)
+{
+  if (!io_mux_init ())
+    return;
+
+  do
+    cb->id = ++io_mux.next_id;
+  while (!cb->id || g_hash_table_lookup (io_mux.tags,
+                                         GUINT_TO_POINTER (cb->id)));
+  g_hash_table_insert (io_mux.tags, GUINT_TO_POINTER (cb->id), cb);
+}
+
+
+/* Add CB to the multiplexer.  Returns false if this is not possible;
+   the caller needs to use an I/O channel then.  */
+static gboolean
+io_mux_add (struct gpa_io_cb_data *cb)
+{
+  struct epoll_event ev;
+
+  if (!cb->id)
+    return FALSE;
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = io_mux_events (cb);
+  ev.data.u32 = cb->id;
+  if (epoll_ctl (io_mux.epfd, EPOLL_CTL_ADD, cb->fd, &ev))
+    return FALSE;
+  cb->in_mux = TRUE;
+  cb->suspended = FALSE;
+  return TRUE;
+}
+
+
+/* Remove CB from the multiplexer.  */
+static void
+io_mux_remove (struct gpa_io_cb_data *cb)
+{
+  struct epoll_event ev;
+
+  if (!cb->in_mux)
+    return;
+
+  /* Old kernels require a non-NULL event for EPOLL_CTL_DEL.  */
+  memset (&ev, 0, sizeof ev);
+  epoll_ctl (io_mux.epfd, EPOLL_CTL_DEL, cb->fd, &ev);
+  cb->in_mux = FALSE;
+}
+
+
+/* Release the tag of CB.  */
+static void
+io_mux_remove_tag (struct gpa_io_cb_data *cb)
+{
+  if (cb->id)
+    g_hash_table_remove (io_mux.tags, GUINT_TO_POINTER (cb->id));
+  cb->id = 0;
+  if (io_mux.running == cb)
+    io_mux.running = NULL;
+}
+#endif /*HAVE_EPOLL_CREATE*/
+
+
 /* This function is called by GLib. It's a wrapper for the callback
  * gpgme provided, whose prototype does not match the one needed
  * by g_io_add_watch_full
@@ -282,6 +515,14 @@ static void
 register_callback (struct gpa_io_cb_data *cb)
 {
   GIOChannel *channel;
+
+#ifdef HAVE_EPOLL_CREATE
+  if (io_mux_add (cb))
+    {
+      cb->registered = TRUE;
+      return;
+    }
+#endif /*HAVE_EPOLL_CREATE*/
  
 #ifdef G_OS_WIN32
   /* We have to ask GPGME for the GIOChannel to use.  The "file
@@ -343,7 +584,12 @@ unregister_all_callbacks (GpaContext *context)
       cb = list->data;
       if (cb->registered)
 	{
-	  g_source_remove (cb->watch);
+#ifdef HAVE_EPOLL_CREATE
+          if (cb->in_mux)
+            io_mux_remove (cb);
+          else
+#endif /*HAVE_EPOLL_CREATE*/
+            g_source_remove (cb->watch);
 	  cb->registered = FALSE;
 	}
     }
@@ -368,6 +614,12 @@ gpa_context_register_cb (void *data, int fd, int dir, gpgme_io_cb_t fnc,
   cb->fnc = fnc;
   cb->fnc_data = fnc_data;
   cb->context = context;
+  cb->id = 0;
+  cb->in_mux = FALSE;
+  cb->suspended = FALSE;
+#ifdef HAVE_EPOLL_CREATE
+  io_mux_add_tag (cb);
+#endif /*HAVE_EPOLL_CREATE*/
   /* If the context is busy, we already have a START event, and can
    * register GLib callbacks immediately.  */
   if (context->busy)
@@ -390,8 +642,16 @@ gpa_context_remove_cb (void *tag)
 
   if (cb->registered)
     {
-      g_source_remove (cb->watch);
+#ifdef HAVE_EPOLL_CREATE
+      if (cb->in_mux)
+        io_mux_remove (cb);
+      else
+#endif /*HAVE_EPOLL_CREATE*/
+        g_source_remove (cb->watch);
     }
+#ifdef HAVE_EPOLL_CREATE
+  io_mux_remove_tag (cb);
+#endif /*HAVE_EPOLL_CREATE*/
   cb->context->cbs = g_list_remove (cb->context->cbs, cb);
   g_free (cb);
 }
@@ -28,6 +28,24 @@
 
 static GObjectClass *parent_class = NULL;
 
+/* The number of fingerprints passed to a single export call.  This
+   keeps the command line of the engine short for large exports.  */
+#define EXPORT_BATCH_SIZE 1000
+
+/* The keys of one protocol and the state of their export.  */
+struct export_part_s
+{
+  GpaExportOperation *op;
+  gpgme_protocol_t protocol;
+  GpaContext *context;
+  gboolean own_context;
+  GPtrArray *fprs;        /* The fingerprints of the keys (not owned).  */
+  guint next;             /* Index of the next fingerprint to export.  */
+  gpgme_data_t dest;
+  gboolean own_dest;
+  guint idle_id;
+};
+
 /* Properties */
 enum
 {
@@ -37,7 +55,7 @@ enum
 
 static gboolean gpa_export_operation_idle_cb (gpointer data);
 static void gpa_export_operation_done_cb (GpaContext *context, gpg_error_t err,
-			      GpaExportOperation *op);
+					  struct export_part_s *part);
 static void gpa_export_operation_done_error_cb (GpaContext *context,
 						gpg_error_t err,
 						GpaExportOperation *op);
@@ -88,6 +106,23 @@ static void
 gpa_export_operation_finalize (GObject *object)
 {
   GpaExportOperation *op = GPA_EXPORT_OPERATION (object);
+  int i;
+
+  for (i = 0; i < op->nparts; i++)
+    {
+      struct export_part_s *part = &op->parts[i];
+
+      if (part->idle_id)
+        g_source_remove (part->idle_id);
+      if (part->own_context)
+        g_object_unref (part->context);
+      if (part->own_dest)
+        gpgme_data_release (part->dest);
+      g_ptr_array_free (part->fprs, TRUE);
+    }
+  g_free (op->parts);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
 
   /* Free each key, and then the list of keys */
   g_list_foreach (op->keys, (GFunc) gpgme_key_unref, NULL);
@@ -106,6 +141,13 @@ gpa_export_operation_init (GpaExportOperation *op)
 {
   op->keys = NULL;
   op->dest = NULL;
+  op->parts = NULL;
+  op->nparts = 0;
+  op->running = 0;
+  op->err = 0;
+  op->batches_done = 0;
+  op->batches_total = 0;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -122,11 +164,8 @@ gpa_export_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_EXPORT_OPERATION (object);
 
-
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_export_operation_done_error_cb), op);
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_export_operation_done_cb), op);
+  /* There is at most one part per protocol.  */
+  op->parts = g_malloc0 (2 * sizeof *op->parts);
 
   /* Begin working when we are back into the main loop */
   g_idle_add (gpa_export_operation_idle_cb, op);
@@ -189,6 +228,190 @@ gpa_export_operation_get_type (void)
 
 /* Private functions */
 
+/* Return the part of OP for PROTOCOL, creating it if needed.  */
+static struct export_part_s *
+get_part (GpaExportOperation *op, gpgme_protocol_t protocol)
+{
+  struct export_part_s *part;
+  int i;
+
+  for (i = 0; i < op->nparts; i++)
+    if (op->parts[i].protocol == protocol)
+      return &op->parts[i];
+
+  part = &op->parts[op->nparts++];
+  part->op = op;
+  part->protocol = protocol;
+  part->fprs = g_ptr_array_new ();
+  return part;
+}
+
+
+/* Start exporting the next batch of keys of PART.  */
+static gpg_error_t
+export_part_next (struct export_part_s *part)
+{
+  const char **patterns;
+  guint n, i;
+  gpg_error_t err;
+
+  n = MIN (part->fprs->len - part->next, EXPORT_BATCH_SIZE);
+  patterns = g_malloc0 ((n + 1) * sizeof *patterns);
+  for (i = 0; i < n; i++)
+    patterns[i] = g_ptr_array_index (part->fprs, part->next + i);
+
+  gpgme_set_protocol (part->context->ctx, part->protocol);
+  err = gpgme_op_export_ext_start (part->context->ctx, patterns, 0,
+                                   part->dest);
+  g_free (patterns);
+  if (!err)
+    part->next += n;
+  return err;
+}
+
+
+/* Update the progress dialog of OP.  */
+static void
+export_progress (GpaExportOperation *op)
+{
+  if (!op->progress_dialog)
+    return;
+
+  gpa_progress_bar_set_fraction
+    (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+     (gdouble) op->batches_done / op->batches_total);
+}
+
+
+/* Append the data exported by the other parts to the destination of
+   OP.  */
+static gpg_error_t
+export_concat (GpaExportOperation *op)
+{
+  char buffer[4096];
+  ssize_t nread;
+  int i;
+
+  for (i = 0; i < op->nparts; i++)
+    {
+      struct export_part_s *part = &op->parts[i];
+
+      if (!part->own_dest)
+        continue;
+      if (gpgme_data_seek (part->dest, 0, SEEK_SET))
+        return gpg_error_from_syserror ();
+      while ((nread = gpgme_data_read (part->dest, buffer, sizeof buffer)) > 0)
+        if (gpgme_data_write (op->dest, buffer, nread) != nread)
+          return gpg_error_from_syserror ();
+      if (nread < 0)
+        return gpg_error_from_syserror ();
+    }
+  return 0;
+}
+
+
+/* All parts of OP are done.  */
+static void
+export_finish (GpaExportOperation *op)
+{
+  gpg_error_t err = op->err;
+
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+  if (!err)
+    {
+      err = export_concat (op);
+      if (err)
+        gpa_gpgme_warning (err);
+    }
+  if (!err)
+    GPA_EXPORT_OPERATION_GET_CLASS (op)->complete_export (op);
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+/* PART is done, with ERR.  */
+static void
+export_part_finish (struct export_part_s *part, gpg_error_t err)
+{
+  GpaExportOperation *op = part->op;
+
+  if (err && !op->err)
+    op->err = err;
+  if (!--op->running)
+    export_finish (op);
+}
+
+
+static gboolean
+export_part_idle_cb (gpointer data)
+{
+  struct export_part_s *part = data;
+  gpg_error_t err;
+
+  part->idle_id = 0;
+  err = export_part_next (part);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      export_part_finish (part, err);
+    }
+
+  return FALSE;
+}
+
+
+/* Split the keys of OP by protocol and prepare the contexts and
+   destinations.  If keys of both protocols are to be exported, the
+   OpenPGP keys are written directly to the destination and the X.509
+   certificates are collected in memory and appended at the end.
+   Both exports run at the same time.  */
+static void
+export_setup (GpaExportOperation *op, gboolean armor)
+{
+  GList *k;
+  int i;
+
+  for (k = op->keys; k; k = g_list_next (k))
+    {
+      gpgme_key_t key = (gpgme_key_t) k->data;
+
+      g_ptr_array_add (get_part (op, key->protocol)->fprs,
+                       key->subkeys->fpr);
+    }
+
+  /* Binary data of both protocols can't be told apart.  */
+  if (op->nparts > 1)
+    armor = TRUE;
+
+  for (i = 0; i < op->nparts; i++)
+    {
+      struct export_part_s *part = &op->parts[i];
+
+      if (!i)
+        {
+          part->context = GPA_OPERATION (op)->context;
+          part->dest = op->dest;
+        }
+      else
+        {
+          part->context = gpa_context_new ();
+          part->own_context = TRUE;
+          if (gpgme_data_new (&part->dest))
+            gpa_gpgme_error (gpg_error_from_syserror ());
+          part->own_dest = TRUE;
+        }
+      gpgme_set_armor (part->context->ctx, armor);
+      g_signal_connect (G_OBJECT (part->context), "done",
+                        G_CALLBACK (gpa_export_operation_done_error_cb), op);
+      g_signal_connect (G_OBJECT (part->context), "done",
+                        G_CALLBACK (gpa_export_operation_done_cb), part);
+      op->batches_total += ((part->fprs->len + EXPORT_BATCH_SIZE - 1)
+                            / EXPORT_BATCH_SIZE);
+    }
+}
+
+
 static gboolean
 gpa_export_operation_idle_cb (gpointer data)
 {
@@ -199,45 +422,47 @@ gpa_export_operation_idle_cb (gpointer data)
 							    &armor))
     {
       gpg_error_t err = 0;
-      const char **patterns;
-      GList *k;
       int i;
-      gpgme_protocol_t prot = GPGME_PROTOCOL_UNKNOWN;
-
-      gpgme_set_armor (GPA_OPERATION (op)->context->ctx, armor);
-      /* Create the set of keys to export */
-      patterns = g_malloc0 (sizeof(gchar*)*(g_list_length(op->keys)+1));
-      for (i = 0, k = op->keys; k; i++, k = g_list_next (k))
-	{
-	  gpgme_key_t key = (gpgme_key_t) k->data;
-	  patterns[i] = key->subkeys->fpr;
-          if (prot == GPGME_PROTOCOL_UNKNOWN)
-            prot = key->protocol;
-          else if (prot != key->protocol)
-            {
-              gpa_window_error
-                (_("Only keys of the same procotol may be exported"
-                   " as a collection."), NULL);
-              g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-              goto cleanup;
-            }
-	}
-      if (prot == GPGME_PROTOCOL_UNKNOWN)
+
+      export_setup (op, armor);
+      if (!op->nparts)
         {
           g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-          goto cleanup;  /* No keys.  */
+          return FALSE;  /* No keys.  */
         }
-      gpgme_set_protocol (GPA_OPERATION (op)->context->ctx, prot);
-      /* Export to the gpgme_data_t */
-      err = gpgme_op_export_ext_start (GPA_OPERATION (op)->context->ctx,
-				       patterns, 0, op->dest);
-      if (err)
-	{
-	  gpa_gpgme_warning (err);
-	  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-	}
-    cleanup:
-      g_free (patterns);
+
+      if (op->batches_total > 1)
+        {
+          guint nkeys = g_list_length (op->keys);
+          gchar *label;
+
+          op->progress_dialog = gpa_progress_dialog_new
+            (GPA_OPERATION (op)->window, GPA_OPERATION (op)->context);
+          gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                                _("Exporting Keys..."));
+          label = g_strdup_printf (ngettext ("Exporting %u key",
+                                             "Exporting %u keys", nkeys),
+                                   nkeys);
+          gpa_progress_dialog_set_label
+            (GPA_PROGRESS_DIALOG (op->progress_dialog), label);
+          g_free (label);
+          gtk_widget_show_all (op->progress_dialog);
+        }
+
+      for (i = 0; i < op->nparts; i++)
+        {
+          err = export_part_next (&op->parts[i]);
+          if (err)
+            {
+              gpa_gpgme_warning (err);
+              if (!op->err)
+                op->err = err;
+              continue;
+            }
+          op->running++;
+        }
+      if (!op->running)
+        export_finish (op);
     }
   else
     /* Abort the operation.  */
@@ -249,11 +474,17 @@ gpa_export_operation_idle_cb (gpointer data)
 
 static void
 gpa_export_operation_done_cb (GpaContext *context, gpg_error_t err,
-			      GpaExportOperation *op)
+			      struct export_part_s *part)
 {
-  if (! err)
-    GPA_EXPORT_OPERATION_GET_CLASS (op)->complete_export (op);
-  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+  part->op->batches_done++;
+  export_progress (part->op);
+  if (!err && part->next < part->fprs->len)
+    {
+      /* Do not start the next export from within the done handler.  */
+      part->idle_id = g_idle_add (export_part_idle_cb, part);
+      return;
+    }
+  export_part_finish (part, err);
 }
 
 static void
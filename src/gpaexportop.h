@@ -43,6 +43,15 @@ struct _GpaExportOperation {
 
   GList *keys;
   gpgme_data_t dest;
+
+  /* The keys partitioned by protocol and the state of their export.  */
+  struct export_part_s *parts;
+  int nparts;
+  int running;
+  gpg_error_t err;
+  guint batches_done;
+  guint batches_total;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaExportOperationClass {
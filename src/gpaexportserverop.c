@@ -178,7 +178,8 @@ gpa_export_server_operation_get_destination (GpaExportOperation *operation,
 		    (gpa_options_get_instance ())))
     {
       gpg_error_t err;
-      *armor = TRUE;
+      /* The keys are armored one by one for the keyserver helpers.  */
+      *armor = is_gpg_version_at_least ("2.1.0");
       err = gpgme_data_new (dest);
       if (err)
 	{
@@ -210,7 +211,7 @@ send_keys (GpaExportServerOperation *op, GList *keylist)
 
   keyarray = g_malloc0_n (g_list_length (keylist)+1, sizeof *keyarray);
   i = 0;
-  for (item = keylist; item; i++, item = g_list_next (item))
+  for (item = keylist; item; item = g_list_next (item))
     {
       key = (gpgme_key_t) item->data;
       if (!key || key->protocol != GPGME_PROTOCOL_OpenPGP)
@@ -239,34 +240,76 @@ send_keys (GpaExportServerOperation *op, GList *keylist)
 }
 
 
+/* Tell the user about the outcome of sending NKEYS keys of which the
+   keys with the IDs in FAILED were rejected by the server.  */
+static void
+report_sent_keys (GpaExportServerOperation *op, guint nkeys, GList *failed)
+{
+  GString *str;
+  GList *item;
+  guint nfailed = g_list_length (failed);
+
+  if (!nfailed)
+    {
+      gchar *msg = g_strdup_printf (ngettext ("The key has been sent to "
+                                              "the server.",
+                                              "%u keys have been sent to "
+                                              "the server.", nkeys), nkeys);
+      gpa_window_message (msg, GPA_OPERATION (op)->window);
+      g_free (msg);
+      return;
+    }
+
+  str = g_string_new (NULL);
+  g_string_append_printf (str, _("%u of %u keys have been sent to the server."
+                                 "  The server did not accept these keys:"),
+                          nkeys - nfailed, nkeys);
+  for (item = failed; item; item = g_list_next (item))
+    g_string_append_printf (str, "\n%s", (const gchar *) item->data);
+  gpa_window_error (str->str, GPA_OPERATION (op)->window);
+  g_string_free (str, TRUE);
+}
+
+
+/* Called when the keyserver helper has sent the keys.  */
+static void
+send_done_cb (gboolean success, guint nkeys, GList *failed, gpointer opaque)
+{
+  GpaExportServerOperation *op = opaque;
+
+  if (success)
+    report_sent_keys (op, nkeys, failed);
+  g_list_foreach (failed, (GFunc) g_free, NULL);
+  g_list_free (failed);
+  g_object_unref (op);
+}
+
 
 static void
 gpa_export_server_operation_complete_export (GpaExportOperation *operation)
 {
   GpaExportServerOperation *op = GPA_EXPORT_SERVER_OPERATION (operation);
-  int okay = 0;
 
   if (is_gpg_version_at_least ("2.1.0"))
     {
       /* GnuPG 2.1.0 does not anymore use the keyserver helpers and
          thus we need to use the real API for sending keys.  */
       if (send_keys (op, operation->keys))
-        okay = 1;
+        report_sent_keys (op, g_list_length (operation->keys), NULL);
     }
   else
     {
-      gpgme_key_t key = (gpgme_key_t) operation->keys->data;
-
+      /* All keys have been exported at once; the helper is also
+         invoked only once and reports the result for each key.  The
+         helper runs in the background, so keep the operation alive
+         until it has finished.  */
       op->server = g_strdup (gpa_options_get_default_keyserver
                              (gpa_options_get_instance ()));
-      if (server_send_keys (op->server, key->subkeys->keyid, operation->dest,
-                             GPA_OPERATION (op)->window))
-        okay = 1;
+      g_object_ref (op);
+      server_send_key_block_start (op->server, operation->dest,
+                                   GPA_OPERATION (op)->window,
+                                   send_done_cb, op);
     }
-
-  if (okay)
-    gpa_window_message (_("The keys have been sent to the server."),
-                        GPA_OPERATION (op)->window);
 }
 
 /* API */
@@ -36,6 +36,7 @@
 #include "gtktools.h"
 #include "gpgmetools.h"
 #include "filetype.h"
+#include "tarstream.h"
 #include "gpafiledecryptop.h"
 #include "verifydlg.h"
 
@@ -103,6 +104,7 @@ gpa_file_decrypt_operation_finalize (GObject *object)
 
   if (op->dialog)
     gtk_widget_destroy (op->dialog);
+  gpa_untar_abort (op->untar);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -115,6 +117,7 @@ gpa_file_decrypt_operation_init (GpaFileDecryptOperation *op)
   op->plain_fd = -1;
   op->cipher = NULL;
   op->plain = NULL;
+  op->untar = NULL;
 }
 
 
@@ -278,7 +281,9 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 				  gpa_file_item_t file_item)
 {
   gpg_error_t err;
+  guint64 *counter;
 
+  counter = gpa_file_operation_begin_item (GPA_FILE_OPERATION (op));
   if (file_item->direct_in)
     {
       /* No copy is made.  */
@@ -311,8 +316,9 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 
       file_item->filename_out = destination_filename (cipher_filename);
       /* Open the files */
-      op->cipher_fd = gpa_open_input (cipher_filename, &op->cipher,
-				  GPA_OPERATION (op)->window);
+      op->cipher_fd = gpa_open_input_counted (cipher_filename, &op->cipher,
+					      GPA_OPERATION (op)->window,
+					      counter);
       if (op->cipher_fd == -1)
 	/* FIXME: Error value.  */
 	return gpg_error (GPG_ERR_GENERAL);
@@ -332,6 +338,26 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
       xfree (file_item->filename_out);
       file_item->filename_out = filename_used;
 
+      /* A folder archive created by GPA is extracted while gpgme
+	 writes it.  The archive file is written anyway, so that it
+	 is kept if the archive can't be extracted or the folder
+	 already exists.  */
+      if (g_str_has_suffix (file_item->filename_out, ".tar"))
+	{
+	  gchar *dirname = g_strndup (file_item->filename_out,
+				      strlen (file_item->filename_out) - 4);
+	  gpgme_data_t data;
+
+	  if (!g_file_test (dirname, G_FILE_TEST_EXISTS)
+	      && !gpa_untar_data_new (&data, &op->untar, dirname,
+				      op->plain_fd))
+	    {
+	      gpgme_data_release (op->plain);
+	      op->plain = data;
+	    }
+	  g_free (dirname);
+	}
+
       gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
                           is_cms_file (cipher_filename) ?
                           GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
@@ -346,6 +372,8 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
 
       gpgme_data_release (op->plain);
       op->plain = NULL;
+      gpa_untar_abort (op->untar);
+      op->untar = NULL;
       close (op->plain_fd);
       op->plain_fd = -1;
       gpgme_data_release (op->cipher);
@@ -356,6 +384,8 @@ gpa_file_decrypt_operation_start (GpaFileDecryptOperation *op,
       return err;
     }
 
+  gpa_file_operation_item_started (GPA_FILE_OPERATION (op));
+
   /* Show and update the progress dialog.  */
   gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
   gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG
@@ -388,6 +418,7 @@ gpa_file_decrypt_operation_next (GpaFileDecryptOperation *op)
     (op, GPA_FILE_OPERATION (op)->current->data);
   if (err)
     {
+      gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
       if (op->verify && op->signed_files)
 	{
 	  /* All files have been verified: show the results dialog */
@@ -440,7 +471,26 @@ gpa_file_decrypt_operation_done_cb (GpaContext *context,
   op->cipher = NULL;
   close (op->cipher_fd);
   op->cipher_fd = -1;
+  gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+  if (op->untar)
+    {
+      gchar *dirname = NULL;
+
+      if (err)
+	gpa_untar_abort (op->untar);
+      else
+	dirname = gpa_untar_finish (op->untar);
+      op->untar = NULL;
+      if (dirname)
+	{
+	  /* The folder has been extracted; the archive is not needed
+	     anymore.  */
+	  g_unlink (file_item->filename_out);
+	  g_free (file_item->filename_out);
+	  file_item->filename_out = dirname;
+	}
+    }
   if (err)
     {
       if (! file_item->direct_in)
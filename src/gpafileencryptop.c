@@ -39,6 +39,8 @@
 #include "gpafileencryptop.h"
 #include "encryptdlg.h"
 #include "gpawidgets.h"
+#include "filetype.h"
+#include "tarstream.h"
 
 /* Internal functions */
 static void gpa_file_encrypt_operation_done_error_cb (GpaContext *context,
@@ -50,6 +52,7 @@ static void gpa_file_encrypt_operation_done_cb (GpaContext *context,
 static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 						    gint response,
 						    gpointer user_data);
+static void release_skipped (GpaFileEncryptOperation *op);
 
 /* GObject */
 
@@ -108,6 +111,7 @@ gpa_file_encrypt_operation_finalize (GObject *object)
      object.  I doubt that the keys are at all released. */
   g_free (op->rset);
   op->rset = NULL;
+  release_skipped (op);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -121,6 +125,7 @@ gpa_file_encrypt_operation_init (GpaFileEncryptOperation *op)
   op->plain_fd = -1;
   op->cipher = NULL;
   op->plain = NULL;
+  op->skipped = NULL;
   op->encrypt_dialog = NULL;
   op->force_armor = FALSE;
 }
@@ -261,6 +266,55 @@ gpa_file_encrypt_operation_new_for_server (GList *files, void *server_ctx)
 
 /* Internal */
 
+static void
+release_skipped (GpaFileEncryptOperation *op)
+{
+  guint i;
+
+  if (!op->skipped)
+    return;
+  for (i = 0; i < op->skipped->len; i++)
+    g_free (g_ptr_array_index (op->skipped, i));
+  g_ptr_array_free (op->skipped, TRUE);
+  op->skipped = NULL;
+}
+
+
+/* Tell the user which members of the folder FILE_ITEM have not been
+   encrypted.  */
+static void
+report_skipped (GpaFileEncryptOperation *op, gpa_file_item_t file_item)
+{
+  GString *names;
+  guint i;
+
+  if (!op->skipped || !op->skipped->len)
+    {
+      release_skipped (op);
+      return;
+    }
+
+  names = g_string_new (NULL);
+  for (i = 0; i < op->skipped->len && i < 10; i++)
+    {
+      g_string_append_c (names, '\n');
+      g_string_append (names, g_ptr_array_index (op->skipped, i));
+    }
+  if (i < op->skipped->len)
+    g_string_append (names, "\n...");
+  gpa_show_warning (GPA_OPERATION (op)->window,
+                    ngettext ("The folder \"%s\" contains %u symbolic link"
+                              " or special file which has not been"
+                              " encrypted:%s",
+                              "The folder \"%s\" contains %u symbolic links"
+                              " or special files which have not been"
+                              " encrypted:%s", op->skipped->len),
+                    file_item->filename_in, op->skipped->len, names->str);
+  g_string_free (names, TRUE);
+  release_skipped (op);
+}
+
+
 static gchar*
 destination_filename (const gchar *filename, gboolean armor)
 {
@@ -286,7 +340,10 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
 				  gpa_file_item_t file_item)
 {
   gpg_error_t err;
+  gpgme_encrypt_flags_t flags;
+  guint64 *counter;
 
+  counter = gpa_file_operation_begin_item (GPA_FILE_OPERATION (op));
   if (file_item->direct_in)
     {
       /* No copy is made.  */
@@ -312,14 +369,40 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       gchar *plain_filename = file_item->filename_in;
       char *filename_used;
 
-      file_item->filename_out = destination_filename
-	(plain_filename, gpgme_get_armor (GPA_OPERATION (op)->context->ctx));
-      /* Open the files */
-      op->plain_fd = gpa_open_input (plain_filename, &op->plain,
-				     GPA_OPERATION (op)->window);
-      if (op->plain_fd == -1)
-	/* FIXME: Error value.  */
-	return gpg_error (GPG_ERR_GENERAL);
+      if (g_file_test (plain_filename, G_FILE_TEST_IS_DIR))
+	{
+	  /* Encrypt a directory as one tar archive which is created
+	     while gpgme reads it.  */
+	  gchar *tar_filename = g_strconcat (plain_filename, ".tar", NULL);
+
+	  file_item->filename_out = destination_filename
+	    (tar_filename,
+	     gpgme_get_armor (GPA_OPERATION (op)->context->ctx));
+	  g_free (tar_filename);
+	  release_skipped (op);
+	  op->skipped = g_ptr_array_new ();
+	  err = gpa_tar_data_new (&op->plain, plain_filename, counter,
+				  op->skipped);
+	  if (err)
+	    {
+	      gpa_gpgme_warning (err);
+	      return err;
+	    }
+	  op->plain_fd = -1;
+	}
+      else
+	{
+	  file_item->filename_out = destination_filename
+	    (plain_filename,
+	     gpgme_get_armor (GPA_OPERATION (op)->context->ctx));
+	  /* Open the files */
+	  op->plain_fd = gpa_open_input_counted (plain_filename, &op->plain,
+						 GPA_OPERATION (op)->window,
+						 counter);
+	  if (op->plain_fd == -1)
+	    /* FIXME: Error value.  */
+	    return gpg_error (GPG_ERR_GENERAL);
+	}
 
       op->cipher_fd = gpa_open_output (file_item->filename_out, &op->cipher,
 				       GPA_OPERATION (op)->window,
@@ -327,7 +410,9 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       if (op->cipher_fd == -1)
 	{
 	  gpgme_data_release (op->plain);
-	  close (op->plain_fd);
+	  op->plain = NULL;
+	  if (op->plain_fd != -1)
+	    close (op->plain_fd);
 	  op->plain_fd = -1;
           xfree (filename_used);
 	  /* FIXME: Error value.  */
@@ -338,17 +423,34 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       file_item->filename_out = filename_used;
     }
 
-  /* Start the operation.  */
   /* Always trust keys, because any untrusted keys were already
      confirmed by the user.  */
+  flags = GPGME_ENCRYPT_ALWAYS_TRUST;
+  switch (gpa_file_encrypt_dialog_get_compress
+          (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog)))
+    {
+    case GPA_COMPRESS_AUTO:
+      /* Compressing images, archives and the like only costs time.  */
+      if (!file_item->direct_in
+          && is_incompressible_file (file_item->filename_in))
+        flags |= GPGME_ENCRYPT_NO_COMPRESS;
+      break;
+    case GPA_COMPRESS_ALWAYS:
+      break;
+    case GPA_COMPRESS_NEVER:
+      flags |= GPGME_ENCRYPT_NO_COMPRESS;
+      break;
+    }
+
+  /* Start the operation.  */
   if (gpa_file_encrypt_dialog_get_sign
       (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog)))
     err = gpgme_op_encrypt_sign_start (GPA_OPERATION (op)->context->ctx,
-				       op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
+				       op->rset, flags,
 				       op->plain, op->cipher);
   else
     err = gpgme_op_encrypt_start (GPA_OPERATION (op)->context->ctx,
-				  op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
+				  op->rset, flags,
 				  op->plain, op->cipher);
 
   if (err)
@@ -367,6 +469,8 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       return err;
     }
 
+  gpa_file_operation_item_started (GPA_FILE_OPERATION (op));
+
   /* Show and update the progress dialog.  */
   gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
   gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG
@@ -391,7 +495,10 @@ gpa_file_encrypt_operation_next (GpaFileEncryptOperation *op)
   err = gpa_file_encrypt_operation_start
     (op, GPA_FILE_OPERATION (op)->current->data);
   if (err)
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    {
+      gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    }
 }
 
 
@@ -436,10 +543,12 @@ gpa_file_encrypt_operation_done_cb (GpaContext *context,
   op->cipher = NULL;
   close (op->cipher_fd);
   op->cipher_fd = -1;
+  gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
 
   if (err)
     {
+      release_skipped (op);
       if (! file_item->direct_in)
 	{
 	  /* If an error happened, (or the user canceled) delete the
@@ -452,6 +561,8 @@ gpa_file_encrypt_operation_done_cb (GpaContext *context,
     }
   else
     {
+      report_skipped (op, file_item);
+
       /* We've just created a file */
       g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
 
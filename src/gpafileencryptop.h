@@ -60,6 +60,9 @@ struct _GpaFileEncryptOperation
   int cipher_fd, plain_fd;
   gpgme_data_t cipher, plain;
 
+  /* The members of a folder which were not archived.  */
+  GPtrArray *skipped;
+
   gboolean force_armor;
 };
 
@@ -21,6 +21,10 @@
 
 #include <config.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
 #include "i18n.h"
 #include "gtktools.h"
 #include "gpafileop.h"
@@ -105,6 +109,10 @@ gpa_file_operation_finalize (GObject *object)
 
   g_list_foreach (op->input_files, (GFunc) free_file_item, NULL);
   g_list_free (op->input_files);
+  if (op->progress_timeout)
+    g_source_remove (op->progress_timeout);
+  if (op->timer)
+    g_timer_destroy (op->timer);
   gtk_widget_destroy (op->progress_dialog);
   
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -116,6 +124,28 @@ gpa_file_operation_init (GpaFileOperation *op)
   op->input_files = NULL;
   op->current = NULL;
   op->progress_dialog = NULL;
+  op->total_bytes = 0;
+  op->done_bytes = 0;
+  op->file_bytes = 0;
+  op->file_size = 0;
+  op->timer = NULL;
+  op->timer_running = FALSE;
+  op->progress_timeout = 0;
+}
+
+
+/* Return the number of input bytes of ITEM.  */
+static guint64
+file_item_size (gpa_file_item_t item)
+{
+  struct stat st;
+
+  if (item->direct_in)
+    return item->direct_in_len;
+  if (item->filename_in && !g_stat (item->filename_in, &st)
+      && S_ISREG (st.st_mode))
+    return st.st_size;
+  return 0;
 }
 
 static GObject*
@@ -125,6 +155,7 @@ gpa_file_operation_constructor (GType type,
 {
   GObject *object;
   GpaFileOperation *op;
+  GList *item;
 
   /* Invoke parent's constructor */
   object = parent_class->constructor (type,
@@ -132,6 +163,8 @@ gpa_file_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_FILE_OPERATION (object);
   /* Initialize */
+  for (item = op->input_files; item; item = g_list_next (item))
+    op->total_bytes += file_item_size (item->data);
   op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION(op)->window,
 						 GPA_OPERATION(op)->context);
 
@@ -230,3 +263,85 @@ gpa_file_operation_current_file (GpaFileOperation *op)
   else
     return NULL;
 }
+
+
+/* Update the statistics in the progress dialog.  */
+static gboolean
+progress_timeout_cb (gpointer data)
+{
+  GpaFileOperation *op = data;
+  guint64 file_done = MIN (op->file_bytes, op->file_size);
+
+  gpa_progress_dialog_set_bytes (GPA_PROGRESS_DIALOG (op->progress_dialog),
+				 file_done, op->file_size,
+				 op->done_bytes + file_done, op->total_bytes,
+				 g_timer_elapsed (op->timer, NULL));
+  return TRUE;
+}
+
+
+/* Start the byte accounting for the current file.  Returns the
+   counter to be passed to gpa_open_input_counted.  */
+guint64 *
+gpa_file_operation_begin_item (GpaFileOperation *op)
+{
+  g_return_val_if_fail (GPA_IS_FILE_OPERATION (op), NULL);
+
+  op->file_bytes = 0;
+  op->file_size = op->current ? file_item_size (op->current->data) : 0;
+  if (!op->timer)
+    {
+      op->timer = g_timer_new ();
+      g_timer_stop (op->timer);
+    }
+  if (!op->progress_timeout && op->total_bytes)
+    op->progress_timeout = g_timeout_add (250, progress_timeout_cb, op);
+
+  return &op->file_bytes;
+}
+
+
+/* Gpgme has started working on the current file.  The timer only
+   runs while gpgme works so that the time spent in dialogs, for
+   example to confirm overwriting a file, does not lower the
+   throughput.  */
+void
+gpa_file_operation_item_started (GpaFileOperation *op)
+{
+  g_return_if_fail (GPA_IS_FILE_OPERATION (op));
+
+  if (op->timer && !op->timer_running)
+    {
+      g_timer_continue (op->timer);
+      op->timer_running = TRUE;
+    }
+}
+
+
+/* Finish the byte accounting for the current file.  */
+void
+gpa_file_operation_end_item (GpaFileOperation *op)
+{
+  g_return_if_fail (GPA_IS_FILE_OPERATION (op));
+
+  if (op->timer_running)
+    {
+      g_timer_stop (op->timer);
+      op->timer_running = FALSE;
+    }
+
+  /* Gpgme may read more than the size of the file, for example the
+     signed data of a detached signature.  Keep the totals consistent
+     with what has actually been read.  */
+  if (op->file_bytes > op->file_size)
+    op->total_bytes += op->file_bytes - op->file_size;
+  op->done_bytes += MAX (op->file_bytes, op->file_size);
+  op->file_bytes = 0;
+  op->file_size = 0;
+
+  if (op->progress_timeout)
+    {
+      g_source_remove (op->progress_timeout);
+      op->progress_timeout = 0;
+    }
+}
@@ -63,6 +63,18 @@ struct _GpaFileOperation {
   GList *input_files;
   GList *current;
   GtkWidget *progress_dialog;
+
+  /* Byte accounting for the progress dialog.  TOTAL_BYTES is the
+     size of all input files, DONE_BYTES the size of the files already
+     processed and FILE_BYTES the number of bytes gpgme has read from
+     the current file of size FILE_SIZE.  */
+  guint64 total_bytes;
+  guint64 done_bytes;
+  guint64 file_bytes;
+  guint64 file_size;
+  GTimer *timer;
+  gboolean timer_running;
+  guint progress_timeout;
 };
 
 struct _GpaFileOperationClass {
@@ -88,4 +100,19 @@ gpa_file_operation_input_files (GpaFileOperation *op);
 const gchar *
 gpa_file_operation_current_file (GpaFileOperation *op);
 
+/* Start the byte accounting for the current file.  Returns the
+   counter to be passed to gpa_open_input_counted.  */
+guint64 *
+gpa_file_operation_begin_item (GpaFileOperation *op);
+
+/* Gpgme has started working on the current file.  Only this time
+   counts for the throughput; dialogs shown before do not.  */
+void
+gpa_file_operation_item_started (GpaFileOperation *op);
+
+/* Finish the byte accounting for the current file.  This must also
+   be called if the operation on the file could not be started.  */
+void
+gpa_file_operation_end_item (GpaFileOperation *op);
+
 #endif
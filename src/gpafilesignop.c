@@ -261,7 +261,9 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
 			       gpa_file_item_t file_item)
 {
   gpg_error_t err;
+  guint64 *counter;
 
+  counter = gpa_file_operation_begin_item (GPA_FILE_OPERATION (op));
   if (file_item->direct_in)
     {
       /* No copy is made.  */
@@ -292,8 +294,8 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
 	 gpgme_get_protocol (GPA_OPERATION (op)->context->ctx), op->sign_type);
 
       /* Open the files */
-      op->plain_fd = gpa_open_input (plain_filename, &op->plain,
-				     GPA_OPERATION (op)->window);
+      op->plain_fd = gpa_open_input_counted (plain_filename, &op->plain,
+					     GPA_OPERATION (op)->window, counter);
       if (op->plain_fd == -1)
 	/* FIXME: Error value.  */
 	return gpg_error (GPG_ERR_GENERAL);
@@ -322,6 +324,8 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
       gpa_gpgme_warning (err);
       return err;
     }
+  gpa_file_operation_item_started (GPA_FILE_OPERATION (op));
+
   /* Show and update the progress dialog */
   gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
   gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG
@@ -348,7 +352,10 @@ gpa_file_sign_operation_next (GpaFileSignOperation *op)
   err = gpa_file_sign_operation_start (op,
 				       GPA_FILE_OPERATION (op)->current->data);
   if (err)
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    {
+      gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    }
 }
 
 
@@ -392,6 +399,7 @@ gpa_file_sign_operation_done_cb (GpaContext *context,
   op->sig = NULL;
   close (op->sig_fd);
   op->sig_fd = -1;
+  gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
 
   if (err)
@@ -21,7 +21,9 @@
 # include <config.h>
 #endif
 
+#include <fcntl.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #ifdef G_OS_UNIX
 #include <unistd.h>
@@ -38,6 +40,20 @@
 #include "gpafileverifyop.h"
 #include "verifydlg.h"
 
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY	_O_BINARY
+#else
+#define O_BINARY	0
+#endif
+#endif
+
+/* The number of verifications run concurrently in batch mode.  */
+#define BATCH_WORKERS 4
+
+/* The extensions used for detached signatures.  */
+static const gchar *sig_extension[] = {".sig", ".asc", ".sign"};
+
 
 /* Internal functions */
 static gboolean gpa_file_verify_operation_idle_cb (gpointer data);
@@ -50,6 +66,8 @@ static void gpa_file_verify_operation_done_cb (GpaContext *context,
 static void gpa_file_verify_operation_response_cb (GtkDialog *dialog,
 						   gint response,
 						   gpointer user_data);
+static gboolean batch_start (GpaFileVerifyOperation *op);
+static void batch_release (GpaFileVerifyOperation *op);
 
 /* GObject */
 
@@ -60,6 +78,7 @@ gpa_file_verify_operation_finalize (GObject *object)
 {
   GpaFileVerifyOperation *op = GPA_FILE_VERIFY_OPERATION (object);
 
+  batch_release (op);
   gtk_widget_destroy (op->dialog);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -75,6 +94,7 @@ gpa_file_verify_operation_init (GpaFileVerifyOperation *op)
   op->signed_text = NULL;
   op->signed_file = NULL;
   op->signature_file = NULL;
+  op->batch = NULL;
 }
 
 static GObject*
@@ -196,7 +216,6 @@ static gboolean
 is_detached_sig (const gchar *filename, gchar **signature_file,
 		 gchar **signed_file, GtkWidget *window)
 {
-  const gchar *sig_extension[] = {".sig", ".asc", ".sign"};
   int i;
   gchar *extension;
 
@@ -245,7 +264,9 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
 				 gpa_file_item_t file_item)
 {
   gpgme_error_t err;
+  guint64 *counter;
 
+  counter = gpa_file_operation_begin_item (GPA_FILE_OPERATION (op));
   if (file_item->direct_in)
     {
       /* Direct input is always an inline signature.  */
@@ -281,14 +302,16 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
 			   GPA_OPERATION (op)->window))
 	{
 	  /* Allocate data objects for a detached signature */
-	  op->sig_fd = gpa_open_input (op->signature_file, &op->sig,
-				       GPA_OPERATION (op)->window);
+	  op->sig_fd = gpa_open_input_counted (op->signature_file, &op->sig,
+					       GPA_OPERATION (op)->window,
+					       counter);
 	  if (op->sig_fd == -1)
 	    {
 	      return FALSE;
 	    }
-	  op->signed_text_fd = gpa_open_input (op->signed_file, &op->signed_text,
-					       GPA_OPERATION (op)->window);
+	  op->signed_text_fd = gpa_open_input_counted
+	    (op->signed_file, &op->signed_text,
+	     GPA_OPERATION (op)->window, counter);
 	  if (op->signed_text_fd == -1)
 	    {
 	      gpgme_data_release (op->sig);
@@ -300,8 +323,9 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
       else
 	{
 	  /* Allocate data object for non-detached signatures */
-	  op->sig_fd = gpa_open_input (sig_filename, &op->sig,
-				       GPA_OPERATION (op)->window);
+	  op->sig_fd = gpa_open_input_counted (sig_filename, &op->sig,
+					       GPA_OPERATION (op)->window,
+					       counter);
 	  if (op->sig_fd == -1)
 	    {
 	      return FALSE;
@@ -331,6 +355,8 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
       gpa_gpgme_warning (err);
       return FALSE;
     }
+  gpa_file_operation_item_started (GPA_FILE_OPERATION (op));
+
   /* Show and update the progress dialog */
   gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
   gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG
@@ -346,13 +372,16 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
 static void
 gpa_file_verify_operation_next (GpaFileVerifyOperation *op)
 {
-  if (! GPA_FILE_OPERATION (op)->current ||
-      ! gpa_file_verify_operation_start (op, GPA_FILE_OPERATION (op)
-					 ->current->data))
+  if (GPA_FILE_OPERATION (op)->current)
     {
-      /* All files have been verified: show the results dialog */
-      gtk_widget_show_all (op->dialog);
+      if (gpa_file_verify_operation_start (op, GPA_FILE_OPERATION (op)
+					   ->current->data))
+	return;
+      gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
     }
+
+  /* All files have been verified: show the results dialog */
+  gtk_widget_show_all (op->dialog);
 }
 
 
@@ -400,6 +429,7 @@ gpa_file_verify_operation_done_cb (GpaContext *context,
   close (op->sig_fd);
   op->sig_fd = -1;
 
+  gpa_file_operation_end_item (GPA_FILE_OPERATION (op));
   gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
   /* Check for error */
   if (err)
@@ -447,7 +477,8 @@ gpa_file_verify_operation_idle_cb (gpointer data)
 {
   GpaFileVerifyOperation *op = data;
 
-  gpa_file_verify_operation_next (op);
+  if (! batch_start (op))
+    gpa_file_verify_operation_next (op);
 
   return FALSE;
 }
@@ -497,3 +528,449 @@ gpa_file_verify_operation_done_error_cb (GpaContext *context, gpg_error_t err,
       break;
     }
 }
+
+
+
+/* Batch mode.  If several files are to be verified, data and
+   signature files are paired up front and the user is asked at most
+   once about detached signatures.  Up to BATCH_WORKERS verifications
+   run concurrently, each in its own context, and the results are
+   collected in the summary table of the verify dialog.  */
+
+struct batch_job_s
+{
+  /* The signed data or NULL for a signed message.  */
+  gchar *signed_file;
+  /* The detached signature or the signed message.  */
+  gchar *signature_file;
+};
+
+
+struct batch_worker_s
+{
+  GpaFileVerifyOperation *op;
+  GpaContext *ctx;
+  struct batch_job_s *job;
+  int sig_fd;
+  int signed_fd;
+  gpgme_data_t sig;
+  gpgme_data_t signed_text;
+  gpgme_data_t plain;
+};
+
+
+struct verify_batch_s
+{
+  GList *jobs;
+  GList *next;
+  guint total;
+  guint done;
+  guint idle_id;
+  struct batch_worker_s workers[BATCH_WORKERS];
+};
+
+
+static void batch_schedule (GpaFileVerifyOperation *op);
+
+
+static void
+free_batch_job (struct batch_job_s *job)
+{
+  g_free (job->signed_file);
+  g_free (job->signature_file);
+  g_free (job);
+}
+
+
+/* Append a job to BATCH.  Takes ownership of the strings.  */
+static void
+add_batch_job (struct verify_batch_s *batch, gchar *signed_file,
+	       gchar *signature_file)
+{
+  struct batch_job_s *job;
+
+  job = g_malloc (sizeof *job);
+  job->signed_file = signed_file;
+  job->signature_file = signature_file;
+  batch->jobs = g_list_prepend (batch->jobs, job);
+  batch->total++;
+}
+
+
+/* If FILENAME is a detached signature and the signed file exists,
+   return the name of the signed file.  */
+static gchar *
+detached_signed_file (const gchar *filename)
+{
+  const gchar *extension;
+  gchar *signed_file;
+  int i;
+
+  extension = strrchr (filename, '.');
+  if (!extension)
+    return NULL;
+  for (i = 0; i < DIM (sig_extension); i++)
+    if (g_str_equal (extension, sig_extension[i]))
+      {
+	signed_file = g_strndup (filename, extension - filename);
+	if (g_file_test (signed_file, G_FILE_TEST_EXISTS))
+	  return signed_file;
+	g_free (signed_file);
+	return NULL;
+      }
+  return NULL;
+}
+
+
+/* Pair the input files of OP with their signatures.  */
+static void
+batch_pair_files (GpaFileVerifyOperation *op)
+{
+  struct verify_batch_s *batch = op->batch;
+  GHashTable *covered;
+  GList *rest = NULL;
+  GList *found = NULL;
+  GList *item;
+  guint nfound = 0;
+  gboolean use_found = FALSE;
+
+  /* Detached signatures given explicitly.  Their signed files need
+     not be verified on their own.  */
+  covered = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (item = gpa_file_operation_input_files (GPA_FILE_OPERATION (op));
+       item; item = g_list_next (item))
+    {
+      gpa_file_item_t file_item = item->data;
+      gchar *signed_file = detached_signed_file (file_item->filename_in);
+
+      if (signed_file)
+	{
+	  g_hash_table_insert (covered, g_strdup (signed_file), NULL);
+	  add_batch_job (batch, signed_file,
+			 g_strdup (file_item->filename_in));
+	}
+      else
+	rest = g_list_prepend (rest, file_item->filename_in);
+    }
+  rest = g_list_reverse (rest);
+
+  /* The remaining files are signed messages or have a detached
+     signature next to them.  */
+  for (item = rest; item; item = g_list_next (item))
+    {
+      const gchar *filename = item->data;
+      int i;
+
+      if (g_hash_table_lookup_extended (covered, filename, NULL, NULL))
+	{
+	  item->data = NULL;
+	  found = g_list_prepend (found, NULL);
+	  continue;
+	}
+      for (i = 0; i < DIM (sig_extension); i++)
+	{
+	  gchar *sig = g_strconcat (filename, sig_extension[i], NULL);
+
+	  if (g_file_test (sig, G_FILE_TEST_EXISTS))
+	    {
+	      found = g_list_prepend (found, sig);
+	      nfound++;
+	      break;
+	    }
+	  g_free (sig);
+	}
+      if (i == DIM (sig_extension))
+	found = g_list_prepend (found, NULL);
+    }
+  found = g_list_reverse (found);
+  g_hash_table_destroy (covered);
+
+  if (nfound)
+    {
+      GtkWidget *dialog;
+
+      dialog = gtk_message_dialog_new
+	(GTK_WINDOW (GPA_OPERATION (op)->window), GTK_DIALOG_MODAL,
+	 GTK_MESSAGE_QUESTION, GTK_BUTTONS_NONE,
+	 ngettext ("GPA found a file that could be a signature of one of "
+		   "the selected files.  Would you like to verify it "
+		   "instead?",
+		   "GPA found files that could be signatures of %u of the "
+		   "selected files.  Would you like to verify them "
+		   "instead?", nfound), nfound);
+      gtk_dialog_add_buttons (GTK_DIALOG (dialog),
+			      _("_Yes"), GTK_RESPONSE_YES,
+			      _("_No"), GTK_RESPONSE_NO, NULL);
+      use_found = (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_YES);
+      gtk_widget_destroy (dialog);
+    }
+
+  for (item = rest; item; item = g_list_next (item))
+    {
+      gchar *sig = found->data;
+
+      found = g_list_delete_link (found, found);
+      if (!item->data)
+	{
+	  /* Covered by an explicitly given signature.  */
+	  g_free (sig);
+	  continue;
+	}
+      if (sig && use_found)
+	add_batch_job (batch, g_strdup (item->data), sig);
+      else
+	{
+	  g_free (sig);
+	  add_batch_job (batch, NULL, g_strdup (item->data));
+	}
+    }
+  g_list_free (rest);
+
+  batch->jobs = g_list_reverse (batch->jobs);
+  batch->next = batch->jobs;
+}
+
+
+/* Open FILENAME for reading into R_DATA.  */
+static gpg_error_t
+batch_open (const gchar *filename, gpgme_data_t *r_data, int *r_fd)
+{
+  gpg_error_t err;
+
+  *r_fd = g_open (filename, O_RDONLY | O_BINARY, 0);
+  if (*r_fd == -1)
+    return gpg_error_from_syserror ();
+  err = gpgme_data_new_from_fd (r_data, *r_fd);
+  if (err)
+    {
+      close (*r_fd);
+      *r_fd = -1;
+    }
+  return err;
+}
+
+
+/* The content of signed messages is not needed.  */
+static ssize_t
+discard_write (void *opaque, const void *buffer, size_t size)
+{
+  return size;
+}
+
+static struct gpgme_data_cbs discard_cbs =
+  {
+    NULL,
+    discard_write,
+    NULL,
+    NULL
+  };
+
+
+static void
+batch_worker_release (struct batch_worker_s *w)
+{
+  gpgme_data_release (w->sig);
+  w->sig = NULL;
+  gpgme_data_release (w->signed_text);
+  w->signed_text = NULL;
+  gpgme_data_release (w->plain);
+  w->plain = NULL;
+  if (w->sig_fd != -1)
+    close (w->sig_fd);
+  w->sig_fd = -1;
+  if (w->signed_fd != -1)
+    close (w->signed_fd);
+  w->signed_fd = -1;
+}
+
+
+static gpg_error_t
+batch_worker_start (struct batch_worker_s *w)
+{
+  struct batch_job_s *job = w->job;
+  gpg_error_t err;
+
+  err = batch_open (job->signature_file, &w->sig, &w->sig_fd);
+  if (!err && job->signed_file)
+    err = batch_open (job->signed_file, &w->signed_text, &w->signed_fd);
+  else if (!err)
+    err = gpgme_data_new_from_cbs (&w->plain, &discard_cbs, NULL);
+  if (!err)
+    {
+      gpgme_set_protocol (w->ctx->ctx,
+			  is_cms_file (job->signature_file) ?
+			  GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+      err = gpgme_op_verify_start (w->ctx->ctx, w->sig, w->signed_text,
+				   w->plain);
+    }
+  return err;
+}
+
+
+static void
+batch_add_result (GpaFileVerifyOperation *op, struct batch_job_s *job,
+		  gpgme_signature_t sigs, gpg_error_t err)
+{
+  gpa_file_verify_dialog_add_summary
+    (GPA_FILE_VERIFY_DIALOG (op->dialog),
+     job->signed_file ? job->signed_file : job->signature_file,
+     job->signed_file ? job->signature_file : NULL,
+     sigs, err);
+}
+
+
+static void
+batch_worker_done_cb (GpaContext *context, gpg_error_t err,
+		      struct batch_worker_s *w)
+{
+  GpaFileVerifyOperation *op = w->op;
+  gpgme_verify_result_t result = NULL;
+
+  if (!err)
+    result = gpgme_op_verify_result (context->ctx);
+  batch_add_result (op, w->job, result ? result->signatures : NULL, err);
+  batch_worker_release (w);
+  w->job = NULL;
+  op->batch->done++;
+
+  /* Do not start the next verification from within the done
+     handler.  */
+  batch_schedule (op);
+}
+
+
+/* Give each idle worker a new job.  */
+static void
+batch_run (GpaFileVerifyOperation *op)
+{
+  struct verify_batch_s *batch = op->batch;
+  GpaProgressDialog *progress;
+  guint running = 0;
+  gchar *label;
+  int i;
+
+  for (i = 0; i < BATCH_WORKERS; i++)
+    {
+      struct batch_worker_s *w = &batch->workers[i];
+
+      while (!w->job && batch->next)
+	{
+	  gpg_error_t err;
+
+	  w->job = batch->next->data;
+	  batch->next = g_list_next (batch->next);
+	  err = batch_worker_start (w);
+	  if (err)
+	    {
+	      batch_add_result (op, w->job, NULL, err);
+	      batch_worker_release (w);
+	      w->job = NULL;
+	      batch->done++;
+	    }
+	}
+      if (w->job)
+	running++;
+    }
+
+  progress = GPA_PROGRESS_DIALOG (GPA_FILE_OPERATION (op)->progress_dialog);
+  if (running)
+    {
+      label = g_strdup_printf (_("Verified %u of %u files"),
+			       batch->done, batch->total);
+      gpa_progress_dialog_set_label (progress, label);
+      g_free (label);
+      gpa_progress_bar_set_fraction (progress->pbar,
+				     (gdouble) batch->done / batch->total);
+    }
+  else
+    {
+      /* All files have been verified: show the results dialog.  */
+      gtk_widget_hide (GTK_WIDGET (progress));
+      gtk_widget_show_all (op->dialog);
+    }
+}
+
+
+static gboolean
+batch_idle_cb (gpointer data)
+{
+  GpaFileVerifyOperation *op = data;
+
+  op->batch->idle_id = 0;
+  batch_run (op);
+
+  return FALSE;
+}
+
+
+static void
+batch_schedule (GpaFileVerifyOperation *op)
+{
+  if (!op->batch->idle_id)
+    op->batch->idle_id = g_idle_add (batch_idle_cb, op);
+}
+
+
+/* Start the batch mode if it is useful for the files of OP.  Returns
+   FALSE if the files are to be verified one by one.  */
+static gboolean
+batch_start (GpaFileVerifyOperation *op)
+{
+  GList *files = gpa_file_operation_input_files (GPA_FILE_OPERATION (op));
+  GList *item;
+  int i;
+
+  if (!files || !g_list_next (files))
+    return FALSE;
+  for (item = files; item; item = g_list_next (item))
+    if (((gpa_file_item_t) item->data)->direct_in)
+      return FALSE;
+
+  op->batch = g_malloc0 (sizeof *op->batch);
+  for (i = 0; i < BATCH_WORKERS; i++)
+    {
+      struct batch_worker_s *w = &op->batch->workers[i];
+
+      w->op = op;
+      w->sig_fd = -1;
+      w->signed_fd = -1;
+      w->ctx = gpa_context_new ();
+      g_signal_connect (G_OBJECT (w->ctx), "done",
+			G_CALLBACK (batch_worker_done_cb), w);
+    }
+
+  batch_pair_files (op);
+
+  gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
+  batch_run (op);
+
+  return TRUE;
+}
+
+
+static void
+batch_release (GpaFileVerifyOperation *op)
+{
+  struct verify_batch_s *batch = op->batch;
+  int i;
+
+  if (!batch)
+    return;
+
+  if (batch->idle_id)
+    g_source_remove (batch->idle_id);
+  for (i = 0; i < BATCH_WORKERS; i++)
+    {
+      struct batch_worker_s *w = &batch->workers[i];
+
+      if (w->ctx->busy)
+	gpgme_cancel (w->ctx->ctx);
+      g_signal_handlers_disconnect_by_func (w->ctx, batch_worker_done_cb, w);
+      batch_worker_release (w);
+      g_object_unref (w->ctx);
+    }
+  g_list_foreach (batch->jobs, (GFunc) free_batch_job, NULL);
+  g_list_free (batch->jobs);
+  g_free (batch);
+  op->batch = NULL;
+}
@@ -43,6 +43,9 @@ struct _GpaFileVerifyOperation {
   gpgme_data_t sig, signed_text, plain;
   gchar *signed_file, *signature_file;
   GtkWidget *dialog;
+
+  /* State of the batch mode used for several files or NULL.  */
+  struct verify_batch_s *batch;
 };
 
 struct _GpaFileVerifyOperationClass {
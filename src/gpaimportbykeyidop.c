@@ -26,24 +26,84 @@
 #include "gtktools.h"
 #include "gpaimportbykeyidop.h"
 #include "server-access.h"
+#include "gpaprogressdlg.h"
+
+
+/* The number of concurrent keyserver requests.  */
+#define REFRESH_WORKERS 3
+
+/* The number of keys fetched by one request.  */
+#define REFRESH_BATCH_SIZE 32
+
+
+/* One keyserver request.  */
+struct refresh_worker_s
+{
+  GpaImportByKeyidOperation *op;
+  GpaContext *ctx;
+  gpgme_key_t *keys;    /* NULL terminated array of the requested keys.  */
+  guint nkeys;
+  gpgme_data_t source;  /* The fetched keys with GnuPG < 2.1.  */
+};
 
 
 static GObjectClass *parent_class = NULL;
 
 static gboolean
-gpa_import_bykeyid_operation_get_source (GpaImportOperation *operation);
-static void
-gpa_import_bykeyid_operation_complete_import (GpaImportOperation *operation);
+gpa_import_bykeyid_operation_start (GpaImportOperation *operation);
+static void refresh_worker_done_cb (GpaContext *context, gpg_error_t err,
+                                    struct refresh_worker_s *w);
+static gboolean refresh_run (gpointer data);
 
 /* GObject boilerplate */
 
+static void
+refresh_worker_release (struct refresh_worker_s *w)
+{
+  guint i;
+
+  if (w->keys)
+    {
+      for (i = 0; w->keys[i]; i++)
+        gpgme_key_unref (w->keys[i]);
+      g_free (w->keys);
+      w->keys = NULL;
+    }
+  w->nkeys = 0;
+  gpgme_data_release (w->source);
+  w->source = NULL;
+}
+
+
 static void
 gpa_import_bykeyid_operation_finalize (GObject *object)
 {
   GpaImportByKeyidOperation *op = GPA_IMPORT_BYKEYID_OPERATION (object);
+  int i;
 
-  gpgme_key_unref (op->key);
-  op->key = NULL;
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  if (op->workers)
+    {
+      for (i = 0; i < REFRESH_WORKERS; i++)
+        {
+          struct refresh_worker_s *w = &op->workers[i];
+
+          if (w->ctx->busy)
+            gpgme_cancel (w->ctx->ctx);
+          g_signal_handlers_disconnect_by_func (w->ctx,
+                                                refresh_worker_done_cb, w);
+          refresh_worker_release (w);
+          g_object_unref (w->ctx);
+        }
+      g_free (op->workers);
+      op->workers = NULL;
+    }
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
+  g_list_foreach (op->keys, (GFunc) gpgme_key_unref, NULL);
+  g_list_free (op->keys);
+  op->keys = NULL;
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -52,7 +112,16 @@ gpa_import_bykeyid_operation_finalize (GObject *object)
 static void
 gpa_import_bykeyid_operation_init (GpaImportByKeyidOperation *op)
 {
-  op->key = NULL;
+  op->keys = NULL;
+  op->next = NULL;
+  op->total = 0;
+  op->done = 0;
+  op->idle_id = 0;
+  op->progress_dialog = NULL;
+  op->workers = NULL;
+  memset (&op->result, 0, sizeof op->result);
+  op->imported_secret = FALSE;
+  op->err = 0;
 }
 
 
@@ -62,13 +131,30 @@ gpa_import_bykeyid_operation_constructor (GType type,
                                  GObjectConstructParam *construct_properties)
 {
   GObject *object;
-  /* GpaImportByKeyidOperation *op; */
+  GpaImportByKeyidOperation *op;
+  int i;
 
   /* Invoke parent's constructor */
   object = parent_class->constructor (type,
 				      n_construct_properties,
 				      construct_properties);
-  /* op = GPA_IMPORT_BYKEYID_OPERATION (object); */
+  op = GPA_IMPORT_BYKEYID_OPERATION (object);
+
+  op->workers = g_malloc0_n (REFRESH_WORKERS, sizeof *op->workers);
+  for (i = 0; i < REFRESH_WORKERS; i++)
+    {
+      struct refresh_worker_s *w = &op->workers[i];
+
+      w->op = op;
+      w->ctx = gpa_context_new ();
+      g_signal_connect (G_OBJECT (w->ctx), "done",
+                        G_CALLBACK (refresh_worker_done_cb), w);
+    }
+
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 op->workers[0].ctx);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+			_("Refreshing Keys..."));
 
   return object;
 }
@@ -85,8 +171,7 @@ gpa_import_bykeyid_operation_class_init (GpaImportByKeyidOperationClass *klass)
   object_class->constructor = gpa_import_bykeyid_operation_constructor;
   object_class->finalize    = gpa_import_bykeyid_operation_finalize;
 
-  import_class->get_source  = gpa_import_bykeyid_operation_get_source;
-  import_class->complete_import = gpa_import_bykeyid_operation_complete_import;
+  import_class->start = gpa_import_bykeyid_operation_start;
 }
 
 
@@ -119,57 +204,218 @@ gpa_import_bykeyid_operation_get_type (void)
 }
 
 
-/* Virtual methods */
+/* Private functions */
 
+/* Return true if KEY can be looked up on a keyserver.  */
 static gboolean
-gpa_import_bykeyid_operation_get_source (GpaImportOperation *operation)
+key_is_refreshable (gpgme_key_t key)
 {
-  GpaImportByKeyidOperation *op = GPA_IMPORT_BYKEYID_OPERATION (operation);
-  int i;
+  return (key->protocol == GPGME_PROTOCOL_OpenPGP
+          && key->subkeys
+          && key->subkeys->keyid
+          && *key->subkeys->keyid);
+}
+
+
+/* Count the keys of worker W as done after the error ERR.  */
+static void
+refresh_worker_failed (struct refresh_worker_s *w, gpg_error_t err)
+{
+  GpaImportByKeyidOperation *op = w->op;
+
+  if (!op->err)
+    op->err = err;
+  op->done += w->nkeys;
+  refresh_worker_release (w);
+}
+
+
+static void
+refresh_schedule (GpaImportByKeyidOperation *op)
+{
+  if (!op->idle_id)
+    op->idle_id = g_idle_add (refresh_run, op);
+}
+
+
+/* Called when the keyserver helper has fetched the key of worker W
+   for GnuPG versions before 2.1.  */
+static void
+refresh_fetched_cb (gboolean success, gpgme_data_t data, gpointer opaque)
+{
+  struct refresh_worker_s *w = opaque;
+  GpaImportByKeyidOperation *op = w->op;
+  gpg_error_t err;
+
+  w->source = data;
+  if (success)
+    err = gpgme_op_import_start (w->ctx->ctx, w->source);
+  else
+    err = gpg_error (GPG_ERR_NO_DATA);
+  if (err)
+    {
+      refresh_worker_failed (w, err);
+      refresh_schedule (op);
+    }
+  g_object_unref (op);
+}
 
-  /* Better reset the source variables.  */
-  gpgme_data_release (operation->source);
-  operation->source = NULL;
-  if (operation->source2)
+
+/* Take the next batch of keys from the list of OP and start fetching
+   it with worker W.  Returns FALSE if no keys are left.  */
+static gboolean
+refresh_worker_start (struct refresh_worker_s *w)
+{
+  GpaImportByKeyidOperation *op = w->op;
+  gboolean use_import_keys = is_gpg_version_at_least ("2.1.0");
+  guint batch_size = use_import_keys? REFRESH_BATCH_SIZE : 1;
+  gpg_error_t err;
+
+  w->keys = g_malloc0_n (batch_size + 1, sizeof *w->keys);
+  while (op->next && w->nkeys < batch_size)
     {
-      for (i=0; operation->source2[i]; i++)
-        gpgme_key_unref (operation->source2[i]);
-      g_free (operation->source2);
-      operation->source2 = NULL;
+      gpgme_key_t key = op->next->data;
+
+      op->next = g_list_next (op->next);
+      if (key_is_refreshable (key))
+        {
+          gpgme_key_ref (key);
+          w->keys[w->nkeys++] = key;
+        }
+      else
+        op->done++;
+    }
+  if (!w->nkeys)
+    {
+      refresh_worker_release (w);
+      return FALSE;
     }
 
-  if (!op->key
-      || op->key->protocol != GPGME_PROTOCOL_OpenPGP
-      || !op->key->subkeys
-      || !op->key->subkeys->keyid
-      || !*op->key->subkeys->keyid)
-    ;
-  else if (is_gpg_version_at_least ("2.1.0"))
+  /* The only protocol supported by keyservers is OpenPGP.  */
+  gpgme_set_protocol (w->ctx->ctx, GPGME_PROTOCOL_OpenPGP);
+  if (use_import_keys)
     {
-      operation->source2 = g_malloc0_n (1 + 1, sizeof *operation->source2);
-      gpgme_key_ref (op->key);
-      operation->source2[0] = op->key;
-      return TRUE;
+      err = gpgme_op_import_keys_start (w->ctx->ctx, w->keys);
+      if (err)
+        refresh_worker_failed (w, err);
     }
   else
     {
+      /* The helper runs in the background; keep the operation alive
+         until it has finished.  */
+      g_object_ref (op);
+      server_get_key_start (gpa_options_get_default_keyserver
+                            (gpa_options_get_instance ()),
+                            w->keys[0]->subkeys->keyid,
+                            GPA_OPERATION (op)->window,
+                            refresh_fetched_cb, w);
+    }
+  return TRUE;
+}
+
+
+/* All batches have been processed: show the summary.  */
+static void
+refresh_finish (GpaImportByKeyidOperation *op)
+{
+  gtk_widget_hide (op->progress_dialog);
+
+  if (op->imported_secret)
+    g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
+  else if (op->result.imported > 0)
+    g_signal_emit_by_name (GPA_OPERATION (op), "imported_keys");
+
+  if (op->err && gpg_err_code (op->err) != GPG_ERR_NO_DATA)
+    gpa_gpgme_warning (op->err);
+  if (!op->err || op->result.considered)
+    gpa_gpgme_show_import_results (GPA_OPERATION (op)->window, &op->result);
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+}
+
+
+/* Keep every worker busy as long as keys are left.  */
+static gboolean
+refresh_run (gpointer data)
+{
+  GpaImportByKeyidOperation *op = data;
+  guint running = 0;
+  gchar *label;
+  int i;
+
+  op->idle_id = 0;
+  for (i = 0; i < REFRESH_WORKERS; i++)
+    {
+      struct refresh_worker_s *w = &op->workers[i];
+
+      while (!w->nkeys && op->next)
+        if (!refresh_worker_start (w))
+          break;
+      if (w->nkeys)
+        running++;
+    }
 
-      if (server_get_key (gpa_options_get_default_keyserver
-			  (gpa_options_get_instance ()),
-			  op->key->subkeys->keyid,
-                          &operation->source, GPA_OPERATION (op)->window))
-	{
-	  return TRUE;
-	}
+  if (!running)
+    {
+      refresh_finish (op);
+      return FALSE;
     }
+
+  label = g_strdup_printf (_("Refreshed %u of %u keys"),
+                           op->done, op->total);
+  gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG (op->progress_dialog),
+                                 label);
+  g_free (label);
+  gpa_progress_bar_set_fraction
+    (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+     op->total? (gdouble) op->done / op->total : 0.0);
+
   return FALSE;
 }
 
 
 static void
-gpa_import_bykeyid_operation_complete_import (GpaImportOperation *operation)
+refresh_worker_done_cb (GpaContext *context, gpg_error_t err,
+                        struct refresh_worker_s *w)
 {
-  (void)operation;
+  GpaImportByKeyidOperation *op = w->op;
+
+  if (!err)
+    {
+      gpgme_import_result_t res;
+
+      res = gpgme_op_import_result (context->ctx);
+      gpa_gpgme_update_import_results (&op->result, 0, 0, res);
+      if (res && res->imported > 0 && res->secret_imported)
+        op->imported_secret = TRUE;
+    }
+  else if (!op->err)
+    op->err = err;
+
+  op->done += w->nkeys;
+  refresh_worker_release (w);
+
+  /* Do not start the next request from within the done handler.  */
+  refresh_schedule (op);
+}
+
+
+/* Virtual methods */
+
+static gboolean
+gpa_import_bykeyid_operation_start (GpaImportOperation *operation)
+{
+  GpaImportByKeyidOperation *op = GPA_IMPORT_BYKEYID_OPERATION (operation);
+
+  if (!op->keys)
+    return FALSE;
+
+  op->next = op->keys;
+  op->total = g_list_length (op->keys);
+  gtk_widget_show_all (op->progress_dialog);
+  refresh_run (op);
+
+  return TRUE;
 }
 
 
@@ -177,13 +423,21 @@ gpa_import_bykeyid_operation_complete_import (GpaImportOperation *operation)
 
 GpaImportByKeyidOperation*
 gpa_import_bykeyid_operation_new (GtkWidget *window, gpgme_key_t key)
+{
+  return gpa_import_bykeyid_operation_new_list (window,
+                                                g_list_append (NULL, key));
+}
+
+
+GpaImportByKeyidOperation*
+gpa_import_bykeyid_operation_new_list (GtkWidget *window, GList *keys)
 {
   GpaImportByKeyidOperation *op;
 
   op = g_object_new (GPA_IMPORT_BYKEYID_OPERATION_TYPE,
 		     "window", window, NULL);
-  gpgme_key_ref (key);
-  op->key = key;
+  g_list_foreach (keys, (GFunc) gpgme_key_ref, NULL);
+  op->keys = keys;
 
   return op;
 }
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "gpaimportop.h"
+#include "gpgmetools.h"
 
 /* GObject stuff */
 #define GPA_IMPORT_BYKEYID_OPERATION_TYPE \
@@ -51,11 +52,24 @@
 typedef struct _GpaImportByKeyidOperation      GpaImportByKeyidOperation;
 typedef struct _GpaImportByKeyidOperationClass GpaImportByKeyidOperationClass;
 
+struct refresh_worker_s;
+
 struct _GpaImportByKeyidOperation
 {
   GpaImportOperation parent;
 
-  gpgme_key_t key;
+  GList *keys;          /* The keys to refresh.  */
+  GList *next;          /* The next key to fetch.  */
+  guint total;
+  guint done;
+  guint idle_id;
+  GtkWidget *progress_dialog;
+  struct refresh_worker_s *workers;
+
+  /* The accumulated result of all batches.  */
+  struct gpa_import_result_s result;
+  gboolean imported_secret;
+  gpg_error_t err;      /* The first error seen.  */
 };
 
 
@@ -73,5 +87,12 @@ GType gpa_import_bykeyid_operation_get_type (void) G_GNUC_CONST;
 GpaImportByKeyidOperation *
 gpa_import_bykeyid_operation_new (GtkWidget *window, gpgme_key_t key);
 
+/* Creates a new import by keyid operation refreshing all OpenPGP keys
+   in the list KEYS.  The keys are fetched in batches by several
+   concurrent requests and a single summary is shown at the end.  The
+   operation takes ownership of the list.  */
+GpaImportByKeyidOperation *
+gpa_import_bykeyid_operation_new_list (GtkWidget *window, GList *keys);
+
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 #endif /*GPA_IMPORT_BYKEYID_OP_H*/
@@ -27,6 +27,7 @@
 #include "gpaimportop.h"
 #include "filetype.h"
 #include "gpgmetools.h"
+#include "gpaprogressdlg.h"
 
 static GObjectClass *parent_class = NULL;
 
@@ -35,16 +36,39 @@ enum
 {
   IMPORTED_KEYS,
   IMPORTED_SECRET_KEYS,
+  IMPORTED_FINGERPRINTS,
   LAST_SIGNAL
 };
 static guint signals [LAST_SIGNAL] = { 0 };
 
+/* Sources of at least this size are imported in chunks.  */
+#define IMPORT_CHUNK_THRESHOLD (8 * 1024 * 1024)
+
+/* The approximate size of one chunk.  */
+#define IMPORT_CHUNK_SIZE (1024 * 1024)
+
+/* State of a chunked import.  */
+struct import_chunks_s
+{
+  GByteArray *pending;    /* Data read from the source but not imported.  */
+  gpgme_data_t chunk;     /* The chunk being imported.  */
+  gboolean eof;
+  guint64 total;          /* The size of the source.  */
+  guint64 offset;         /* The number of bytes imported so far.  */
+  struct gpa_import_result_s result;
+  GtkWidget *progress_dialog;
+  guint idle_id;
+};
+
 static gboolean gpa_import_operation_idle_cb (gpointer data);
 static void gpa_import_operation_done_cb (GpaContext *context, gpg_error_t err,
 			      GpaImportOperation *op);
 static void gpa_import_operation_done_error_cb (GpaContext *context,
 						gpg_error_t err,
 						GpaImportOperation *op);
+static void import_chunks_release (GpaImportOperation *op);
+static gboolean import_chunks_start (GpaImportOperation *op);
+static void import_chunks_done (GpaImportOperation *op, gpg_error_t err);
 
 /* GObject boilerplate */
 
@@ -54,6 +78,7 @@ gpa_import_operation_finalize (GObject *object)
   GpaImportOperation *op = GPA_IMPORT_OPERATION (object);
   int i;
 
+  import_chunks_release (op);
   /* Free the data object, if it exists */
   gpgme_data_release (op->source);
   op->source = NULL;
@@ -73,6 +98,7 @@ gpa_import_operation_init (GpaImportOperation *op)
 {
   op->source = NULL;
   op->source2 = NULL;
+  op->chunks = NULL;
 }
 
 static GObject*
@@ -113,6 +139,7 @@ gpa_import_operation_class_init (GpaImportOperationClass *klass)
   /* Virtual methods */
   klass->get_source = NULL;
   klass->complete_import = NULL;
+  klass->start = NULL;
 
   /* Signals */
   klass->imported_keys = NULL;
@@ -132,7 +159,16 @@ gpa_import_operation_class_init (GpaImportOperationClass *klass)
 		  NULL, NULL,
 		  g_cclosure_marshal_VOID__VOID,
 		  G_TYPE_NONE, 0);
-
+  klass->imported_fingerprints = NULL;
+  signals[IMPORTED_FINGERPRINTS] =
+    g_signal_new ("imported_fingerprints",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_FIRST,
+		  G_STRUCT_OFFSET (GpaImportOperationClass,
+				   imported_fingerprints),
+		  NULL, NULL,
+		  g_cclosure_marshal_VOID__POINTER,
+		  G_TYPE_NONE, 1, G_TYPE_POINTER);
 }
 
 GType
@@ -170,39 +206,15 @@ gpa_import_operation_idle_cb (gpointer data)
 {
   GpaImportOperation *op = data;
 
-  if (GPA_IMPORT_OPERATION_GET_CLASS (op)->get_source (op))
+  if (GPA_IMPORT_OPERATION_GET_CLASS (op)->start)
     {
-      gpg_error_t err;
-
-      if (op->source)
-        {
-          gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
-                              is_cms_data_ext (op->source)?
-                              GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
-          err = gpgme_op_import_start (GPA_OPERATION (op)->context->ctx,
-                                       op->source);
-        }
-      else if (op->source2)
-        {
-          /* The only protocol where an array of keys is used in GPA
-             is OpenPGP.  */
-          gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
-                              GPGME_PROTOCOL_OpenPGP);
-          err = gpgme_op_import_keys_start (GPA_OPERATION (op)->context->ctx,
-                                            op->source2);
-        }
-      else
-        err = gpg_error (GPG_ERR_BUG);
-      if (err)
-	{
-	  gpa_gpgme_warning (err);
-	  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
-	}
+      if (! GPA_IMPORT_OPERATION_GET_CLASS (op)->start (op))
+        g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                               gpg_error (GPG_ERR_CANCELED));
     }
   else
-    /* Abort the operation.  */
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed",
-			   gpg_error (GPG_ERR_CANCELED));
+    gpa_import_operation_source_ready
+      (op, GPA_IMPORT_OPERATION_GET_CLASS (op)->get_source (op));
 
   return FALSE;
 }
@@ -212,6 +224,12 @@ static void
 gpa_import_operation_done_cb (GpaContext *context, gpg_error_t err,
 			      GpaImportOperation *op)
 {
+  if (op->chunks)
+    {
+      import_chunks_done (op, err);
+      return;
+    }
+
   if (! err)
     {
       struct gpa_import_result_s result;
@@ -252,3 +270,305 @@ gpa_import_operation_done_error_cb (GpaContext *context, gpg_error_t err,
       break;
     }
 }
+
+
+/* Chunked import.  Large binary key dumps are split at key
+   boundaries and imported chunk by chunk.  The running counts are
+   shown in a progress dialog and, instead of reloading all keys at
+   the end, the fingerprints of the changed keys are announced after
+   each chunk.  */
+
+static void
+import_chunks_release (GpaImportOperation *op)
+{
+  struct import_chunks_s *chunks = op->chunks;
+
+  if (!chunks)
+    return;
+
+  if (chunks->idle_id)
+    g_source_remove (chunks->idle_id);
+  if (chunks->progress_dialog)
+    gtk_widget_destroy (chunks->progress_dialog);
+  gpgme_data_release (chunks->chunk);
+  g_byte_array_free (chunks->pending, TRUE);
+  g_free (chunks);
+  op->chunks = NULL;
+}
+
+
+/* Return the offset of the last key in BUF which starts after the
+   first one, or 0 if there is none.  If EOF is set, all of BUF is
+   returned.  */
+static gsize
+find_chunk_end (const guchar *buf, gsize len, gboolean eof)
+{
+  gsize off = 0;
+  gsize last = 0;
+  int tag;
+  gsize hdrlen, bodylen;
+
+  if (eof)
+    return len;
+
+  while (off < len
+         && gpa_openpgp_parse_packet (buf + off, len - off, &tag,
+                                      &hdrlen, &bodylen))
+    {
+      /* Public and secret key packets start a new key.  */
+      if ((tag == 6 || tag == 5) && off)
+        last = off;
+      off += hdrlen + bodylen;
+    }
+  return last;
+}
+
+
+/* Read the next chunk from the source of OP and start importing it.
+   Returns FALSE if there is nothing left to import.  */
+static gboolean
+import_next_chunk (GpaImportOperation *op, gpg_error_t *r_err)
+{
+  struct import_chunks_s *chunks = op->chunks;
+  gsize want = IMPORT_CHUNK_SIZE;
+  gsize cut = 0;
+  char buffer[65536];
+  ssize_t nread;
+
+  *r_err = 0;
+  while (!cut)
+    {
+      while (!chunks->eof && chunks->pending->len < want)
+        {
+          nread = gpgme_data_read (op->source, buffer, sizeof buffer);
+          if (nread < 0)
+            {
+              *r_err = gpg_error_from_syserror ();
+              return FALSE;
+            }
+          if (!nread)
+            chunks->eof = TRUE;
+          else
+            g_byte_array_append (chunks->pending, (guchar *) buffer, nread);
+        }
+      if (!chunks->pending->len)
+        return FALSE;
+      cut = find_chunk_end (chunks->pending->data, chunks->pending->len,
+                            chunks->eof);
+      /* A single key larger than the chunk size.  */
+      want += IMPORT_CHUNK_SIZE;
+    }
+
+  gpgme_data_release (chunks->chunk);
+  chunks->chunk = NULL;
+  *r_err = gpgme_data_new_from_mem (&chunks->chunk,
+                                    (char *) chunks->pending->data, cut, 1);
+  if (*r_err)
+    return FALSE;
+  g_byte_array_remove_range (chunks->pending, 0, cut);
+  chunks->offset += cut;
+
+  *r_err = gpgme_op_import_start (GPA_OPERATION (op)->context->ctx,
+                                  chunks->chunk);
+  return !*r_err;
+}
+
+
+/* Show the running counts of the chunked import of OP.  */
+static void
+import_chunks_progress (GpaImportOperation *op)
+{
+  struct import_chunks_s *chunks = op->chunks;
+  GpaProgressDialog *dialog = GPA_PROGRESS_DIALOG (chunks->progress_dialog);
+  gchar *label;
+
+  label = g_strdup_printf (_("%i public keys read\n"
+                             "%i public keys imported\n"
+                             "%i public keys unchanged"),
+                           chunks->result.considered,
+                           chunks->result.imported,
+                           chunks->result.unchanged);
+  gpa_progress_dialog_set_label (dialog, label);
+  g_free (label);
+  if (chunks->total)
+    gpa_progress_bar_set_fraction (dialog->pbar,
+                                   (gdouble) chunks->offset / chunks->total);
+}
+
+
+/* Finish the chunked import of OP with ERR.  The results of the
+   chunks imported so far are shown in any case.  */
+static void
+import_chunks_finish (GpaImportOperation *op, gpg_error_t err)
+{
+  struct import_chunks_s *chunks = op->chunks;
+
+  gtk_widget_hide (chunks->progress_dialog);
+  if (!err)
+    GPA_IMPORT_OPERATION_GET_CLASS (op)->complete_import (op);
+  if (chunks->result.secret_imported)
+    g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
+  gpa_gpgme_show_import_results (GPA_OPERATION (op)->window,
+                                 &chunks->result);
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+static gboolean
+import_chunks_idle_cb (gpointer data)
+{
+  GpaImportOperation *op = data;
+  gpg_error_t err;
+
+  op->chunks->idle_id = 0;
+  if (!import_next_chunk (op, &err))
+    {
+      if (err)
+        gpa_gpgme_warning (err);
+      import_chunks_finish (op, err);
+    }
+  else
+    import_chunks_progress (op);
+
+  return FALSE;
+}
+
+
+/* Start a chunked import if the source of OP is a large binary
+   OpenPGP key dump.  Returns FALSE if the source is to be imported as
+   a whole.  */
+static gboolean
+import_chunks_start (GpaImportOperation *op)
+{
+  struct import_chunks_s *chunks;
+  off_t total;
+  unsigned char first;
+  gpg_error_t err;
+
+  total = gpgme_data_seek (op->source, 0, SEEK_END);
+  if (total < IMPORT_CHUNK_THRESHOLD
+      || gpgme_data_seek (op->source, 0, SEEK_SET))
+    {
+      gpgme_data_seek (op->source, 0, SEEK_SET);
+      return FALSE;
+    }
+  /* Only binary OpenPGP data can be split at key boundaries.  */
+  if (gpgme_data_read (op->source, &first, 1) != 1
+      || !(first & 0x80) || is_cms_data_ext (op->source))
+    {
+      gpgme_data_seek (op->source, 0, SEEK_SET);
+      return FALSE;
+    }
+  gpgme_data_seek (op->source, 0, SEEK_SET);
+
+  chunks = g_malloc0 (sizeof *chunks);
+  chunks->pending = g_byte_array_new ();
+  chunks->total = total;
+  op->chunks = chunks;
+
+  gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
+                      GPGME_PROTOCOL_OpenPGP);
+  if (!import_next_chunk (op, &err))
+    {
+      import_chunks_release (op);
+      gpgme_data_seek (op->source, 0, SEEK_SET);
+      return FALSE;
+    }
+
+  chunks->progress_dialog = gpa_progress_dialog_new
+    (GPA_OPERATION (op)->window, GPA_OPERATION (op)->context);
+  gtk_window_set_title (GTK_WINDOW (chunks->progress_dialog),
+                        _("Importing..."));
+  gtk_widget_show_all (chunks->progress_dialog);
+  import_chunks_progress (op);
+
+  return TRUE;
+}
+
+
+/* A chunk has been imported.  */
+static void
+import_chunks_done (GpaImportOperation *op, gpg_error_t err)
+{
+  struct import_chunks_s *chunks = op->chunks;
+  gpgme_import_result_t res;
+  gpgme_import_status_t imp;
+  GPtrArray *fprs;
+
+  res = gpgme_op_import_result (GPA_OPERATION (op)->context->ctx);
+  gpa_gpgme_update_import_results (&chunks->result, 0, 0, res);
+
+  /* Tell the key list only about keys which have been changed.  */
+  fprs = g_ptr_array_new ();
+  for (imp = res? res->imports : NULL; imp; imp = imp->next)
+    if (!imp->result && imp->status && imp->fpr)
+      g_ptr_array_add (fprs, imp->fpr);
+  if (fprs->len)
+    {
+      g_ptr_array_add (fprs, NULL);
+      g_signal_emit (op, signals[IMPORTED_FINGERPRINTS], 0, fprs->pdata);
+    }
+  g_ptr_array_free (fprs, TRUE);
+
+  gpgme_data_release (chunks->chunk);
+  chunks->chunk = NULL;
+
+  if (err)
+    {
+      /* Keep the keys imported so far and report them.  The error has
+         already been shown by the error handler.  */
+      import_chunks_finish (op, err);
+      return;
+    }
+
+  import_chunks_progress (op);
+
+  /* Do not start the next import from within the done handler.  */
+  chunks->idle_id = g_idle_add (import_chunks_idle_cb, op);
+}
+
+
+/* API */
+
+/* The source of OP has been set up; start importing it.  If SUCCESS
+   is false the operation is aborted instead.  */
+void
+gpa_import_operation_source_ready (GpaImportOperation *op, gboolean success)
+{
+  gpg_error_t err;
+
+  if (!success)
+    {
+      /* Abort the operation.  */
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                             gpg_error (GPG_ERR_CANCELED));
+      return;
+    }
+
+  if (op->source && import_chunks_start (op))
+    err = 0;
+  else if (op->source)
+    {
+      gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
+                          is_cms_data_ext (op->source)?
+                          GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+      err = gpgme_op_import_start (GPA_OPERATION (op)->context->ctx,
+                                   op->source);
+    }
+  else if (op->source2)
+    {
+      /* The only protocol where an array of keys is used in GPA
+         is OpenPGP.  */
+      gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
+                          GPGME_PROTOCOL_OpenPGP);
+      err = gpgme_op_import_keys_start (GPA_OPERATION (op)->context->ctx,
+                                        op->source2);
+    }
+  else
+    err = gpg_error (GPG_ERR_BUG);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+    }
+}
@@ -43,6 +43,9 @@ struct _GpaImportOperation {
 
   gpgme_data_t source;    /* Either a data object with the full key  */
   gpgme_key_t *source2;   /* or an array of key descriptions.  */
+
+  /* State of the chunked import of large key dumps or NULL.  */
+  struct import_chunks_s *chunks;
 };
 
 struct _GpaImportOperationClass {
@@ -59,11 +62,32 @@ struct _GpaImportOperationClass {
    */
   void (*complete_import) (GpaImportOperation *op);
 
+  /* Start an import which does not use the context of the operation
+   * or which gets its source asynchronously.  If this is set,
+   * GET_SOURCE is not used.  The subclass either emits the "completed"
+   * signal itself or calls gpa_import_operation_source_ready once the
+   * source has been set up.  Returns FALSE if the operation should be
+   * aborted.
+   */
+  gboolean (*start) (GpaImportOperation *op);
+
   /* "Some keys were imported" signal.
    */
   void (*imported_keys) (GpaImportOperation *op);
+
+  /* "Some keys of a large import were changed" signal.  Takes a NULL
+   * terminated array with the fingerprints of the changed keys.  It
+   * is emitted for each chunk instead of "imported_keys".
+   */
+  void (*imported_fingerprints) (GpaImportOperation *op, const char **fprs);
 };
 
 GType gpa_import_operation_get_type (void) G_GNUC_CONST;
 
+/* API */
+
+/* Start importing the source set up by the START method of OP.  */
+void gpa_import_operation_source_ready (GpaImportOperation *op,
+                                        gboolean success);
+
 #endif
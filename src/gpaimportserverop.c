@@ -39,7 +39,7 @@
 static GObjectClass *parent_class = NULL;
 
 static gboolean
-gpa_import_server_operation_get_source (GpaImportOperation *operation);
+gpa_import_server_operation_start (GpaImportOperation *operation);
 static void
 gpa_import_server_operation_complete_import (GpaImportOperation *operation);
 
@@ -83,7 +83,7 @@ gpa_import_server_operation_class_init (GpaImportServerOperationClass *klass)
 
   object_class->constructor = gpa_import_server_operation_constructor;
   object_class->finalize = gpa_import_server_operation_finalize;
-  import_class->get_source = gpa_import_server_operation_get_source;
+  import_class->start = gpa_import_server_operation_start;
   import_class->complete_import = gpa_import_server_operation_complete_import;
 }
 
@@ -191,10 +191,22 @@ search_keys (GpaImportOperation *operation, const char *keyid)
 }
 
 
+/* The keyserver helper has fetched the key.  */
+static void
+fetched_cb (gboolean success, gpgme_data_t data, gpointer opaque)
+{
+  GpaImportOperation *operation = opaque;
+
+  operation->source = data;
+  gpa_import_operation_source_ready (operation, success);
+  g_object_unref (operation);
+}
+
+
 /* Virtual methods */
 
 static gboolean
-gpa_import_server_operation_get_source (GpaImportOperation *operation)
+gpa_import_server_operation_start (GpaImportOperation *operation)
 {
   GpaImportServerOperation *op = GPA_IMPORT_SERVER_OPERATION (operation);
   GtkWidget *dialog;
@@ -228,25 +240,26 @@ gpa_import_server_operation_get_source (GpaImportOperation *operation)
          the keyids to be passed to the import function we run a
          --search-keys first to get the list of matching keys and pass
          them to the actual import function (which does a --recv-keys).  */
-      /* Fixme: As with server_get_key (below), this is a blocking
-         operation. */
+      /* Fixme: This is a blocking operation. */
       if (search_keys (operation, keyid))
         {
           /* Okay, found key(s).  */
 	  g_free (keyid);
+	  gpa_import_operation_source_ready (operation, TRUE);
 	  return TRUE;
         }
     }
   else if (response == GTK_RESPONSE_OK)
     {
-      if (server_get_key (gpa_options_get_default_keyserver
-			  (gpa_options_get_instance ()),
-			  keyid,
-                          &operation->source, GPA_OPERATION (op)->window))
-	{
-	  g_free (keyid);
-	  return TRUE;
-	}
+      /* The helper runs in the background; keep the operation alive
+         until it has finished.  */
+      g_object_ref (operation);
+      server_get_key_start (gpa_options_get_default_keyserver
+                            (gpa_options_get_instance ()),
+                            keyid, GPA_OPERATION (op)->window,
+                            fetched_cb, operation);
+      g_free (keyid);
+      return TRUE;
     }
   g_free (keyid);
   return FALSE;
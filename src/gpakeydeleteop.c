@@ -32,6 +32,20 @@
 
 #include "gpa.h"
 #include "gpakeydeleteop.h"
+#include "keytable.h"
+#include "gpaprogressdlg.h"
+
+/* The number of fingerprints passed to one engine invocation.  */
+#define DELETE_BATCH_SIZE 1000
+
+/* One engine invocation of a bulk deletion.  */
+struct delete_job_s
+{
+  gboolean verify;        /* List the keys instead of deleting them.  */
+  gpgme_protocol_t protocol;
+  gboolean with_secret;
+  GPtrArray *fprs;        /* NULL terminated; the strings are not owned.  */
+};
 
 /* Internal functions */
 static gboolean gpa_key_delete_operation_idle_cb (gpointer data);
@@ -49,6 +63,18 @@ static GObjectClass *parent_class = NULL;
 static void
 gpa_key_delete_operation_finalize (GObject *object)
 {
+  GpaKeyDeleteOperation *op = GPA_KEY_DELETE_OPERATION (object);
+
+  g_ptr_array_free (op->deleted, TRUE);
+  if (op->jobs)
+    g_ptr_array_free (op->jobs, TRUE);
+  if (op->survivors)
+    g_hash_table_destroy (op->survivors);
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -56,6 +82,13 @@ gpa_key_delete_operation_finalize (GObject *object)
 static void
 gpa_key_delete_operation_init (GpaKeyDeleteOperation *op)
 {
+  op->deleted = g_ptr_array_new ();
+  op->changed_wot = FALSE;
+  op->jobs = NULL;
+  op->next_job = 0;
+  op->survivors = NULL;
+  op->idle_id = 0;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -142,6 +175,35 @@ gpa_key_delete_operation_new (GtkWidget *window, GList *keys)
 
 /* Internal */
 
+/* KEY has been deleted.  */
+static void
+record_deleted (GpaKeyDeleteOperation *op, gpgme_key_t key)
+{
+  g_ptr_array_add (op->deleted, key->subkeys->fpr);
+  /* Signatures made with a secret key or an ultimately trusted key
+     may have been all that made other keys valid.  */
+  if (key->owner_trust == GPGME_VALIDITY_ULTIMATE
+      || gpa_keytable_lookup_key (gpa_keytable_get_secret_instance (),
+                                  key->subkeys->fpr))
+    op->changed_wot = TRUE;
+}
+
+
+/* Tell the key manager about the deleted keys.  */
+static void
+report_deleted (GpaKeyDeleteOperation *op)
+{
+  if (op->changed_wot)
+    g_signal_emit_by_name (GPA_OPERATION (op), "changed_wot");
+  else if (op->deleted->len)
+    {
+      g_ptr_array_add (op->deleted, NULL);
+      g_signal_emit_by_name (GPA_OPERATION (op), "removed_keys",
+                             op->deleted->pdata);
+    }
+}
+
+
 static gpg_error_t
 gpa_key_delete_operation_start (GpaKeyDeleteOperation *op)
 {
@@ -165,13 +227,229 @@ gpa_key_delete_operation_start (GpaKeyDeleteOperation *op)
   return 0;
 }
 
+/* Bulk deletion.  The keys are grouped by protocol and by whether
+   they have a secret key.  Each group is deleted by one invocation of
+   the engine for up to DELETE_BATCH_SIZE keys.  The engine does not
+   tell which keys have been deleted; thus the keys are listed again
+   afterwards and those still found are reported.  */
+
+static void
+delete_job_free (gpointer data)
+{
+  struct delete_job_s *job = data;
+
+  g_ptr_array_free (job->fprs, TRUE);
+  g_free (job);
+}
+
+
+/* Add jobs for deleting the keys with the fingerprints in FPRS and
+   for listing them afterwards.  The listing jobs are collected in
+   VERIFY.  */
+static void
+bulk_add_jobs (GpaKeyDeleteOperation *op, GPtrArray *verify,
+               gpgme_protocol_t protocol, gboolean with_secret,
+               GPtrArray *fprs)
+{
+  guint i, j;
+
+  for (i = 0; i < fprs->len; i += DELETE_BATCH_SIZE)
+    {
+      struct delete_job_s *job, *check;
+
+      job = g_malloc0 (sizeof *job);
+      job->protocol = protocol;
+      job->with_secret = with_secret;
+      job->fprs = g_ptr_array_new ();
+      check = g_malloc0 (sizeof *check);
+      check->verify = TRUE;
+      check->protocol = protocol;
+      check->fprs = g_ptr_array_new ();
+      for (j = i; j < fprs->len && j < i + DELETE_BATCH_SIZE; j++)
+        {
+          g_ptr_array_add (job->fprs, g_ptr_array_index (fprs, j));
+          g_ptr_array_add (check->fprs, g_ptr_array_index (fprs, j));
+        }
+      g_ptr_array_add (job->fprs, NULL);
+      g_ptr_array_add (check->fprs, NULL);
+      g_ptr_array_add (op->jobs, job);
+      g_ptr_array_add (verify, check);
+    }
+}
+
+
+/* Group the keys of OP into engine invocations.  */
+static void
+bulk_build_jobs (GpaKeyDeleteOperation *op)
+{
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
+  GPtrArray *openpgp = g_ptr_array_new ();
+  GPtrArray *openpgp_secret = g_ptr_array_new ();
+  GPtrArray *cms = g_ptr_array_new ();
+  GPtrArray *verify = g_ptr_array_new ();
+  GList *item;
+  guint i;
+
+  for (item = GPA_KEY_OPERATION (op)->keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      if (key->protocol == GPGME_PROTOCOL_CMS)
+        g_ptr_array_add (cms, key->subkeys->fpr);
+      else if (gpa_keytable_lookup_key (secret, key->subkeys->fpr))
+        g_ptr_array_add (openpgp_secret, key->subkeys->fpr);
+      else
+        g_ptr_array_add (openpgp, key->subkeys->fpr);
+    }
+
+  op->jobs = g_ptr_array_new_with_free_func (delete_job_free);
+  bulk_add_jobs (op, verify, GPGME_PROTOCOL_OpenPGP, TRUE, openpgp_secret);
+  bulk_add_jobs (op, verify, GPGME_PROTOCOL_OpenPGP, FALSE, openpgp);
+  bulk_add_jobs (op, verify, GPGME_PROTOCOL_CMS, FALSE, cms);
+  for (i = 0; i < verify->len; i++)
+    g_ptr_array_add (op->jobs, g_ptr_array_index (verify, i));
+
+  g_ptr_array_free (verify, TRUE);
+  g_ptr_array_free (cms, TRUE);
+  g_ptr_array_free (openpgp, TRUE);
+  g_ptr_array_free (openpgp_secret, TRUE);
+}
+
+
+/* A key has been found by a listing job: it has not been deleted.  */
+static void
+bulk_next_key_cb (GpaContext *context, gpgme_key_t key,
+                  GpaKeyDeleteOperation *op)
+{
+  if (op->survivors && key->subkeys && key->subkeys->fpr)
+    g_hash_table_insert (op->survivors, g_strdup (key->subkeys->fpr),
+                         GINT_TO_POINTER (1));
+}
+
+
+/* All jobs are done.  Report the keys which are gone.  */
+static void
+bulk_finish (GpaKeyDeleteOperation *op)
+{
+  GList *item;
+  guint nkeys = 0;
+  guint failed;
+
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+
+  for (item = GPA_KEY_OPERATION (op)->keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      nkeys++;
+      if (!g_hash_table_lookup (op->survivors, key->subkeys->fpr))
+        record_deleted (op, key);
+    }
+  report_deleted (op);
+
+  failed = g_hash_table_size (op->survivors);
+  if (failed)
+    {
+      gchar *message;
+
+      message = g_strdup_printf (ngettext ("%u of %u keys could not be"
+                                           " deleted.",
+                                           "%u of %u keys could not be"
+                                           " deleted.", failed),
+                                 failed, nkeys);
+      gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_free (message);
+    }
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                         failed? gpg_error (GPG_ERR_GENERAL) : 0);
+}
+
+
+/* Run the next job.  */
+static gboolean
+bulk_next_cb (gpointer data)
+{
+  GpaKeyDeleteOperation *op = data;
+  gpgme_ctx_t ctx = GPA_OPERATION (op)->context->ctx;
+  gpg_error_t err;
+
+  op->idle_id = 0;
+  for (; op->next_job < op->jobs->len; op->next_job++)
+    {
+      struct delete_job_s *job = g_ptr_array_index (op->jobs, op->next_job);
+
+      if (job->verify)
+        {
+          gpgme_set_protocol (ctx, job->protocol);
+          err = gpgme_op_keylist_ext_start (ctx, (const char **)
+                                            job->fprs->pdata, 0, 0);
+        }
+      else
+        err = gpa_delete_keys_start (ctx, job->protocol, job->with_secret,
+                                     (const char **) job->fprs->pdata);
+      if (!err)
+        return FALSE;
+      if (!job->verify)
+        gpa_gpgme_warning (err);
+    }
+
+  bulk_finish (op);
+  return FALSE;
+}
+
+
+/* A job is done.  */
+static void
+bulk_done (GpaKeyDeleteOperation *op)
+{
+  op->next_job++;
+  if (op->progress_dialog)
+    gpa_progress_bar_set_fraction
+      (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+       (gdouble) op->next_job / op->jobs->len);
+
+  /* Do not start the next job from within the done handler.  */
+  op->idle_id = g_idle_add (bulk_next_cb, op);
+}
+
+
+/* Delete all keys of OP after asking only once.  */
+static gpg_error_t
+bulk_start (GpaKeyDeleteOperation *op)
+{
+  if (! gpa_delete_dialog_run_multiple (GPA_OPERATION (op)->window,
+                                        GPA_KEY_OPERATION (op)->keys))
+    return gpg_error (GPG_ERR_CANCELED);
+
+  bulk_build_jobs (op);
+  op->survivors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, NULL);
+  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "next_key",
+                    G_CALLBACK (bulk_next_key_cb), op);
+
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 GPA_OPERATION (op)->context);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                        _("Removing Keys..."));
+  gtk_widget_show_all (op->progress_dialog);
+
+  bulk_next_cb (op);
+  return 0;
+}
+
+
 static gboolean
 gpa_key_delete_operation_idle_cb (gpointer data)
 {
   gpg_error_t err;
   GpaKeyDeleteOperation *op = data;
 
-  err = gpa_key_delete_operation_start (op);
+  if (g_list_length (GPA_KEY_OPERATION (op)->keys) > 1)
+    err = bulk_start (op);
+  else
+    err = gpa_key_delete_operation_start (op);
   if (err)
     g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
 
@@ -191,7 +469,7 @@ gpa_key_delete_operation_next (GpaKeyDeleteOperation *op)
 	return;
     }
 
-  g_signal_emit_by_name (GPA_OPERATION (op), "changed_wot");
+  report_deleted (op);
   g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
 }
 
@@ -199,6 +477,12 @@ static void gpa_key_delete_operation_done_error_cb (GpaContext *context,
 						    gpg_error_t err,
 						    GpaKeyDeleteOperation *op)
 {
+  /* Keys not found by the listing jobs have been deleted.  */
+  if (op->jobs && op->next_job < op->jobs->len
+      && ((struct delete_job_s *)
+          g_ptr_array_index (op->jobs, op->next_job))->verify)
+    return;
+
   switch (gpg_err_code (err))
     {
     case GPG_ERR_NO_ERROR:
@@ -215,6 +499,14 @@ static void gpa_key_delete_operation_done_cb (GpaContext *context,
 					      gpg_error_t err,
 					      GpaKeyDeleteOperation *op)
 {
+  if (op->jobs)
+    {
+      bulk_done (op);
+      return;
+    }
+  if (!err)
+    record_deleted (op, gpa_key_operation_current_key
+                    (GPA_KEY_OPERATION (op)));
   GPA_KEY_OPERATION (op)->current = g_list_next
     (GPA_KEY_OPERATION (op)->current);
   gpa_key_delete_operation_next (op);
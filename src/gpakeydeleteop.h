@@ -40,6 +40,19 @@ typedef struct _GpaKeyDeleteOperationClass GpaKeyDeleteOperationClass;
 
 struct _GpaKeyDeleteOperation {
   GpaKeyOperation parent;
+
+  /* The fingerprints of the deleted keys.  */
+  GPtrArray *deleted;
+
+  /* Whether a deleted key may have changed the validity of others.  */
+  gboolean changed_wot;
+
+  /* State of the bulk deletion used for several keys.  */
+  GPtrArray *jobs;
+  guint next_job;
+  GHashTable *survivors;
+  guint idle_id;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaKeyDeleteOperationClass {
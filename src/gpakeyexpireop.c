@@ -20,6 +20,7 @@
 
 #include <config.h>
 
+#include <time.h>
 #include <glib.h>
 
 #ifdef G_OS_UNIX
@@ -35,6 +36,27 @@
 #include "expirydlg.h"
 #include "gpgmeedit.h"
 #include "gtktools.h"
+#include "keytable.h"
+#include "gpaprogressdlg.h"
+
+/* The number of keys changed at the same time in batch mode.  */
+#define EXPIRE_WORKERS 3
+
+/* A context changing one key in batch mode.  */
+struct expire_worker_s
+{
+  GpaKeyExpireOperation *op;
+  GpaContext *ctx;
+  gpgme_key_t key;
+  /* 0 while the primary key is changed, 1 for the subkeys.  */
+  int step;
+  /* The step finished and the next one is to be started.  */
+  gboolean again;
+  /* The subkeys to change as a list of fingerprints for the quick
+     command and as a list of indices for the edit interface.  */
+  gchar *subfprs;
+  int *subidx;
+};
 
 /* Internal functions */
 static gboolean gpa_key_expire_operation_idle_cb (gpointer data);
@@ -61,6 +83,27 @@ static GObjectClass *parent_class = NULL;
 static void
 gpa_key_expire_operation_finalize (GObject *object)
 {
+  GpaKeyExpireOperation *op = GPA_KEY_EXPIRE_OPERATION (object);
+  int i;
+
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  for (i = 0; i < op->nworkers; i++)
+    {
+      g_object_unref (op->workers[i].ctx);
+      g_free (op->workers[i].subfprs);
+      g_free (op->workers[i].subidx);
+    }
+  g_free (op->workers);
+  g_list_free (op->pending);
+  if (op->modified_fprs)
+    g_ptr_array_free (op->modified_fprs, TRUE);
+  if (op->failures)
+    g_string_free (op->failures, TRUE);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
+  if (op->date)
+    g_date_free (op->date);
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -69,6 +112,23 @@ static void
 gpa_key_expire_operation_init (GpaKeyExpireOperation *op)
 {
   op->modified_keys = 0;
+  op->date = NULL;
+  op->use_quick = FALSE;
+  op->subkeys = GPA_EXPIRY_SUBKEYS_NONE;
+  op->expires = 0;
+  op->pending = NULL;
+  op->total = 0;
+  op->done = 0;
+  op->unlocked = FALSE;
+  op->aborted = FALSE;
+  op->err = 0;
+  op->workers = NULL;
+  op->nworkers = 0;
+  op->running = 0;
+  op->idle_id = 0;
+  op->modified_fprs = NULL;
+  op->failures = NULL;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -192,12 +252,375 @@ gpa_key_expire_operation_start (GpaKeyExpireOperation *op)
 }
 
 
+/* Batch mode.  The new date is asked once for all keys.  If GPGME
+   and GnuPG support it, the keys are changed with the non-interactive
+   quick-set-expire command, several keys at a time.  Otherwise the
+   edit interface is used for one key after the other.  The key list
+   is updated only for the changed keys at the end.  */
+
+/* Return true if the quick-set-expire command can be used.  */
+static gboolean
+have_quick_expire (void)
+{
+#if GPGME_VERSION_NUMBER >= 0x010e01  /* GPGME >= 1.14.1 */
+  return is_gpg_version_at_least ("2.1.22");
+#else
+  return FALSE;
+#endif
+}
+
+
+/* Select the subkeys of W->key to change along with the primary
+   key.  */
+static void
+batch_select_subkeys (struct expire_worker_s *w)
+{
+  GpaKeyExpireOperation *op = w->op;
+  gpgme_subkey_t subkey;
+  GString *fprs;
+  GArray *idx;
+  time_t limit = 0;
+  int i;
+
+  g_free (w->subfprs);
+  w->subfprs = NULL;
+  g_free (w->subidx);
+  w->subidx = NULL;
+  if (op->subkeys == GPA_EXPIRY_SUBKEYS_NONE)
+    return;
+
+  if (op->expires)
+    limit = time (NULL) + op->expires;
+  fprs = g_string_new (NULL);
+  idx = g_array_new (TRUE, TRUE, sizeof (int));
+  for (subkey = w->key->subkeys->next, i = 1; subkey;
+       subkey = subkey->next, i++)
+    {
+      if (subkey->revoked)
+        continue;
+      /* Don't shorten the lifetime of a subkey.  */
+      if (op->subkeys == GPA_EXPIRY_SUBKEYS_EXPIRING
+          && (!subkey->expires || (limit && subkey->expires >= limit)))
+        continue;
+      if (fprs->len)
+        g_string_append_c (fprs, '\n');
+      g_string_append (fprs, subkey->fpr);
+      g_array_append_val (idx, i);
+    }
+  if (idx->len)
+    {
+      w->subfprs = g_string_free (fprs, FALSE);
+      w->subidx = (int *) g_array_free (idx, FALSE);
+    }
+  else
+    {
+      g_string_free (fprs, TRUE);
+      g_array_free (idx, TRUE);
+    }
+}
+
+
+/* Start the current step for the key of worker W.  */
+static gpg_error_t
+batch_worker_start (struct expire_worker_s *w)
+{
+  GpaKeyExpireOperation *op = w->op;
+
+#if GPGME_VERSION_NUMBER >= 0x010e01  /* GPGME >= 1.14.1 */
+  if (op->use_quick)
+    {
+      gpgme_set_protocol (w->ctx->ctx, GPGME_PROTOCOL_OpenPGP);
+      return gpgme_op_setexpire_start (w->ctx->ctx, w->key, op->expires,
+                                       w->step? w->subfprs : NULL, 0);
+    }
+#endif
+  if (w->step)
+    return gpa_gpgme_edit_expire_subkeys_start (w->ctx, w->key,
+                                                w->subidx, op->date);
+  return gpa_gpgme_edit_expire_start (w->ctx, w->key, op->date);
+}
+
+
+/* Record the outcome ERR for KEY.  MODIFIED is true if the key was
+   changed even if ERR is set.  */
+static void
+batch_record (GpaKeyExpireOperation *op, gpgme_key_t key, gpg_error_t err,
+              gboolean modified)
+{
+  op->done++;
+  if (!err || modified)
+    {
+      op->modified_keys++;
+      g_ptr_array_add (op->modified_fprs, key->subkeys->fpr);
+    }
+  switch (gpg_err_code (err))
+    {
+    case GPG_ERR_NO_ERROR:
+      op->unlocked = TRUE;
+      break;
+    case GPG_ERR_CANCELED:
+    case GPG_ERR_BAD_PASSPHRASE:
+    case GPG_ERR_INV_TIME:
+      /* All other keys would fail the same way.  */
+      op->aborted = TRUE;
+      if (!op->err)
+        op->err = err;
+      break;
+    default:
+      {
+        gchar *uid = gpa_gpgme_key_get_userid (key->uids);
+
+        g_string_append_printf (op->failures, "\n%s: %s",
+                                uid, gpg_strerror (err));
+        g_free (uid);
+      }
+      break;
+    }
+
+  if (op->progress_dialog)
+    gpa_progress_bar_set_fraction
+      (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+       (gdouble) op->done / op->total);
+}
+
+
+/* All keys have been processed.  */
+static void
+batch_finish (GpaKeyExpireOperation *op)
+{
+  gchar *message;
+
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+
+  if (op->modified_fprs->len)
+    {
+      g_ptr_array_add (op->modified_fprs, NULL);
+      g_signal_emit_by_name (GPA_OPERATION (op), "changed_keys",
+                             op->modified_fprs->pdata);
+    }
+
+  if (gpg_err_code (op->err) == GPG_ERR_BAD_PASSPHRASE)
+    gpa_window_error (_("Wrong passphrase!"), GPA_OPERATION (op)->window);
+  else if (gpg_err_code (op->err) == GPG_ERR_INV_TIME)
+    gpa_window_error
+      (_("Invalid time given.\n"
+         "(you may not set the expiration time to the past.)"),
+       GPA_OPERATION (op)->window);
+
+  if (op->failures->len)
+    {
+      message = g_strdup_printf (_("%u of %u keys have been changed."
+                                   "  These keys could not be changed:%s"),
+                                 op->modified_keys, op->total,
+                                 op->failures->str);
+      gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_free (message);
+    }
+  else if (op->modified_keys)
+    {
+      message = g_strdup_printf
+        (ngettext ("The expiry date of %u key has been changed.",
+                   "The expiry date of %u keys has been changed.",
+                   op->modified_keys),
+         op->modified_keys);
+      gpa_window_message (message, GPA_OPERATION (op)->window);
+      g_free (message);
+    }
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+}
+
+
+/* Continue the keys waiting for their subkeys and start as many
+   pending keys as allowed.  Until the first key has been changed only
+   one key is changed at a time so that the passphrase is asked only
+   once.  */
+static gboolean
+batch_schedule_cb (gpointer data)
+{
+  GpaKeyExpireOperation *op = data;
+  int limit = op->unlocked? op->nworkers : 1;
+  gpg_error_t err;
+  int i;
+
+  op->idle_id = 0;
+  for (i = 0; i < op->nworkers; i++)
+    {
+      struct expire_worker_s *w = &op->workers[i];
+
+      if (!w->again)
+        continue;
+      w->again = FALSE;
+      err = op->aborted? gpg_error (GPG_ERR_CANCELED) : batch_worker_start (w);
+      if (err)
+        {
+          batch_record (op, w->key, err, TRUE);
+          w->key = NULL;
+          op->running--;
+        }
+    }
+
+  for (i = 0; (i < op->nworkers && op->running < limit
+               && op->pending && !op->aborted); i++)
+    {
+      struct expire_worker_s *w = &op->workers[i];
+
+      if (w->key)
+        continue;
+      w->key = op->pending->data;
+      w->step = 0;
+      op->pending = g_list_delete_link (op->pending, op->pending);
+      batch_select_subkeys (w);
+      err = batch_worker_start (w);
+      if (err)
+        {
+          batch_record (op, w->key, err, FALSE);
+          w->key = NULL;
+          continue;
+        }
+      op->running++;
+    }
+  if (op->aborted)
+    {
+      g_list_free (op->pending);
+      op->pending = NULL;
+    }
+  if (!op->running && !op->pending)
+    batch_finish (op);
+
+  return FALSE;
+}
+
+
+static void
+batch_worker_done_cb (GpaContext *context, gpg_error_t err,
+                      struct expire_worker_s *w)
+{
+  GpaKeyExpireOperation *op = w->op;
+
+  if (!err && !w->step && w->subidx)
+    {
+      /* The subkeys are still to be changed.  */
+      w->step = 1;
+      w->again = TRUE;
+    }
+  else
+    {
+      batch_record (op, w->key, err, w->step > 0);
+      w->key = NULL;
+      op->running--;
+    }
+
+  /* Do not start the next key from within the done handler.  */
+  if (!op->idle_id)
+    op->idle_id = g_idle_add (batch_schedule_cb, op);
+}
+
+
+/* Change the expiry date of the keys in KEYS in batch mode.  Returns
+   FALSE if the user canceled.  */
+static gboolean
+batch_start (GpaKeyExpireOperation *op, GList *keys)
+{
+  int i;
+
+  if (! gpa_expiry_dialog_run_batch (GPA_OPERATION (op)->window, keys,
+                                     &op->date, &op->subkeys))
+    return FALSE;
+  if (op->date)
+    {
+      GDate today;
+      gint days;
+
+      g_date_set_time_t (&today, time (NULL));
+      days = g_date_days_between (&today, op->date);
+      if (days <= 0)
+        {
+          gpa_window_error
+            (_("Invalid time given.\n"
+               "(you may not set the expiration time to the past.)"),
+             GPA_OPERATION (op)->window);
+          return FALSE;
+        }
+      op->expires = (unsigned long) days * 86400;
+    }
+
+  op->use_quick = have_quick_expire ();
+  op->pending = keys;
+  op->total = g_list_length (keys);
+  op->modified_fprs = g_ptr_array_new ();
+  op->failures = g_string_new (NULL);
+  /* The passphrase callback used with the edit interface of old GnuPG
+     versions can't be shared between several contexts.  */
+  op->nworkers = op->use_quick? EXPIRE_WORKERS : 1;
+  op->workers = g_malloc0_n (op->nworkers, sizeof *op->workers);
+  for (i = 0; i < op->nworkers; i++)
+    {
+      struct expire_worker_s *w = &op->workers[i];
+
+      w->op = op;
+      w->ctx = gpa_context_new ();
+      g_signal_connect (G_OBJECT (w->ctx), "done",
+                        G_CALLBACK (batch_worker_done_cb), w);
+    }
+
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 op->workers[0].ctx);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                        _("Changing Expiry Dates..."));
+  gtk_widget_show_all (op->progress_dialog);
+
+  batch_schedule_cb (op);
+  return TRUE;
+}
+
+
 static gboolean
 gpa_key_expire_operation_idle_cb (gpointer data)
 {
   GpaKeyExpireOperation *op = data;
+  GpaKeyOperation *keyop = GPA_KEY_OPERATION (op);
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
+  GList *item, *next;
   gpg_error_t err;
 
+  /* Only keys with a secret part can be changed.  Drop the others
+     before deciding between the single and the batch dialog.  */
+  for (item = keyop->keys; item; item = next)
+    {
+      gpgme_key_t key = item->data;
+
+      next = g_list_next (item);
+      if (key->protocol != GPGME_PROTOCOL_OpenPGP
+          || !gpa_keytable_lookup_key (secret, key->subkeys->fpr))
+        {
+          gpgme_key_unref (key);
+          keyop->keys = g_list_delete_link (keyop->keys, item);
+        }
+    }
+  keyop->current = keyop->keys;
+
+  if (!keyop->keys)
+    {
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                             gpg_error (GPG_ERR_NO_SECKEY));
+      return FALSE;
+    }
+
+  if (g_list_length (keyop->keys) > 1)
+    {
+      GList *keys = g_list_copy (keyop->keys);
+
+      if (! batch_start (op, keys))
+        {
+          g_list_free (keys);
+          g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                                 gpg_error (GPG_ERR_CANCELED));
+        }
+      return FALSE;
+    }
+
   err = gpa_key_expire_operation_start (op);
   if (err)
     g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
@@ -25,6 +25,7 @@
 #include <glib-object.h>
 #include "gpa.h"
 #include "gpakeyop.h"
+#include "expirydlg.h"
 
 /* GObject stuff */
 #define GPA_KEY_EXPIRE_OPERATION_TYPE	  (gpa_key_expire_operation_get_type ())
@@ -42,6 +43,24 @@ struct _GpaKeyExpireOperation {
 
   int modified_keys;
   GDate *date;
+
+  /* State of the batch mode used for several keys.  */
+  gboolean use_quick;
+  gpa_expiry_subkeys_t subkeys;
+  unsigned long expires;
+  GList *pending;
+  guint total;
+  guint done;
+  gboolean unlocked;
+  gboolean aborted;
+  gpg_error_t err;
+  struct expire_worker_s *workers;
+  int nworkers;
+  int running;
+  guint idle_id;
+  GPtrArray *modified_fprs;
+  GString *failures;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaKeyExpireOperationClass {
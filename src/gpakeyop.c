@@ -28,6 +28,8 @@
 enum
 {
   CHANGED_WOT,
+  CHANGED_KEYS,
+  REMOVED_KEYS,
   LAST_SIGNAL
 };
 
@@ -139,6 +141,22 @@ gpa_key_operation_class_init (GpaKeyOperationClass *klass)
 		  NULL, NULL,
 		  g_cclosure_marshal_VOID__VOID,
 		  G_TYPE_NONE, 0);
+  signals[CHANGED_KEYS] =
+    g_signal_new ("changed_keys",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_FIRST,
+		  G_STRUCT_OFFSET (GpaKeyOperationClass, changed_keys),
+		  NULL, NULL,
+		  g_cclosure_marshal_VOID__POINTER,
+		  G_TYPE_NONE, 1, G_TYPE_POINTER);
+  signals[REMOVED_KEYS] =
+    g_signal_new ("removed_keys",
+		  G_TYPE_FROM_CLASS (object_class),
+		  G_SIGNAL_RUN_FIRST,
+		  G_STRUCT_OFFSET (GpaKeyOperationClass, removed_keys),
+		  NULL, NULL,
+		  g_cclosure_marshal_VOID__POINTER,
+		  G_TYPE_NONE, 1, G_TYPE_POINTER);
   /* Properties */
   g_object_class_install_property (object_class,
 				   PROP_KEYS,
@@ -50,6 +50,14 @@ struct _GpaKeyOperationClass {
 
   /* Signal handlers */
   void (*changed_wot) (GpaKeyOperation *operation);
+
+  /* Only the keys with the fingerprints in the NULL terminated array
+     FPRS have been changed.  */
+  void (*changed_keys) (GpaKeyOperation *operation, const char **fprs);
+
+  /* The keys with the fingerprints in the NULL terminated array FPRS
+     have been deleted.  */
+  void (*removed_keys) (GpaKeyOperation *operation, const char **fprs);
 };
 
 GType gpa_key_operation_get_type (void) G_GNUC_CONST;
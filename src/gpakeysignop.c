@@ -35,6 +35,18 @@
 #include "keysigndlg.h"
 #include "gpgmeedit.h"
 #include "gtktools.h"
+#include "gpaprogressdlg.h"
+
+/* The number of keys signed at the same time in batch mode.  */
+#define SIGN_WORKERS 3
+
+/* A context signing one key in batch mode.  */
+struct sign_worker_s
+{
+  GpaKeySignOperation *op;
+  GpaContext *ctx;
+  gpgme_key_t key;
+};
 
 /* Internal functions */
 static gboolean gpa_key_sign_operation_idle_cb (gpointer data);
@@ -53,10 +65,24 @@ static void
 gpa_key_sign_operation_finalize (GObject *object)
 {
   GpaKeySignOperation *op = GPA_KEY_SIGN_OPERATION (object);
+  int i;
+
   if (op->signer_key)
     {
       gpgme_key_unref (op->signer_key);
     }
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  for (i = 0; i < op->nworkers; i++)
+    g_object_unref (op->workers[i].ctx);
+  g_free (op->workers);
+  g_list_free (op->pending);
+  if (op->signed_fprs)
+    g_ptr_array_free (op->signed_fprs, TRUE);
+  if (op->failures)
+    g_string_free (op->failures, TRUE);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -66,6 +92,22 @@ gpa_key_sign_operation_init (GpaKeySignOperation *op)
 {
   op->signer_key = NULL;
   op->signed_keys = 0;
+  op->use_keysign = FALSE;
+  op->sign_locally = FALSE;
+  op->expires = 0;
+  op->pending = NULL;
+  op->total = 0;
+  op->done = 0;
+  op->unlocked = FALSE;
+  op->aborted = FALSE;
+  op->err = 0;
+  op->workers = NULL;
+  op->nworkers = 0;
+  op->running = 0;
+  op->idle_id = 0;
+  op->signed_fprs = NULL;
+  op->failures = NULL;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -180,6 +222,258 @@ gpa_key_sign_operation_start (GpaKeySignOperation *op)
 }
 
 
+/* Batch mode.  The options are asked once for all keys.  If GPGME
+   and GnuPG support it, the keys are certified with the
+   non-interactive keysign command, several keys at a time.  Otherwise
+   the edit interface is used for one key after the other.  The key
+   list is updated only for the signed keys at the end.  */
+
+/* Return true if the non-interactive keysign command can be used.  */
+static gboolean
+have_keysign (void)
+{
+#if GPGME_VERSION_NUMBER >= 0x010700  /* GPGME >= 1.7.0 */
+  return is_gpg_version_at_least ("2.1.12");
+#else
+  return FALSE;
+#endif
+}
+
+
+/* Return a description of the error ERR for the batch summary.  */
+static const char *
+batch_error_string (gpg_error_t err)
+{
+  switch (gpg_err_code (err))
+    {
+    case GPG_ERR_UNUSABLE_PUBKEY:
+      return _("This key has expired! Unable to sign.");
+    case GPG_ERR_CONFLICT:
+      return _("This key has already been signed with your own!");
+    default:
+      return gpg_strerror (err);
+    }
+}
+
+
+/* Start signing KEY with worker W.  */
+static gpg_error_t
+batch_worker_start (struct sign_worker_s *w, gpgme_key_t key)
+{
+  GpaKeySignOperation *op = w->op;
+  gpg_error_t err;
+
+  w->key = key;
+#if GPGME_VERSION_NUMBER >= 0x010700  /* GPGME >= 1.7.0 */
+  if (op->use_keysign)
+    {
+      unsigned int flags = 0;
+
+      if (op->sign_locally)
+        flags |= GPGME_KEYSIGN_LOCAL;
+      if (!op->expires)
+        flags |= GPGME_KEYSIGN_NOEXPIRE;
+      gpgme_set_protocol (w->ctx->ctx, GPGME_PROTOCOL_OpenPGP);
+      gpgme_signers_clear (w->ctx->ctx);
+      err = gpgme_signers_add (w->ctx->ctx, op->signer_key);
+      if (!err)
+        err = gpgme_op_keysign_start (w->ctx->ctx, key, NULL,
+                                      op->expires, flags);
+      return err;
+    }
+#endif
+  err = gpa_gpgme_edit_sign_start (w->ctx, key, op->signer_key,
+                                   op->sign_locally);
+  return err;
+}
+
+
+/* Record the outcome ERR for KEY.  */
+static void
+batch_record (GpaKeySignOperation *op, gpgme_key_t key, gpg_error_t err)
+{
+  op->done++;
+  switch (gpg_err_code (err))
+    {
+    case GPG_ERR_NO_ERROR:
+      op->signed_keys++;
+      op->unlocked = TRUE;
+      g_ptr_array_add (op->signed_fprs, key->subkeys->fpr);
+      break;
+    case GPG_ERR_CANCELED:
+    case GPG_ERR_BAD_PASSPHRASE:
+    case GPG_ERR_NO_SECKEY:
+      /* All other keys would fail the same way.  */
+      op->aborted = TRUE;
+      if (!op->err)
+        op->err = err;
+      break;
+    default:
+      {
+        gchar *uid = gpa_gpgme_key_get_userid (key->uids);
+
+        g_string_append_printf (op->failures, "\n%s: %s",
+                                uid, batch_error_string (err));
+        g_free (uid);
+      }
+      break;
+    }
+
+  if (op->progress_dialog)
+    gpa_progress_bar_set_fraction
+      (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar,
+       (gdouble) op->done / op->total);
+}
+
+
+/* All keys have been processed.  */
+static void
+batch_finish (GpaKeySignOperation *op)
+{
+  gchar *message;
+
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+
+  if (op->signed_fprs->len)
+    {
+      g_ptr_array_add (op->signed_fprs, NULL);
+      g_signal_emit_by_name (GPA_OPERATION (op), "changed_keys",
+                             op->signed_fprs->pdata);
+    }
+
+  if (gpg_err_code (op->err) == GPG_ERR_BAD_PASSPHRASE)
+    gpa_window_error (_("Wrong passphrase!"), GPA_OPERATION (op)->window);
+  else if (gpg_err_code (op->err) == GPG_ERR_NO_SECKEY)
+    gpa_window_error (_("You haven't selected a default key "
+                        "to sign with!"), GPA_OPERATION (op)->window);
+
+  if (op->failures->len)
+    {
+      message = g_strdup_printf (_("%u of %u keys have been signed."
+                                   "  These keys could not be signed:%s"),
+                                 op->signed_keys, op->total,
+                                 op->failures->str);
+      gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_free (message);
+    }
+  else if (op->signed_keys)
+    {
+      message = g_strdup_printf (ngettext ("%u key has been signed.",
+                                           "%u keys have been signed.",
+                                           op->signed_keys),
+                                 op->signed_keys);
+      gpa_window_message (message, GPA_OPERATION (op)->window);
+      g_free (message);
+    }
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+}
+
+
+/* Start as many pending keys as allowed.  Until the first key has
+   been signed only one key is signed at a time so that the passphrase
+   is asked only once.  */
+static gboolean
+batch_schedule_cb (gpointer data)
+{
+  GpaKeySignOperation *op = data;
+  int limit = op->unlocked? op->nworkers : 1;
+  int i;
+
+  op->idle_id = 0;
+  for (i = 0; (i < op->nworkers && op->running < limit
+               && op->pending && !op->aborted); i++)
+    {
+      struct sign_worker_s *w = &op->workers[i];
+      gpgme_key_t key;
+      gpg_error_t err;
+
+      if (w->key)
+        continue;
+      key = op->pending->data;
+      op->pending = g_list_delete_link (op->pending, op->pending);
+      err = batch_worker_start (w, key);
+      if (err)
+        {
+          w->key = NULL;
+          batch_record (op, key, err);
+          continue;
+        }
+      op->running++;
+    }
+  if (op->aborted)
+    {
+      g_list_free (op->pending);
+      op->pending = NULL;
+    }
+  if (!op->running && !op->pending)
+    batch_finish (op);
+
+  return FALSE;
+}
+
+
+static void
+batch_worker_done_cb (GpaContext *context, gpg_error_t err,
+                      struct sign_worker_s *w)
+{
+  GpaKeySignOperation *op = w->op;
+
+  batch_record (op, w->key, err);
+  w->key = NULL;
+  op->running--;
+
+  /* Do not start the next key from within the done handler.  */
+  if (!op->idle_id)
+    op->idle_id = g_idle_add (batch_schedule_cb, op);
+}
+
+
+/* Sign the OpenPGP keys in KEYS in batch mode.  Returns FALSE if the
+   user canceled.  */
+static gboolean
+batch_start (GpaKeySignOperation *op, GList *keys)
+{
+  int expire_days = 0;
+  int i;
+
+  op->use_keysign = have_keysign ();
+  if (! gpa_key_sign_run_batch_dialog (GPA_OPERATION (op)->window, keys,
+                                       op->use_keysign, &op->sign_locally,
+                                       &expire_days))
+    return FALSE;
+  op->expires = (unsigned long) expire_days * 86400;
+
+  op->pending = keys;
+  op->total = g_list_length (keys);
+  op->signed_fprs = g_ptr_array_new ();
+  op->failures = g_string_new (NULL);
+  /* The passphrase callback used with the edit interface of old GnuPG
+     versions can't be shared between several contexts.  */
+  op->nworkers = op->use_keysign? SIGN_WORKERS : 1;
+  op->workers = g_malloc0_n (op->nworkers, sizeof *op->workers);
+  for (i = 0; i < op->nworkers; i++)
+    {
+      struct sign_worker_s *w = &op->workers[i];
+
+      w->op = op;
+      w->ctx = gpa_context_new ();
+      g_signal_connect (G_OBJECT (w->ctx), "done",
+                        G_CALLBACK (batch_worker_done_cb), w);
+    }
+
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 op->workers[0].ctx);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                        _("Signing Keys..."));
+  gtk_widget_show_all (op->progress_dialog);
+
+  batch_schedule_cb (op);
+  return TRUE;
+}
+
+
 static gboolean
 gpa_key_sign_operation_idle_cb (gpointer data)
 {
@@ -198,6 +492,28 @@ gpa_key_sign_operation_idle_cb (gpointer data)
     }
   gpgme_key_ref (op->signer_key);
 
+  if (g_list_length (GPA_KEY_OPERATION (op)->keys) > 1)
+    {
+      GList *keys = NULL;
+      GList *item;
+
+      for (item = GPA_KEY_OPERATION (op)->keys; item;
+           item = g_list_next (item))
+        if (((gpgme_key_t) item->data)->protocol == GPGME_PROTOCOL_OpenPGP)
+          keys = g_list_append (keys, item->data);
+      if (g_list_length (keys) > 1)
+        {
+          if (! batch_start (op, keys))
+            {
+              g_list_free (keys);
+              g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                                     gpg_error (GPG_ERR_CANCELED));
+            }
+          return FALSE;
+        }
+      g_list_free (keys);
+    }
+
   err = gpa_key_sign_operation_start (op);
   if (err)
     g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
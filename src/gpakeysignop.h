@@ -42,6 +42,24 @@ struct _GpaKeySignOperation {
 
   gpgme_key_t signer_key;
   int signed_keys;
+
+  /* State of the batch mode used for several keys.  */
+  gboolean use_keysign;
+  gboolean sign_locally;
+  unsigned long expires;
+  GList *pending;
+  guint total;
+  guint done;
+  gboolean unlocked;
+  gboolean aborted;
+  gpg_error_t err;
+  struct sign_worker_s *workers;
+  int nworkers;
+  int running;
+  guint idle_id;
+  GPtrArray *signed_fprs;
+  GString *failures;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaKeySignOperationClass {
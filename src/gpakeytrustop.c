@@ -35,6 +35,7 @@
 #include "ownertrustdlg.h"
 #include "gpgmeedit.h"
 #include "gtktools.h"
+#include "gpaprogressdlg.h"
 
 /* Internal functions */
 static gboolean gpa_key_trust_operation_idle_cb (gpointer data);
@@ -52,6 +53,15 @@ static GObjectClass *parent_class = NULL;
 static void
 gpa_key_trust_operation_finalize (GObject *object)
 {
+  GpaKeyTrustOperation *op = GPA_KEY_TRUST_OPERATION (object);
+
+  if (op->idle_id)
+    g_source_remove (op->idle_id);
+  if (op->fprs)
+    g_ptr_array_free (op->fprs, TRUE);
+  gpgme_data_release (op->records);
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -60,6 +70,11 @@ static void
 gpa_key_trust_operation_init (GpaKeyTrustOperation *op)
 {
   op->modified_keys = 0;
+  op->fprs = NULL;
+  op->records = NULL;
+  op->bulk_step = 0;
+  op->idle_id = 0;
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -170,13 +185,171 @@ gpa_key_trust_operation_start (GpaKeyTrustOperation *op)
 }
 
 
+/* Bulk mode.  The owner trust is asked once for all keys and written
+   as an ownertrust record set which gpg imports in one go.  The trust
+   database is then checked once.  Because the owner trust affects the
+   validity of other keys, the whole key list is reloaded.  */
+
+/* Return the value used by --import-ownertrust for TRUST.  */
+static int
+ownertrust_level (gpgme_validity_t trust)
+{
+  switch (trust)
+    {
+    case GPGME_VALIDITY_NEVER:
+      return 3;
+    case GPGME_VALIDITY_MARGINAL:
+      return 4;
+    case GPGME_VALIDITY_FULL:
+      return 5;
+    case GPGME_VALIDITY_ULTIMATE:
+      return 6;
+    default:
+      /* "I don't know or won't say".  */
+      return 2;
+    }
+}
+
+
+/* The ownertrust flag marking a disabled key.  */
+#define OWNERTRUST_FLAG_DISABLED 32
+
+
+/* Return the ownertrust value of KEY with the trust level TRUST as
+   used by --import-ownertrust.  The record replaces the whole value;
+   thus the disabled flag of the key is kept.  */
+static int
+ownertrust_value (gpgme_key_t key, gpgme_validity_t trust)
+{
+  return (ownertrust_level (trust)
+          | (key->disabled ? OWNERTRUST_FLAG_DISABLED : 0));
+}
+
+
+/* All steps are done.  ERR is the error of the import.  */
+static void
+bulk_finish (GpaKeyTrustOperation *op, gpg_error_t err)
+{
+  if (op->progress_dialog)
+    gtk_widget_hide (op->progress_dialog);
+
+  if (!err)
+    g_signal_emit_by_name (GPA_OPERATION (op), "changed_wot");
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+static gboolean
+bulk_check_trustdb_cb (gpointer data)
+{
+  GpaKeyTrustOperation *op = data;
+  gpg_error_t err;
+
+  op->idle_id = 0;
+  err = gpa_check_trustdb_start (GPA_OPERATION (op)->context->ctx);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      bulk_finish (op, 0);
+    }
+  return FALSE;
+}
+
+
+/* A step is done.  */
+static void
+bulk_done (GpaKeyTrustOperation *op, gpg_error_t err)
+{
+  if (op->bulk_step == 0 && !err)
+    {
+      op->bulk_step = 1;
+      if (op->progress_dialog)
+        gpa_progress_bar_set_fraction
+          (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar, 0.5);
+      /* Do not start the check from within the done handler.  */
+      op->idle_id = g_idle_add (bulk_check_trustdb_cb, op);
+      return;
+    }
+
+  /* A failed check of the trust database does not undo the import.  */
+  bulk_finish (op, op->bulk_step? 0 : err);
+}
+
+
+/* Set the owner trust of all OpenPGP keys of OP after asking only
+   once.  */
+static gpg_error_t
+bulk_start (GpaKeyTrustOperation *op)
+{
+  GList *keys = NULL;
+  GList *item;
+  GString *records;
+  gpgme_validity_t trust;
+  gpg_error_t err;
+
+  for (item = GPA_KEY_OPERATION (op)->keys; item; item = g_list_next (item))
+    if (((gpgme_key_t) item->data)->protocol == GPGME_PROTOCOL_OpenPGP)
+      keys = g_list_append (keys, item->data);
+
+  if (! gpa_ownertrust_run_dialog_multiple (keys, GPA_OPERATION (op)->window,
+                                            &trust))
+    {
+      g_list_free (keys);
+      return gpg_error (GPG_ERR_CANCELED);
+    }
+
+  /* Keys which already have this owner trust are left alone.  */
+  records = g_string_new (NULL);
+  op->fprs = g_ptr_array_new ();
+  for (item = keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      if (ownertrust_value (key, key->owner_trust)
+          == ownertrust_value (key, trust))
+        continue;
+      g_string_append_printf (records, "%s:%d:\n", key->subkeys->fpr,
+                              ownertrust_value (key, trust));
+      g_ptr_array_add (op->fprs, key->subkeys->fpr);
+    }
+  g_list_free (keys);
+  if (!op->fprs->len)
+    {
+      g_string_free (records, TRUE);
+      return gpg_error (GPG_ERR_CANCELED);
+    }
+
+  err = gpgme_data_new_from_mem (&op->records, records->str,
+                                 records->len, 1);
+  g_string_free (records, TRUE);
+  if (!err)
+    err = gpa_import_ownertrust_start (GPA_OPERATION (op)->context->ctx,
+                                       op->records);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      return err;
+    }
+
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 GPA_OPERATION (op)->context);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                        _("Setting Owner Trust..."));
+  gtk_widget_show_all (op->progress_dialog);
+  return 0;
+}
+
+
 static gboolean
 gpa_key_trust_operation_idle_cb (gpointer data)
 {
   GpaKeyTrustOperation *op = data;
   gpg_error_t err;
 
-  err = gpa_key_trust_operation_start (op);
+  if (g_list_length (GPA_KEY_OPERATION (op)->keys) > 1)
+    err = bulk_start (op);
+  else
+    err = gpa_key_trust_operation_start (op);
   if (err)
     g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
 
@@ -223,6 +396,11 @@ static void gpa_key_trust_operation_done_cb (GpaContext *context,
 					      gpg_error_t err,
 					      GpaKeyTrustOperation *op)
 {
+  if (op->fprs)
+    {
+      bulk_done (op, err);
+      return;
+    }
   GPA_KEY_OPERATION (op)->current = g_list_next
     (GPA_KEY_OPERATION (op)->current);
   gpa_key_trust_operation_next (op);
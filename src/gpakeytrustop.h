@@ -41,6 +41,13 @@ struct _GpaKeyTrustOperation {
   GpaKeyOperation parent;
 
   int modified_keys;
+
+  /* State of the bulk mode used for several keys.  */
+  GPtrArray *fprs;
+  gpgme_data_t records;
+  int bulk_step;
+  guint idle_id;
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaKeyTrustOperationClass {
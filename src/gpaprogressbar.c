@@ -175,7 +175,9 @@ gpa_progress_bar_new_with_context (GpaContext *context)
 static void
 progress_cb (GpaContext *context, int current, int total, GpaProgressBar *pbar)
 {
-  if (total > 0) 
+  if (pbar->external)
+    ;
+  else if (total > 0) 
     gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (pbar),
 				   (gdouble) current / (gdouble) total);
   else
@@ -231,3 +233,17 @@ gpa_progress_bar_set_context (GpaProgressBar *pbar, GpaContext *context)
 						G_CALLBACK (progress_cb), pbar);
     }
 }
+
+
+void
+gpa_progress_bar_set_fraction (GpaProgressBar *pbar, gdouble fraction)
+{
+  g_return_if_fail (GTK_IS_PROGRESS_BAR (pbar));
+
+  pbar->external = TRUE;
+  if (fraction < 0.0)
+    fraction = 0.0;
+  else if (fraction > 1.0)
+    fraction = 1.0;
+  gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (pbar), fraction);
+}
@@ -54,6 +54,9 @@ struct _GpaProgressBar
   gulong sig_id_progress;
   gulong sig_id_start;
   gulong sig_id_done;
+  /* If set, the fraction is set by the owner and not by the
+     progress status of the context.  */
+  gboolean external;
 };
 
 
@@ -80,4 +83,8 @@ GpaContext *gpa_progress_bar_get_context (GpaProgressBar *pbar);
 /* Get the context.  */
 void gpa_progress_bar_set_context (GpaProgressBar *pbar, GpaContext *context);
 
+/* Set the fraction from outside.  Once called, the progress status
+   of the context is ignored.  */
+void gpa_progress_bar_set_fraction (GpaProgressBar *pbar, gdouble fraction);
+
 #endif
@@ -133,6 +133,11 @@ gpa_progress_dialog_init (GpaProgressDialog *dialog)
   dialog->pbar = GPA_PROGRESS_BAR (gpa_progress_bar_new ());
   gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox),
 			       GTK_WIDGET (dialog->pbar));
+  dialog->stats = gtk_label_new (NULL);
+  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox),
+			       dialog->stats);
+  /* Only shown once byte counts are known.  */
+  gtk_widget_set_no_show_all (dialog->stats, TRUE);
   /* Set up the dialog.  */
   gtk_dialog_add_button (GTK_DIALOG (dialog),
 			 _("_Cancel"),
@@ -197,3 +202,59 @@ gpa_progress_dialog_set_label (GpaProgressDialog *dialog, const gchar *label)
 {
   gtk_label_set_text (GTK_LABEL (dialog->label), label);
 }
+
+
+/* Percentage of DONE in TOTAL.  */
+static int
+percent_of (guint64 done, guint64 total)
+{
+  if (!total || done >= total)
+    return 100;
+  return (int) ((done * 100) / total);
+}
+
+
+/* Show the byte based progress of a file operation.  */
+void
+gpa_progress_dialog_set_bytes (GpaProgressDialog *dialog,
+                               guint64 file_done, guint64 file_size,
+                               guint64 done, guint64 total, gdouble elapsed)
+{
+  gchar *text;
+  gchar *eta;
+  gdouble rate;
+
+  if (done > total)
+    total = done;
+
+  gpa_progress_bar_set_fraction (dialog->pbar,
+                                 total ? (gdouble) done / total : 1.0);
+
+  /* Don't guess a rate from the first few milliseconds.  */
+  rate = elapsed > 0.5 ? done / elapsed : 0.0;
+  if (rate > 0.0 && done < total)
+    {
+      unsigned long secs = (unsigned long) ((total - done) / rate);
+
+      if (secs >= 3600)
+        eta = g_strdup_printf (_("%lu:%02lu:%02lu remaining"),
+                               secs / 3600, (secs / 60) % 60, secs % 60);
+      else
+        eta = g_strdup_printf (_("%lu:%02lu remaining"),
+                               secs / 60, secs % 60);
+    }
+  else
+    eta = g_strdup ("");
+
+  text = g_strdup_printf (_("File: %d%%  Total: %d%% (%.1f of %.1f MB)\n"
+                            "%.1f MB/s  %s"),
+                          percent_of (file_done, file_size),
+                          percent_of (done, total),
+                          done / (1024.0 * 1024.0),
+                          total / (1024.0 * 1024.0),
+                          rate / (1024.0 * 1024.0), eta);
+  gtk_label_set_text (GTK_LABEL (dialog->stats), text);
+  gtk_widget_show (dialog->stats);
+  g_free (text);
+  g_free (eta);
+}
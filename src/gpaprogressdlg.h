@@ -55,6 +55,7 @@ struct _GpaProgressDialog
   GpaContext *context;
   GpaProgressBar *pbar;
   GtkWidget *label;
+  GtkWidget *stats;
   guint timer;
 };
 
@@ -77,4 +78,12 @@ GtkWidget *gpa_progress_dialog_new (GtkWidget *parent, GpaContext *context);
 void gpa_progress_dialog_set_label (GpaProgressDialog *dialog,
 				    const gchar *label);
 
+/* Show the byte based progress: FILE_DONE of FILE_SIZE bytes of the
+   current file, DONE of TOTAL bytes of all files, and ELAPSED seconds
+   since the operation started.  */
+void gpa_progress_dialog_set_bytes (GpaProgressDialog *dialog,
+                                    guint64 file_done, guint64 file_size,
+                                    guint64 done, guint64 total,
+                                    gdouble elapsed);
+
 #endif
@@ -70,13 +70,26 @@ typedef int (*edit_transit_t) (int current_state, status_type_t status,
 enum
   {
     EXPIRE_START,
+    EXPIRE_SELECT,
     EXPIRE_COMMAND,
     EXPIRE_DATE,
+    EXPIRE_CONFIRM,
     EXPIRE_QUIT,
     EXPIRE_SAVE,
     EXPIRE_ERROR
   };
 
+/* Parameter for the expire command.  */
+struct expire_parms_s
+{
+  gchar date[12];
+  /* Zero terminated list of the subkeys to select or NULL to change
+     the primary key.  */
+  int *subkeys;
+  int idx;
+  gchar select[16];
+};
+
 
 /* States for the edit trust command.  */
 enum
@@ -359,17 +372,27 @@ edit_fnc (void *opaque, status_type_t status,
 static gpg_error_t
 edit_expire_fnc_action (int state, void *opaque, char **result)
 {
-  char *date = opaque;
+  struct expire_parms_s *parms = opaque;
 
   switch (state)
     {
+      /* Select the next subkey */
+    case EXPIRE_SELECT:
+      g_snprintf (parms->select, sizeof parms->select,
+                  "key %d", parms->subkeys[parms->idx]);
+      *result = parms->select;
+      break;
       /* Start the operation */
     case EXPIRE_COMMAND:
       *result = "expire";
       break;
       /* Send the new expire date */
     case EXPIRE_DATE:
-      *result = date;
+      *result = parms->date;
+      break;
+      /* Change several subkeys at once */
+    case EXPIRE_CONFIRM:
+      *result = "Y";
       break;
       /* End the operation */
     case EXPIRE_QUIT:
@@ -395,6 +418,7 @@ static int
 edit_expire_fnc_transit (int current_state, status_type_t status,
 			 const char *args, void *opaque, gpg_error_t *err)
 {
+  struct expire_parms_s *parms = opaque;
   int next_state;
 
   switch (current_state)
@@ -402,7 +426,25 @@ edit_expire_fnc_transit (int current_state, status_type_t status,
     case EXPIRE_START:
       if (CMP_STATUS (GET_LINE) && g_str_equal (args, "keyedit.prompt"))
         {
-          next_state = EXPIRE_COMMAND;
+          if (parms->subkeys && parms->subkeys[0])
+            next_state = EXPIRE_SELECT;
+          else
+            next_state = EXPIRE_COMMAND;
+        }
+      else
+        {
+          next_state = EXPIRE_ERROR;
+          *err = gpg_error (GPG_ERR_GENERAL);
+        }
+      break;
+    case EXPIRE_SELECT:
+      if (CMP_STATUS (GET_LINE) && g_str_equal (args, "keyedit.prompt"))
+        {
+          parms->idx++;
+          if (parms->subkeys[parms->idx])
+            next_state = EXPIRE_SELECT;
+          else
+            next_state = EXPIRE_COMMAND;
         }
       else
         {
@@ -415,6 +457,12 @@ edit_expire_fnc_transit (int current_state, status_type_t status,
         {
           next_state = EXPIRE_DATE;
         }
+      else if (CMP_STATUS (GET_BOOL)
+               && g_str_equal (args,
+                               "keyedit.expire_multiple_subkeys.okay"))
+        {
+          next_state = EXPIRE_CONFIRM;
+        }
       else
         {
           next_state = EXPIRE_ERROR;
@@ -437,6 +485,17 @@ edit_expire_fnc_transit (int current_state, status_type_t status,
           *err =  gpg_error (GPG_ERR_GENERAL);
         }
       break;
+    case EXPIRE_CONFIRM:
+      if (CMP_STATUS (GET_LINE) && g_str_equal (args, "keygen.valid"))
+        {
+          next_state = EXPIRE_DATE;
+        }
+      else
+        {
+          next_state = EXPIRE_ERROR;
+          *err = gpg_error (GPG_ERR_GENERAL);
+        }
+      break;
     case EXPIRE_QUIT:
       if (CMP_STATUS (GET_BOOL) && g_str_equal (args, "keyedit.save.okay"))
         {
@@ -989,13 +1048,16 @@ static void
 gpa_gpgme_edit_expire_parms_release (GpaContext *ctx, gpg_error_t err,
 				     struct edit_parms_s* parms)
 {
+  struct expire_parms_s *expire_parms = parms->opaque;
+
   gpgme_data_release (parms->out);
   if (parms->signal_id != 0)
     {
       /* Don't run this signal handler again if the context is reused */
       g_signal_handler_disconnect (ctx, parms->signal_id);
     }
-  g_free (parms->opaque);
+  g_free (expire_parms->subkeys);
+  g_free (expire_parms);
   g_free (parms);
 }
 
@@ -1003,26 +1065,37 @@ gpa_gpgme_edit_expire_parms_release (GpaContext *ctx, gpg_error_t err,
 /* Generate the edit parameters needed for changing the expiry date.  */
 static struct edit_parms_s*
 gpa_gpgme_edit_expire_parms_new (GpaContext *ctx, GDate *date,
-				 gpgme_data_t out)
+				 const int *subkeys, gpgme_data_t out)
 {
   struct edit_parms_s *edit_parms = g_malloc0 (sizeof (struct edit_parms_s));
-  int buf_len = 12;
-  gchar *buf = g_malloc (buf_len);
+  struct expire_parms_s *expire_parms;
 
+  expire_parms = g_malloc0 (sizeof (struct expire_parms_s));
   edit_parms->state = EXPIRE_START;
   edit_parms->action = edit_expire_fnc_action;
   edit_parms->transit = edit_expire_fnc_transit;
   edit_parms->out = out;
-  edit_parms->opaque = buf;
+  edit_parms->opaque = expire_parms;
 
   /* The new expiration date */
   if (date)
     {
-      g_date_strftime (buf, buf_len, "%Y-%m-%d", date);
+      g_date_strftime (expire_parms->date, sizeof expire_parms->date,
+                       "%Y-%m-%d", date);
     }
   else
     {
-      strncpy (buf, "0", buf_len);
+      strncpy (expire_parms->date, "0", sizeof expire_parms->date);
+    }
+
+  /* The subkeys to change */
+  if (subkeys)
+    {
+      int n;
+
+      for (n = 0; subkeys[n]; n++)
+        ;
+      expire_parms->subkeys = g_memdup (subkeys, (n + 1) * sizeof (int));
     }
 
   /* Make sure the cleanup is run when the edit completes */
@@ -1038,6 +1111,16 @@ gpa_gpgme_edit_expire_parms_new (GpaContext *ctx, GDate *date,
 /* Change the expire date of a key.  */
 gpg_error_t
 gpa_gpgme_edit_expire_start (GpaContext *ctx, gpgme_key_t key, GDate *date)
+{
+  return gpa_gpgme_edit_expire_subkeys_start (ctx, key, NULL, date);
+}
+
+
+/* Change the expire date of the subkeys of KEY with the indices in
+   the zero terminated list SUBKEYS.  */
+gpg_error_t
+gpa_gpgme_edit_expire_subkeys_start (GpaContext *ctx, gpgme_key_t key,
+                                     const int *subkeys, GDate *date)
 {
   struct edit_parms_s *parms;
   gpg_error_t err;
@@ -1049,7 +1132,7 @@ gpa_gpgme_edit_expire_start (GpaContext *ctx, gpgme_key_t key, GDate *date)
       return err;
     }
 
-  parms = gpa_gpgme_edit_expire_parms_new (ctx, date, out);
+  parms = gpa_gpgme_edit_expire_parms_new (ctx, date, subkeys, out);
 #if USE_GPGME_INTERACT
   err = gpgme_op_interact_start (ctx->ctx, key, 0, edit_fnc, parms, out);
 #else
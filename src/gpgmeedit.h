@@ -37,6 +37,13 @@ gpg_error_t gpa_gpgme_edit_trust_start (GpaContext *ctx, gpgme_key_t key,
 gpg_error_t gpa_gpgme_edit_expire_start (GpaContext *ctx, gpgme_key_t key, 
 					 GDate *date);
 
+/* Change the expiry date of the subkeys with the indices (starting
+ * at 1) in the zero terminated list SUBKEYS. */
+gpg_error_t gpa_gpgme_edit_expire_subkeys_start (GpaContext *ctx,
+                                                 gpgme_key_t key,
+                                                 const int *subkeys,
+                                                 GDate *date);
+
 /* Sign this key with the given private key. If local is true, make a local
  * signature. */
 gpg_error_t gpa_gpgme_edit_sign_start (GpaContext *ctx, gpgme_key_t key,
@@ -279,8 +279,61 @@ gpa_open_output (const char *filename, gpgme_data_t *data, GtkWidget *parent,
 }
 
 
+/* The state of a data object created by gpa_open_input_counted.  */
+struct counted_input_s
+{
+  int fd;
+  guint64 *counter;
+};
+
+
+static ssize_t
+counted_input_read (void *opaque, void *buffer, size_t size)
+{
+  struct counted_input_s *parm = opaque;
+  ssize_t nread;
+
+  do
+    nread = read (parm->fd, buffer, size);
+  while (nread == -1 && errno == EINTR);
+  if (nread > 0)
+    *parm->counter += nread;
+  return nread;
+}
+
+
+static off_t
+counted_input_seek (void *opaque, off_t offset, int whence)
+{
+  struct counted_input_s *parm = opaque;
+
+  return lseek (parm->fd, offset, whence);
+}
+
+
+static void
+counted_input_release (void *opaque)
+{
+  g_free (opaque);
+}
+
+
+static struct gpgme_data_cbs counted_input_cbs =
+  {
+    counted_input_read,
+    NULL,
+    counted_input_seek,
+    counted_input_release
+  };
+
+
+/* Like gpa_open_input but add the number of bytes gpgme reads from
+   the file to *COUNTER.  COUNTER must stay valid until the data
+   object has been released.  If COUNTER is NULL this is identical to
+   gpa_open_input.  */
 int
-gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
+gpa_open_input_counted (const char *filename, gpgme_data_t *data,
+                        GtkWidget *parent, guint64 *counter)
 {
   gpg_error_t err;
   int target = -1;
@@ -292,8 +345,21 @@ gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
       message = g_strdup_printf ("%s: %s", filename, strerror(errno));
       gpa_window_error (message, parent);
       g_free (message);
+      return -1;
     }
-  err = gpgme_data_new_from_fd (data, target);
+  if (counter)
+    {
+      struct counted_input_s *parm;
+
+      parm = g_malloc (sizeof *parm);
+      parm->fd = target;
+      parm->counter = counter;
+      err = gpgme_data_new_from_cbs (data, &counted_input_cbs, parm);
+      if (err)
+        g_free (parm);
+    }
+  else
+    err = gpgme_data_new_from_fd (data, target);
   if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
     {
       close (target);
@@ -304,6 +370,13 @@ gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
 }
 
 
+int
+gpa_open_input (const char *filename, gpgme_data_t *data, GtkWidget *parent)
+{
+  return gpa_open_input_counted (filename, data, parent, NULL);
+}
+
+
 /* Do a gpgme_data_new_from_file and report any GPGME_File_Error to
    the user.  */
 gpg_error_t
@@ -554,120 +627,149 @@ get_gpg_connect_agent_path (void)
 }
 
 
-/* Backup a key. It exports both the public and secret keys to a file.
-   IS_X509 tells the function that the fingerprint is from an X.509
-   key.  Returns TRUE on success and FALSE on error. It displays
-   errors to the user.  */
-gboolean
-gpa_backup_key (const gchar *fpr, const char *filename, int is_x509)
+/* Start exporting the keys with the fingerprints FPRS to DEST.
+   PROTOCOL selects the engine.  If SECRET is not set, the public keys
+   are exported.  Otherwise, for OpenPGP all these secret keys are
+   exported by one invocation of gpg.  gpgsm can only export a single secret
+   key in PKCS#12 format; thus for CMS only the first fingerprint is
+   used.  The output is armored.  CTX is switched to the spawn
+   protocol.  */
+gpg_error_t
+gpa_backup_keys_start (gpgme_ctx_t ctx, gpgme_protocol_t protocol,
+                       const char **fprs, int secret, gpgme_data_t dest)
 {
-  const char *header_argv[] =
-    {
-      "", "--batch", "--no-tty", "--fingerprint",
-      (char*) fpr, NULL
-    };
-  const char *pub_argv[] =
-    {
-      "", "--batch", "--no-tty", "--armor", "--export",
-      (char*) fpr, NULL
-    };
-  const char *sec_argv[] =
-    {
-      "", "--batch", "--no-tty", "--armor", "--export-secret-key",
-      (char*) fpr, NULL
-    };
-  const char *seccms_argv[] =
-    {
-      "", "--batch", "--no-tty", "--armor", "--export-secret-key-p12",
-      (char*) fpr, NULL
-    };
-  gpg_error_t err;
-  FILE *fp;
-  gpgme_data_t dfp = NULL;
   const char *pgm;
-  gpgme_ctx_t ctx = NULL;
-  int result = FALSE;
+  const char **argv;
+  int argc, i;
+  gpg_error_t err;
 
-  /* Get the gpg path.  */
-  if (is_x509)
+  if (protocol == GPGME_PROTOCOL_CMS)
     pgm = get_gpgsm_path ();
   else
     pgm = get_gpg_path ();
-  g_return_val_if_fail (pgm && *pgm, FALSE);
+  if (!pgm || !*pgm || !fprs || !fprs[0])
+    return gpg_error (GPG_ERR_INV_ARG);
 
-  /* Open the file */
-  {
-    mode_t mask = umask (0077);
-    fp = g_fopen (filename, "w");
-    umask (mask);
-  }
-  if (!fp)
+  for (argc = 0; fprs[argc]; argc++)
+    ;
+  argv = g_malloc0 ((argc + 6) * sizeof *argv);
+  i = 0;
+  argv[i++] = "";
+  argv[i++] = "--batch";
+  argv[i++] = "--no-tty";
+  argv[i++] = "--armor";
+  if (secret && protocol == GPGME_PROTOCOL_CMS)
+    {
+      argv[i++] = "--export-secret-key-p12";
+      argv[i++] = fprs[0];
+    }
+  else
     {
-      gchar message[256];
-      g_snprintf (message, sizeof(message), "%s: %s",
-		  filename, strerror(errno));
-      gpa_window_error (message, NULL);
-      return FALSE;
+      argv[i++] = secret? "--export-secret-keys" : "--export";
+      for (argc = 0; fprs[argc]; argc++)
+        argv[i++] = fprs[argc];
     }
+  argv[i] = NULL;
 
-  fputs (_(
-    "************************************************************************\n"
-    "* WARNING: This file is a backup of your secret key. Please keep it in *\n"
-    "* a safe place.                                                        *\n"
-    "************************************************************************\n"
-    "\n"), fp);
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  err = gpgme_op_spawn_start (ctx, pgm, argv, NULL, dest, NULL,
+                              GPGME_SPAWN_DETACHED|GPGME_SPAWN_ALLOW_SET_FG);
+  g_free (argv);
+  return err;
+}
 
-  fputs (_("The key backed up in this file is:\n\n"), fp);
-  fflush (fp);
 
-  err = gpgme_data_new_from_stream (&dfp, fp);
-  if (err)
-    {
-      g_message ("error creating data object '%s': %s",
-                 filename, gpg_strerror (err));
-      goto leave;
-    }
+/* Start deleting the keys with the fingerprints FPRS by one
+   invocation of the engine for PROTOCOL.  If WITH_SECRET is set, the
+   keys have a secret part which is deleted too.  CTX is switched to
+   the spawn protocol.  */
+gpg_error_t
+gpa_delete_keys_start (gpgme_ctx_t ctx, gpgme_protocol_t protocol,
+                       gboolean with_secret, const char **fprs)
+{
+  const char *pgm;
+  const char **argv;
+  int argc, i;
+  gpg_error_t err;
+
+  if (protocol == GPGME_PROTOCOL_CMS)
+    pgm = get_gpgsm_path ();
+  else
+    pgm = get_gpg_path ();
+  if (!pgm || !*pgm || !fprs || !fprs[0])
+    return gpg_error (GPG_ERR_INV_ARG);
+
+  for (argc = 0; fprs[argc]; argc++)
+    ;
+  argv = g_malloc0 ((argc + 5) * sizeof *argv);
+  i = 0;
+  argv[i++] = "";
+  argv[i++] = "--batch";
+  argv[i++] = "--yes";
+  /* gpgsm has no secret keyring; the private keys are kept by the
+     agent.  */
+  if (with_secret && protocol != GPGME_PROTOCOL_CMS)
+    argv[i++] = "--delete-secret-and-public-keys";
+  else
+    argv[i++] = "--delete-keys";
+  for (argc = 0; fprs[argc]; argc++)
+    argv[i++] = fprs[argc];
+  argv[i] = NULL;
 
-  ctx = gpa_gpgme_new ();
   gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  err = gpgme_op_spawn_start (ctx, pgm, argv, NULL, NULL, NULL,
+                              GPGME_SPAWN_ALLOW_SET_FG);
+  g_free (argv);
+  return err;
+}
 
-  err = gpgme_op_spawn (ctx, pgm, header_argv, NULL, dfp, NULL,
-                        GPGME_SPAWN_DETACHED|GPGME_SPAWN_ALLOW_SET_FG);
-  if (err)
-    {
-      g_message ("error running '%s' (1): %s", pgm, gpg_strerror (err));
-      goto leave;
-    }
-  gpgme_data_write (dfp, "\n", 1);
 
-  err = gpgme_op_spawn (ctx, pgm, pub_argv, NULL, dfp, NULL,
-                        GPGME_SPAWN_DETACHED|GPGME_SPAWN_ALLOW_SET_FG);
-  if (err)
-    {
-      g_message ("error running '%s' (2): %s", pgm, gpg_strerror (err));
-      goto leave;
-    }
-  gpgme_data_write (dfp, "\n", 1);
+/* Start setting the owner trust with one invocation of gpg.  RECORDS
+   holds lines of the form "FPR:LEVEL:" as written by
+   --export-ownertrust.  CTX is switched to the spawn protocol.  */
+gpg_error_t
+gpa_import_ownertrust_start (gpgme_ctx_t ctx, gpgme_data_t records)
+{
+  const char *pgm;
+  const char *argv[4];
 
-  err = gpgme_op_spawn (ctx, pgm, is_x509? seccms_argv : sec_argv,
-                        NULL, dfp, NULL,
-                        GPGME_SPAWN_DETACHED|GPGME_SPAWN_ALLOW_SET_FG);
-  if (err)
-    {
-      g_message ("error running '%s' (3): %s", pgm, gpg_strerror (err));
-      goto leave;
-    }
+  pgm = get_gpg_path ();
+  if (!pgm || !*pgm)
+    return gpg_error (GPG_ERR_INV_ENGINE);
 
-  result = TRUE;
+  argv[0] = "";
+  argv[1] = "--batch";
+  argv[2] = "--import-ownertrust";
+  argv[3] = NULL;
 
- leave:
-  gpgme_release (ctx);
-  gpgme_data_release (dfp);
-  fclose (fp);
-  return result;
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  return gpgme_op_spawn_start (ctx, pgm, argv, records, NULL, NULL,
+                               GPGME_SPAWN_ALLOW_SET_FG);
 }
 
 
+/* Start updating the trust database.  CTX is switched to the spawn
+   protocol.  */
+gpg_error_t
+gpa_check_trustdb_start (gpgme_ctx_t ctx)
+{
+  const char *pgm;
+  const char *argv[4];
+
+  pgm = get_gpg_path ();
+  if (!pgm || !*pgm)
+    return gpg_error (GPG_ERR_INV_ENGINE);
+
+  argv[0] = "";
+  argv[1] = "--batch";
+  argv[2] = "--check-trustdb";
+  argv[3] = NULL;
+
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  return gpgme_op_spawn_start (ctx, pgm, argv, NULL, NULL, NULL,
+                               GPGME_SPAWN_ALLOW_SET_FG);
+}
+
 void
 gpa_keygen_para_free (gpa_keygen_para_t *params)
 {
@@ -1843,3 +1945,74 @@ gpa_validate_gpg_comment (const char *comment)
   return result;
 }
 
+
+/* Parse the header of the OpenPGP packet at BUF.  Stores the tag, the
+   length of the header and the length of the body.  Returns FALSE if
+   the packet is invalid or truncated.  */
+gboolean
+gpa_openpgp_parse_packet (const guchar *buf, gsize len, int *r_tag,
+			  gsize *r_hdrlen, gsize *r_bodylen)
+{
+  gsize hdrlen, bodylen;
+
+  if (len < 2 || !(buf[0] & 0x80))
+    return FALSE;
+  if (buf[0] & 0x40)
+    {
+      /* New format packet.  Partial lengths are not used for keys.  */
+      *r_tag = buf[0] & 0x3f;
+      if (buf[1] < 192)
+	{
+	  hdrlen = 2;
+	  bodylen = buf[1];
+	}
+      else if (buf[1] < 224)
+	{
+	  if (len < 3)
+	    return FALSE;
+	  hdrlen = 3;
+	  bodylen = ((buf[1] - 192) << 8) + buf[2] + 192;
+	}
+      else if (buf[1] == 255)
+	{
+	  if (len < 6)
+	    return FALSE;
+	  hdrlen = 6;
+	  bodylen = ((gsize) buf[2] << 24) | (buf[3] << 16)
+	    | (buf[4] << 8) | buf[5];
+	}
+      else
+	return FALSE;
+    }
+  else
+    {
+      *r_tag = (buf[0] >> 2) & 0x0f;
+      switch (buf[0] & 3)
+	{
+	case 0:
+	  hdrlen = 2;
+	  bodylen = buf[1];
+	  break;
+	case 1:
+	  if (len < 3)
+	    return FALSE;
+	  hdrlen = 3;
+	  bodylen = (buf[1] << 8) | buf[2];
+	  break;
+	case 2:
+	  if (len < 5)
+	    return FALSE;
+	  hdrlen = 5;
+	  bodylen = ((gsize) buf[1] << 24) | (buf[2] << 16)
+	    | (buf[3] << 8) | buf[4];
+	  break;
+	default:
+	  return FALSE;
+	}
+    }
+  if (bodylen > len - hdrlen)
+    return FALSE;
+  *r_hdrlen = hdrlen;
+  *r_bodylen = bodylen;
+  return TRUE;
+}
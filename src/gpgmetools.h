@@ -146,6 +146,11 @@ int gpa_open_output (const char *filename, gpgme_data_t *data,
 int gpa_open_input (const char *filename, gpgme_data_t *data,
 		    GtkWidget *parent);
 
+/* Same as gpa_open_input but count the bytes read by gpgme in
+   *COUNTER.  */
+int gpa_open_input_counted (const char *filename, gpgme_data_t *data,
+                            GtkWidget *parent, guint64 *counter);
+
 /* Write the contents of the gpgme_data_t into the clipboard.  */
 int dump_data_to_clipboard (gpgme_data_t data, GtkClipboard *clipboard);
 
@@ -155,11 +160,25 @@ int dump_data_to_clipboard (gpgme_data_t data, GtkClipboard *clipboard);
 gpg_error_t gpa_generate_key_start (gpgme_ctx_t ctx,
 				    gpa_keygen_para_t *params);
 
-/* Backup a key.  It exports both the public and secret keys to a
-   file.  IS_X509 tells the function that the fingerprint is from an
-   X.509 key.  Returns TRUE on success and FALSE on error.  It
-   displays errors to the user.  */
-gboolean gpa_backup_key (const gchar *fpr, const char *filename, int is_x509);
+/* Start exporting the keys with the fingerprints in the NULL
+   terminated array FPRS to DEST.  If SECRET is set the secret keys
+   are exported; for CMS only the first of them.  */
+gpg_error_t gpa_backup_keys_start (gpgme_ctx_t ctx, gpgme_protocol_t protocol,
+                                   const char **fprs, int secret,
+                                   gpgme_data_t dest);
+
+/* Start deleting the keys with the fingerprints in the NULL
+   terminated array FPRS with one engine invocation.  */
+gpg_error_t gpa_delete_keys_start (gpgme_ctx_t ctx, gpgme_protocol_t protocol,
+                                   gboolean with_secret, const char **fprs);
+
+/* Start setting the owner trust from the "FPR:LEVEL:" lines in
+   RECORDS with one invocation of gpg.  */
+gpg_error_t gpa_import_ownertrust_start (gpgme_ctx_t ctx,
+                                         gpgme_data_t records);
+
+/* Start updating the trust database of gpg.  */
+gpg_error_t gpa_check_trustdb_start (gpgme_ctx_t ctx);
 
 gpa_keygen_para_t *gpa_keygen_para_new (void);
 
@@ -263,5 +282,9 @@ const char *gpa_validate_gpg_name (const char *name);
 const char *gpa_validate_gpg_email (const char *email);
 const char *gpa_validate_gpg_comment (const char *comment);
 
+/* Parse the header of the OpenPGP packet at BUF of length LEN.  */
+gboolean gpa_openpgp_parse_packet (const guchar *buf, gsize len, int *r_tag,
+                                   gsize *r_hdrlen, gsize *r_bodylen);
+
 
 #endif /*GPGMETOOLS_H*/
@@ -154,3 +154,85 @@ gpa_delete_dialog_run (GtkWidget * parent, gpgme_key_t key)
       return FALSE;
     }
 } /* gpa_delete_dialog_run */
+
+
+/* Run the delete dialog for all keys in KEYS at once and return TRUE
+ * if the user chose Yes.  If some of the keys have a secret key, the
+ * special warning for deleting secret keys is displayed once.
+ */
+gboolean
+gpa_delete_dialog_run_multiple (GtkWidget *parent, GList *keys)
+{
+  GtkWidget *window;
+  GtkWidget *vbox;
+  GtkWidget *label;
+  GList *item;
+  guint nkeys = 0;
+  guint nsecret = 0;
+  gchar *string;
+  gboolean result;
+
+  for (item = keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      nkeys++;
+      if (gpa_keytable_lookup_key (gpa_keytable_get_secret_instance (),
+                                   key->subkeys->fpr))
+        nsecret++;
+    }
+
+  window = gtk_dialog_new_with_buttons (_("Remove Keys"), GTK_WINDOW(parent),
+                                        GTK_DIALOG_MODAL,
+                                        _("_Yes"),
+                                        GTK_RESPONSE_YES,
+                                        _("_No"),
+                                        GTK_RESPONSE_NO,
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (window), GTK_RESPONSE_YES);
+  gtk_container_set_border_width (GTK_CONTAINER (window), 5);
+
+  vbox = GTK_DIALOG (window)->vbox;
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 5);
+
+  string = g_strdup_printf (ngettext ("You have selected %u key "
+                                      "for removal.",
+                                      "You have selected %u keys "
+                                      "for removal.", nkeys), nkeys);
+  label = gtk_label_new (string);
+  g_free (string);
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+
+  if (nsecret)
+    {
+      string = g_strdup_printf (ngettext ("%u of these keys has a secret key."
+                                          " Deleting it cannot be undone,"
+                                          " unless you have a backup copy.",
+                                          "%u of these keys have a secret key."
+                                          " Deleting them cannot be undone,"
+                                          " unless you have a backup copy.",
+                                          nsecret), nsecret);
+      label = gtk_label_new (string);
+      g_free (string);
+    }
+  else
+    label = gtk_label_new (_("These keys are public keys."
+                             " Deleting them cannot be undone easily,"
+                             " although you may be able to get new copies"
+                             " from the owners or from a key server."));
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+
+  label = gtk_label_new (_("Are you sure you want to delete these keys?"));
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+
+  gtk_widget_show_all (window);
+
+  result = (gtk_dialog_run (GTK_DIALOG (window)) == GTK_RESPONSE_YES);
+  if (result && nsecret)
+    result = confirm_delete_secret (window);
+  gtk_widget_destroy (window);
+  return result;
+}
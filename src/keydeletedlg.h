@@ -23,5 +23,6 @@
 
 #include <gtk/gtk.h>
 gboolean gpa_delete_dialog_run (GtkWidget * parent, gpgme_key_t key);
+gboolean gpa_delete_dialog_run_multiple (GtkWidget *parent, GList *keys);
 
 #endif /* KEYDELETEDLG_H */
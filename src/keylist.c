@@ -68,6 +68,7 @@ typedef enum
   GPA_KEYLIST_COLUMN_EXPIRY_TS,
   GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
   GPA_KEYLIST_COLUMN_VALIDITY_VALUE,
+  GPA_KEYLIST_COLUMN_USERID_COLLATE,
   GPA_KEYLIST_N_COLUMNS
 } GpaKeyListColumn;
 
@@ -76,6 +77,11 @@ typedef enum
 static void add_trustdb_dialog (GpaKeyList * keylist);
 static void gpa_keylist_next (gpgme_key_t key, gpointer data);
 static void gpa_keylist_end (gpointer data);
+static void selection_changed_cb (GtkTreeSelection *selection,
+                                  gpointer user_data);
+static gint compare_collate_keys (GtkTreeModel *model,
+                                  GtkTreeIter *a, GtkTreeIter *b,
+                                  gpointer user_data);
 
 
 
@@ -164,6 +170,11 @@ gpa_keylist_dispose (GObject *object)
   GpaKeyList *list = GPA_KEYLIST (object);
 
   list->disposed = 1;
+  if (list->update_id)
+    {
+      g_source_remove (list->update_id);
+      list->update_id = 0;
+    }
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -179,6 +190,8 @@ gpa_keylist_finalize (GObject *object)
   g_list_free (list->keys);
   list->keys = NULL;
   gpa_gpgme_release_keyarray (list->initial_keys);
+  g_ptr_array_foreach (list->update_fprs, (GFunc) g_free, NULL);
+  g_ptr_array_free (list->update_fprs, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -205,7 +218,19 @@ gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
 			      G_TYPE_ULONG,
 			      G_TYPE_ULONG,
 			      G_TYPE_ULONG,
-			      G_TYPE_LONG);
+			      G_TYPE_LONG,
+			      G_TYPE_STRING);
+
+  /* Sort the user names by their precomputed collation keys.  The
+     other columns are sorted by numeric values.  */
+  gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (store),
+                                   GPA_KEYLIST_COLUMN_USERID,
+                                   compare_collate_keys,
+                                   GINT_TO_POINTER
+                                   (GPA_KEYLIST_COLUMN_USERID_COLLATE),
+                                   NULL);
+
+  list->update_fprs = g_ptr_array_new ();
 
   /* Setup the view.  */
   gtk_tree_view_set_model (GTK_TREE_VIEW (list), GTK_TREE_MODEL (store));
@@ -213,6 +238,10 @@ gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
   gpa_keylist_set_brief (list);
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
   gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
+  /* Connect first so that the selection aggregates are invalidated
+     before any other "changed" handler looks at them.  */
+  g_signal_connect (G_OBJECT (selection), "changed",
+                    G_CALLBACK (selection_changed_cb), list);
 
   /* Load the keyring.  */
   add_trustdb_dialog (list);
@@ -414,6 +443,120 @@ get_key_pixbuf (gpgme_key_t key)
 
 
 
+/* Add KEY with the secret key flag HAS_SECRET to the aggregate
+   INFO.  */
+static void
+add_to_counts (struct gpa_keylist_counts_s *info, gpgme_key_t key,
+               gboolean has_secret)
+{
+  info->count++;
+  info->single = info->count == 1? key : NULL;
+  if (key->protocol == GPGME_PROTOCOL_OpenPGP)
+    info->count_openpgp++;
+  else if (key->protocol == GPGME_PROTOCOL_CMS)
+    info->count_cms++;
+  if (has_secret)
+    info->count_secret++;
+}
+
+
+/* Remove KEY from the aggregates in INFO.  The single key of INFO
+   is not known afterwards.  */
+static void
+remove_from_counts (struct gpa_keylist_counts_s *info, gpgme_key_t key,
+                    gboolean has_secret)
+{
+  info->count--;
+  info->single = NULL;
+  if (key->protocol == GPGME_PROTOCOL_OpenPGP)
+    info->count_openpgp--;
+  else if (key->protocol == GPGME_PROTOCOL_CMS)
+    info->count_cms--;
+  if (has_secret)
+    info->count_secret--;
+}
+
+
+/* Helper for update_selinfo.  */
+static void
+update_selinfo_helper (GtkTreeModel *model, GtkTreePath *path,
+                       GtkTreeIter *iter, gpointer data)
+{
+  struct gpa_keylist_counts_s *info = data;
+  gpgme_key_t key;
+  gboolean has_secret;
+
+  gtk_tree_model_get (model, iter,
+                      GPA_KEYLIST_COLUMN_KEY, &key,
+                      GPA_KEYLIST_COLUMN_HAS_SECRET, &has_secret,
+                      -1);
+  if (key)
+    add_to_counts (info, key, has_secret);
+}
+
+
+/* Make sure that the selection aggregates of LIST are up to date.
+   This walks the selection only once after each change; all further
+   queries are answered from the cache.  */
+static void
+update_selinfo (GpaKeyList *list)
+{
+  GtkTreeSelection *selection;
+
+  if (list->selinfo_valid)
+    return;
+
+  memset (&list->selinfo, 0, sizeof list->selinfo);
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
+  gtk_tree_selection_selected_foreach (selection, update_selinfo_helper,
+                                       &list->selinfo);
+  list->selinfo_valid = 1;
+}
+
+
+/* Signal handler for the "changed" signal of the selection.  */
+static void
+selection_changed_cb (GtkTreeSelection *selection, gpointer user_data)
+{
+  GpaKeyList *list = user_data;
+
+  if (list->selecting_all)
+    {
+      /* All rows are selected; thus the aggregates of the entire
+         model describe the selection as well.  */
+      list->selinfo = list->allinfo;
+      list->selinfo_valid = 1;
+    }
+  else
+    list->selinfo_valid = 0;
+}
+
+
+/* Sort function for a text column.  USER_DATA is the index of the
+   column holding the collation key as created by g_utf8_collate_key.
+   Comparing these keys with strcmp yields the same order as
+   g_utf8_collate on the displayed strings.  */
+static gint
+compare_collate_keys (GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b,
+                      gpointer user_data)
+{
+  gint column = GPOINTER_TO_INT (user_data);
+  gchar *key_a, *key_b;
+  gint result;
+
+  gtk_tree_model_get (model, a, column, &key_a, -1);
+  gtk_tree_model_get (model, b, column, &key_b, -1);
+  if (!key_a || !key_b)
+    result = key_a? 1 : key_b? -1 : 0;
+  else
+    result = strcmp (key_a, key_b);
+  g_free (key_a);
+  g_free (key_b);
+
+  return result;
+}
+
+
 /* For keys, gpg can't cope with, the fingerprint is set to all
    zero. This helper function returns true for such a FPR. */
 static int
@@ -434,7 +577,7 @@ gpa_keylist_next (gpgme_key_t key, gpointer data)
   GtkListStore *store;
   GtkTreeIter iter;
   const gchar *ownertrust, *validity;
-  gchar *userid, *created, *expiry;
+  gchar *userid, *userid_collate, *created, *expiry;
   gboolean has_secret;
   long int val_value;
   const char *keytype;
@@ -498,6 +641,7 @@ gpa_keylist_next (gpgme_key_t key, gpointer data)
 
   /* Append the key to the list */
   gtk_list_store_append (store, &iter);
+  add_to_counts (&list->allinfo, key, has_secret);
 
   /* Set an appropiate value for sorting revoked and expired keys. This
    * includes a hack for forcing a value to a range outside the
@@ -511,6 +655,10 @@ gpa_keylist_next (gpgme_key_t key, gpointer data)
   else
       val_value = GPGME_VALIDITY_UNKNOWN;
 
+  /* Precompute the collation key so that sorting by user name needs
+     only a bytewise comparison.  */
+  userid_collate = g_utf8_collate_key (userid? userid : "", -1);
+
   gtk_list_store_set (store, &iter,
 		      GPA_KEYLIST_COLUMN_KEYTYPE, keytype,
 		      GPA_KEYLIST_COLUMN_CREATED, created,
@@ -532,12 +680,14 @@ gpa_keylist_next (gpgme_key_t key, gpointer data)
 		      /* Set revoked and expired keys to "never trust"
 		         for sorting.  */
 		      GPA_KEYLIST_COLUMN_VALIDITY_VALUE, val_value,
+		      GPA_KEYLIST_COLUMN_USERID_COLLATE, userid_collate,
                       /* Store the image only if enabled.  */
 		      list->public_only ? -1 : GPA_KEYLIST_COLUMN_IMAGE,
                       list->public_only ? NULL : get_key_pixbuf (key),
 		      -1);
   /* Clean up */
   g_free (userid);
+  g_free (userid_collate);
   g_free (created);
   g_free (expiry);
 }
@@ -756,9 +906,8 @@ gpa_keylist_set_detailed (GpaKeyList * keylist)
 gboolean
 gpa_keylist_has_selection (GpaKeyList * keylist)
 {
-  GtkTreeSelection *selection =
-    gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
-  return gtk_tree_selection_count_selected_rows (selection) > 0;
+  update_selinfo (keylist);
+  return keylist->selinfo.count > 0;
 }
 
 
@@ -766,9 +915,8 @@ gpa_keylist_has_selection (GpaKeyList * keylist)
 gboolean
 gpa_keylist_has_single_selection (GpaKeyList * keylist)
 {
-  GtkTreeSelection *selection =
-    gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
-  return gtk_tree_selection_count_selected_rows (selection) == 1;
+  update_selinfo (keylist);
+  return keylist->selinfo.count == 1;
 }
 
 
@@ -776,39 +924,57 @@ gpa_keylist_has_single_selection (GpaKeyList * keylist)
 gboolean
 gpa_keylist_has_single_secret_selection (GpaKeyList *keylist)
 {
-  GtkTreeSelection *selection;
+  if (keylist->public_only)
+    return FALSE;
 
+  update_selinfo (keylist);
+  return (keylist->selinfo.count == 1 && keylist->selinfo.count_secret == 1);
+}
+
+
+/* Return true if at least one secret key is selected in the list.  */
+gboolean
+gpa_keylist_has_secret_selection (GpaKeyList *keylist)
+{
   if (keylist->public_only)
     return FALSE;
 
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
-  if (gtk_tree_selection_count_selected_rows (selection) == 1)
-    {
-      GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (keylist));
-      GList *list = gtk_tree_selection_get_selected_rows (selection, &model);
-      gpgme_key_t key;
-      GtkTreeIter iter;
-      GtkTreePath *path = list->data;
-      GValue value = {0,};
+  update_selinfo (keylist);
+  return (keylist->selinfo.count_secret > 0);
+}
 
-      gtk_tree_model_get_iter (model, &iter, path);
-      gtk_tree_model_get_value (model, &iter, GPA_KEYLIST_COLUMN_KEY,
-				&value);
-      key = g_value_get_pointer (&value);
-      g_value_unset(&value);
 
-      g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
-      g_list_free (list);
-      return (gpa_keytable_lookup_key (gpa_keytable_get_secret_instance(),
-				       key->subkeys->fpr) != NULL);
-    }
-  else
+/* Return the number of selected keys.  Unless PROTOCOL is
+   GPGME_PROTOCOL_UNKNOWN only keys of that protocol are counted.  */
+guint
+gpa_keylist_count_selected (GpaKeyList *keylist, gpgme_protocol_t protocol)
+{
+  update_selinfo (keylist);
+  switch (protocol)
     {
-      return FALSE;
+    case GPGME_PROTOCOL_OpenPGP: return keylist->selinfo.count_openpgp;
+    case GPGME_PROTOCOL_CMS:     return keylist->selinfo.count_cms;
+    case GPGME_PROTOCOL_UNKNOWN: return keylist->selinfo.count;
+    default: return 0;
     }
 }
 
 
+/* Select all keys in the list.  Unlike a plain
+   gtk_tree_selection_select_all this does not require a walk over
+   the selection to update the aggregates.  */
+void
+gpa_keylist_select_all (GpaKeyList *keylist)
+{
+  GtkTreeSelection *selection;
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
+  keylist->selecting_all++;
+  gtk_tree_selection_select_all (selection);
+  keylist->selecting_all--;
+}
+
+
 /* Return a GList of selected keys. The caller must not dereference
    the keys as they belong to the caller.  Unless PROTOCOL is
    GPGME_PROTOCOL_UNKNOWN, only keys matching thhe requested protocol
@@ -854,33 +1020,15 @@ gpa_keylist_get_selected_keys (GpaKeyList * keylist, gpgme_protocol_t protocol)
 gpgme_key_t
 gpa_keylist_get_selected_key (GpaKeyList *keylist)
 {
-  GtkTreeSelection *selection;
-  GtkTreeModel *model;
-  GList *list;
-  GtkTreePath *path;
-  GtkTreeIter iter;
-  GValue value = {0};
   gpgme_key_t key;
 
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
-  if (gtk_tree_selection_count_selected_rows (selection) != 1)
+  update_selinfo (keylist);
+  if (keylist->selinfo.count != 1)
     return NULL;
 
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (keylist));
-  list = gtk_tree_selection_get_selected_rows (selection, &model);
-  if (!list)
-    return NULL;
-  path = list->data;
-
-  gtk_tree_model_get_iter (model, &iter, path);
-  gtk_tree_model_get_value (model, &iter, GPA_KEYLIST_COLUMN_KEY, &value);
-  key = g_value_get_pointer (&value);
-  g_value_unset (&value);
-  gpgme_key_ref (key);
-
-  g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
-  g_list_free (list);
-
+  key = keylist->selinfo.single;
+  if (key)
+    gpgme_key_ref (key);
   return key;
 }
 
@@ -897,6 +1045,8 @@ gpa_keylist_start_reload (GpaKeyList * keylist)
   g_list_foreach (keylist->keys, (GFunc) gpgme_key_unref, NULL);
   g_list_free (keylist->keys);
   keylist->keys = NULL;
+  memset (&keylist->allinfo, 0, sizeof keylist->allinfo);
+  keylist->selinfo_valid = 0;
   add_trustdb_dialog (keylist);
 
   gpa_keytable_force_reload (gpa_keytable_get_public_instance (),
@@ -926,6 +1076,143 @@ gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr)
 }
 
 
+/* Remove the rows and keys of LIST whose fingerprints are in the
+   hash table FPRS.  */
+static void
+remove_key_rows (GpaKeyList *list, GHashTable *fprs)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+  GtkTreeIter iter;
+  gboolean valid;
+  GList *item, *next;
+
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  while (valid)
+    {
+      gpgme_key_t key;
+      gboolean has_secret;
+
+      gtk_tree_model_get (model, &iter,
+                          GPA_KEYLIST_COLUMN_KEY, &key,
+                          GPA_KEYLIST_COLUMN_HAS_SECRET, &has_secret,
+                          -1);
+      if (key && key->subkeys && key->subkeys->fpr
+          && g_hash_table_lookup (fprs, key->subkeys->fpr))
+        {
+          remove_from_counts (&list->allinfo, key, has_secret);
+          valid = gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+        }
+      else
+        valid = gtk_tree_model_iter_next (model, &iter);
+    }
+
+  for (item = list->keys; item; item = next)
+    {
+      gpgme_key_t key = item->data;
+
+      next = g_list_next (item);
+      if (key->subkeys && key->subkeys->fpr
+          && g_hash_table_lookup (fprs, key->subkeys->fpr))
+        {
+          gpgme_key_unref (key);
+          list->keys = g_list_delete_link (list->keys, item);
+        }
+    }
+  if (list->allinfo.count == 1 && list->keys)
+    list->allinfo.single = list->keys->data;
+  list->selinfo_valid = 0;
+}
+
+
+static gboolean update_keys_cb (gpointer data);
+
+static void
+update_keys_end (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  list->updating = 0;
+  gpa_keylist_end (list);
+  if (!list->disposed && list->update_fprs->len && !list->update_id)
+    list->update_id = g_idle_add (update_keys_cb, list);
+}
+
+
+/* Reload the keys queued by gpa_keylist_update_keys.  */
+static gboolean
+update_keys_cb (gpointer data)
+{
+  GpaKeyList *list = data;
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+  GHashTable *fprs;
+  gchar **patterns;
+  guint idx;
+
+  list->update_id = 0;
+  if (!list->update_fprs->len)
+    return FALSE;
+  if (list->updating || gpa_context_busy (keytable->context))
+    {
+      /* Wait until the key table is not used anymore.  */
+      list->update_id = g_timeout_add (100, update_keys_cb, list);
+      return FALSE;
+    }
+
+  fprs = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; idx < list->update_fprs->len; idx++)
+    g_hash_table_insert (fprs, g_ptr_array_index (list->update_fprs, idx),
+                         GINT_TO_POINTER (1));
+  remove_key_rows (list, fprs);
+  g_hash_table_destroy (fprs);
+
+  g_ptr_array_add (list->update_fprs, NULL);
+  patterns = (gchar **) g_ptr_array_free (list->update_fprs, FALSE);
+  list->update_fprs = g_ptr_array_new ();
+
+  list->updating = 1;
+  gpa_keytable_load_keys (keytable, (const char **) patterns,
+                          gpa_keylist_next, update_keys_end, list);
+  g_strfreev (patterns);
+
+  return FALSE;
+}
+
+
+/* Let the keylist know that the keys with the fingerprints FPRS have
+   been changed or added.  The updates are collected and reloaded
+   together as soon as the key table is idle.  */
+void
+gpa_keylist_update_keys (GpaKeyList *keylist, const char **fprs)
+{
+  int idx;
+
+  for (idx = 0; fprs[idx]; idx++)
+    g_ptr_array_add (keylist->update_fprs, g_strdup (fprs[idx]));
+  if (!keylist->update_id && !keylist->updating)
+    keylist->update_id = g_idle_add (update_keys_cb, keylist);
+}
+
+
+/* Let the keylist know that the keys with the fingerprints FPRS have
+   been deleted.  Their rows are removed without reloading the
+   list.  */
+void
+gpa_keylist_remove_keys (GpaKeyList *keylist, const char **fprs)
+{
+  GHashTable *set;
+  int idx;
+
+  set = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; fprs[idx]; idx++)
+    g_hash_table_insert (set, (gpointer) fprs[idx], GINT_TO_POINTER (1));
+  remove_key_rows (keylist, set);
+  g_hash_table_destroy (set);
+
+  gpa_keytable_remove_keys (gpa_keytable_get_public_instance (), fprs);
+  gpa_keytable_remove_keys (gpa_keytable_get_secret_instance (), fprs);
+}
+
+
 /* Let the keylist know that a new sceret key has been imported. */
 void
 gpa_keylist_imported_secret_key (GpaKeyList *keylist)
@@ -34,6 +34,16 @@
 typedef struct _GpaKeyList GpaKeyList;
 typedef struct _GpaKeyListClass GpaKeyListClass;
 
+/* Aggregated information about a set of keys in the list.  */
+struct gpa_keylist_counts_s
+{
+  guint count;           /* Number of keys.  */
+  guint count_openpgp;   /* Number of OpenPGP keys.  */
+  guint count_cms;       /* Number of X.509 keys.  */
+  guint count_secret;    /* Number of keys with a secret key.  */
+  gpgme_key_t single;    /* The key if COUNT is 1 (not referenced).  */
+};
+
 struct _GpaKeyList {
   GtkTreeView parent;
 
@@ -56,7 +66,22 @@ struct _GpaKeyList {
   int requested_usage;
   gboolean only_usable_keys;
 
+  /* Aggregates of the current selection and of all keys in the
+     model.  SELINFO is only valid if SELINFO_VALID is set; it is
+     invalidated by the selection's "changed" signal and recomputed on
+     demand with a single walk over the selection.  */
+  struct gpa_keylist_counts_s selinfo;
+  struct gpa_keylist_counts_s allinfo;
+  int selinfo_valid;
+  int selecting_all;
+
   int disposed;
+
+  /* Fingerprints of changed keys waiting to be reloaded, the source
+     ID of the pending reload and whether a reload is running.  */
+  GPtrArray *update_fprs;
+  guint update_id;
+  int updating;
 };
 
 struct _GpaKeyListClass {
@@ -105,6 +130,17 @@ gboolean gpa_keylist_has_single_selection (GpaKeyList * keylist);
 /* Return true if one, and only one, secret key is selected in the list.  */
 gboolean gpa_keylist_has_single_secret_selection (GpaKeyList * keylist);
 
+/* Return true if at least one secret key is selected in the list.  */
+gboolean gpa_keylist_has_secret_selection (GpaKeyList *keylist);
+
+/* Return the number of selected keys.  Unless PROTOCOL is
+   GPGME_PROTOCOL_UNKNOWN only keys of that protocol are counted.  */
+guint gpa_keylist_count_selected (GpaKeyList *keylist,
+                                  gpgme_protocol_t protocol);
+
+/* Select all keys in the list.  */
+void gpa_keylist_select_all (GpaKeyList *keylist);
+
 /* Return a GList of selected keys. The caller must not dereference
    the keys as they belong to the caller.  */
 GList *gpa_keylist_get_selected_keys (GpaKeyList *keylist,
@@ -124,5 +160,14 @@ void gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr);
 /* Let the keylist know that a new sceret key has been imported.  */
 void gpa_keylist_imported_secret_key (GpaKeyList * keylist);
 
+/* Let the keylist know that the keys with the fingerprints in the
+   NULL terminated array FPRS have been changed or added.  Only these
+   keys are reloaded.  */
+void gpa_keylist_update_keys (GpaKeyList *keylist, const char **fprs);
+
+/* Let the keylist know that the keys with the fingerprints in the
+   NULL terminated array FPRS have been deleted.  */
+void gpa_keylist_remove_keys (GpaKeyList *keylist, const char **fprs);
+
 
 #endif /* GPA_KEYLIST_H */
@@ -53,6 +53,7 @@
 #include "gpakeydeleteop.h"
 #include "gpakeysignop.h"
 #include "gpakeytrustop.h"
+#include "gpakeyexpireop.h"
 
 #include "gpaexportfileop.h"
 #include "gpaexportclipop.h"
@@ -244,24 +245,16 @@ key_manager_has_single_selection (gpointer param)
 }
 
 
-/* Return TRUE if the key list widget of the key manager has
-   exactly one selected OpenPGP item.  Usable as a sensitivity
+/* Return TRUE if the key list widget of the key manager has at
+   least one OpenPGP item selected.  Usable as a sensitivity
    callback.  */
 static gboolean
-key_manager_has_single_selection_OpenPGP (gpointer param)
+key_manager_has_selection_OpenPGP (gpointer param)
 {
   GpaKeyManager *self = param;
-  int result = 0;
-
-  if (gpa_keylist_has_single_selection (self->keylist))
-    {
-      gpgme_key_t key = gpa_keylist_get_selected_key (self->keylist);
-      if (key && key->protocol == GPGME_PROTOCOL_OpenPGP)
-        result = 1;
-      gpgme_key_unref (key);
-    }
 
-  return result;
+  return gpa_keylist_count_selected (self->keylist,
+                                     GPGME_PROTOCOL_OpenPGP) > 0;
 }
 
 /* Return TRUE if the key list widget of the key manager has
@@ -277,6 +270,18 @@ key_manager_has_private_selected (gpointer param)
 }
 
 
+/* Return TRUE if the key list widget of the key manager has at
+   least one private key selected.  Usable as a sensitivity
+   callback.  */
+static gboolean
+key_manager_has_private_selection (gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  return gpa_keylist_has_secret_selection (GPA_KEYLIST(self->keylist));
+}
+
+
 /* Return the the currently selected key. NULL if no key is selected.  */
 static gpgme_key_t
 key_manager_current_key (GpaKeyManager *self)
@@ -297,6 +302,26 @@ gpa_key_manager_changed_wot_cb (gpointer data)
 }
 
 
+/* The keys with the fingerprints FPRS have been deleted.  */
+static void
+gpa_key_manager_removed_fprs_cb (gpointer data, const char **fprs)
+{
+  GpaKeyManager *self = data;
+
+  gpa_keylist_remove_keys (self->keylist, fprs);
+}
+
+
+/* Only the keys with the fingerprints FPRS have been changed.  */
+static void
+gpa_key_manager_changed_fprs_cb (gpointer data, const char **fprs)
+{
+  GpaKeyManager *self = data;
+
+  gpa_keylist_update_keys (self->keylist, fprs);
+}
+
+
 static void
 gpa_key_manager_changed_wot_secret_cb (gpointer data)
 {
@@ -332,6 +357,12 @@ register_key_operation (GpaKeyManager *self, GpaKeyOperation *op)
   g_signal_connect_swapped (G_OBJECT (op), "changed_wot",
 			    G_CALLBACK (gpa_key_manager_changed_wot_cb),
 			    self);
+  g_signal_connect_swapped (G_OBJECT (op), "changed_keys",
+			    G_CALLBACK (gpa_key_manager_changed_fprs_cb),
+			    self);
+  g_signal_connect_swapped (G_OBJECT (op), "removed_keys",
+			    G_CALLBACK (gpa_key_manager_removed_fprs_cb),
+			    self);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), self);
 }
@@ -347,6 +378,10 @@ register_import_operation (GpaKeyManager *self, GpaImportOperation *op)
     (G_OBJECT (op), "imported_secret_keys",
      G_CALLBACK (gpa_key_manager_changed_wot_secret_cb),
      self);
+  g_signal_connect_swapped
+    (G_OBJECT (op), "imported_fingerprints",
+     G_CALLBACK (gpa_key_manager_changed_fprs_cb),
+     self);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), self);
 }
@@ -491,9 +526,7 @@ key_manager_trust (GtkAction *action, gpointer param)
   GList *selection;
   GpaKeyTrustOperation *op;
 
-  /* FIXME: Key trust operation currently does not support more than
-     one key at a time.  */
-  if (! key_manager_has_single_selection (self))
+  if (! key_manager_has_selection_OpenPGP (self))
     return;
 
   selection = gpa_keylist_get_selected_keys (self->keylist,
@@ -506,6 +539,27 @@ key_manager_trust (GtkAction *action, gpointer param)
 }
 
 
+/* Change the expiry date of the selected private keys.  */
+static void
+key_manager_expire (GtkAction *action, gpointer param)
+{
+  GpaKeyManager *self = param;
+  GList *selection;
+  GpaKeyExpireOperation *op;
+
+  if (! key_manager_has_private_selection (self))
+    return;
+
+  selection = gpa_keylist_get_selected_keys (self->keylist,
+                                             GPGME_PROTOCOL_OpenPGP);
+  if (selection)
+    {
+      op = gpa_key_expire_operation_new (GTK_WIDGET (self), selection);
+      register_key_operation (self, GPA_KEY_OPERATION (op));
+    }
+}
+
+
 /* Import keys.  */
 static void
 key_manager_import (GtkAction *action, gpointer param)
@@ -550,7 +604,7 @@ key_manager_retrieve (GtkAction *action, gpointer param)
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 
 
-/* Refresh keys from the keyserver.  */
+/* Refresh the selected keys from the keyserver.  */
 #ifdef ENABLE_KEYSERVER_SUPPORT
 static void
 key_manager_refresh_keys (GtkAction *action, gpointer param)
@@ -559,17 +613,30 @@ key_manager_refresh_keys (GtkAction *action, gpointer param)
   GpaImportByKeyidOperation *op;
   GList *selection;
 
-  /* FIXME: The refresh-from-server operation currently only supports
-     one key at a time.  */
-  if (!key_manager_has_single_selection (self))
-    return;
-
   selection = gpa_keylist_get_selected_keys (self->keylist,
                                              GPGME_PROTOCOL_OPENPGP);
   if (selection)
     {
-      op = gpa_import_bykeyid_operation_new (GTK_WIDGET (self),
-                                             (gpgme_key_t) selection->data);
+      op = gpa_import_bykeyid_operation_new_list (GTK_WIDGET (self),
+                                                  selection);
+      register_import_operation (self, GPA_IMPORT_OPERATION (op));
+    }
+}
+
+
+/* Refresh all public keys of the keyring from the keyserver.  */
+static void
+key_manager_refresh_all_keys (GtkAction *action, gpointer param)
+{
+  GpaKeyManager *self = param;
+  GpaImportByKeyidOperation *op;
+  GList *keys;
+
+  /* The key table has been filled by the key list.  */
+  keys = g_list_copy (gpa_keytable_get_public_instance ()->keys);
+  if (keys)
+    {
+      op = gpa_import_bykeyid_operation_new_list (GTK_WIDGET (self), keys);
       register_import_operation (self, GPA_IMPORT_OPERATION (op));
     }
 }
@@ -585,11 +652,6 @@ key_manager_send (GtkAction *action, gpointer param)
   GList *selection;
   GpaExportServerOperation *op;
 
-  /* FIXME: The export-to-server operation currently only supports
-     exporting one key at a time.  */
-  if (! key_manager_has_single_selection (self))
-    return;
-
   selection = gpa_keylist_get_selected_keys (self->keylist,
                                              GPGME_PROTOCOL_OPENPGP);
   if (selection)
@@ -601,25 +663,56 @@ key_manager_send (GtkAction *action, gpointer param)
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 
 
-/* Backup the default keys.  */
+/* Backup the secret keys in the list KEYS.  Keys without a secret
+   part are skipped.  Takes ownership of the list.  */
 static void
-key_manager_backup (GtkAction *action, gpointer param)
+key_manager_backup_keys (GpaKeyManager *self, GList *keys)
 {
-  GpaKeyManager *self = param;
-  gpgme_key_t key;
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
   GpaBackupOperation *op;
+  GList *item, *next;
 
-  if (! key_manager_has_private_selected (self))
-    return;
-  key = key_manager_current_key (self);
-  if (! key)
+  for (item = keys; item; item = next)
+    {
+      gpgme_key_t key = item->data;
+
+      next = g_list_next (item);
+      if (!gpa_keytable_lookup_key (secret, key->subkeys->fpr))
+        keys = g_list_delete_link (keys, item);
+    }
+  if (!keys)
     return;
 
-  op = gpa_backup_operation_new (GTK_WIDGET (self), key);
+  op = gpa_backup_operation_new_list (GTK_WIDGET (self), keys);
   register_operation (self, GPA_OPERATION (op));
 }
 
 
+/* Backup the selected secret keys.  */
+static void
+key_manager_backup (GtkAction *action, gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  if (! key_manager_has_private_selection (self))
+    return;
+
+  key_manager_backup_keys (self, gpa_keylist_get_selected_keys
+                           (self->keylist, GPGME_PROTOCOL_UNKNOWN));
+}
+
+
+/* Backup all secret keys.  */
+static void
+key_manager_backup_all (GtkAction *action, gpointer param)
+{
+  GpaKeyManager *self = param;
+
+  key_manager_backup_keys
+    (self, g_list_copy (gpa_keytable_get_secret_instance ()->keys));
+}
+
+
 /* Run the advanced key generation dialog and if the user clicked OK,
    generate a new key pair and update the key list.  */
 static void
@@ -686,7 +779,7 @@ key_manager_selection_changed (GtkTreeSelection *treeselection,
 				  gpointer param)
 {
   GpaKeyManager *self = param;
-  GList *selection;
+  gpgme_key_t key;
 
   /* Some other piece of the keyring wants us to ignore this signal.  */
   if (self->freeze_selection)
@@ -705,15 +798,11 @@ key_manager_selection_changed (GtkTreeSelection *treeselection,
     gpgme_op_keylist_end (self->ctx->ctx);
 
   /* Load the new one.  */
-  if (gpa_keylist_has_single_selection (self->keylist)
-      && (selection = gpa_keylist_get_selected_keys (self->keylist,
-                                                     GPGME_PROTOCOL_UNKNOWN)))
+  if ((key = gpa_keylist_get_selected_key (self->keylist)))
     {
       gpg_error_t err;
-      gpgme_key_t key;
       int old_mode;
 
-      key = (gpgme_key_t) selection->data;
       old_mode = gpgme_get_keylist_mode (self->ctx->ctx);
 
       /* With all the signatures and validating for the sake of X.509.
@@ -735,7 +824,7 @@ key_manager_selection_changed (GtkTreeSelection *treeselection,
 	gpa_gpgme_warning (err);
 
       gpgme_set_keylist_mode (self->ctx->ctx, old_mode);
-      g_list_free (selection);
+      gpgme_key_unref (key);
 
       /* Make sure the actions that depend on a current key are
 	 disabled.  */
@@ -842,10 +931,8 @@ static void
 key_manager_select_all (GtkAction *action, gpointer param)
 {
   GpaKeyManager *self = param;
-  GtkTreeSelection *selection;
 
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (self->keylist));
-  gtk_tree_selection_select_all (selection);
+  gpa_keylist_select_all (self->keylist);
 }
 
 
@@ -957,8 +1044,11 @@ key_manager_action_new (GpaKeyManager *self,
       { "KeysSign", GPA_STOCK_SIGN, N_("_Sign Keys..."), NULL,
 	N_("Sign the selected key"), G_CALLBACK (key_manager_sign) },
       { "KeysSetOwnerTrust", NULL, N_("Set _Owner Trust..."), NULL,
-	N_("Set owner trust of the selected key"),
+	N_("Set owner trust of the selected keys"),
 	G_CALLBACK (key_manager_trust) },
+      { "KeysSetExpiry", NULL, N_("Change Ex_piry Date..."), NULL,
+	N_("Change the expiry date of the selected private keys"),
+	G_CALLBACK (key_manager_expire) },
       { "KeysEditPrivateKey", GPA_STOCK_EDIT, N_("_Edit Private Key..."), NULL,
 	N_("Edit the selected private key"),
 	G_CALLBACK (key_manager_edit) },
@@ -968,6 +1058,8 @@ key_manager_action_new (GpaKeyManager *self,
 	N_("Export Keys"), G_CALLBACK (key_manager_export) },
       { "KeysBackup", NULL, N_("_Backup..."), NULL,
 	N_("Backup key"), G_CALLBACK (key_manager_backup) },
+      { "KeysBackupAll", NULL, N_("Backup _All Secret Keys..."), NULL,
+	N_("Backup all secret keys"), G_CALLBACK (key_manager_backup_all) },
 
       /* Server menu.  */
 #ifdef ENABLE_KEYSERVER_SUPPORT
@@ -977,6 +1069,9 @@ key_manager_action_new (GpaKeyManager *self,
       { "ServerRefresh", NULL, N_("Re_fresh Keys"), NULL,
         N_("Refresh keys from server"),
         G_CALLBACK (key_manager_refresh_keys) },
+      { "ServerRefreshAll", NULL, N_("Refresh _All Keys"), NULL,
+        N_("Refresh all keys from server"),
+        G_CALLBACK (key_manager_refresh_all_keys) },
       { "ServerSend", NULL, N_("_Send Keys..."), NULL,
         N_("Send keys to server"), G_CALLBACK (key_manager_send) }
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
@@ -1014,11 +1109,13 @@ key_manager_action_new (GpaKeyManager *self,
     "      <separator/>"
     "      <menuitem action='KeysSign'/>"
     "      <menuitem action='KeysSetOwnerTrust'/>"
+    "      <menuitem action='KeysSetExpiry'/>"
     "      <menuitem action='KeysEditPrivateKey'/>"
     "      <separator/>"
     "      <menuitem action='KeysImport'/>"
     "      <menuitem action='KeysExport'/>"
     "      <menuitem action='KeysBackup'/>"
+    "      <menuitem action='KeysBackupAll'/>"
     "    </menu>"
     "    <menu action='Windows'>"
     "      <menuitem action='WindowsKeyringEditor'/>"
@@ -1031,6 +1128,7 @@ key_manager_action_new (GpaKeyManager *self,
 #ifdef ENABLE_KEYSERVER_SUPPORT
     "    <menu action='Server'>"
     "      <menuitem action='ServerRetrieve'/>"
+    "      <menuitem action='ServerRefreshAll'/>"
     "      <menuitem action='ServerSend'/>"
     "    </menu>"
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
@@ -1153,15 +1251,15 @@ key_manager_action_new (GpaKeyManager *self,
 #ifdef ENABLE_KEYSERVER_SUPPORT
   action = gtk_action_group_get_action (action_group, "ServerRefresh");
   add_selection_sensitive_action (self, action,
-                                  key_manager_has_single_selection);
+                                  key_manager_has_selection);
   action = gtk_action_group_get_action (action_group, "ServerSend");
   add_selection_sensitive_action (self, action,
-                                  key_manager_has_single_selection);
+                                  key_manager_has_selection);
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 
   action = gtk_action_group_get_action (action_group, "KeysSetOwnerTrust");
   add_selection_sensitive_action (self, action,
-				  key_manager_has_single_selection_OpenPGP);
+				  key_manager_has_selection_OpenPGP);
 
   action = gtk_action_group_get_action (action_group, "KeysSign");
   add_selection_sensitive_action (self, action,
@@ -1170,9 +1268,12 @@ key_manager_action_new (GpaKeyManager *self,
   action = gtk_action_group_get_action (action_group, "KeysEditPrivateKey");
   add_selection_sensitive_action (self, action,
                                   key_manager_has_private_selected);
+  action = gtk_action_group_get_action (action_group, "KeysSetExpiry");
+  add_selection_sensitive_action (self, action,
+                                  key_manager_has_private_selection);
   action = gtk_action_group_get_action (action_group, "KeysBackup");
   add_selection_sensitive_action (self, action,
-                                  key_manager_has_private_selected);
+                                  key_manager_has_private_selection);
 
   *menu = gtk_ui_manager_get_widget (ui_manager, "/MainMenu");
   *toolbar = gtk_ui_manager_get_widget (ui_manager, "/ToolBar");
@@ -1206,14 +1307,10 @@ idle_update_details (gpointer param)
     }
   else
     {
-      GList *selection = gpa_keylist_get_selected_keys (self->keylist,
-                                                        GPGME_PROTOCOL_UNKNOWN);
-      if (selection)
-        {
-          gpa_key_details_update (self->details, NULL,
-                                  g_list_length (selection));
-          g_list_free (selection);
-        }
+      guint count = gpa_keylist_count_selected (self->keylist,
+                                                GPGME_PROTOCOL_UNKNOWN);
+      if (count)
+        gpa_key_details_update (self->details, NULL, count);
     }
 
   /* Set the idle id to NULL to indicate that the idle handler has
@@ -157,3 +157,153 @@ gpa_key_sign_run_dialog (GtkWidget * parent, gpgme_key_t key,
       return FALSE;
     }
 }
+
+
+static void
+batch_expire_toggled_cb (GtkToggleButton *button, gpointer data)
+{
+  GtkWidget *spin = data;
+
+  gtk_widget_set_sensitive (spin, gtk_toggle_button_get_active (button));
+}
+
+
+/* Run the dialog for certifying all keys in KEYS with the default
+ * key.  The names and fingerprints of all keys are listed so that
+ * they can be checked against a key signing party list.
+ *
+ * If the user clicks OK, return TRUE and set SIGN_LOCALLY and
+ * EXPIRE_DAYS (0 for no expiration).
+ */
+gboolean
+gpa_key_sign_run_batch_dialog (GtkWidget *parent, GList *keys,
+                               gboolean can_expire,
+                               gboolean *sign_locally,
+                               int *expire_days)
+{
+  GtkWidget *window;
+  GtkWidget *vbox;
+  GtkWidget *label;
+  GtkWidget *scroller;
+  GtkWidget *view;
+  GtkListStore *store;
+  GtkCellRenderer *renderer;
+  GtkWidget *check = NULL;
+  GtkWidget *expire_box = NULL;
+  GtkWidget *expire_check = NULL;
+  GtkWidget *expire_spin = NULL;
+  GtkResponseType response;
+  GList *item;
+  gchar *string;
+  guint nkeys = g_list_length (keys);
+
+  window = gtk_dialog_new_with_buttons (_("Sign Keys"), GTK_WINDOW(parent),
+                                        GTK_DIALOG_MODAL,
+                                        _("_Yes"),
+                                        GTK_RESPONSE_YES,
+                                        _("_No"),
+                                        GTK_RESPONSE_NO,
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (window), GTK_RESPONSE_YES);
+  gtk_container_set_border_width (GTK_CONTAINER (window), 5);
+  gtk_window_set_default_size (GTK_WINDOW (window), 560, 420);
+  vbox = GTK_DIALOG (window)->vbox;
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 5);
+
+  string = g_strdup_printf (ngettext ("Do you want to sign the following"
+                                      " %u key?",
+                                      "Do you want to sign the following"
+                                      " %u keys?", nkeys), nkeys);
+  label = gtk_label_new (string);
+  g_free (string);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, TRUE, 5);
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+
+  /* The list of keys.  */
+  store = gtk_list_store_new (2, G_TYPE_STRING, G_TYPE_STRING);
+  for (item = keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+      GtkTreeIter iter;
+      gchar *uid = gpa_gpgme_key_get_userid (key->uids);
+      gchar *fpr = gpa_gpgme_key_format_fingerprint (key->subkeys->fpr);
+
+      gtk_list_store_append (store, &iter);
+      gtk_list_store_set (store, &iter, 0, uid, 1, fpr, -1);
+      g_free (uid);
+      g_free (fpr);
+    }
+  view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+  g_object_unref (store);
+  renderer = gtk_cell_renderer_text_new ();
+  g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+  gtk_tree_view_insert_column_with_attributes
+    (GTK_TREE_VIEW (view), -1, _("User Name"), renderer, "text", 0, NULL);
+  gtk_tree_view_column_set_expand
+    (gtk_tree_view_get_column (GTK_TREE_VIEW (view), 0), TRUE);
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_insert_column_with_attributes
+    (GTK_TREE_VIEW (view), -1, _("Fingerprint"), renderer, "text", 1, NULL);
+  scroller = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroller),
+                                  GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scroller),
+                                       GTK_SHADOW_IN);
+  gtk_container_add (GTK_CONTAINER (scroller), view);
+  gtk_box_pack_start (GTK_BOX (vbox), scroller, TRUE, TRUE, 0);
+
+  label = gtk_label_new (_("Check the names and fingerprints carefully to"
+                           " be sure that these really are the keys you"
+                           " want to sign.  All user names in these keys"
+                           " will be signed with your default private"
+                           " key."));
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, TRUE, 10);
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 1.0);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+
+  if (can_expire)
+    {
+      expire_box = gtk_hbox_new (FALSE, 4);
+      expire_check = gtk_check_button_new_with_mnemonic
+        (_("Signatures _expire after"));
+      gtk_box_pack_start (GTK_BOX (expire_box), expire_check,
+                          FALSE, FALSE, 0);
+      expire_spin = gtk_spin_button_new_with_range (1, 36500, 1);
+      gtk_spin_button_set_value (GTK_SPIN_BUTTON (expire_spin), 365);
+      gtk_widget_set_sensitive (expire_spin, FALSE);
+      gtk_box_pack_start (GTK_BOX (expire_box), expire_spin,
+                          FALSE, FALSE, 0);
+      label = gtk_label_new (_("days"));
+      gtk_box_pack_start (GTK_BOX (expire_box), label, FALSE, FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (vbox), expire_box, FALSE, FALSE, 0);
+      g_signal_connect (G_OBJECT (expire_check), "toggled",
+                        G_CALLBACK (batch_expire_toggled_cb), expire_spin);
+    }
+
+  if (! gpa_options_get_simplified_ui (gpa_options_get_instance ()))
+    {
+      check = gtk_check_button_new_with_mnemonic (_("Sign only _locally"));
+      gtk_box_pack_start (GTK_BOX (vbox), check, FALSE, FALSE, 0);
+      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), *sign_locally);
+    }
+
+  gtk_widget_show_all (window);
+  response = gtk_dialog_run (GTK_DIALOG (window));
+  if (response == GTK_RESPONSE_YES)
+    {
+      *sign_locally = check &&
+        gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (check));
+      *expire_days = 0;
+      if (expire_check
+          && gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (expire_check)))
+        *expire_days = gtk_spin_button_get_value_as_int
+          (GTK_SPIN_BUTTON (expire_spin));
+      gtk_widget_destroy (window);
+      return TRUE;
+    }
+  else
+    {
+      gtk_widget_destroy (window);
+      return FALSE;
+    }
+}
@@ -26,5 +26,14 @@
 gboolean gpa_key_sign_run_dialog (GtkWidget * parent, gpgme_key_t key,
 				  gboolean * sign_locally);
 
+/* Run the dialog for certifying all keys in KEYS at once.  On OK,
+   return TRUE and set the options common to all signatures.  If
+   CAN_EXPIRE is false, the signature expiration can't be chosen and
+   *EXPIRE_DAYS is set to 0.  */
+gboolean gpa_key_sign_run_batch_dialog (GtkWidget *parent, GList *keys,
+                                        gboolean can_expire,
+                                        gboolean *sign_locally,
+                                        int *expire_days);
+
 
 #endif /* KEYSIGNDLG_H */
@@ -26,6 +26,9 @@
 #include "keytable.h"
 #include "gtktools.h"
 
+/* Maximum number of patterns passed to one keylist operation.  */
+#define MAX_KEYLIST_PATTERNS 64
+
 /* Internal */
 static void first_half_done_cb (GpaContext *context, gpg_error_t err,
                                 GpaKeyTable *keytable);
@@ -93,6 +96,8 @@ gpa_keytable_init (GpaKeyTable *keytable)
   keytable->secret = FALSE;
   keytable->initialized = FALSE;
   keytable->new_key = FALSE;
+  keytable->patterns = NULL;
+  keytable->patterns_pos = 0;
   keytable->tmp_list = NULL;
   /* Note, that the next_key and done signals are emitted by means of
      gpgme events with the help of gpacontext.c:gpa_context_event_cb.  */
@@ -108,12 +113,45 @@ gpa_keytable_finalize (GObject *object)
   GpaKeyTable *keytable = GPA_KEYTABLE (object);
 
   g_object_unref (keytable->context);
+  g_strfreev (keytable->patterns);
   g_list_foreach (keytable->keys, (GFunc) gpgme_key_unref, NULL);
   g_list_free (keytable->keys);
 }
 
 /* Internal functions */
 
+/* Return true if there are PATTERNS left which have not yet been
+   listed.  */
+static int
+more_patterns (GpaKeyTable *keytable)
+{
+  return (keytable->patterns
+          && keytable->patterns[keytable->patterns_pos]);
+}
+
+/* Start listing the keys given by FPR or, if set, the next batch of
+   PATTERNS.  */
+static gpg_error_t
+start_keylist (GpaKeyTable *keytable)
+{
+  if (keytable->patterns)
+    {
+      const char *batch[MAX_KEYLIST_PATTERNS + 1];
+      gchar **pattern = keytable->patterns + keytable->patterns_pos;
+      int n;
+
+      /* The engine copies the patterns.  */
+      for (n = 0; n < MAX_KEYLIST_PATTERNS && pattern[n]; n++)
+        batch[n] = pattern[n];
+      batch[n] = NULL;
+      keytable->patterns_pos += n;
+      return gpgme_op_keylist_ext_start (keytable->context->ctx, batch,
+                                         keytable->secret, 0);
+    }
+  return gpgme_op_keylist_start (keytable->context->ctx, keytable->fpr,
+				 keytable->secret);
+}
+
 static void
 reload_cache (GpaKeyTable *keytable, const char *fpr)
 {
@@ -124,11 +162,13 @@ reload_cache (GpaKeyTable *keytable, const char *fpr)
   keytable->did_first_half = 0;
   keytable->first_half_err = 0;
   keytable->fpr = fpr;
+  keytable->patterns_pos = 0;
   gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
-  err = gpgme_op_keylist_start (keytable->context->ctx, fpr,
-				keytable->secret);
+  err = start_keylist (keytable);
   if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
     {
+      g_strfreev (keytable->patterns);
+      keytable->patterns = NULL;
       gpa_gpgme_warning (err);
       if (keytable->end)
 	{
@@ -148,15 +188,44 @@ done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
         gpa_gpgme_warning (keytable->first_half_err);
       if (err)
         gpa_gpgme_warning (err);
-      return;
+      /* When loading individual keys, keep those which have been
+         listed before the error.  */
+      if (!keytable->new_key)
+        return;
     }
   /* Reverse the list to have the keys come up in the same order they
    * were listed */
   keytable->tmp_list = g_list_reverse (keytable->tmp_list);
   if (keytable->new_key)
     {
-      /* Append the new key(s)
+      GList *item, *next;
+      GHashTable *listed;
+
+      /* Drop the old versions of the listed keys and append the new
+       * key(s)
        */
+      listed = g_hash_table_new (g_str_hash, g_str_equal);
+      for (item = keytable->tmp_list; item; item = g_list_next (item))
+	{
+	  gpgme_key_t key = item->data;
+
+	  if (key->subkeys && key->subkeys->fpr)
+	    g_hash_table_insert (listed, key->subkeys->fpr,
+				 GINT_TO_POINTER (1));
+	}
+      for (item = keytable->keys; item; item = next)
+	{
+	  gpgme_key_t key = item->data;
+
+	  next = g_list_next (item);
+	  if (key->subkeys && key->subkeys->fpr
+	      && g_hash_table_lookup (listed, key->subkeys->fpr))
+	    {
+	      gpgme_key_unref (key);
+	      keytable->keys = g_list_delete_link (keytable->keys, item);
+	    }
+	}
+      g_hash_table_destroy (listed);
       keytable->keys = g_list_concat (keytable->keys, keytable->tmp_list);
     }
   else
@@ -183,6 +252,15 @@ static void
 first_half_done_cb (GpaContext *context, gpg_error_t err,
                     GpaKeyTable *keytable)
 {
+  /* Continue with the next batch of patterns.  On error the keys
+     listed so far are kept.  */
+  if (!err && more_patterns (keytable))
+    {
+      err = start_keylist (keytable);
+      if (!err)
+        return;
+    }
+
   if (keytable->did_first_half || !cms_hack)
     {
       /* We are here for the second time and thus we continue with the
@@ -190,6 +268,8 @@ first_half_done_cb (GpaContext *context, gpg_error_t err,
          been enabled.  We reset the protocol to OpenPGP because some
          old code might assume that it is in OpenPGP mode.  */
       keytable->fpr = NULL; /* Not needed anymore.  */
+      g_strfreev (keytable->patterns);
+      keytable->patterns = NULL;
       gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
       done_cb (context, err, keytable);
       return;
@@ -201,12 +281,13 @@ first_half_done_cb (GpaContext *context, gpg_error_t err,
   keytable->did_first_half = 1;
 
   gpgme_set_protocol (context->ctx, GPGME_PROTOCOL_CMS);
-  err = gpgme_op_keylist_start (keytable->context->ctx,
-                                keytable->fpr,
-				keytable->secret);
+  keytable->patterns_pos = 0;
+  err = start_keylist (keytable);
   keytable->fpr = NULL; /* Not needed anymore.  */
   if (err)
     {
+      g_strfreev (keytable->patterns);
+      keytable->patterns = NULL;
       if (keytable->first_half_err)
         gpa_gpgme_warning (keytable->first_half_err);
 
@@ -331,6 +412,7 @@ gpa_keytable_list_keys (GpaKeyTable *keytable,
   keytable->end = end;
   keytable->data = data;
   /* List keys */
+  keytable->new_key = FALSE;
   if (keytable->keys)
     {
       /* There is a cached list */
@@ -358,6 +440,7 @@ gpa_keytable_force_reload (GpaKeyTable *keytable,
   keytable->end = end;
   keytable->data = data;
   /* List keys */
+  keytable->new_key = FALSE;
   reload_cache (keytable, NULL);
 }
 
@@ -383,6 +466,58 @@ gpa_keytable_load_new (GpaKeyTable *keytable,
   reload_cache (keytable, fpr);
 }
 
+/* Load the keys with the given fingerprints from GnuPG, replacing
+ * them in the keytable.
+ */
+void
+gpa_keytable_load_keys (GpaKeyTable *keytable,
+                        const char **fprs,
+                        GpaKeyTableNextFunc next,
+                        GpaKeyTableEndFunc end,
+                        gpointer data)
+{
+  g_return_if_fail (keytable != NULL);
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+
+  /* Set up callbacks */
+  keytable->next = next;
+  keytable->end = end;
+  keytable->data = data;
+  /* List keys */
+  keytable->new_key = TRUE;
+  g_strfreev (keytable->patterns);
+  keytable->patterns = g_strdupv ((gchar **) fprs);
+  reload_cache (keytable, NULL);
+}
+
+/* Remove the keys with the fingerprints FPRS from the keytable.
+ */
+void
+gpa_keytable_remove_keys (GpaKeyTable *keytable, const char **fprs)
+{
+  GHashTable *set;
+  GList *item, *next;
+  int idx;
+
+  set = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; fprs[idx]; idx++)
+    g_hash_table_insert (set, (gpointer) fprs[idx], GINT_TO_POINTER (1));
+
+  for (item = keytable->keys; item; item = next)
+    {
+      gpgme_key_t key = item->data;
+
+      next = g_list_next (item);
+      if (key->subkeys && key->subkeys->fpr
+          && g_hash_table_lookup (set, key->subkeys->fpr))
+	{
+	  gpgme_key_unref (key);
+	  keytable->keys = g_list_delete_link (keytable->keys, item);
+	}
+    }
+  g_hash_table_destroy (set);
+}
+
 /* Return the key with a given fingerprint from the keytable, NULL if
    there is none. No reference is provided.  */
 gpgme_key_t
@@ -55,6 +55,8 @@ struct _GpaKeyTable {
   GpaKeyTableEndFunc end;
   gpointer data;
   const char *fpr;
+  gchar **patterns;
+  int patterns_pos;
   int did_first_half;
   gpg_error_t first_half_err;
 
@@ -104,6 +106,21 @@ void gpa_keytable_load_new (GpaKeyTable *keytable,
 			    GpaKeyTableEndFunc end,
 			    gpointer data);
 
+/* Load the keys with the fingerprints in the NULL terminated array
+ * FPRS from GnuPG, replacing them in the keytable.  FPRS may be freed
+ * after the call.
+ */
+void gpa_keytable_load_keys (GpaKeyTable *keytable,
+			     const char **fprs,
+			     GpaKeyTableNextFunc next,
+			     GpaKeyTableEndFunc end,
+			     gpointer data);
+
+/* Remove the keys with the fingerprints in the NULL terminated array
+ * FPRS from the keytable.
+ */
+void gpa_keytable_remove_keys (GpaKeyTable *keytable, const char **fprs);
+
 /* Return the key with a given fingerprint from the keytable, NULL if
    there is none. No reference is provided.  */
 gpgme_key_t gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr);
@@ -55,9 +55,18 @@ put_membuf (membuf_t *mb, const void *buf, size_t len)
   if (mb->len + len >= mb->size)
     {
       char *p;
-      
-      mb->size += len + 1024;
-      p = g_try_realloc (mb->buf, mb->size);
+      size_t newsize = mb->size;
+
+      /* Double the size so that appending many small pieces does not
+         take quadratic time.  */
+      while (newsize <= mb->len + len && newsize <= (size_t)(-1) / 2)
+        newsize *= 2;
+      if (newsize <= mb->len + len)
+        newsize = mb->len + len + 1;
+      mb->size = newsize;
+      /* Do not use realloc: it may leave a copy of the old contents
+         behind, which might be sensitive.  */
+      p = g_try_malloc (mb->size);
       if (!p)
         {
           mb->out_of_core = errno ? errno : ENOMEM;
@@ -68,6 +77,9 @@ put_membuf (membuf_t *mb, const void *buf, size_t len)
           memset (mb->buf, 0, mb->len);
           return;
         }
+      memcpy (p, mb->buf, mb->len);
+      memset (mb->buf, 0, mb->len);
+      g_free (mb->buf);
       mb->buf = p;
     }
   memcpy (mb->buf + mb->len, buf, len);
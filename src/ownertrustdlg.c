@@ -85,50 +85,25 @@ get_selected_validity (GtkWidget *unknown_radio, GtkWidget *never_radio,
     }
 }
 
-/* Run the owner trust dialog modally. */
-gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
-				    gpgme_validity_t *return_trust)
+/* Create the "Owner Trust" frame and return the radio buttons.  */
+static GtkWidget *
+create_trust_frame (GtkWidget **unknown_radio, GtkWidget **never_radio,
+                    GtkWidget **marginal_radio, GtkWidget **full_radio,
+                    GtkWidget **ultimate_radio)
 {
-  GtkWidget *dialog;
-  GtkWidget *key_info;
-  GtkWidget *table;
   GtkWidget *frame;
-  GtkWidget *unknown_radio, *never_radio, *marginal_radio, *full_radio,
-    *ultimate_radio;
+  GtkWidget *table;
   GtkWidget *label;
-  GtkResponseType response;
-  gpgme_validity_t trust = key->owner_trust;
-  gboolean result;
-
-  /* Create the dialog */
-
-  dialog = gtk_dialog_new_with_buttons
-    (_("Change key ownertrust"), GTK_WINDOW(parent), GTK_DIALOG_MODAL,
-     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
-     GTK_STOCK_OK, GTK_RESPONSE_OK,
-     NULL);
-  gtk_dialog_set_alternative_button_order (GTK_DIALOG (dialog),
-                                           GTK_RESPONSE_OK,
-                                           GTK_RESPONSE_CANCEL,
-                                           -1);
-  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
-  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
-
-  key_info = gpa_key_info_new (key);
-  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox), key_info);
-
-  /* Create the "Owner Trust" frame */
 
   frame = gtk_frame_new (_("Owner Trust"));
-  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox), frame);
   table = gtk_table_new (10, 2, FALSE);
   gtk_container_add (GTK_CONTAINER (frame), table);
 
-  unknown_radio = gtk_radio_button_new (NULL);
-  gtk_table_attach (GTK_TABLE (table), unknown_radio, 0, 1, 0, 1, 
+  *unknown_radio = gtk_radio_button_new (NULL);
+  gtk_table_attach (GTK_TABLE (table), *unknown_radio, 0, 1, 0, 1, 
                     0, 0, 0, 0);
   label = gtk_label_new_with_mnemonic (_("_Unknown"));
-  gtk_label_set_mnemonic_widget (GTK_LABEL (label), unknown_radio);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), *unknown_radio);
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 0, 1);
 
@@ -138,12 +113,12 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 1, 2);
 
-  never_radio = gtk_radio_button_new_from_widget 
-    (GTK_RADIO_BUTTON (unknown_radio));
-  gtk_table_attach (GTK_TABLE (table), never_radio, 0, 1, 2, 3,
+  *never_radio = gtk_radio_button_new_from_widget 
+    (GTK_RADIO_BUTTON (*unknown_radio));
+  gtk_table_attach (GTK_TABLE (table), *never_radio, 0, 1, 2, 3,
                     0, 0, 0, 0);
   label = gtk_label_new_with_mnemonic (_("_Never"));
-  gtk_label_set_mnemonic_widget (GTK_LABEL (label), never_radio);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), *never_radio);
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 2, 3);
 
@@ -153,12 +128,12 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 3, 4);
 
-  marginal_radio = gtk_radio_button_new_from_widget 
-    (GTK_RADIO_BUTTON (unknown_radio));
-  gtk_table_attach (GTK_TABLE (table), marginal_radio, 0, 1, 4, 5,
+  *marginal_radio = gtk_radio_button_new_from_widget 
+    (GTK_RADIO_BUTTON (*unknown_radio));
+  gtk_table_attach (GTK_TABLE (table), *marginal_radio, 0, 1, 4, 5,
                     0, 0, 0, 0);
   label = gtk_label_new_with_mnemonic (_("_Marginal"));
-  gtk_label_set_mnemonic_widget (GTK_LABEL (label), marginal_radio);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), *marginal_radio);
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 4, 5);
 
@@ -175,12 +150,12 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 5, 6);
 
-  full_radio = gtk_radio_button_new_from_widget 
-    (GTK_RADIO_BUTTON (unknown_radio));
-  gtk_table_attach (GTK_TABLE (table), full_radio, 0, 1, 6, 7,
+  *full_radio = gtk_radio_button_new_from_widget 
+    (GTK_RADIO_BUTTON (*unknown_radio));
+  gtk_table_attach (GTK_TABLE (table), *full_radio, 0, 1, 6, 7,
                     0, 0, 0, 0);
   label = gtk_label_new_with_mnemonic (_("_Full"));
-  gtk_label_set_mnemonic_widget (GTK_LABEL (label), full_radio);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), *full_radio);
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 6, 7);
 
@@ -193,12 +168,12 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 7, 8);
 
-  ultimate_radio = gtk_radio_button_new_from_widget 
-    (GTK_RADIO_BUTTON (unknown_radio));
-  gtk_table_attach (GTK_TABLE (table), ultimate_radio, 0, 1, 8, 9,
+  *ultimate_radio = gtk_radio_button_new_from_widget 
+    (GTK_RADIO_BUTTON (*unknown_radio));
+  gtk_table_attach (GTK_TABLE (table), *ultimate_radio, 0, 1, 8, 9,
                     0, 0, 0, 0);
   label = gtk_label_new_with_mnemonic (_("U_ltimate"));
-  gtk_label_set_mnemonic_widget (GTK_LABEL (label), ultimate_radio);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), *ultimate_radio);
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 8, 9);
 
@@ -212,6 +187,46 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.0);
   gtk_table_attach_defaults (GTK_TABLE (table), label, 1, 2, 9, 10);
 
+  return frame;
+}
+
+
+/* Run the owner trust dialog modally. */
+gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
+				    gpgme_validity_t *return_trust)
+{
+  GtkWidget *dialog;
+  GtkWidget *key_info;
+  GtkWidget *frame;
+  GtkWidget *unknown_radio, *never_radio, *marginal_radio, *full_radio,
+    *ultimate_radio;
+  GtkResponseType response;
+  gpgme_validity_t trust = key->owner_trust;
+  gboolean result;
+
+  /* Create the dialog */
+
+  dialog = gtk_dialog_new_with_buttons
+    (_("Change key ownertrust"), GTK_WINDOW(parent), GTK_DIALOG_MODAL,
+     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+     GTK_STOCK_OK, GTK_RESPONSE_OK,
+     NULL);
+  gtk_dialog_set_alternative_button_order (GTK_DIALOG (dialog),
+                                           GTK_RESPONSE_OK,
+                                           GTK_RESPONSE_CANCEL,
+                                           -1);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
+
+  key_info = gpa_key_info_new (key);
+  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox), key_info);
+
+  /* Create the "Owner Trust" frame */
+
+  frame = create_trust_frame (&unknown_radio, &never_radio, &marginal_radio,
+                              &full_radio, &ultimate_radio);
+  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox), frame);
+
   /* Initialize */
   init_radio_buttons (trust, unknown_radio, never_radio, marginal_radio, 
                       full_radio, ultimate_radio);
@@ -249,3 +264,72 @@ gboolean gpa_ownertrust_run_dialog (gpgme_key_t key, GtkWidget *parent,
   gtk_widget_destroy (dialog);
   return result;
 }
+
+
+/* Run the owner trust dialog modally for all keys in KEYS.  The
+   dialog starts with the owner trust of the keys if they all have the
+   same.  */
+gboolean
+gpa_ownertrust_run_dialog_multiple (GList *keys, GtkWidget *parent,
+                                    gpgme_validity_t *return_trust)
+{
+  GtkWidget *dialog;
+  GtkWidget *label;
+  GtkWidget *frame;
+  GtkWidget *unknown_radio, *never_radio, *marginal_radio, *full_radio,
+    *ultimate_radio;
+  GtkResponseType response;
+  gpgme_validity_t trust = GPGME_VALIDITY_UNKNOWN;
+  GList *item;
+  gchar *string;
+  guint nkeys = g_list_length (keys);
+
+  dialog = gtk_dialog_new_with_buttons
+    (_("Change key ownertrust"), GTK_WINDOW(parent), GTK_DIALOG_MODAL,
+     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+     GTK_STOCK_OK, GTK_RESPONSE_OK,
+     NULL);
+  gtk_dialog_set_alternative_button_order (GTK_DIALOG (dialog),
+                                           GTK_RESPONSE_OK,
+                                           GTK_RESPONSE_CANCEL,
+                                           -1);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
+
+  string = g_strdup_printf (ngettext ("Set the owner trust of %u key:",
+                                      "Set the owner trust of %u keys:",
+                                      nkeys), nkeys);
+  label = gtk_label_new (string);
+  g_free (string);
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_box_pack_start (GTK_BOX (GTK_DIALOG (dialog)->vbox), label,
+                      FALSE, FALSE, 5);
+
+  frame = create_trust_frame (&unknown_radio, &never_radio, &marginal_radio,
+                              &full_radio, &ultimate_radio);
+  gtk_box_pack_start_defaults (GTK_BOX (GTK_DIALOG (dialog)->vbox), frame);
+
+  for (item = keys; item; item = g_list_next (item))
+    {
+      gpgme_key_t key = item->data;
+
+      if (item == keys)
+        trust = key->owner_trust;
+      else if (key->owner_trust != trust)
+        {
+          trust = GPGME_VALIDITY_UNKNOWN;
+          break;
+        }
+    }
+  init_radio_buttons (trust, unknown_radio, never_radio, marginal_radio,
+                      full_radio, ultimate_radio);
+
+  gtk_widget_show_all (dialog);
+  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  if (response == GTK_RESPONSE_OK)
+    *return_trust = get_selected_validity (unknown_radio, never_radio,
+                                           marginal_radio, full_radio,
+                                           ultimate_radio);
+  gtk_widget_destroy (dialog);
+  return response == GTK_RESPONSE_OK;
+}
@@ -28,13 +28,10 @@
 #include <glib.h>
 #include <assert.h>
 #include <ctype.h>
-#include <signal.h>
 
 /* For unlink() */
 #ifdef G_OS_UNIX
 #include <unistd.h>
-#include <sys/types.h>
-#include <sys/wait.h>
 #else
 #include <windows.h>
 #include <io.h>
@@ -359,11 +356,10 @@ wait_dialog (const gchar *server, GtkWidget *parent)
 {
   GtkWidget *dialog =
     gtk_message_dialog_new (GTK_WINDOW (parent),
-			    GTK_DIALOG_MODAL,
+			    GTK_DIALOG_DESTROY_WITH_PARENT,
 			    GTK_MESSAGE_INFO, GTK_BUTTONS_NONE,
 			    _("Connecting to server \"%s\".\n"
 			      "Please wait."), server);
-  /* FIXME: The dialog is not displayed */
   gtk_widget_show_all (dialog);
   return dialog;
 }
@@ -414,55 +410,175 @@ check_errors (int exit_status, gchar *error_message, gchar *output_filename,
   return FALSE;
 }
 
-/* This is a hack: when a SIGCHLD is received, close the dialog. We need a
- * global variable to pass the dialog to the signal handler. */
-#ifdef G_OS_UNIX
-GtkWidget *waiting_dlg;
+/* The state of one invocation of a keyserver helper.  Several of
+ * them may run at the same time.
+ */
+typedef struct helper_job_s *helper_job_t;
+struct helper_job_s
+{
+  gchar *server;
+  gchar *keyserver;	/* Parsed copy of SERVER; SCHEME points into it.  */
+  gchar *scheme;
+  gchar *command_filename;
+  gchar *output_filename;
+  int output_fd;
+  GtkWidget *parent;	/* Cleared when the window is destroyed.  */
+  gulong parent_destroy_id;
+  GtkWidget *dialog;	/* Cleared when the dialog is destroyed.  */
+  GPid pid;
+  GString *error_output;
+  gint exit_status;
+  int pending;		/* The child watch and the stderr channel.  */
+  gboolean success;
+
+  /* Called with the result once the helper has finished.  */
+  void (*finish) (helper_job_t job);
+  guint nkeys;
+  server_get_key_cb_t get_cb;
+  server_send_cb_t send_cb;
+  gpointer opaque;
+};
+
+
+static helper_job_t
+helper_job_new (const gchar *server, GtkWidget *parent)
+{
+  helper_job_t job = g_malloc0 (sizeof *job);
+
+  job->server = g_strdup (server);
+  job->keyserver = g_strdup (server);
+  job->output_fd = -1;
+  job->parent = parent;
+  if (parent)
+    job->parent_destroy_id =
+      g_signal_connect (G_OBJECT (parent), "destroy",
+                        G_CALLBACK (gtk_widget_destroyed), &job->parent);
+  job->error_output = g_string_new (NULL);
+  return job;
+}
+
+
 static void
-close_dialog (int sig)
+helper_job_free (helper_job_t job)
 {
-  gtk_dialog_response (GTK_DIALOG (waiting_dlg), GTK_RESPONSE_CLOSE);
+  if (job->dialog)
+    gtk_widget_destroy (job->dialog);
+  if (job->parent)
+    g_signal_handler_disconnect (G_OBJECT (job->parent),
+                                 job->parent_destroy_id);
+  if (job->command_filename)
+    {
+      unlink (job->command_filename);
+      g_free (job->command_filename);
+    }
+  if (job->output_fd != -1)
+    close (job->output_fd);
+  if (job->output_filename)
+    {
+      unlink (job->output_filename);
+      g_free (job->output_filename);
+    }
+  g_string_free (job->error_output, TRUE);
+  g_free (job->keyserver);
+  g_free (job->server);
+  g_free (job);
 }
-#endif /*G_OS_UNIX*/
 
-/* Run the helper, and update the dialog if possible. Returns FALSE on error */
+
+/* Deliver the result of JOB and release it.  */
+static void
+helper_job_finish (helper_job_t job)
+{
+  if (job->dialog)
+    {
+      gtk_widget_destroy (job->dialog);
+      job->dialog = NULL;
+    }
+  job->finish (job);
+  helper_job_free (job);
+}
+
+
+/* Called for each of the two events which end a helper run.  */
+static void
+helper_job_event (helper_job_t job)
+{
+  if (--job->pending)
+    return;
+
+  g_spawn_close_pid (job->pid);
+  /* Check for errors in the output.  */
+  job->success = !check_errors (job->exit_status, job->error_output->str,
+                                job->output_filename,
+                                protocol_version (job->scheme),
+                                job->dialog);
+  helper_job_finish (job);
+}
+
+
+static void
+helper_child_watch_cb (GPid pid, gint status, gpointer data)
+{
+  helper_job_t job = data;
+
+  job->exit_status = status;
+  helper_job_event (job);
+}
+
+
+/* Collect the error messages of the helper.  */
 static gboolean
-do_spawn (const gchar *scheme, const gchar *command_filename,
-          const gchar *output_filename, gchar **error_output,
-          gint *exit_status, GtkWidget *dialog)
+helper_stderr_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  helper_job_t job = data;
+  gchar buffer[256];
+  gsize nread = 0;
+  GIOStatus status;
+
+  status = g_io_channel_read_chars (channel, buffer, sizeof buffer,
+                                    &nread, NULL);
+  if (nread)
+    g_string_append_len (job->error_output, buffer, nread);
+  if (status == G_IO_STATUS_NORMAL || status == G_IO_STATUS_AGAIN)
+    return TRUE;
+
+  /* This closes the pipe once the watch has been removed.  */
+  g_io_channel_unref (channel);
+  helper_job_event (job);
+  return FALSE;
+}
+
+
+/* Run the helper for the command file of JOB without blocking.  The
+ * finish function of JOB is called when the helper has finished.
+ */
+static void
+helper_job_start (helper_job_t job)
 {
   gchar *helper_argv[] = {NULL, "-o", NULL, NULL, NULL};
   GError *error = NULL;
-#ifdef G_OS_UNIX
-  pid_t pid;
   gint standard_error;
-  gsize length;
   GIOChannel *channel;
-#endif
 
-  /* Make sure output parameters get a sane value */
-  *error_output = NULL;
-  *exit_status = 127;
+  /* Display a pretty dialog */
+  job->dialog = wait_dialog (job->server, job->parent);
+  /* The dialog goes away with its parent window.  */
+  g_signal_connect (G_OBJECT (job->dialog), "destroy",
+                    G_CALLBACK (gtk_widget_destroyed), &job->dialog);
+  /* Open the output file */
+  job->output_fd = g_file_open_tmp (OUTPUT_TEMP_NAME, &job->output_filename,
+                                    NULL);
   /* Build the command line */
-  helper_argv[0] = helper_path (scheme);
-  helper_argv[2] = (gchar*) output_filename;
-  helper_argv[3] = (gchar*) command_filename;
+  helper_argv[0] = helper_path (job->scheme);
+  helper_argv[2] = job->output_filename;
+  helper_argv[3] = job->command_filename;
 
   /* Invoke the keyserver helper */
-#ifdef G_OS_UNIX
-  /* On Unix, run the helper asyncronously, so that we can update the dialog */
   g_spawn_async_with_pipes (NULL, helper_argv, NULL,
                             G_SPAWN_STDOUT_TO_DEV_NULL|
                             G_SPAWN_DO_NOT_REAP_CHILD,
-                            NULL, NULL, &pid, NULL, NULL, &standard_error,
-                            &error);
-#else
-  /* On Windows, use syncronous spawn */
-  g_spawn_sync (NULL, helper_argv, NULL,
-		G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL,
-		NULL, error_output, exit_status, &error);
-#endif
-
+                            NULL, NULL, &job->pid, NULL, NULL,
+                            &standard_error, &error);
   /* Free the helper's filename */
   g_free (helper_argv[0]);
 
@@ -471,146 +587,293 @@ do_spawn (const gchar *scheme, const gchar *command_filename,
       /* An error ocurred in the fork/exec: we assume that there is no plugin.
        */
       gpa_window_error (_("There is no plugin available for the keyserver\n"
-                          "protocol you specified."), dialog);
-      return FALSE;
+                          "protocol you specified."), job->dialog);
+      g_error_free (error);
+      job->success = FALSE;
+      helper_job_finish (job);
+      return;
     }
 
-#ifdef G_OS_UNIX
-  /* FIXME: Could we do this properly, without a global variable? */
-  /* We run the dialog until we get a SIGCHLD, meaning the helper has
-   * finnished, then we wait for it. */
-  waiting_dlg = dialog;
-  signal (SIGCHLD, close_dialog);
-  gtk_dialog_run (GTK_DIALOG (dialog));
-  signal (SIGCHLD, SIG_DFL);
-  wait (exit_status);
-  /* Read stderr, since we need any error message */
+  job->pending = 2;
   channel = g_io_channel_unix_new (standard_error);
-  g_io_channel_read_to_end (channel, error_output, &length, NULL);
-  g_io_channel_unref (channel);
-  /* Make sure the pipe is closed */
-  close (standard_error);
-#endif
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_buffered (channel, FALSE);
+  g_io_channel_set_close_on_unref (channel, TRUE);
+  g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                  helper_stderr_cb, job);
+  g_child_watch_add (job->pid, helper_child_watch_cb, job);
+}
 
-  return TRUE;
+
+/* Parse the keyserver of JOB and create its command file with
+ * COMMAND.  Returns the command file or NULL on error.
+ */
+static FILE *
+helper_job_command (helper_job_t job, const char *command_name)
+{
+  gchar *host, *port, *opaque;
+  int command_fd;
+  FILE *command;
+
+  /* Parse the URI */
+  if (!parse_keyserver_uri (job->keyserver, &job->scheme, &host, &port,
+                            &opaque))
+    {
+      gpa_window_error (_("The keyserver you specified is not valid"),
+                        job->parent);
+      return NULL;
+    }
+  /* Create a temp command file */
+  command_fd = g_file_open_tmp (COMMAND_TEMP_NAME, &job->command_filename,
+                                NULL);
+  command = fdopen (command_fd, "w");
+  /* Write the command to the file */
+  write_command (command, job->scheme, host, port, opaque, command_name);
+  return command;
 }
 
-static gboolean
-invoke_helper (const gchar *server, const gchar *scheme,
-               gchar *command_filename, gchar **output_filename,
-               GtkWidget *parent)
+
+/* Return the CRC-24 checksum of BUF as used by OpenPGP armor.  */
+static guint32
+crc24 (const guchar *buf, gsize len)
 {
-  int exit_status;
-  int output_fd;
-  gchar *error_output;
-  GtkWidget *dialog = NULL;
-  gboolean result = TRUE;
+  guint32 crc = 0xb704ce;
+  int i;
 
-  /* Display a pretty dialog */
-  dialog = wait_dialog (server, parent);
-  /* Open the output file */
-  output_fd = g_file_open_tmp (OUTPUT_TEMP_NAME, output_filename, NULL);
-  /* Run the helper */
-  result = do_spawn (scheme, command_filename, *output_filename, &error_output,
-                     &exit_status, dialog);
-  /* If the exec went well, check for errors in the output */
-  if (result)
+  while (len--)
+    {
+      crc ^= (*buf++) << 16;
+      for (i = 0; i < 8; i++)
+	{
+	  crc <<= 1;
+	  if (crc & 0x1000000)
+	    crc ^= 0x1864cfb;
+	}
+    }
+  return crc & 0xffffff;
+}
+
+/* Write the OpenPGP key in BUF of length LEN as an armored key block
+ * to FILE.
+ */
+static void
+write_armored_key (FILE *file, const guchar *buf, gsize len)
+{
+  guint32 crc = crc24 (buf, len);
+  guchar crcbuf[3];
+  gchar *b64;
+  gsize b64len, i;
+
+  fputs ("-----BEGIN PGP PUBLIC KEY BLOCK-----\n\n", file);
+  b64 = g_base64_encode (buf, len);
+  b64len = strlen (b64);
+  for (i = 0; i < b64len; i += 64)
+    fprintf (file, "%.64s\n", b64 + i);
+  g_free (b64);
+  crcbuf[0] = crc >> 16;
+  crcbuf[1] = crc >> 8;
+  crcbuf[2] = crc;
+  b64 = g_base64_encode (crcbuf, 3);
+  fprintf (file, "=%s\n", b64);
+  g_free (b64);
+  fputs ("-----END PGP PUBLIC KEY BLOCK-----\n", file);
+}
+
+/* Return the key ID of the public key packet BODY.  The key ID is
+ * only computed for version 4 keys; for other keys a placeholder
+ * derived from INDEX is returned.
+ */
+static gchar *
+packet_keyid (const guchar *body, gsize len, guint index)
+{
+  GChecksum *sha1;
+  guchar prefix[3];
+  guint8 digest[20];
+  gsize digestlen = sizeof digest;
+  gchar *keyid;
+  int i;
+
+  if (!len || body[0] != 4 || len > 0xffff)
+    return g_strdup_printf ("%016X", index);
+
+  prefix[0] = 0x99;
+  prefix[1] = len >> 8;
+  prefix[2] = len;
+  sha1 = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (sha1, prefix, 3);
+  g_checksum_update (sha1, body, len);
+  g_checksum_get_digest (sha1, digest, &digestlen);
+  g_checksum_free (sha1);
+
+  keyid = g_malloc (17);
+  for (i = 0; i < 8; i++)
+    sprintf (keyid + 2 * i, "%02X", digest[12 + i]);
+  return keyid;
+}
+
+/* Write each key of the unarmored export in BUF to the command FILE
+ * in its own KEY block.  Returns the number of keys written.
+ */
+static guint
+write_key_blocks (FILE *file, const guchar *buf, gsize len)
+{
+  gsize off = 0;
+  gsize start = 0;
+  gchar *keyid = NULL;
+  guint nkeys = 0;
+
+  while (off < len)
     {
-      result = !check_errors (exit_status, error_output, *output_filename,
-                              protocol_version (scheme), dialog);
+      int tag;
+      gsize hdrlen, bodylen;
+
+      if (!gpa_openpgp_parse_packet (buf + off, len - off, &tag,
+				      &hdrlen, &bodylen))
+	break;
+      if (tag == 6)
+	{
+	  /* A public key packet starts the next key.  */
+	  if (keyid)
+	    {
+	      fprintf (file, "\nKEY %s BEGIN\n", keyid);
+	      write_armored_key (file, buf + start, off - start);
+	      fprintf (file, "\nKEY %s END\n", keyid);
+	      g_free (keyid);
+	    }
+	  keyid = packet_keyid (buf + off + hdrlen, bodylen, nkeys++);
+	  start = off;
+	}
+      off += hdrlen + bodylen;
+    }
+  if (keyid)
+    {
+      fprintf (file, "\nKEY %s BEGIN\n", keyid);
+      write_armored_key (file, buf + start, off - start);
+      fprintf (file, "\nKEY %s END\n", keyid);
+      g_free (keyid);
     }
-  close (output_fd);
-  g_free (error_output);
-  /* Destroy the dialog */
-  gtk_widget_destroy (dialog);
 
-  return result;
+  return nkeys;
+}
+
+/* Append the IDs of the keys the helper failed to send to R_FAILED.
+ * Keys which already exist on the server are not considered as
+ * failed.
+ */
+static void
+collect_failed_keys (const gchar *filename, GList **r_failed)
+{
+  FILE *file = fopen (filename, "r");
+  char line[80];
+  char keyid[17];
+  gint error;
+
+  if (!file)
+    return;
+
+  while (fgets (line, sizeof (line), file) != NULL)
+    if (sscanf (line, "KEY %16s FAILED %i\n", keyid, &error) == 2
+	&& error != KEYSERVER_KEY_EXISTS)
+      *r_failed = g_list_append (*r_failed, g_strdup (keyid));
+  fclose (file);
+}
+
+/* Finish function for sending keys.  */
+static void
+send_finish (helper_job_t job)
+{
+  GList *failed = NULL;
+
+  if (job->output_filename)
+    collect_failed_keys (job->output_filename, &failed);
+  job->send_cb (job->success, job->nkeys, failed, job->opaque);
+}
+
+
+/* Finish function for fetching a key.  */
+static void
+get_finish (helper_job_t job)
+{
+  gpgme_data_t data = NULL;
+  gpg_error_t err;
+
+  /* No error checking: the import will take care of that. */
+  if (job->output_filename)
+    err = gpa_gpgme_data_new_from_file (&data, job->output_filename,
+                                        job->parent);
+  else
+    err = gpgme_data_new (&data);
+  if (err)
+    gpa_gpgme_error (err);
+  job->get_cb (job->success, data, job->opaque);
 }
 
+
 /* Public functions */
 
-gboolean
-server_send_keys (const gchar *server, const gchar *keyid,
-                  gpgme_data_t data, GtkWidget *parent)
+void
+server_send_key_block_start (const gchar *server, gpgme_data_t data,
+                             GtkWidget *parent,
+                             server_send_cb_t callback, gpointer opaque)
 {
-  gchar *keyserver = g_strdup (server);
-  gchar *command_filename, *output_filename;
-  int command_fd;
+  helper_job_t job = helper_job_new (server, parent);
   FILE *command;
-  gchar *scheme, *host, *port, *opaque;
-  gboolean success;
+  GByteArray *keys;
+  char buffer[4096];
+  ssize_t nread;
 
-  /* Parse the URI */
-  if (!parse_keyserver_uri (keyserver, &scheme, &host, &port, &opaque))
+  job->finish = send_finish;
+  job->send_cb = callback;
+  job->opaque = opaque;
+
+  command = helper_job_command (job, "SEND");
+  if (!command)
     {
-      gpa_window_error (_("The keyserver you specified is not valid"), parent);
-      return FALSE;
+      job->success = FALSE;
+      helper_job_finish (job);
+      return;
     }
-  /* Create a temp command file */
-  command_fd = g_file_open_tmp (COMMAND_TEMP_NAME, &command_filename, NULL);
-  command = fdopen (command_fd, "w");
-  /* Write the command to the file */
-  write_command (command, scheme, host, port, opaque, "SEND");
-  /* Write the keys to the file */
-  fprintf (command, "\nKEY %s BEGIN\n", keyid);
-  dump_data_to_file (data, command);
-  fprintf (command, "\nKEY %s END\n", keyid);
+  /* Write each key to the file */
+  keys = g_byte_array_new ();
+  if (gpgme_data_seek (data, 0, SEEK_SET) != -1)
+    while ((nread = gpgme_data_read (data, buffer, sizeof buffer)) > 0)
+      g_byte_array_append (keys, (guchar *) buffer, nread);
+  job->nkeys = write_key_blocks (command, keys->data, keys->len);
+  g_byte_array_free (keys, TRUE);
   fclose (command);
-  success = invoke_helper (server, scheme, command_filename,
-                           &output_filename, parent);
-  g_free (keyserver);
-  /* Delete temp files */
-  unlink (command_filename);
-  g_free (command_filename);
-  unlink (output_filename);
-  g_free (output_filename);
-
-  return success;
+
+  if (!job->nkeys)
+    {
+      job->success = FALSE;
+      helper_job_finish (job);
+    }
+  else
+    helper_job_start (job);
 }
 
-gboolean
-server_get_key (const gchar *server, const gchar *keyid,
-                gpgme_data_t *data, GtkWidget *parent)
+
+void
+server_get_key_start (const gchar *server, const gchar *keyid,
+                      GtkWidget *parent,
+                      server_get_key_cb_t callback, gpointer opaque)
 {
-  gchar *keyserver = g_strdup (server);
-  gchar *command_filename, *output_filename;
-  int command_fd;
+  helper_job_t job = helper_job_new (server, parent);
   FILE *command;
-  gchar *scheme, *host, *port, *opaque;
-  int success;
-  gpg_error_t err;
 
-  /* Parse the URI */
-  if (!parse_keyserver_uri (keyserver, &scheme, &host, &port, &opaque))
+  job->finish = get_finish;
+  job->get_cb = callback;
+  job->opaque = opaque;
+
+  command = helper_job_command (job, "GET");
+  if (!command)
     {
-      /* Create an empty gpgme_data_t, so that we always return a valid one */
-      err = gpgme_data_new (data);
-      if (err)
-        gpa_gpgme_error (err);
-      gpa_window_error (_("The keyserver you specified is not valid"), parent);
-      return FALSE;
+      job->success = FALSE;
+      helper_job_finish (job);
+      return;
     }
-  /* Create a temp command file */
-  command_fd = g_file_open_tmp (COMMAND_TEMP_NAME, &command_filename, NULL);
-  command = fdopen (command_fd, "w");
-  /* Write the command to the file */
-  write_command (command, scheme, host, port, opaque, "GET");
   /* Write the keys to the file */
   fprintf (command, "0x%s\n", keyid);
   fclose (command);
-  success = invoke_helper (server, scheme, command_filename,
-                           &output_filename, parent);
-  /* Read the output */
-  /* No error checking: the import will take care of that. */
-  err = gpa_gpgme_data_new_from_file (data, output_filename, parent);
-  if (err)
-    gpa_gpgme_error (err);
-  g_free (keyserver);
-  /* Delete temp files */
-  unlink (command_filename);
-  g_free (command_filename);
-  unlink (output_filename);
-  g_free (output_filename);
-
-  return success;
+
+  helper_job_start (job);
 }
@@ -29,14 +29,38 @@
 #include <gpgme.h>
 #include "gpa.h"
 
-/* Send the keys in NULL terminated array KEYS to the keyserver SERVER.
- * The PARENT window is used as parent for any dialog the function displays.
+/* The helpers run asynchronously and several of them may run at the
+ * same time.  A non-modal dialog is shown while a helper runs.  The
+ * PARENT window is used as parent for any dialog the functions
+ * display.
  */
-gboolean server_send_keys (const gchar *server, const gchar *keyid,
-		       gpgme_data_t data, GtkWidget *parent);
 
-gboolean server_get_key (const gchar *server, const gchar *keyid,
-                         gpgme_data_t *data, GtkWidget *parent);
+/* Called when a key has been fetched.  The callback takes ownership
+ * of DATA, which is always a valid data object.
+ */
+typedef void (*server_get_key_cb_t) (gboolean success, gpgme_data_t data,
+                                     gpointer opaque);
+
+/* Called when keys have been sent.  NKEYS is the number of keys sent
+ * and FAILED a list with the IDs of the keys the server rejected.
+ * The callback takes ownership of the list and its strings.
+ */
+typedef void (*server_send_cb_t) (gboolean success, guint nkeys,
+                                  GList *failed, gpointer opaque);
+
+/* Send the unarmored export of one or more keys in DATA to the
+ * keyserver SERVER with a single invocation of the helper.  Each key
+ * is sent in its own block.  DATA may be released when the function
+ * returns.
+ */
+void server_send_key_block_start (const gchar *server, gpgme_data_t data,
+                                  GtkWidget *parent,
+                                  server_send_cb_t callback, gpointer opaque);
+
+/* Fetch the key KEYID from the keyserver SERVER.  */
+void server_get_key_start (const gchar *server, const gchar *keyid,
+                           GtkWidget *parent,
+                           server_get_key_cb_t callback, gpointer opaque);
 
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 #endif /*SERVER_ACCESS_H*/
@@ -46,6 +46,7 @@
 #include "gpafiledecryptop.h"
 #include "gpafileverifyop.h"
 #include "gpafileimportop.h"
+#include "fileman.h"
 
 
 #define set_error(e,t) assuan_set_error (ctx, gpg_error (e), (t))
@@ -106,8 +107,10 @@ struct conn_ctrl_s
   unsigned int session_number;
   char *session_title;
 
-  /* The list of all files to be processed.  */
+  /* The list of all files to be processed and its last element.
+     FILES_TAIL is only valid if FILES is not NULL.  */
   GList *files;
+  GList *files_tail;
 };
 
 
@@ -1179,12 +1182,31 @@ static const char hlp_start_filemanager[] =
   "\n"
   "Pop up the file manager window.  The client expects that the file\n"
   "manager is brought into the foregound and that this command\n"
-  "immediatley returns.";
+  "immediatley returns.  Files given with the FILE command are\n"
+  "added to the file manager and the list of files is cleared.";
 static gpg_error_t
 cmd_start_filemanager (assuan_context_t ctx, char *line)
 {
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
   gpa_open_filemanager (NULL, NULL);
 
+  if (ctrl->files)
+    {
+      GSList *names = NULL;
+      GList *item;
+
+      for (item = ctrl->files; item; item = g_list_next (item))
+        names = g_slist_prepend
+          (names, ((gpa_file_item_t) item->data)->filename_in);
+      names = g_slist_reverse (names);
+      gpa_file_manager_open_files (GPA_FILE_MANAGER
+                                   (gpa_file_manager_get_instance ()),
+                                   names);
+      g_slist_free (names);
+      release_files (ctrl);
+    }
+
   return assuan_process_done (ctx, 0);
 }
 
@@ -1288,7 +1310,11 @@ cmd_file (assuan_context_t ctx, char *line)
 
   file_item = g_malloc0 (sizeof (*file_item));
   file_item->filename_in = g_strdup (line);
-  ctrl->files = g_list_append (ctrl->files, file_item);
+  /* Append in constant time; clients may send thousands of files.  */
+  if (! ctrl->files)
+    ctrl->files = ctrl->files_tail = g_list_append (NULL, file_item);
+  else
+    ctrl->files_tail = g_list_append (ctrl->files_tail, file_item)->next;
 
   return assuan_process_done (ctx, err);
 }
@@ -0,0 +1,1170 @@
+/* tarstream.c - Streaming tar archives for gpgme data objects.
+   Copyright (C) 2026 g10 Code GmbH
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+   The archive writer walks a directory tree while gpgme reads from
+   the data object, so that the archive never exists on disk.  Only
+   directories and regular files are stored.  The archive uses the
+   ustar format; names and sizes which do not fit into a ustar header
+   are described by a pax extended header.  A global extended header
+   with a comment marks the archive as created by GPA.
+
+   The reader writes the plaintext to a file as usual and extracts it
+   at the same time into a staging directory.  Only archives with the
+   GPA marker whose members are all below one top level directory are
+   extracted; anything which can't be represented exactly (links,
+   devices, absolute names, names with a ".." component) makes the
+   reader give up and remove the staging directory, so that the user
+   gets the plain archive file.  When the archive is complete, the top
+   level directory is renamed to the target directory and the archive
+   file may be removed.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include "tarstream.h"
+
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY	_O_BINARY
+#else
+#define O_BINARY	0
+#endif
+#endif
+
+
+#define BLOCKSIZE 512
+
+/* The largest size which fits into the 11 octal digits of the size
+   field.  */
+#define MAX_USTAR_SIZE ((((guint64) 1) << 33) - 1)
+
+/* Extended headers larger than this are not accepted.  */
+#define MAX_PAX_SIZE (1024 * 1024)
+
+/* The comment in the global extended header which marks archives
+   created by GPA.  Only those are extracted on decryption.  */
+#define GPA_TAR_MARKER "Folder archive created by GPA"
+
+/* The ustar header block.  All fields are character arrays, thus
+   there is no padding.  */
+struct ustar_header
+{
+  char name[100];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char size[12];
+  char mtime[12];
+  char checksum[8];
+  char typeflag;
+  char linkname[100];
+  char magic[6];
+  char version[2];
+  char uname[32];
+  char gname[32];
+  char devmajor[8];
+  char devminor[8];
+  char prefix[155];
+  char pad[12];
+};
+
+
+/* Store VALUE as octal number into the field FIELD of length LEN.  */
+static void
+put_octal (char *field, size_t len, guint64 value)
+{
+  char buf[32];
+
+  snprintf (buf, sizeof buf, "%0*" G_GINT64_MODIFIER "o",
+            (int) len - 1, value);
+  memcpy (field, buf, len);
+}
+
+
+/* Return the octal number in the field FIELD of length LEN.  */
+static guint64
+get_octal (const char *field, size_t len)
+{
+  guint64 value = 0;
+  size_t i;
+
+  for (i = 0; i < len && field[i] == ' '; i++)
+    ;
+  for (; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+    value = (value << 3) + (field[i] - '0');
+  return value;
+}
+
+
+/* Return the checksum of the header HDR.  The checksum field itself
+   is counted as spaces.  */
+static unsigned int
+header_checksum (const struct ustar_header *hdr)
+{
+  const unsigned char *p = (const unsigned char *) hdr;
+  unsigned int sum = 0;
+  size_t i;
+
+  for (i = 0; i < BLOCKSIZE; i++)
+    if (i >= offsetof (struct ustar_header, checksum)
+        && i < offsetof (struct ustar_header, checksum) + sizeof hdr->checksum)
+      sum += ' ';
+    else
+      sum += p[i];
+  return sum;
+}
+
+
+/* Append a pax record KEY=VALUE to PAX.  */
+static void
+add_pax_record (GString *pax, const char *key, const char *value)
+{
+  /* The length field counts the whole record including itself.  */
+  size_t len = strlen (key) + strlen (value) + 3;
+  size_t total = len + 1;
+  char buf[32];
+
+  while (snprintf (buf, sizeof buf, "%lu", (unsigned long) total)
+         != (int) (total - len))
+    total++;
+  g_string_append_printf (pax, "%lu %s=%s\n", (unsigned long) total,
+                          key, value);
+}
+
+
+/* Append LEN zero bytes to STR.  */
+static void
+append_zeros (GString *str, size_t len)
+{
+  static const char zeros[BLOCKSIZE];
+
+  while (len)
+    {
+      size_t n = MIN (len, sizeof zeros);
+
+      g_string_append_len (str, zeros, n);
+      len -= n;
+    }
+}
+
+
+/* Return the number of padding bytes after SIZE bytes of data.  */
+static size_t
+block_padding (guint64 size)
+{
+  return (BLOCKSIZE - (size % BLOCKSIZE)) % BLOCKSIZE;
+}
+
+
+/* Initialize HDR for the member NAME.  Returns FALSE if NAME does not
+   fit and needs to be given in an extended header.  */
+static gboolean
+init_header (struct ustar_header *hdr, const char *name, int typeflag,
+             unsigned int mode, guint64 size, guint64 mtime)
+{
+  size_t namelen = strlen (name);
+  gboolean fits = TRUE;
+
+  memset (hdr, 0, sizeof *hdr);
+  if (namelen <= sizeof hdr->name)
+    memcpy (hdr->name, name, namelen);
+  else
+    {
+      const char *s;
+
+      /* Split at a slash so that both parts fit.  */
+      for (s = name + namelen - 1; s > name; s--)
+        if (*s == '/' && (size_t) (s - name) <= sizeof hdr->prefix
+            && namelen - (s - name) - 1 <= sizeof hdr->name
+            && s[1])
+          break;
+      if (s > name)
+        {
+          memcpy (hdr->prefix, name, s - name);
+          memcpy (hdr->name, s + 1, namelen - (s - name) - 1);
+        }
+      else
+        {
+          /* Keep the tail for readers which don't know pax.  */
+          memcpy (hdr->name, name + namelen - sizeof hdr->name,
+                  sizeof hdr->name);
+          fits = FALSE;
+        }
+    }
+
+  put_octal (hdr->mode, sizeof hdr->mode, mode & 07777);
+  put_octal (hdr->uid, sizeof hdr->uid, 0);
+  put_octal (hdr->gid, sizeof hdr->gid, 0);
+  put_octal (hdr->size, sizeof hdr->size,
+             size > MAX_USTAR_SIZE ? 0 : size);
+  put_octal (hdr->mtime, sizeof hdr->mtime, mtime);
+  hdr->typeflag = typeflag;
+  memcpy (hdr->magic, "ustar", 6);
+  memcpy (hdr->version, "00", 2);
+
+  return fits;
+}
+
+
+/* Seal HDR by computing its checksum and append it to OUT.  */
+static void
+append_header (GString *out, struct ustar_header *hdr)
+{
+  snprintf (hdr->checksum, sizeof hdr->checksum, "%06o",
+            header_checksum (hdr));
+  hdr->checksum[7] = ' ';
+  g_string_append_len (out, (const char *) hdr, BLOCKSIZE);
+}
+
+
+/* Append the extended header of type TYPEFLAG with the records PAX
+   to OUT.  */
+static void
+append_pax_header (GString *out, int typeflag, GString *pax, guint64 mtime)
+{
+  struct ustar_header xhdr;
+
+  init_header (&xhdr, typeflag == 'g'? "././@PaxGlobal" : "././@PaxHeader",
+               typeflag, 0644, pax->len, mtime);
+  append_header (out, &xhdr);
+  g_string_append_len (out, pax->str, pax->len);
+  append_zeros (out, block_padding (pax->len));
+}
+
+
+
+/* The archive writer.  */
+
+struct dir_frame
+{
+  GDir *dir;
+  char *path;
+  char *arcname;
+};
+
+
+struct tar_writer_s
+{
+  /* The directories being walked, innermost first.  */
+  GSList *stack;
+
+  /* Header or padding data to be returned before anything else.  */
+  char *pending;
+  size_t pendlen;
+  size_t pendpos;
+
+  /* The file currently being archived.  */
+  int fd;
+  guint64 remaining;
+  size_t padding;
+
+  gboolean finished;
+  guint64 *counter;
+
+  /* The names of the members which are not archived.  */
+  GPtrArray *skipped;
+};
+
+
+static void
+set_pending (struct tar_writer_s *w, GString *str)
+{
+  g_free (w->pending);
+  w->pendlen = str->len;
+  w->pendpos = 0;
+  w->pending = g_string_free (str, FALSE);
+}
+
+
+/* Queue the headers for the member ARCNAME.  */
+static void
+add_member (struct tar_writer_s *w, const char *arcname, int typeflag,
+            const struct stat *st, guint64 size)
+{
+  GString *out = g_string_sized_new (3 * BLOCKSIZE);
+  GString *pax = g_string_new (NULL);
+  struct ustar_header hdr;
+
+  if (!init_header (&hdr, arcname, typeflag, st->st_mode, size, st->st_mtime))
+    add_pax_record (pax, "path", arcname);
+  if (size > MAX_USTAR_SIZE)
+    {
+      char buf[32];
+
+      snprintf (buf, sizeof buf, "%" G_GUINT64_FORMAT, size);
+      add_pax_record (pax, "size", buf);
+    }
+
+  if (pax->len)
+    append_pax_header (out, 'x', pax, st->st_mtime);
+  g_string_free (pax, TRUE);
+
+  append_header (out, &hdr);
+  set_pending (w, out);
+}
+
+
+static gboolean
+push_dir (struct tar_writer_s *w, const char *path, const char *arcname)
+{
+  struct dir_frame *frame;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (!dir)
+    {
+      if (!errno)
+        errno = EACCES;
+      return FALSE;
+    }
+
+  frame = g_malloc (sizeof *frame);
+  frame->dir = dir;
+  frame->path = g_strdup (path);
+  frame->arcname = g_strdup (arcname);
+  w->stack = g_slist_prepend (w->stack, frame);
+  return TRUE;
+}
+
+
+static void
+pop_dir (struct tar_writer_s *w)
+{
+  struct dir_frame *frame = w->stack->data;
+
+  w->stack = g_slist_delete_link (w->stack, w->stack);
+  g_dir_close (frame->dir);
+  g_free (frame->path);
+  g_free (frame->arcname);
+  g_free (frame);
+}
+
+
+/* Queue the next member of the walk.  Returns 0 on success, 1 if all
+   files have been archived and -1 on error with ERRNO set.  */
+static int
+next_member (struct tar_writer_s *w)
+{
+  while (w->stack)
+    {
+      struct dir_frame *frame = w->stack->data;
+      const char *name;
+      char *path, *arcname;
+      struct stat st;
+      int rc = 0;
+
+      name = g_dir_read_name (frame->dir);
+      if (!name)
+        {
+          pop_dir (w);
+          continue;
+        }
+
+      path = g_build_filename (frame->path, name, NULL);
+      arcname = g_strconcat (frame->arcname, "/", name, NULL);
+      if (g_lstat (path, &st))
+        rc = -1;
+      else if (S_ISDIR (st.st_mode))
+        {
+          char *dirname = g_strconcat (arcname, "/", NULL);
+
+          add_member (w, dirname, '5', &st, 0);
+          g_free (dirname);
+          if (!push_dir (w, path, arcname))
+            rc = -1;
+        }
+      else if (S_ISREG (st.st_mode))
+        {
+          w->fd = g_open (path, O_RDONLY | O_BINARY, 0);
+          if (w->fd == -1)
+            rc = -1;
+          else
+            {
+              add_member (w, arcname, '0', &st, st.st_size);
+              w->remaining = st.st_size;
+              w->padding = block_padding (st.st_size);
+            }
+        }
+      else
+        {
+          /* Symbolic links and special files can't be restored
+             safely; tell the caller about them.  */
+          if (w->skipped)
+            g_ptr_array_add (w->skipped, g_strdup (arcname));
+          rc = 1;
+        }
+      g_free (path);
+      g_free (arcname);
+
+      if (rc < 0)
+        return -1;
+      if (!rc)
+        return 0;
+    }
+
+  return 1;
+}
+
+
+static ssize_t
+tar_writer_read (void *opaque, void *buffer, size_t size)
+{
+  struct tar_writer_s *w = opaque;
+  ssize_t nread;
+  int rc;
+
+  if (!size)
+    return 0;
+
+  for (;;)
+    {
+      if (w->pendpos < w->pendlen)
+        {
+          nread = MIN (size, w->pendlen - w->pendpos);
+          memcpy (buffer, w->pending + w->pendpos, nread);
+          w->pendpos += nread;
+          return nread;
+        }
+
+      if (w->fd != -1)
+        {
+          if (w->remaining)
+            {
+              do
+                nread = read (w->fd, buffer, MIN (size, w->remaining));
+              while (nread == -1 && errno == EINTR);
+              if (nread == -1)
+                return -1;
+              if (!nread)
+                {
+                  /* The file has been truncated while we read it.
+                     Fill up with zeros to keep the archive valid.  */
+                  nread = MIN (size, w->remaining);
+                  memset (buffer, 0, nread);
+                }
+              w->remaining -= nread;
+              if (w->counter)
+                *w->counter += nread;
+              return nread;
+            }
+
+          close (w->fd);
+          w->fd = -1;
+          {
+            GString *pad = g_string_new (NULL);
+
+            append_zeros (pad, w->padding);
+            set_pending (w, pad);
+          }
+          continue;
+        }
+
+      if (w->finished)
+        return 0;
+
+      rc = next_member (w);
+      if (rc < 0)
+        return -1;
+      if (rc > 0)
+        {
+          GString *eof = g_string_new (NULL);
+
+          /* Two zero blocks mark the end of the archive.  */
+          append_zeros (eof, 2 * BLOCKSIZE);
+          set_pending (w, eof);
+          w->finished = TRUE;
+        }
+    }
+}
+
+
+static void
+tar_writer_release (void *opaque)
+{
+  struct tar_writer_s *w = opaque;
+
+  while (w->stack)
+    pop_dir (w);
+  if (w->fd != -1)
+    close (w->fd);
+  g_free (w->pending);
+  g_free (w);
+}
+
+
+static struct gpgme_data_cbs tar_writer_cbs =
+  {
+    tar_writer_read,
+    NULL,
+    NULL,
+    tar_writer_release
+  };
+
+
+/* Create a data object which reads as a tar archive of the directory
+   DIRNAME.  The archive is created on the fly while the data object
+   is read.  If COUNTER is not NULL, the number of bytes read from the
+   archived files is added to it.  If SKIPPED is not NULL, a malloced
+   copy of the name of each symbolic link or special file, which are
+   not archived, is added to it.  */
+gpg_error_t
+gpa_tar_data_new (gpgme_data_t *r_data, const char *dirname,
+                  guint64 *counter, GPtrArray *skipped)
+{
+  gpg_error_t err;
+  struct tar_writer_s *w;
+  struct stat st;
+  char *base, *arcname;
+
+  if (g_stat (dirname, &st))
+    return gpg_error_from_syserror ();
+  if (!S_ISDIR (st.st_mode))
+    return gpg_error (GPG_ERR_ENOTDIR);
+
+  w = g_malloc0 (sizeof *w);
+  w->fd = -1;
+  w->counter = counter;
+  w->skipped = skipped;
+
+  base = g_path_get_basename (dirname);
+  if (!push_dir (w, dirname, base))
+    {
+      err = gpg_error_from_syserror ();
+      g_free (base);
+      tar_writer_release (w);
+      return err;
+    }
+  arcname = g_strconcat (base, "/", NULL);
+  add_member (w, arcname, '5', &st, 0);
+  g_free (arcname);
+  g_free (base);
+
+  /* Put the marker in front of the first member.  */
+  {
+    GString *out = g_string_sized_new (4 * BLOCKSIZE);
+    GString *pax = g_string_new (NULL);
+
+    add_pax_record (pax, "comment", GPA_TAR_MARKER);
+    append_pax_header (out, 'g', pax, st.st_mtime);
+    g_string_free (pax, TRUE);
+    g_string_append_len (out, w->pending, w->pendlen);
+    set_pending (w, out);
+  }
+
+  err = gpgme_data_new_from_cbs (r_data, &tar_writer_cbs, w);
+  if (err)
+    tar_writer_release (w);
+  return err;
+}
+
+
+
+/* The archive reader.  */
+
+enum tar_reader_state
+  {
+    READ_HEADER,
+    READ_DATA,
+    READ_EXT,
+    READ_SKIP,
+    READ_END
+  };
+
+
+struct tar_reader_s
+{
+  /* The file descriptor receiving the archive itself.  */
+  int outfd;
+
+  /* The directory to be created and the staging directory the archive
+     is extracted to.  STAGEDIR is NULL if we gave up extracting.  */
+  char *destdir;
+  char *stagedir;
+
+  /* The first name component shared by all members.  */
+  char *topname;
+
+  enum tar_reader_state state;
+  gboolean have_marker;
+
+  union
+  {
+    struct ustar_header hdr;
+    char buf[BLOCKSIZE];
+  } header;
+  size_t hdrlen;
+  int zero_blocks;
+
+  /* The member currently being extracted.  */
+  int fd;
+  guint64 remaining;
+  size_t padding;
+
+  /* The data of an extended header ('x', 'g' or GNU 'L').  */
+  GString *ext;
+  int exttype;
+
+  /* Values from an extended header for the next member.  */
+  char *next_path;
+  gboolean have_next_size;
+  guint64 next_size;
+};
+
+
+/* Remove the file or directory tree PATH.  Returns 0 on success.  */
+static int
+remove_tree (const char *path)
+{
+  struct stat st;
+  GDir *dir;
+  const char *name;
+  int rc = 0;
+
+  if (g_lstat (path, &st))
+    return -1;
+  if (!S_ISDIR (st.st_mode))
+    return g_remove (path);
+
+  dir = g_dir_open (path, 0, NULL);
+  if (!dir)
+    return -1;
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *child = g_build_filename (path, name, NULL);
+
+      if (remove_tree (child))
+        rc = -1;
+      g_free (child);
+    }
+  g_dir_close (dir);
+  if (g_rmdir (path))
+    rc = -1;
+
+  return rc;
+}
+
+
+/* Stop extracting the archive because of REASON and remove what has
+   been extracted so far.  The archive is still written to the output
+   file.  */
+static void
+give_up (struct tar_reader_s *r, const char *reason)
+{
+  if (!r->stagedir)
+    return;
+
+  g_debug ("tar: not extracting to `%s': %s", r->destdir, reason);
+  if (r->fd != -1)
+    {
+      close (r->fd);
+      r->fd = -1;
+    }
+  if (remove_tree (r->stagedir))
+    g_debug ("tar: error removing `%s': %s", r->stagedir, strerror (errno));
+  g_free (r->stagedir);
+  r->stagedir = NULL;
+}
+
+
+/* Return the file name in the staging directory for the member NAME
+   or NULL if NAME can't be represented.  All members need to be
+   below the same top level directory; *R_TOPLEVEL is set if NAME is
+   that directory itself.  */
+static char *
+member_path (struct tar_reader_s *r, const char *name, gboolean *r_toplevel)
+{
+  char **parts;
+  char *result;
+  int i;
+  int ncomps = 0;
+
+  *r_toplevel = FALSE;
+  if (*name == '/')
+    return NULL;
+
+  parts = g_strsplit (name, "/", -1);
+  result = g_strdup (r->stagedir);
+  for (i = 0; parts[i]; i++)
+    {
+      char *tmp;
+
+      if (!*parts[i] || !strcmp (parts[i], "."))
+        continue;
+      if (!strcmp (parts[i], "..")
+#ifdef G_OS_WIN32
+          || strpbrk (parts[i], "\\:")
+#endif
+          )
+        {
+          g_free (result);
+          result = NULL;
+          break;
+        }
+      if (!ncomps++)
+        {
+          if (!r->topname)
+            r->topname = g_strdup (parts[i]);
+          else if (strcmp (r->topname, parts[i]))
+            {
+              g_free (result);
+              result = NULL;
+              break;
+            }
+        }
+      tmp = g_build_filename (result, parts[i], NULL);
+      g_free (result);
+      result = tmp;
+    }
+  g_strfreev (parts);
+
+  if (result && !ncomps)
+    {
+      g_free (result);
+      result = NULL;
+    }
+  else if (result && ncomps == 1)
+    *r_toplevel = TRUE;
+
+  return result;
+}
+
+
+/* Parse the extended header collected in R->EXT.  */
+static int
+parse_pax (struct tar_reader_s *r)
+{
+  const char *p = r->ext->str;
+  const char *end = p + r->ext->len;
+
+  while (p < end)
+    {
+      const char *rec = p;
+      const char *key, *eq;
+      unsigned long len = 0;
+
+      while (p < end && *p >= '0' && *p <= '9')
+        len = len * 10 + (*p++ - '0');
+      if (p >= end || *p != ' ' || !len || len > (unsigned long) (end - rec)
+          || rec[len - 1] != '\n')
+        return -1;
+      key = p + 1;
+      p = rec + len;
+      eq = memchr (key, '=', p - key);
+      if (!eq)
+        continue;
+
+      if (r->exttype == 'g')
+        {
+          if (eq - key == 7 && !strncmp (key, "comment", 7)
+              && (size_t) (p - eq - 2) == strlen (GPA_TAR_MARKER)
+              && !strncmp (eq + 1, GPA_TAR_MARKER, p - eq - 2))
+            r->have_marker = TRUE;
+        }
+      else if (eq - key == 4 && !strncmp (key, "path", 4))
+        {
+          g_free (r->next_path);
+          r->next_path = g_strndup (eq + 1, p - eq - 2);
+        }
+      else if (eq - key == 4 && !strncmp (key, "size", 4))
+        {
+          r->next_size = g_ascii_strtoull (eq + 1, NULL, 10);
+          r->have_next_size = TRUE;
+        }
+    }
+
+  return 0;
+}
+
+
+/* The data of the current member has been consumed.  */
+static void
+end_member (struct tar_reader_s *r)
+{
+  if (r->state == READ_DATA)
+    {
+      int rc = close (r->fd);
+
+      r->fd = -1;
+      if (rc)
+        give_up (r, strerror (errno));
+    }
+  else if (r->state == READ_EXT)
+    {
+      if (r->exttype == 'L')
+        {
+          /* A GNU long name is terminated by a Nul.  */
+          g_free (r->next_path);
+          r->next_path = g_strndup (r->ext->str, r->ext->len);
+        }
+      else if (parse_pax (r))
+        give_up (r, "invalid extended header");
+      g_string_free (r->ext, TRUE);
+      r->ext = NULL;
+    }
+
+  r->state = READ_HEADER;
+}
+
+
+/* Process the complete header block in R->HEADER.  */
+static void
+process_header (struct tar_reader_s *r)
+{
+  struct ustar_header *hdr = &r->header.hdr;
+  char *name = NULL;
+  char *path = NULL;
+  const char *problem = NULL;
+  gboolean toplevel;
+  guint64 size;
+  unsigned int mode;
+  size_t i;
+
+  for (i = 0; i < BLOCKSIZE && !r->header.buf[i]; i++)
+    ;
+  if (i == BLOCKSIZE)
+    {
+      if (++r->zero_blocks == 2)
+        r->state = READ_END;
+      return;
+    }
+  r->zero_blocks = 0;
+
+  if (get_octal (hdr->checksum, sizeof hdr->checksum) != header_checksum (hdr)
+      || memcmp (hdr->magic, "ustar", 5))
+    {
+      give_up (r, "invalid header");
+      return;
+    }
+
+  size = get_octal (hdr->size, sizeof hdr->size);
+  mode = get_octal (hdr->mode, sizeof hdr->mode) & 0777;
+
+  if (hdr->typeflag == 'g' || hdr->typeflag == 'x' || hdr->typeflag == 'L')
+    {
+      if (size > MAX_PAX_SIZE)
+        {
+          give_up (r, "extended header too large");
+          return;
+        }
+      r->ext = g_string_sized_new (size);
+      r->exttype = hdr->typeflag;
+      r->state = READ_EXT;
+      goto leave;
+    }
+
+  /* The marker needs to come first.  */
+  if (!r->have_marker)
+    {
+      give_up (r, "archive not created by GPA");
+      return;
+    }
+
+  if (r->have_next_size)
+    size = r->next_size;
+  r->have_next_size = FALSE;
+  if (r->next_path)
+    {
+      name = r->next_path;
+      r->next_path = NULL;
+    }
+  else if (hdr->prefix[0])
+    name = g_strdup_printf ("%.*s/%.*s",
+                            (int) sizeof hdr->prefix, hdr->prefix,
+                            (int) sizeof hdr->name, hdr->name);
+  else
+    name = g_strndup (hdr->name, sizeof hdr->name);
+
+  r->state = READ_SKIP;
+  if (hdr->typeflag == '5')
+    {
+      path = member_path (r, name, &toplevel);
+      if (!path)
+        problem = "invalid member name";
+      else if (g_mkdir_with_parents (path, mode | 0700))
+        problem = strerror (errno);
+    }
+  else if (hdr->typeflag == '0' || hdr->typeflag == '\0'
+           || hdr->typeflag == '7')
+    {
+      path = member_path (r, name, &toplevel);
+      if (!path || toplevel)
+        problem = "invalid member name";
+      else
+        {
+          char *dir = g_path_get_dirname (path);
+
+          if (g_mkdir_with_parents (dir, 0777))
+            problem = strerror (errno);
+          g_free (dir);
+          if (!problem)
+            {
+              r->fd = g_open (path, O_WRONLY | O_CREAT | O_EXCL | O_BINARY,
+                              mode | 0600);
+              if (r->fd == -1)
+                problem = strerror (errno);
+              else
+                r->state = READ_DATA;
+            }
+        }
+    }
+  else
+    problem = "member type not supported";
+
+  if (problem)
+    {
+      char *reason = g_strdup_printf ("%s: %s", name, problem);
+
+      give_up (r, reason);
+      g_free (reason);
+    }
+  g_free (path);
+  g_free (name);
+  if (!r->stagedir)
+    return;
+
+ leave:
+  r->remaining = size;
+  r->padding = block_padding (size);
+  if (!r->remaining && !r->padding)
+    end_member (r);
+}
+
+
+static ssize_t
+tar_reader_write (void *opaque, const void *buffer, size_t size)
+{
+  struct tar_reader_s *r = opaque;
+  const char *p = buffer;
+  size_t left = size;
+  size_t done = 0;
+
+  /* The archive itself is always written so that we can fall back
+     to it if it can't be extracted.  */
+  while (done < size)
+    {
+      ssize_t nwritten = write (r->outfd, p + done, size - done);
+
+      if (nwritten == -1 && errno == EINTR)
+        continue;
+      if (nwritten <= 0)
+        return -1;
+      done += nwritten;
+    }
+
+  while (left && r->stagedir && r->state != READ_END)
+    {
+      size_t n;
+
+      switch (r->state)
+        {
+        case READ_HEADER:
+          n = MIN (left, BLOCKSIZE - r->hdrlen);
+          memcpy (r->header.buf + r->hdrlen, p, n);
+          r->hdrlen += n;
+          if (r->hdrlen == BLOCKSIZE)
+            {
+              r->hdrlen = 0;
+              process_header (r);
+            }
+          break;
+
+        default:
+          if (r->remaining)
+            {
+              n = MIN (left, r->remaining);
+              if (r->state == READ_DATA)
+                {
+                  ssize_t nwritten;
+                  size_t written = 0;
+
+                  while (written < n)
+                    {
+                      nwritten = write (r->fd, p + written, n - written);
+                      if (nwritten == -1 && errno == EINTR)
+                        continue;
+                      if (nwritten <= 0)
+                        {
+                          give_up (r, strerror (errno? errno : ENOSPC));
+                          break;
+                        }
+                      written += nwritten;
+                    }
+                }
+              else if (r->state == READ_EXT)
+                g_string_append_len (r->ext, p, n);
+              r->remaining -= n;
+            }
+          else
+            {
+              n = MIN (left, r->padding);
+              r->padding -= n;
+            }
+          if (r->stagedir && !r->remaining && !r->padding)
+            end_member (r);
+          break;
+        }
+
+      p += n;
+      left -= n;
+    }
+
+  return size;
+}
+
+
+static struct gpgme_data_cbs tar_reader_cbs =
+  {
+    NULL,
+    tar_reader_write,
+    NULL,
+    NULL
+  };
+
+
+/* Create a data object which writes a tar archive to the file
+   descriptor OUTFD and extracts it at the same time.  The extracted
+   archive is moved to DESTDIR by gpa_untar_finish.  */
+gpg_error_t
+gpa_untar_data_new (gpgme_data_t *r_data, gpa_untar_t *r_untar,
+                    const char *destdir, int outfd)
+{
+  gpg_error_t err = 0;
+  struct tar_reader_s *r;
+  int i;
+
+  r = g_malloc0 (sizeof *r);
+  r->outfd = outfd;
+  r->destdir = g_strdup (destdir);
+  r->state = READ_HEADER;
+  r->fd = -1;
+
+  /* The staging directory is created next to DESTDIR so that it can
+     be renamed.  */
+  for (i = 0; i < 100 && !r->stagedir; i++)
+    {
+      r->stagedir = g_strdup_printf ("%s.%08x", destdir, g_random_int ());
+      if (g_mkdir (r->stagedir, 0700))
+        {
+          err = gpg_error_from_syserror ();
+          g_free (r->stagedir);
+          r->stagedir = NULL;
+          if (gpg_err_code (err) != GPG_ERR_EEXIST)
+            break;
+        }
+    }
+  if (!r->stagedir)
+    {
+      gpa_untar_abort (r);
+      return err;
+    }
+
+  err = gpgme_data_new_from_cbs (r_data, &tar_reader_cbs, r);
+  if (err)
+    {
+      gpa_untar_abort (r);
+      return err;
+    }
+
+  *r_untar = r;
+  return 0;
+}
+
+
+/* Release the state of R without touching the file system.  */
+static void
+untar_release (struct tar_reader_s *r)
+{
+  if (r->ext)
+    g_string_free (r->ext, TRUE);
+  g_free (r->stagedir);
+  g_free (r->next_path);
+  g_free (r->topname);
+  g_free (r->destdir);
+  g_free (r);
+}
+
+
+/* Finish the extraction.  This must be called after the data object
+   has been released.  If the archive has been extracted completely,
+   it is moved to the target directory and a malloced copy of its name
+   is returned.  Otherwise everything extracted is removed and NULL is
+   returned; the output file then holds the archive.  UNTAR is
+   released in any case.  */
+char *
+gpa_untar_finish (gpa_untar_t r)
+{
+  char *result = NULL;
+
+  if (!r->stagedir)
+    ;
+  else if (r->state != READ_END)
+    give_up (r, "archive is incomplete");
+  else if (!r->topname)
+    give_up (r, "archive is empty");
+  else if (g_file_test (r->destdir, G_FILE_TEST_EXISTS))
+    give_up (r, "target exists");
+  else
+    {
+      char *top = g_build_filename (r->stagedir, r->topname, NULL);
+
+      if (g_rename (top, r->destdir))
+        give_up (r, strerror (errno));
+      else
+        {
+          g_rmdir (r->stagedir);
+          result = g_strdup (r->destdir);
+        }
+      g_free (top);
+    }
+
+  untar_release (r);
+  return result;
+}
+
+
+/* Release UNTAR and remove everything extracted so far.  */
+void
+gpa_untar_abort (gpa_untar_t r)
+{
+  if (!r)
+    return;
+
+  give_up (r, "aborted");
+  untar_release (r);
+}
@@ -0,0 +1,52 @@
+/* tarstream.h - Streaming tar archives for gpgme data objects.
+   Copyright (C) 2026 g10 Code GmbH
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef TARSTREAM_H
+#define TARSTREAM_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* Create a data object which reads as a tar archive of the directory
+   DIRNAME.  The archive is created on the fly while the data object
+   is read.  If COUNTER is not NULL, the number of bytes read from the
+   archived files is added to it.  If SKIPPED is not NULL, a malloced
+   copy of the name of each symbolic link or special file, which are
+   not archived, is added to it.  */
+gpg_error_t gpa_tar_data_new (gpgme_data_t *r_data, const char *dirname,
+                              guint64 *counter, GPtrArray *skipped);
+
+/* The state of an archive extraction.  */
+typedef struct tar_reader_s *gpa_untar_t;
+
+/* Create a data object which writes a tar archive to the file
+   descriptor OUTFD and extracts it at the same time.  The extracted
+   archive is moved to DESTDIR by gpa_untar_finish.  */
+gpg_error_t gpa_untar_data_new (gpgme_data_t *r_data, gpa_untar_t *r_untar,
+                                const char *destdir, int outfd);
+
+/* Finish the extraction after the data object has been released.
+   Returns a malloced copy of the directory name if the archive has
+   been extracted or NULL if only the archive file has been written.
+   UNTAR is released.  */
+char *gpa_untar_finish (gpa_untar_t untar);
+
+/* Release UNTAR and remove everything extracted so far.  */
+void gpa_untar_abort (gpa_untar_t untar);
+
+#endif /*TARSTREAM_H*/
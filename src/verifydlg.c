@@ -439,3 +439,170 @@ void gpa_file_verify_dialog_add_file (GpaFileVerifyDialog *dialog,
   gtk_notebook_append_page (GTK_NOTEBOOK (dialog->notebook), page,
 			    gtk_label_new (filename));
 }
+
+
+/* Columns of the summary table.  */
+typedef enum
+{
+  SUM_FILE_COLUMN,
+  SUM_SIGFILE_COLUMN,
+  SUM_STATUS_COLUMN,
+  SUM_RANK_COLUMN,
+  SUM_KEYID_COLUMN,
+  SUM_USERID_COLUMN,
+  SUM_N_COLUMNS
+} SummaryListColumn;
+
+
+/* Return a sort rank for the signature summary SUMMARY so that
+   problems are listed first.  The order matches the checks in
+   signature_status_label.  */
+static int
+signature_rank (unsigned long summary)
+{
+  if (summary & GPGME_SIGSUM_VALID)
+    return 6;
+  else if (summary & GPGME_SIGSUM_RED)
+    return 1;
+  else if (summary & GPGME_SIGSUM_KEY_MISSING)
+    return 2;
+  else if (summary & GPGME_SIGSUM_KEY_REVOKED)
+    return 3;
+  else if (summary & GPGME_SIGSUM_KEY_EXPIRED)
+    return 4;
+  else
+    return 5;
+}
+
+
+static void
+add_summary_column (GtkWidget *list, const gchar *title, const char *attr,
+		    int column, int sort_column)
+{
+  GtkTreeViewColumn *col;
+  GtkCellRenderer *renderer;
+
+  renderer = gtk_cell_renderer_text_new ();
+  col = gtk_tree_view_column_new_with_attributes (title, renderer,
+						  attr, column, NULL);
+  gtk_tree_view_column_set_sort_column_id (col, sort_column);
+  gtk_tree_view_column_set_resizable (col, TRUE);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (list), col);
+}
+
+
+/* Create the summary page as the first page of DIALOG.  */
+static void
+create_summary_page (GpaFileVerifyDialog *dialog)
+{
+  GtkWidget *list;
+  GtkWidget *scrolled;
+
+  dialog->summary = gtk_list_store_new (SUM_N_COLUMNS, G_TYPE_STRING,
+					G_TYPE_STRING, G_TYPE_STRING,
+					G_TYPE_INT, G_TYPE_STRING,
+					G_TYPE_STRING);
+  list = gtk_tree_view_new_with_model (GTK_TREE_MODEL (dialog->summary));
+  /* The view holds the reference.  */
+  g_object_unref (dialog->summary);
+  gtk_tree_view_set_rules_hint (GTK_TREE_VIEW (list), TRUE);
+  gtk_widget_set_size_request (list, 600, 300);
+
+  add_summary_column (list, _("File"), "text",
+		      SUM_FILE_COLUMN, SUM_FILE_COLUMN);
+  add_summary_column (list, _("Status"), "markup",
+		      SUM_STATUS_COLUMN, SUM_RANK_COLUMN);
+  add_summary_column (list, _("Key ID"), "text",
+		      SUM_KEYID_COLUMN, SUM_KEYID_COLUMN);
+  add_summary_column (list, _("User Name"), "text",
+		      SUM_USERID_COLUMN, SUM_USERID_COLUMN);
+  add_summary_column (list, _("Signature"), "text",
+		      SUM_SIGFILE_COLUMN, SUM_SIGFILE_COLUMN);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (dialog->summary),
+					SUM_RANK_COLUMN, GTK_SORT_ASCENDING);
+
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled),
+				       GTK_SHADOW_IN);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+				  GTK_POLICY_AUTOMATIC,
+				  GTK_POLICY_AUTOMATIC);
+  gtk_container_set_border_width (GTK_CONTAINER (scrolled), 5);
+  gtk_container_add (GTK_CONTAINER (scrolled), list);
+  gtk_widget_show_all (scrolled);
+
+  gtk_notebook_prepend_page (GTK_NOTEBOOK (dialog->notebook), scrolled,
+			     gtk_label_new (_("Summary")));
+}
+
+
+/* Add the result of verifying FILENAME to the summary table.  ERR is
+   the error of the verification.  */
+void
+gpa_file_verify_dialog_add_summary (GpaFileVerifyDialog *dialog,
+				    const gchar *filename,
+				    const gchar *signature_file,
+				    gpgme_signature_t sigs,
+				    gpg_error_t err)
+{
+  GtkTreeIter iter;
+  gpgme_signature_t sig;
+
+  if (!dialog->summary)
+    create_summary_page (dialog);
+
+  if (err || !sigs)
+    {
+      gchar *status;
+
+      status = g_markup_printf_escaped
+	("<span foreground=\"red\" weight=\"bold\">%s</span>",
+	 err ? gpg_strerror (err) : _("No signature"));
+      gtk_list_store_insert_with_values (dialog->summary, &iter, G_MAXINT,
+					 SUM_FILE_COLUMN, filename,
+					 SUM_SIGFILE_COLUMN,
+					 signature_file ? signature_file : "",
+					 SUM_STATUS_COLUMN, status,
+					 SUM_RANK_COLUMN, 0,
+					 SUM_KEYID_COLUMN, "",
+					 SUM_USERID_COLUMN, "",
+					 -1);
+      g_free (status);
+      return;
+    }
+
+  for (sig = sigs; sig; sig = sig->next)
+    {
+      SignatureData data;
+      const gchar *keyid;
+      gchar *status;
+
+      memset (&data, 0, sizeof data);
+      data.summary = sig->summary;
+      data.sigdesc = gpa_gpgme_get_signature_desc (dialog->ctx->ctx, sig,
+						   &data.keydesc, &data.key);
+      if (data.key)
+	keyid = gpa_gpgme_key_get_short_keyid (data.key);
+      else if (sig->fpr && strlen (sig->fpr) > 8)
+	keyid = sig->fpr + strlen (sig->fpr) - 8;
+      else
+	keyid = "";
+      status = signature_status_label (&data);
+
+      gtk_list_store_insert_with_values
+	(dialog->summary, &iter, G_MAXINT,
+	 SUM_FILE_COLUMN, filename,
+	 SUM_SIGFILE_COLUMN, signature_file ? signature_file : "",
+	 SUM_STATUS_COLUMN, status,
+	 SUM_RANK_COLUMN, signature_rank (sig->summary),
+	 SUM_KEYID_COLUMN, keyid,
+	 SUM_USERID_COLUMN,
+	 data.keydesc ? data.keydesc : _("[Unknown user ID]"),
+	 -1);
+
+      g_free (status);
+      gpgme_key_unref (data.key);
+      g_free (data.sigdesc);
+      g_free (data.keydesc);
+    }
+}
@@ -41,6 +41,8 @@ struct _GpaFileVerifyDialog {
   GtkDialog parent;
 
   GtkWidget *notebook;
+  /* The list of results in batch mode or NULL.  */
+  GtkListStore *summary;
   /* Context for retrieving signature's keys */
   GpaContext *ctx;
 };
@@ -64,4 +66,12 @@ void gpa_file_verify_dialog_add_file (GpaFileVerifyDialog *dialog,
 				      const gchar *signature_file,
 				      gpgme_signature_t sigs);
 
+/* Add the result of verifying FILENAME to the summary table.  ERR is
+   the error of the verification.  */
+void gpa_file_verify_dialog_add_summary (GpaFileVerifyDialog *dialog,
+                                         const gchar *filename,
+                                         const gchar *signature_file,
+                                         gpgme_signature_t sigs,
+                                         gpg_error_t err);
+
 #endif